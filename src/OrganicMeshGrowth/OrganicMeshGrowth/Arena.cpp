@@ -0,0 +1,63 @@
+#include "Arena.h"
+#include <cstdint>
+#include <new>
+
+Arena::Arena(size_t blockSize) : blockSize(blockSize)
+{
+}
+
+Arena::~Arena()
+{
+	Reset();
+}
+
+void * Arena::Allocate(size_t size, size_t alignment)
+{
+	if (!blocks.empty())
+	{
+		Block & block = blocks.back();
+		uintptr_t address = reinterpret_cast<uintptr_t>(block.data) + block.used;
+		size_t padding = (alignment - address % alignment) % alignment;
+
+		if (block.used + padding + size <= block.size)
+		{
+			block.used += padding + size;
+			return block.data + block.used - size;
+		}
+	}
+
+	// Oversized requests get a block of their own
+	Block block;
+	block.size = size + alignment > blockSize ? size + alignment : blockSize;
+	block.data = static_cast<char*>(::operator new(block.size));
+
+	uintptr_t address = reinterpret_cast<uintptr_t>(block.data);
+	size_t padding = (alignment - address % alignment) % alignment;
+	block.used = padding + size;
+
+	// Keep the block with free space at the back, so small allocations can still use it
+	if (!blocks.empty() && block.size - block.used < blocks.back().size - blocks.back().used)
+		blocks.insert(blocks.end() - 1, block);
+	else
+		blocks.push_back(block);
+
+	return block.data + padding;
+}
+
+void Arena::Reset()
+{
+	for (Block& block : blocks)
+		::operator delete(block.data);
+
+	blocks.clear();
+}
+
+size_t Arena::GetReservedSize() const
+{
+	size_t size = 0;
+
+	for (const Block& block : blocks)
+		size += block.size;
+
+	return size;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#define ARENA_DEFAULT_BLOCK_SIZE (64 * 1024 * 1024)
+
+// Bump allocator for large, short lived arrays that are all released at once.
+// Nothing is destructed, so it is only meant for plain data.
+class Arena
+{
+public:
+	explicit Arena(size_t blockSize = ARENA_DEFAULT_BLOCK_SIZE);
+	~Arena();
+
+	Arena(const Arena&) = delete;
+	Arena& operator=(const Arena&) = delete;
+
+	void * Allocate(size_t size, size_t alignment = 16);
+
+	template<typename T>
+	T * AllocateArray(size_t count)
+	{
+		return static_cast<T*>(Allocate(sizeof(T) * count, alignof(T) > 16 ? alignof(T) : 16));
+	}
+
+	// Frees every block
+	void Reset();
+
+	size_t GetReservedSize() const;
+
+private:
+	struct Block
+	{
+		char * data;
+		size_t size;
+		size_t used;
+	};
+
+	std::vector<Block> blocks;
+	size_t blockSize;
+};
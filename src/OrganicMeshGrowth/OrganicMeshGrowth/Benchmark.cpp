@@ -0,0 +1,1585 @@
+#include "Benchmark.h"
+#include "FileUtils.h"
+#include "GrowthSimulator.h"
+#include "Mesh.h"
+#include "MeshQuery.h"
+#include "NoiseBaker.h"
+#include "ObjParser.h"
+#include "Parallel.h"
+#include "SdfBaker.h"
+#include "SdfGraph.h"
+#include "TaskScheduler.h"
+#include "WindingNumber.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <thread>
+
+// ShaderNoiseTexel is compared bit for bit with NoiseBaker, which is built without fused multiply-adds
+#if defined(__clang__)
+#pragma STDC FP_CONTRACT OFF
+#elif defined(__GNUC__)
+#pragma GCC optimize("fp-contract=off")
+#elif defined(_MSC_VER)
+#pragma fp_contract(off)
+#endif
+
+using namespace std::chrono;
+
+namespace {
+	typedef bool(*ObjLoadFunction)(const std::string&, ObjData&, std::string&);
+
+	size_t FileSize(const std::string& filename)
+	{
+		std::ifstream file(filename, std::ios::ate | std::ios::binary);
+		return file.is_open() ? static_cast<size_t>(file.tellg()) : 0;
+	}
+
+	// Best of N, to filter out page cache warmup and scheduling noise
+	double BestLoadTime(ObjLoadFunction load, const std::string& filename, int iterations, ObjData& data)
+	{
+		double best = std::numeric_limits<double>::max();
+
+		for (int i = 0; i < iterations; ++i)
+		{
+			data = ObjData();
+			std::string error;
+
+			high_resolution_clock::time_point start = high_resolution_clock::now();
+			bool loaded = load(filename, data, error);
+			duration<double> elapsed = high_resolution_clock::now() - start;
+
+			if (!loaded)
+			{
+				std::cout << "Failed to load " << filename << ": " << error << std::endl;
+				return 0.0;
+			}
+
+			best = std::min(best, elapsed.count());
+		}
+
+		return best;
+	}
+
+	// Evaluates the distance at the center of every voxel of a resolution^3 grid over [-1, 1]^3
+	void QueryGrid(const CompactKdTree& tree, int resolution, std::vector<float>& distances, MeshQueryStats& stats)
+	{
+		MeshQuery query(tree);
+		std::vector<MeshQueryStats> sliceStats(resolution);
+		distances.resize(static_cast<size_t>(resolution) * resolution * resolution);
+
+		Parallel::For(resolution, [&](int z) {
+			for (int y = 0; y < resolution; ++y)
+			{
+				for (int x = 0; x < resolution; ++x)
+				{
+					glm::vec3 p = (glm::vec3(x, y, z) / static_cast<float>(resolution)) * 2.f - 1.f;
+					distances[(static_cast<size_t>(z) * resolution + y) * resolution + x] = query.Distance(p, sliceStats[z]);
+				}
+			}
+		});
+
+		for (const MeshQueryStats& s : sliceStats)
+		{
+			stats.queries += s.queries;
+			stats.nodeVisits += s.nodeVisits;
+			stats.leafVisits += s.leafVisits;
+			stats.backtracks += s.backtracks;
+			stats.triangleTests += s.triangleTests;
+		}
+	}
+
+	// perlin3D as generator.comp evaluates it, hashing all eight corners every time
+	float ShaderPerlin(const glm::vec3& p)
+	{
+		glm::vec3 p1 = glm::floor(p);
+		float influences[8];
+
+		for (int corner = 0; corner < 8; ++corner)
+		{
+			glm::vec3 c = p1 + glm::vec3(corner & 1, (corner >> 1) & 1, corner >> 2);
+			influences[corner] = glm::dot(p - c, NoiseBaker::Gradient(c));
+		}
+
+		auto fade = [](float t) { float t3 = t * t * t; return 6.f * t3 * t * t - 15.f * t3 * t + 10.f * t3; };
+		auto mix = [](float a, float b, float t) { return a * (1.f - t) + b * t; };
+
+		float fX = fade(p.x - p1.x);
+		float fY = fade(p.y - p1.y);
+		float fZ = fade(p.z - p1.z);
+
+		float m1 = mix(mix(influences[0], influences[1], fX), mix(influences[2], influences[3], fX), fY);
+		float m2 = mix(mix(influences[4], influences[5], fX), mix(influences[6], influences[7], fX), fY);
+		return mix(m1, m2, fZ) * 0.707213578f + .5f;
+	}
+
+	// The vector field texel of main() in generator.comp: curl3D and worley3D
+	glm::vec4 ShaderNoiseTexel(const NoiseParameters& parameters, int resolution, const glm::ivec3& coord)
+	{
+		glm::vec3 nPos = (glm::vec3(coord) / static_cast<float>(resolution)) * 2.f - 1.f;
+		glm::vec3 p = nPos * parameters.curlFrequency + parameters.curlOffset;
+		float e = parameters.curlEpsilon;
+		glm::vec3 ex(e, 0.f, 0.f), ey(0.f, e, 0.f), ez(0.f, 0.f, e);
+		glm::vec3 n2(27.f, 13.f, 41.f), n3(35.f, 85.f, -30.f);
+
+		float dN1dy = ShaderPerlin(p + ey) - ShaderPerlin(p - ey);
+		float dN1dz = ShaderPerlin(p + ez) - ShaderPerlin(p - ez);
+		float dN2dx = ShaderPerlin(p + ex + n2) - ShaderPerlin(p - ex + n2);
+		float dN2dz = ShaderPerlin(p + ez + n2) - ShaderPerlin(p - ez + n2);
+		float dN3dx = ShaderPerlin(p + ex + n3) - ShaderPerlin(p - ex + n3);
+		float dN3dy = ShaderPerlin(p + ey + n3) - ShaderPerlin(p - ey + n3);
+
+		glm::vec3 w = nPos * parameters.worleyFrequency + parameters.worleyOffset;
+		glm::ivec3 pos(w);
+		float minDistance = 100000.f;
+
+		for (int k = pos.z - 1; k <= pos.z + 1; ++k)
+			for (int j = pos.y - 1; j <= pos.y + 1; ++j)
+				for (int i = pos.x - 1; i <= pos.x + 1; ++i)
+					minDistance = std::min(minDistance, glm::length(NoiseBaker::FeaturePoint(glm::vec3(i, j, k)) - w));
+
+		float t = glm::clamp((minDistance - parameters.worleyInner) / (parameters.worleyOuter - parameters.worleyInner), 0.f, 1.f);
+		return glm::vec4(glm::vec3(dN3dy - dN2dz, dN1dz - dN3dx, dN2dx - dN1dy) / e, 1.f - t * t * (3.f - 2.f * t));
+	}
+
+	// imageLoads of SourceMeshSDF per updated cell in kernel.comp, plus the one of the derivative field when it has one
+	int KernelLoads(const GrowthBehaviour& behaviour, bool derivativeField)
+	{
+		int width = 2 * behaviour.relaxationRadius + 1;
+		int loads = width * width * width + 1;		// Relaxation neighbourhood and the cell itself
+
+		if (derivativeField)
+			loads += behaviour.UsesNormal() || behaviour.UsesCurvature() ? 1 : 0;
+		else
+			loads += (behaviour.UsesNormal() ? 6 : 0) + (behaviour.UsesCurvature() ? 7 : 0);
+
+		loads += behaviour.repulsion.enabled ? 8 : 0;
+		return loads;
+	}
+
+	// derivatives.comp always writes the normal, curv2 only with an offset
+	int DerivativePassLoads(const GrowthBehaviour& behaviour)
+	{
+		return 6 + (behaviour.UsesCurvature() ? 7 : 0);
+	}
+
+	// Loads per cell of the relaxation box: the kernel loop, or the two relaxation.comp passes plus the z sums in the kernel
+	int RelaxationLoads(int radius, bool separable)
+	{
+		int width = 2 * radius + 1;
+		return separable ? 3 * width : width * width * width;
+	}
+}
+
+void Benchmark::ObjParsing(const std::vector<std::string>& meshes, int iterations)
+{
+	std::cout << "---------------------------------------------" << std::endl;
+	std::cout << "obj parsing, best of " << iterations << std::endl;
+	std::cout << std::left << std::setw(32) << "mesh" << std::setw(12) << "MB" << std::setw(14) << "tinyobj MB/s" << std::setw(14) << "parallel MB/s" << "speedup" << std::endl;
+
+	for (const std::string& mesh : meshes)
+	{
+		double megabytes = FileSize(mesh) / (1024.0 * 1024.0);
+
+		ObjData reference;
+		ObjData parallel;
+		double tinyObjTime = BestLoadTime(ObjParser::LoadWithTinyObj, mesh, iterations, reference);
+		double parallelTime = BestLoadTime(ObjParser::Load, mesh, iterations, parallel);
+
+		if (tinyObjTime <= 0.0 || parallelTime <= 0.0)
+			continue;
+
+		std::cout << std::left << std::setw(32) << mesh << std::setw(12) << std::setprecision(3) << megabytes
+			<< std::setw(14) << megabytes / tinyObjTime << std::setw(14) << megabytes / parallelTime
+			<< tinyObjTime / parallelTime << "x" << std::endl;
+
+		// Same bits, not only the same counts
+		bool samePositions = reference.positions.size() == parallel.positions.size()
+			&& std::memcmp(reference.positions.data(), parallel.positions.data(), parallel.positions.size() * sizeof(glm::vec3)) == 0;
+
+		if (reference.indices != parallel.indices || !samePositions)
+			std::cout << "  WARNING: parsers disagree on " << mesh << std::endl;
+	}
+
+	std::cout << "---------------------------------------------" << std::endl;
+}
+
+void Benchmark::KdTreeSplits(const std::vector<std::string>& meshes, int resolution)
+{
+	const KdSplitMethod methods[] = { KdSplitMethod::Median, KdSplitMethod::SAH, KdSplitMethod::SAH };
+	const bool spatialSplits[] = { false, false, true };
+	const char * methodNames[] = { "median", "sah", "sah+clip" };
+
+	std::cout << "---------------------------------------------" << std::endl;
+	std::cout << "kd-tree split methods, " << resolution << "^3 distance queries" << std::endl;
+	std::cout << std::left << std::setw(32) << "mesh" << std::setw(10) << "split" << std::setw(10) << "nodes" << std::setw(12) << "references" << std::setw(10) << "MB"
+		<< std::setw(12) << "build ms" << std::setw(14) << "nodes/voxel" << std::setw(14) << "tests/voxel" << "query ns/voxel" << std::endl;
+
+	for (const std::string& mesh : meshes)
+	{
+		ObjData obj;
+		std::string error;
+
+		if (!ObjParser::Load(mesh, obj, error))
+		{
+			std::cout << "Failed to load " << mesh << ": " << error << std::endl;
+			continue;
+		}
+
+		Arena arena;
+		TriangleSoup soup;
+		soup.Load(arena, obj, 1.f);
+
+		std::vector<float> reference;
+
+		for (int m = 0; m < 3; ++m)
+		{
+			high_resolution_clock::time_point start = high_resolution_clock::now();
+			Mesh kdMesh(9, 5, soup, methods[m], spatialSplits[m]);
+			kdMesh.Build();
+			duration<double, std::milli> buildTime = high_resolution_clock::now() - start;
+
+			CompactKdTree tree = kdMesh.GetCompactKdTree();
+			std::vector<float> distances;
+			MeshQueryStats stats;
+
+			start = high_resolution_clock::now();
+			QueryGrid(tree, resolution, distances, stats);
+			duration<double, std::nano> queryTime = high_resolution_clock::now() - start;
+
+			double queries = static_cast<double>(stats.queries);
+			double megabytes = (tree.nodeCount * sizeof(CompactNode) + tree.triangleCount * sizeof(TriangleData) + tree.leafIndexCount * sizeof(int)) / (1024.0 * 1024.0);
+
+			std::cout << std::left << std::setw(32) << mesh << std::setw(10) << methodNames[m] << std::setw(10) << tree.nodeCount << std::setw(12) << tree.leafIndexCount
+				<< std::setw(10) << std::setprecision(4) << megabytes << std::setw(12) << buildTime.count() << std::setw(14) << stats.nodeVisits / queries
+				<< std::setw(14) << stats.triangleTests / queries << queryTime.count() / queries << std::endl;
+
+			// All trees hold the same triangles, so the field should only differ where the traversal limits kick in
+			if (m == 0)
+			{
+				reference.swap(distances);
+			}
+			else
+			{
+				size_t mismatches = 0;
+
+				for (size_t i = 0; i < distances.size(); ++i)
+					mismatches += std::abs(distances[i] - reference[i]) > 1e-4f;
+
+				if (mismatches > 0)
+					std::cout << "  " << mismatches << " voxels differ between split methods" << std::endl;
+			}
+		}
+	}
+
+	std::cout << "---------------------------------------------" << std::endl;
+}
+
+void Benchmark::KdTreeBuildScaling(const std::vector<std::string>& meshes, int iterations)
+{
+	TaskScheduler & scheduler = TaskScheduler::Get();
+	unsigned int originalThreadCount = scheduler.GetThreadCount();
+	unsigned int maxThreads = std::max(1u, std::thread::hardware_concurrency());
+
+	std::vector<unsigned int> threadCounts;
+
+	for (unsigned int t = 1; t < maxThreads; t *= 2)
+		threadCounts.push_back(t);
+
+	threadCounts.push_back(maxThreads);
+
+	std::cout << "---------------------------------------------" << std::endl;
+	std::cout << "kd-tree build scaling, best of " << iterations << std::endl;
+	std::cout << std::left << std::setw(32) << "mesh" << std::setw(10) << "threads" << std::setw(12) << "build ms" << std::setw(10) << "speedup" << "output" << std::endl;
+
+	for (const std::string& mesh : meshes)
+	{
+		ObjData obj;
+		std::string error;
+
+		if (!ObjParser::Load(mesh, obj, error))
+		{
+			std::cout << "Failed to load " << mesh << ": " << error << std::endl;
+			continue;
+		}
+
+		Arena arena;
+		TriangleSoup soup;
+		soup.Load(arena, obj, 1.f);
+
+		double serialTime = 0.0;
+		uint64_t serialHash = 0;
+
+		for (unsigned int threads : threadCounts)
+		{
+			scheduler.SetThreadCount(threads);
+
+			double best = std::numeric_limits<double>::max();
+			uint64_t hash = 0;
+
+			for (int i = 0; i < iterations; ++i)
+			{
+				high_resolution_clock::time_point start = high_resolution_clock::now();
+				Mesh kdMesh(9, 5, soup);
+				kdMesh.Build();
+				duration<double, std::milli> elapsed = high_resolution_clock::now() - start;
+				best = std::min(best, elapsed.count());
+
+				CompactKdTree tree = kdMesh.GetCompactKdTree();
+				hash = FileUtils::Hash(tree.nodes, sizeof(CompactNode) * tree.nodeCount, FileUtils::Hash(tree.leafIndices, sizeof(int) * tree.leafIndexCount));
+			}
+
+			if (threads == 1)
+			{
+				serialTime = best;
+				serialHash = hash;
+			}
+
+			std::cout << std::left << std::setw(32) << mesh << std::setw(10) << threads << std::setw(12) << std::setprecision(4) << best
+				<< std::setw(10) << serialTime / best << (hash == serialHash ? "identical" : "DIFFERENT") << std::endl;
+		}
+	}
+
+	scheduler.SetThreadCount(originalThreadCount);
+	std::cout << "---------------------------------------------" << std::endl;
+}
+
+void Benchmark::TriangleLayouts(const std::vector<std::string>& meshes, int resolution)
+{
+	const TriangleLayout layouts[] = { TriangleLayout::Full, TriangleLayout::Packed };
+	const char * layoutNames[] = { "full", "packed" };
+
+	// Scene defaults: SAH with spatial splits
+
+	std::cout << "---------------------------------------------" << std::endl;
+	std::cout << "triangle layouts, " << resolution << "^3 distance queries" << std::endl;
+	std::cout << std::left << std::setw(32) << "mesh" << std::setw(10) << "layout" << std::setw(14) << "triangle MB" << std::setw(12) << "total MB"
+		<< std::setw(16) << "query ns/voxel" << "voxels off by 1e-3" << std::endl;
+
+	for (const std::string& mesh : meshes)
+	{
+		ObjData obj;
+		std::string error;
+
+		if (!ObjParser::Load(mesh, obj, error))
+		{
+			std::cout << "Failed to load " << mesh << ": " << error << std::endl;
+			continue;
+		}
+
+		Arena arena;
+		TriangleSoup soup;
+		soup.Load(arena, obj, 1.f);
+
+		std::vector<float> reference;
+
+		for (int l = 0; l < 2; ++l)
+		{
+			Mesh kdMesh(9, 5, soup, KdSplitMethod::SAH, true, layouts[l]);
+			kdMesh.Build();
+
+			CompactKdTree tree = kdMesh.GetCompactKdTree();
+			std::vector<float> distances;
+			MeshQueryStats stats;
+
+			high_resolution_clock::time_point start = high_resolution_clock::now();
+			QueryGrid(tree, resolution, distances, stats);
+			duration<double, std::nano> queryTime = high_resolution_clock::now() - start;
+
+			size_t triangleBytes = layouts[l] == TriangleLayout::Packed ? tree.triangleCount * sizeof(PackedTriangle) + tree.vertexCount * sizeof(glm::vec3) : tree.triangleCount * sizeof(TriangleData);
+			size_t totalBytes = triangleBytes + tree.nodeCount * sizeof(CompactNode) + tree.leafIndexCount * sizeof(int);
+
+			// Quantized directions move the distance very little, but they can flip a point between the face
+			// and edge cases of the bent tangent test, which changes its sign
+			size_t mismatches = 0;
+
+			if (l == 0)
+				reference = distances;
+			else
+				for (size_t i = 0; i < distances.size(); ++i)
+					mismatches += std::abs(distances[i] - reference[i]) > 1e-3f;
+
+			std::cout << std::left << std::setw(32) << mesh << std::setw(10) << layoutNames[l] << std::setw(14) << std::setprecision(4) << triangleBytes / (1024.0 * 1024.0)
+				<< std::setw(12) << totalBytes / (1024.0 * 1024.0) << std::setw(16) << queryTime.count() / stats.queries << mismatches << std::endl;
+		}
+	}
+
+	std::cout << "---------------------------------------------" << std::endl;
+}
+
+void Benchmark::KdTreeTraversal(const std::vector<std::string>& meshes, int resolution)
+{
+	const int depths[] = { 9, 12, 16, 20 };
+
+	std::cout << "---------------------------------------------" << std::endl;
+	std::cout << "stackless traversal against brute force, " << resolution << "^3 distance queries" << std::endl;
+	std::cout << std::left << std::setw(32) << "mesh" << std::setw(8) << "depth" << std::setw(10) << "nodes" << std::setw(16) << "visits/voxel"
+		<< std::setw(18) << "backtracks/voxel" << std::setw(16) << "tests/voxel" << std::setw(14) << "mismatches" << "max error" << std::endl;
+
+	for (const std::string& mesh : meshes)
+	{
+		ObjData obj;
+		std::string error;
+
+		if (!ObjParser::Load(mesh, obj, error))
+		{
+			std::cout << "Failed to load " << mesh << ": " << error << std::endl;
+			continue;
+		}
+
+		Arena arena;
+		TriangleSoup soup;
+		soup.Load(arena, obj, 1.f);
+
+		// The reference ignores the tree, any of them will do
+		std::vector<float> reference(static_cast<size_t>(resolution) * resolution * resolution);
+
+		{
+			Mesh kdMesh(1, 5, soup);
+			kdMesh.Build();
+
+			MeshQuery query(kdMesh.GetCompactKdTree());
+
+			Parallel::For(resolution, [&](int z) {
+				for (int y = 0; y < resolution; ++y)
+				{
+					for (int x = 0; x < resolution; ++x)
+					{
+						glm::vec3 p = (glm::vec3(x, y, z) / static_cast<float>(resolution)) * 2.f - 1.f;
+						reference[(static_cast<size_t>(z) * resolution + y) * resolution + x] = query.BruteForceDistance(p);
+					}
+				}
+			});
+		}
+
+		for (int depth : depths)
+		{
+			Mesh kdMesh(depth, 5, soup, KdSplitMethod::SAH, true);
+			kdMesh.Build();
+
+			CompactKdTree tree = kdMesh.GetCompactKdTree();
+			std::vector<float> distances;
+			MeshQueryStats stats;
+			QueryGrid(tree, resolution, distances, stats);
+
+			// Anything beyond float noise means the step budget ran out, or that the brute force picked a triangle by a
+			// plane distance below its true one, which the prune can skip (see MeshQuery::ClosestTriangle)
+			size_t mismatches = 0;
+			float maxError = 0.f;
+
+			for (size_t i = 0; i < distances.size(); ++i)
+			{
+				float e = std::abs(distances[i] - reference[i]);
+				mismatches += e > 1e-5f;
+				maxError = std::max(maxError, e);
+			}
+
+			double queries = static_cast<double>(stats.queries);
+
+			std::cout << std::left << std::setw(32) << mesh << std::setw(8) << depth << std::setw(10) << tree.nodeCount << std::setprecision(4)
+				<< std::setw(16) << stats.nodeVisits / queries << std::setw(18) << stats.backtracks / queries << std::setw(16) << stats.triangleTests / queries
+				<< std::setw(14) << mismatches << maxError << std::endl;
+		}
+	}
+
+	std::cout << "---------------------------------------------" << std::endl;
+}
+
+void Benchmark::KdTreeParameters(const std::vector<std::string>& meshes, int resolution)
+{
+	const int depths[] = { 8, 10, 12, 14 };
+	const int leafSizes[] = { 2, 5, 8, 12 };
+
+	std::cout << "---------------------------------------------" << std::endl;
+	std::cout << "kd-tree depth and leaf size sweep, " << resolution << "^3 distance queries" << std::endl;
+	std::cout << std::left << std::setw(32) << "mesh" << std::setw(7) << "depth" << std::setw(6) << "leaf" << std::setw(9) << "nodes" << std::setw(8) << "dup"
+		<< std::setw(9) << "empty %" << std::setw(11) << "est. cost" << std::setw(11) << "build ms" << std::setw(20) << "fetches mean/p99" << "tests mean/p99" << std::endl;
+
+	for (const std::string& mesh : meshes)
+	{
+		ObjData obj;
+		std::string error;
+
+		if (!ObjParser::Load(mesh, obj, error))
+		{
+			std::cout << "Failed to load " << mesh << ": " << error << std::endl;
+			continue;
+		}
+
+		Arena arena;
+		TriangleSoup soup;
+		soup.Load(arena, obj, 1.f);
+
+		for (int depth : depths)
+		{
+			for (int leafSize : leafSizes)
+			{
+				Mesh kdMesh(depth, leafSize, soup, KdSplitMethod::SAH, true);
+				kdMesh.Build();
+
+				const KdTreeStats& stats = kdMesh.GetStats();
+				MeshQuery query(kdMesh.GetCompactKdTree());
+
+				// Same packed counters as the instrumented generator pass
+				std::vector<uint32_t> counters(static_cast<size_t>(resolution) * resolution * resolution);
+
+				Parallel::For(resolution, [&](int z) {
+					for (int y = 0; y < resolution; ++y)
+					{
+						for (int x = 0; x < resolution; ++x)
+						{
+							MeshQueryStats voxelStats;
+							glm::vec3 p = (glm::vec3(x, y, z) / static_cast<float>(resolution)) * 2.f - 1.f;
+							query.Distance(p, voxelStats);
+							counters[(static_cast<size_t>(z) * resolution + y) * resolution + x] = TraversalCounters::Pack(voxelStats.nodeVisits + voxelStats.backtracks, voxelStats.triangleTests);
+						}
+					}
+				});
+
+				CounterPercentiles fetches;
+				CounterPercentiles tests;
+				TraversalCounters::Reduce(counters.data(), counters.size(), fetches, tests);
+
+				std::ostringstream fetchColumn;
+				std::ostringstream testColumn;
+				fetchColumn << std::fixed << std::setprecision(0) << fetches.mean << "/" << fetches.p99;
+				testColumn << std::fixed << std::setprecision(0) << tests.mean << "/" << tests.p99;
+
+				std::cout << std::left << std::setw(32) << mesh << std::setw(7) << depth << std::setw(6) << leafSize << std::setw(9) << stats.nodeCount
+					<< std::fixed << std::setprecision(2) << std::setw(8) << stats.DuplicationFactor() << std::setprecision(1) << std::setw(9) << stats.EmptyLeafRatio() * 100.f
+					<< std::setw(11) << stats.estimatedCost << std::setw(11) << stats.boundsTime + stats.treeTime + stats.compactTime
+					<< std::setw(20) << fetchColumn.str() << testColumn.str() << std::defaultfloat << std::setprecision(6) << std::endl;
+			}
+		}
+	}
+
+	std::cout << "---------------------------------------------" << std::endl;
+}
+
+void Benchmark::SdfBaking(const std::vector<std::string>& meshes, int resolution)
+{
+	std::cout << "---------------------------------------------" << std::endl;
+	std::cout << "CPU sdf baking, " << resolution << "^3 voxels, " << Parallel::GetThreadCount() << " threads, " << (SdfBaker::UsesAVX2() ? "AVX2" : "scalar") << std::endl;
+	std::cout << std::left << std::setw(32) << "mesh" << std::setw(14) << "baker ms" << std::setw(14) << "MeshQuery ms" << std::setw(16) << "Mvoxels/s" << "mismatches" << std::endl;
+
+	for (const std::string& mesh : meshes)
+	{
+		ObjData obj;
+		std::string error;
+
+		if (!ObjParser::Load(mesh, obj, error))
+		{
+			std::cout << "Failed to load " << mesh << ": " << error << std::endl;
+			continue;
+		}
+
+		Arena arena;
+		TriangleSoup soup;
+		soup.Load(arena, obj, 1.f);
+
+		// Scene defaults
+		Mesh kdMesh(12, 5, soup, KdSplitMethod::SAH, true, TriangleLayout::Packed);
+		kdMesh.Build();
+
+		CompactKdTree tree = kdMesh.GetCompactKdTree();
+		SdfBaker baker(tree);
+		std::vector<float> baked(static_cast<size_t>(resolution) * resolution * resolution);
+
+		high_resolution_clock::time_point start = high_resolution_clock::now();
+		baker.Bake(resolution, baked.data());
+		duration<double, std::milli> bakeTime = high_resolution_clock::now() - start;
+
+		// The scalar traversal over the same grid, which the baker must reproduce bit for bit
+		std::vector<float> reference;
+		MeshQueryStats stats;
+
+		start = high_resolution_clock::now();
+		QueryGrid(tree, resolution, reference, stats);
+		duration<double, std::milli> queryTime = high_resolution_clock::now() - start;
+
+		size_t mismatches = 0;
+
+		for (size_t i = 0; i < baked.size(); ++i)
+			mismatches += baked[i] != reference[i];
+
+		std::cout << std::left << std::setw(32) << mesh << std::fixed << std::setprecision(1) << std::setw(14) << bakeTime.count() << std::setw(14) << queryTime.count()
+			<< std::setprecision(2) << std::setw(16) << baked.size() / (bakeTime.count() * 1000.0) << mismatches << std::defaultfloat << std::setprecision(6) << std::endl;
+	}
+
+	std::cout << "---------------------------------------------" << std::endl;
+}
+
+void Benchmark::NarrowBandBaking(const std::vector<std::string>& meshes, int resolution, int bandWidth)
+{
+	std::cout << "---------------------------------------------" << std::endl;
+	std::cout << "Narrow band sdf baking, " << resolution << "^3 voxels, band of " << bandWidth << " cells, " << Parallel::GetThreadCount() << " threads" << std::endl;
+	std::cout << std::left << std::setw(32) << "mesh" << std::setw(12) << "full ms" << std::setw(12) << "band ms" << std::setw(10) << "band %" << std::setw(12) << "mismatches"
+		<< std::setw(14) << "far mean err" << std::setw(14) << "far max err" << "sign flips" << std::endl;
+
+	for (const std::string& mesh : meshes)
+	{
+		ObjData obj;
+		std::string error;
+
+		if (!ObjParser::Load(mesh, obj, error))
+		{
+			std::cout << "Failed to load " << mesh << ": " << error << std::endl;
+			continue;
+		}
+
+		Arena arena;
+		TriangleSoup soup;
+		soup.Load(arena, obj, 1.f);
+
+		Mesh kdMesh(12, 5, soup, KdSplitMethod::SAH, true, TriangleLayout::Packed);
+		kdMesh.Build();
+
+		SdfBaker baker(kdMesh.GetCompactKdTree());
+		size_t voxelCount = static_cast<size_t>(resolution) * resolution * resolution;
+		std::vector<float> full(voxelCount);
+		std::vector<float> narrow(voxelCount);
+
+		high_resolution_clock::time_point start = high_resolution_clock::now();
+		baker.Bake(resolution, full.data());
+		duration<double, std::milli> fullTime = high_resolution_clock::now() - start;
+
+		start = high_resolution_clock::now();
+		size_t bandCount = baker.BakeNarrowBand(resolution, bandWidth, narrow.data());
+		duration<double, std::milli> narrowTime = high_resolution_clock::now() - start;
+
+		// Band voxels must match the full bake bit for bit, the rest is measured against it
+		std::vector<uint8_t> band;
+		baker.RasterizeBand(resolution, bandWidth, band);
+
+		size_t mismatches = 0;
+		size_t farCount = 0;
+		size_t signFlips = 0;
+		double errorSum = 0.0;
+		float maxError = 0.f;
+
+		for (size_t i = 0; i < voxelCount; ++i)
+		{
+			if (band[i])
+			{
+				mismatches += full[i] != narrow[i];
+			}
+			else
+			{
+				float e = std::abs(std::abs(full[i]) - std::abs(narrow[i]));
+				errorSum += e;
+				maxError = std::max(maxError, e);
+				signFlips += (full[i] < 0.f) != (narrow[i] < 0.f);
+				++farCount;
+			}
+		}
+
+		std::cout << std::left << std::setw(32) << mesh << std::fixed << std::setprecision(1) << std::setw(12) << fullTime.count() << std::setw(12) << narrowTime.count()
+			<< std::setw(10) << 100.0 * bandCount / voxelCount << std::setw(12) << mismatches << std::setprecision(5) << std::setw(14) << (farCount ? errorSum / farCount : 0.0)
+			<< std::setw(14) << maxError << signFlips << std::defaultfloat << std::setprecision(6) << std::endl;
+	}
+
+	std::cout << "---------------------------------------------" << std::endl;
+}
+
+void Benchmark::SignMethods(const std::vector<std::string>& meshes, int resolution)
+{
+	const char * methodNames[3] = { "bent normals", "winding", "winding bricks" };
+	const SdfSignMethod methods[3] = { SdfSignMethod::BentNormals, SdfSignMethod::WindingNumber, SdfSignMethod::WindingNumberBricks };
+
+	std::cout << "---------------------------------------------" << std::endl;
+	std::cout << "Sdf sign methods, " << resolution << "^3 voxels, wrong signs against a brute force winding number" << std::endl;
+	std::cout << std::left << std::setw(32) << "mesh" << std::setw(18) << "method" << std::setw(12) << "bake ms" << "wrong signs" << std::endl;
+
+	size_t voxelCount = static_cast<size_t>(resolution) * resolution * resolution;
+
+	for (const std::string& mesh : meshes)
+	{
+		ObjData obj;
+		std::string error;
+
+		if (!ObjParser::Load(mesh, obj, error))
+		{
+			std::cout << "Failed to load " << mesh << ": " << error << std::endl;
+			continue;
+		}
+
+		Arena arena;
+		TriangleSoup soup;
+		soup.Load(arena, obj, 1.f);
+
+		Mesh kdMesh(12, 5, soup, KdSplitMethod::SAH, true, TriangleLayout::Packed);
+		kdMesh.Build();
+
+		CompactKdTree tree = kdMesh.GetCompactKdTree();
+
+		// Every triangle solid angle for every voxel
+		WindingNumber winding(tree);
+		std::vector<uint8_t> inside(voxelCount);
+
+		Parallel::For(resolution, [&](int z) {
+			for (int y = 0; y < resolution; ++y)
+			{
+				for (int x = 0; x < resolution; ++x)
+				{
+					glm::vec3 p = (glm::vec3(x, y, z) / static_cast<float>(resolution)) * 2.f - 1.f;
+					inside[(static_cast<size_t>(z) * resolution + y) * resolution + x] = winding.EvaluateBruteForce(p) > .5f;
+				}
+			}
+		});
+
+		for (int m = 0; m < 3; ++m)
+		{
+			SdfBaker baker(tree, methods[m]);
+			std::vector<float> distances(voxelCount);
+
+			high_resolution_clock::time_point start = high_resolution_clock::now();
+			baker.Bake(resolution, distances.data());
+			duration<double, std::milli> bakeTime = high_resolution_clock::now() - start;
+
+			size_t wrongSigns = 0;
+
+			for (size_t i = 0; i < voxelCount; ++i)
+				wrongSigns += (distances[i] < 0.f) != (inside[i] != 0);
+
+			std::cout << std::left << std::setw(32) << (m == 0 ? mesh : "") << std::setw(18) << methodNames[m] << std::fixed << std::setprecision(1) << std::setw(12) << bakeTime.count()
+				<< wrongSigns << std::defaultfloat << std::setprecision(6) << std::endl;
+
+			if (methods[m] != SdfSignMethod::BentNormals)
+				continue;
+
+			// What GENERATOR_WINDING_SIGN does to the generator output, the time is only the sign pass
+			start = high_resolution_clock::now();
+			SdfBaker::SignWithWindingNumber(winding, resolution, distances.data());
+			duration<double, std::milli> signTime = high_resolution_clock::now() - start;
+
+			wrongSigns = 0;
+
+			for (size_t i = 0; i < voxelCount; ++i)
+				wrongSigns += (distances[i] < 0.f) != (inside[i] != 0);
+
+			std::cout << std::left << std::setw(32) << "" << std::setw(18) << "+ winding pass" << std::fixed << std::setprecision(1) << std::setw(12) << signTime.count()
+				<< wrongSigns << std::defaultfloat << std::setprecision(6) << std::endl;
+		}
+	}
+
+	std::cout << "---------------------------------------------" << std::endl;
+}
+
+void Benchmark::BrickCulling(const std::vector<std::string>& meshes, int resolution)
+{
+	std::cout << "---------------------------------------------" << std::endl;
+	std::cout << "Brick culling, " << resolution << "^3 voxels, " << SDF_BRICK_SIZE << "^3 bricks, " << Parallel::GetThreadCount() << " threads" << std::endl;
+	std::cout << std::left << std::setw(32) << "mesh" << std::setw(12) << "voxel ms" << std::setw(12) << "brick ms" << std::setw(12) << "nodes/vx" << std::setw(12) << "nodes/vx b"
+		<< std::setw(12) << "tris/vx" << std::setw(12) << "tris/vx b" << std::setw(14) << "cand avg/max" << std::setw(10) << "culled %" << std::setw(12) << "baker ms" << std::setw(12) << "baker b ms" << "mismatches" << std::endl;
+
+	for (const std::string& mesh : meshes)
+	{
+		ObjData obj;
+		std::string error;
+
+		if (!ObjParser::Load(mesh, obj, error))
+		{
+			std::cout << "Failed to load " << mesh << ": " << error << std::endl;
+			continue;
+		}
+
+		Arena arena;
+		TriangleSoup soup;
+		soup.Load(arena, obj, 1.f);
+
+		Mesh kdMesh(12, 5, soup, KdSplitMethod::SAH, true, TriangleLayout::Packed);
+		kdMesh.Build();
+
+		CompactKdTree tree = kdMesh.GetCompactKdTree();
+		MeshQuery query(tree);
+
+		// Per voxel traversal, what generateMeshSDF does without BRICK_CULLING
+		std::vector<float> reference;
+		MeshQueryStats voxelStats;
+
+		high_resolution_clock::time_point start = high_resolution_clock::now();
+		QueryGrid(tree, resolution, reference, voxelStats);
+		duration<double, std::milli> voxelTime = high_resolution_clock::now() - start;
+
+		// One gather per brick, then every voxel only tests the candidates. Node visits are the gathers,
+		// amortized over the brick, which is what the first invocation of each workgroup pays on the GPU.
+		int bricksPerAxis = (resolution + SDF_BRICK_SIZE - 1) / SDF_BRICK_SIZE;
+		int brickCount = bricksPerAxis * bricksPerAxis * bricksPerAxis;
+		std::vector<float> culled(reference.size());
+		std::vector<MeshQueryStats> brickStats(brickCount);
+		std::vector<size_t> candidateCounts(brickCount);
+		std::vector<uint8_t> overflows(brickCount);
+
+		start = high_resolution_clock::now();
+
+		Parallel::For(brickCount, [&](int brick) {
+			glm::ivec3 first = glm::ivec3(brick % bricksPerAxis, (brick / bricksPerAxis) % bricksPerAxis, brick / (bricksPerAxis * bricksPerAxis)) * SDF_BRICK_SIZE;
+			glm::ivec3 last = glm::min(first + SDF_BRICK_SIZE, glm::ivec3(resolution)) - 1;
+
+			std::vector<int> candidates;
+			overflows[brick] = !query.GatherCandidates(glm::vec3(first) / static_cast<float>(resolution) * 2.f - 1.f,
+				glm::vec3(last) / static_cast<float>(resolution) * 2.f - 1.f, candidates, brickStats[brick]);
+			candidateCounts[brick] = overflows[brick] ? 0 : candidates.size();
+
+			for (int z = first.z; z <= last.z; ++z)
+				for (int y = first.y; y <= last.y; ++y)
+					for (int x = first.x; x <= last.x; ++x)
+					{
+						glm::vec3 p = (glm::vec3(x, y, z) / static_cast<float>(resolution)) * 2.f - 1.f;
+						size_t voxel = (static_cast<size_t>(z) * resolution + y) * resolution + x;
+						culled[voxel] = overflows[brick] ? query.Distance(p, brickStats[brick]) : query.CandidateDistance(p, candidates, brickStats[brick]);
+					}
+		});
+
+		duration<double, std::milli> brickTime = high_resolution_clock::now() - start;
+
+		MeshQueryStats culledStats;
+		size_t candidateSum = 0;
+		size_t candidateMax = 0;
+		int culledBricks = 0;
+
+		for (int b = 0; b < brickCount; ++b)
+		{
+			culledStats.nodeVisits += brickStats[b].nodeVisits;
+			culledStats.triangleTests += brickStats[b].triangleTests;
+			candidateSum += candidateCounts[b];
+			candidateMax = std::max(candidateMax, candidateCounts[b]);
+			culledBricks += !overflows[b];
+		}
+
+		// The candidates resolve ties between triangles at the same distance by index, like the brute force search.
+		// The traversal keeps the first one it visits, so those voxels are checked against brute force instead.
+		size_t mismatches = 0;
+
+		auto countMismatches = [&](const std::vector<float>& grid) {
+			for (int z = 0; z < resolution; ++z)
+				for (int y = 0; y < resolution; ++y)
+					for (int x = 0; x < resolution; ++x)
+					{
+						size_t voxel = (static_cast<size_t>(z) * resolution + y) * resolution + x;
+
+						if (grid[voxel] != reference[voxel])
+							mismatches += grid[voxel] != query.BruteForceDistance((glm::vec3(x, y, z) / static_cast<float>(resolution)) * 2.f - 1.f);
+					}
+		};
+
+		countMismatches(culled);
+
+		// The CPU baker with and without culling
+		SdfBaker baker(tree);
+		SdfBaker culledBaker(tree, SdfSignMethod::BentNormals, true);
+		std::vector<float> baked(reference.size());
+
+		start = high_resolution_clock::now();
+		baker.Bake(resolution, baked.data());
+		duration<double, std::milli> bakeTime = high_resolution_clock::now() - start;
+
+		start = high_resolution_clock::now();
+		culledBaker.Bake(resolution, culled.data());
+		duration<double, std::milli> culledBakeTime = high_resolution_clock::now() - start;
+
+		countMismatches(culled);
+
+		double voxels = static_cast<double>(reference.size());
+		std::string candidatesColumn = std::to_string(culledBricks ? candidateSum / culledBricks : 0) + "/" + std::to_string(candidateMax);
+
+		std::cout << std::left << std::setw(32) << mesh << std::fixed << std::setprecision(1) << std::setw(12) << voxelTime.count() << std::setw(12) << brickTime.count()
+			<< std::setw(12) << voxelStats.nodeVisits / voxels << std::setw(12) << culledStats.nodeVisits / voxels
+			<< std::setw(12) << voxelStats.triangleTests / voxels << std::setw(12) << culledStats.triangleTests / voxels << std::setw(14) << candidatesColumn << std::setw(10) << 100.0 * culledBricks / brickCount
+			<< std::setw(12) << bakeTime.count() << std::setw(12) << culledBakeTime.count() << mismatches << std::defaultfloat << std::setprecision(6) << std::endl;
+	}
+
+	std::cout << "---------------------------------------------" << std::endl;
+}
+
+void Benchmark::HierarchicalBaking(const std::vector<std::string>& meshes, int resolution, int coarseResolution)
+{
+	std::cout << "---------------------------------------------" << std::endl;
+	std::cout << "Hierarchical sdf baking, " << resolution << "^3 voxels from " << coarseResolution << "^3, " << Parallel::GetThreadCount() << " threads" << std::endl;
+	std::cout << std::left << std::setw(32) << "mesh" << std::setw(12) << "full ms" << std::setw(12) << "coarse ms" << std::setw(12) << "exact %" << std::setw(14) << "skipped"
+		<< std::setw(12) << "mismatches" << std::setw(14) << "interp mean" << std::setw(14) << "interp max" << "sign flips" << std::endl;
+
+	int ratio = resolution / coarseResolution;
+
+	for (const std::string& mesh : meshes)
+	{
+		ObjData obj;
+		std::string error;
+
+		if (!ObjParser::Load(mesh, obj, error))
+		{
+			std::cout << "Failed to load " << mesh << ": " << error << std::endl;
+			continue;
+		}
+
+		Arena arena;
+		TriangleSoup soup;
+		soup.Load(arena, obj, 1.f);
+
+		Mesh kdMesh(12, 5, soup, KdSplitMethod::SAH, true, TriangleLayout::Packed);
+		kdMesh.Build();
+
+		SdfBaker baker(kdMesh.GetCompactKdTree());
+		size_t voxelCount = static_cast<size_t>(resolution) * resolution * resolution;
+		std::vector<float> full(voxelCount);
+		std::vector<float> hierarchical(voxelCount);
+
+		high_resolution_clock::time_point start = high_resolution_clock::now();
+		baker.Bake(resolution, full.data());
+		duration<double, std::milli> fullTime = high_resolution_clock::now() - start;
+
+		start = high_resolution_clock::now();
+		size_t exactCount = baker.BakeHierarchical(resolution, coarseResolution, hierarchical.data());
+		duration<double, std::milli> hierarchicalTime = high_resolution_clock::now() - start;
+
+		// The coarse level again, to know which voxels were refined
+		int samples = coarseResolution + 1;
+		std::vector<float> coarse(static_cast<size_t>(samples) * samples * samples);
+
+		for (int z = 0; z < samples; ++z)
+			for (int y = 0; y < samples; ++y)
+				for (int x = 0; x < samples; ++x)
+					coarse[SdfHierarchy::CoarseIndex(coarseResolution, x, y, z)] = baker.Distance((glm::vec3(x, y, z) / static_cast<float>(coarseResolution)) * 2.f - 1.f);
+
+		size_t mismatches = 0;
+		size_t interpolatedCount = 0;
+		size_t signFlips = 0;
+		double errorSum = 0.0;
+		float maxError = 0.f;
+
+		for (int z = 0; z < resolution; ++z)
+			for (int y = 0; y < resolution; ++y)
+				for (int x = 0; x < resolution; ++x)
+				{
+					size_t i = (static_cast<size_t>(z) * resolution + y) * resolution + x;
+
+					if (SdfHierarchy::RefineCell(coarse.data(), coarseResolution, resolution, glm::ivec3(x, y, z) / ratio))
+					{
+						mismatches += full[i] != hierarchical[i];
+					}
+					else
+					{
+						float e = std::abs(full[i] - hierarchical[i]);
+						errorSum += e;
+						maxError = std::max(maxError, e);
+						signFlips += (full[i] < 0.f) != (hierarchical[i] < 0.f);
+						++interpolatedCount;
+					}
+				}
+
+		std::cout << std::left << std::setw(32) << mesh << std::fixed << std::setprecision(1) << std::setw(12) << fullTime.count() << std::setw(12) << hierarchicalTime.count()
+			<< std::setw(12) << 100.0 * exactCount / voxelCount << std::setw(14) << voxelCount - exactCount << std::setw(12) << mismatches << std::setprecision(5)
+			<< std::setw(14) << (interpolatedCount ? errorSum / interpolatedCount : 0.0) << std::setw(14) << maxError << signFlips << std::defaultfloat << std::setprecision(6) << std::endl;
+	}
+
+	std::cout << "---------------------------------------------" << std::endl;
+}
+
+void Benchmark::ClosestFeatures(const std::vector<std::string>& meshes, int resolution)
+{
+	std::cout << "---------------------------------------------" << std::endl;
+	std::cout << "Closest features, " << resolution << "^3 voxels, " << Parallel::GetThreadCount() << " threads" << std::endl;
+	std::cout << std::left << std::setw(32) << "mesh" << std::setw(10) << "culling" << std::setw(12) << "sdf ms" << std::setw(12) << "feature ms" << std::setw(12) << "mismatches"
+		<< std::setw(12) << "missing" << std::setw(12) << "gap mean" << std::setw(12) << "gap max" << "packed err" << std::endl;
+
+	for (const std::string& mesh : meshes)
+	{
+		ObjData obj;
+		std::string error;
+
+		if (!ObjParser::Load(mesh, obj, error))
+		{
+			std::cout << "Failed to load " << mesh << ": " << error << std::endl;
+			continue;
+		}
+
+		Arena arena;
+		TriangleSoup soup;
+		soup.Load(arena, obj, 1.f);
+
+		Mesh kdMesh(12, 5, soup, KdSplitMethod::SAH, true, TriangleLayout::Packed);
+		kdMesh.Build();
+
+		CompactKdTree tree = kdMesh.GetCompactKdTree();
+		MeshQuery query(tree);
+
+		size_t voxelCount = static_cast<size_t>(resolution) * resolution * resolution;
+		std::vector<float> distances(voxelCount);
+		std::vector<float> featureDistances(voxelCount);
+		std::vector<uint32_t> triangles(voxelCount);
+		std::vector<uint32_t> barycentrics(voxelCount);
+
+		for (bool culling : { false, true })
+		{
+			SdfBaker baker(tree, SdfSignMethod::BentNormals, culling);
+
+			high_resolution_clock::time_point start = high_resolution_clock::now();
+			baker.Bake(resolution, distances.data());
+			duration<double, std::milli> sdfTime = high_resolution_clock::now() - start;
+
+			start = high_resolution_clock::now();
+			baker.Bake(resolution, featureDistances.data(), triangles.data(), barycentrics.data());
+			duration<double, std::milli> featureTime = high_resolution_clock::now() - start;
+
+			// The features can't change the distances, and the triangle has to give them back, offset included when
+			// the traversal ran out of steps. The gap is how far the exact closest point is from the baked distance,
+			// which near edges uses the plane of the oct encoded normal. Packed error is what 16 bits move that point.
+			size_t mismatches = 0;
+			size_t missing = 0;
+			double gapSum = 0.0;
+			float gapMax = 0.f;
+			float packedError = 0.f;
+
+			for (int z = 0; z < resolution; ++z)
+				for (int y = 0; y < resolution; ++y)
+					for (int x = 0; x < resolution; ++x)
+					{
+						size_t i = (static_cast<size_t>(z) * resolution + y) * resolution + x;
+						glm::vec3 p = (glm::vec3(x, y, z) / static_cast<float>(resolution)) * 2.f - 1.f;
+
+						if (triangles[i] == ClosestFeature::NO_TRIANGLE || triangles[i] >= static_cast<uint32_t>(tree.triangleCount))
+						{
+							++missing;
+							continue;
+						}
+
+						int triangle = static_cast<int>(triangles[i]);
+						float distance = query.TriangleDistance(triangle, p);
+						mismatches += featureDistances[i] != distances[i] || (distance != distances[i] && distance - .0115f != distances[i]);
+
+						TriangleData t = query.LoadTriangle(triangle);
+						glm::vec3 exact = query.ClosestBarycentrics(triangle, p);
+						glm::vec3 packed = ClosestFeature::UnpackBarycentrics(barycentrics[i]);
+
+						glm::vec3 closest = exact.x * t.v1 + exact.y * t.v2 + exact.z * t.v3;
+						float gap = std::abs(glm::length(p - closest) - std::abs(distances[i]));
+						gapSum += gap;
+						gapMax = std::max(gapMax, gap);
+						packedError = std::max(packedError, glm::length(closest - (packed.x * t.v1 + packed.y * t.v2 + packed.z * t.v3)));
+					}
+
+			std::cout << std::left << std::setw(32) << mesh << std::setw(10) << (culling ? "on" : "off") << std::fixed << std::setprecision(1) << std::setw(12) << sdfTime.count()
+				<< std::setw(12) << featureTime.count() << std::setw(12) << mismatches << std::setw(12) << missing << std::defaultfloat << std::setprecision(3)
+				<< std::setw(12) << gapSum / std::max<size_t>(voxelCount - missing, 1) << std::setw(12) << gapMax << packedError << std::setprecision(6) << std::endl;
+		}
+	}
+
+	std::cout << "---------------------------------------------" << std::endl;
+}
+
+void Benchmark::NoiseBaking(int resolution)
+{
+	std::cout << "---------------------------------------------" << std::endl;
+	std::cout << "Vector field noise baking, " << resolution << "^3 texels, " << Parallel::GetThreadCount() << " threads" << (NoiseBaker::UsesAVX2() ? ", AVX2" : "") << std::endl;
+
+	NoiseParameters parameters;
+	size_t texelCount = static_cast<size_t>(resolution) * resolution * resolution;
+
+	// Hashing every corner like the shader
+	std::vector<glm::vec4> reference(texelCount);
+	high_resolution_clock::time_point start = high_resolution_clock::now();
+
+	Parallel::For(resolution, [&](int z) {
+		for (int y = 0; y < resolution; ++y)
+			for (int x = 0; x < resolution; ++x)
+				reference[(static_cast<size_t>(z) * resolution + y) * resolution + x] = ShaderNoiseTexel(parameters, resolution, glm::ivec3(x, y, z));
+	});
+
+	duration<double, std::milli> referenceTime = high_resolution_clock::now() - start;
+
+	start = high_resolution_clock::now();
+	NoiseBaker baker(parameters, resolution);
+	duration<double, std::milli> tableTime = high_resolution_clock::now() - start;
+
+	// Scalar lookups into the tables
+	std::vector<glm::vec4> scalar(texelCount);
+	start = high_resolution_clock::now();
+
+	Parallel::For(resolution, [&](int z) {
+		for (int y = 0; y < resolution; ++y)
+			for (int x = 0; x < resolution; ++x)
+				scalar[(static_cast<size_t>(z) * resolution + y) * resolution + x] = baker.Texel(glm::ivec3(x, y, z));
+	});
+
+	duration<double, std::milli> scalarTime = high_resolution_clock::now() - start;
+
+	std::vector<float> baked(texelCount * 4);
+	start = high_resolution_clock::now();
+	baker.Bake(baked.data());
+	duration<double, std::milli> bakeTime = high_resolution_clock::now() - start;
+
+	// The tables hold exactly what the shader hashes, so all three must agree bit for bit
+	size_t scalarMismatches = 0;
+	size_t bakedMismatches = 0;
+
+	for (size_t i = 0; i < texelCount; ++i)
+	{
+		scalarMismatches += scalar[i] != reference[i];
+		bakedMismatches += glm::vec4(baked[i * 4], baked[i * 4 + 1], baked[i * 4 + 2], baked[i * 4 + 3]) != reference[i];
+	}
+
+	std::cout << std::fixed << std::setprecision(1) << "per texel hashing " << referenceTime.count() << " ms, tables " << tableTime.count() << " ms, scalar lookups " << scalarTime.count()
+		<< " ms, baker " << bakeTime.count() << " ms (" << texelCount / (bakeTime.count() * 1000.0) << " Mtexels/s)" << std::defaultfloat << std::setprecision(6) << std::endl;
+	std::cout << "Mismatches against per texel hashing: scalar " << scalarMismatches << ", baker " << bakedMismatches << std::endl;
+	std::cout << "---------------------------------------------" << std::endl;
+}
+
+void Benchmark::ProceduralShapes(int resolution)
+{
+	std::cout << "---------------------------------------------" << std::endl;
+	std::cout << "Procedural shapes, " << resolution << "^3 voxels, " << Parallel::GetThreadCount() << " threads" << std::endl;
+
+	size_t voxelCount = static_cast<size_t>(resolution) * resolution * resolution;
+	float farDistance = SDF_GRAPH_FAR_CELLS * 2.f / resolution;
+
+	for (const char * name : { "minion", "spheres", "cubes" })
+	{
+		SdfGraph graph;
+		SdfProgram program = graph.Compile(SdfShapes::ByName(graph, name));
+
+		std::vector<float> full(voxelCount), pruned(voxelCount), far(voxelCount);
+
+		high_resolution_clock::time_point start = high_resolution_clock::now();
+		program.Bake(resolution, 0.f, full.data(), false);
+		duration<double, std::milli> fullTime = high_resolution_clock::now() - start;
+
+		start = high_resolution_clock::now();
+		SdfBakeStats prunedStats = program.Bake(resolution, 0.f, pruned.data());
+		duration<double, std::milli> prunedTime = high_resolution_clock::now() - start;
+
+		start = high_resolution_clock::now();
+		SdfBakeStats farStats = program.Bake(resolution, farDistance, far.data());
+		duration<double, std::milli> farTime = high_resolution_clock::now() - start;
+
+		// Pruning only drops branches that can't change a bit
+		size_t mismatches = 0;
+		double maxError = 0.0;
+		double errorSum = 0.0;
+
+		for (size_t i = 0; i < voxelCount; ++i)
+		{
+			mismatches += std::memcmp(&full[i], &pruned[i], sizeof(float)) != 0;
+
+			double error = std::abs(far[i] - full[i]);
+			maxError = std::max(maxError, error);
+			errorSum += error;
+		}
+
+		std::cout << name << ": " << program.GetInstructionCount() << " instructions" << std::fixed << std::setprecision(1)
+			<< ", full tape " << fullTime.count() << " ms, pruned " << prunedTime.count() << " ms (" << prunedStats.instructions / static_cast<double>(voxelCount)
+			<< " instructions per voxel), far bricks interpolated " << farTime.count() << " ms (" << farStats.instructions / static_cast<double>(voxelCount)
+			<< ", " << 100.0 * farStats.interpolatedVoxels / voxelCount << "% interpolated)" << std::defaultfloat << std::setprecision(6) << std::endl;
+		std::cout << "  pruned mismatches " << mismatches << ", interpolated error max " << maxError << " mean " << errorSum / voxelCount << std::endl;
+	}
+
+	std::cout << "---------------------------------------------" << std::endl;
+}
+
+void Benchmark::GrowthSimulation(int resolution, int steps)
+{
+	std::cout << "---------------------------------------------" << std::endl;
+	std::cout << "Growth simulation, " << resolution << "^3 cells, " << steps << " steps from 1 s, " << Parallel::GetThreadCount() << " threads"
+		<< (GrowthSimulator::UsesAVX2() ? ", AVX2" : "") << std::endl;
+	std::cout << std::left << std::setw(16) << "preset" << std::setw(16) << "reference ms" << std::setw(12) << "step ms" << std::setw(12) << "Mcells/s"
+		<< std::setw(12) << "mismatches" << std::setw(14) << "inside before" << std::setw(14) << "inside after" << "max change" << std::endl;
+
+	size_t cellCount = static_cast<size_t>(resolution) * resolution * resolution;
+
+	SdfGraph graph;
+	SdfProgram program = graph.Compile(SdfShapes::Minion(graph));
+	std::vector<float> seed(cellCount);
+	program.Bake(resolution, 0.f, seed.data());
+
+	std::vector<float> vectorField(cellCount * 4);
+	NoiseBaker(NoiseParameters(), resolution).Bake(vectorField.data());
+
+	auto countInside = [&](const float * volume) {
+		return static_cast<size_t>(std::count_if(volume, volume + cellCount, [](float d) { return d < 0.f; }));
+	};
+
+	for (GrowthPreset preset : { GrowthPreset::MoltenCore, GrowthPreset::DemonBunny, GrowthPreset::Coral, GrowthPreset::Mushroom })
+	{
+		GrowthSimulator reference(resolution, preset);
+		GrowthSimulator simulator(resolution, preset);
+		simulator.SetSparse(false);
+
+		for (GrowthSimulator * s : { &reference, &simulator })
+		{
+			s->SetVolume(seed.data());
+			s->SetVectorField(vectorField.data());
+		}
+
+		duration<double, std::milli> referenceTime(0.0);
+		duration<double, std::milli> stepTime(0.0);
+		size_t mismatches = 0;
+
+		// Past the fade in, where every term of main() is running
+		for (int i = 0; i < steps; ++i)
+		{
+			float totalTime = 1.f + i * GROWTH_FRAME_TIME;
+
+			high_resolution_clock::time_point start = high_resolution_clock::now();
+			reference.StepReference(totalTime);
+			referenceTime += high_resolution_clock::now() - start;
+
+			start = high_resolution_clock::now();
+			simulator.Step(totalTime);
+			stepTime += high_resolution_clock::now() - start;
+
+			for (size_t c = 0; c < cellCount; ++c)
+				mismatches += std::memcmp(&reference.GetVolume()[c], &simulator.GetVolume()[c], sizeof(float)) != 0;
+		}
+
+		float maxChange = 0.f;
+
+		for (size_t i = 0; i < cellCount; ++i)
+			maxChange = std::max(maxChange, std::abs(simulator.GetVolume()[i] - seed[i]));
+
+		std::cout << std::left << std::setw(16) << GrowthBehaviour::GetPresetName(preset) << std::fixed << std::setprecision(1) << std::setw(16) << referenceTime.count() / steps
+			<< std::setw(12) << stepTime.count() / steps << std::setw(12) << cellCount * steps / (stepTime.count() * 1000.0) << std::setw(12) << mismatches
+			<< std::setw(14) << countInside(seed.data()) << std::setw(14) << countInside(simulator.GetVolume()) << std::defaultfloat << std::setprecision(4) << maxChange
+			<< std::setprecision(6) << std::endl;
+	}
+
+	std::cout << "---------------------------------------------" << std::endl;
+}
+
+void Benchmark::SparseGrowth(int resolution, int steps)
+{
+	std::cout << "---------------------------------------------" << std::endl;
+	std::cout << "Sparse growth, " << resolution << "^3 cells, " << steps << " steps from the first frame, " << GROWTH_BRICK_SIZE << "^3 bricks, " << Parallel::GetThreadCount() << " threads" << std::endl;
+	std::cout << std::left << std::setw(16) << "preset" << std::setw(12) << "dense ms" << std::setw(12) << "sparse ms" << std::setw(10) << "speedup" << std::setw(12) << "active %"
+		<< std::setw(14) << "band max" << std::setw(14) << "band mean" << std::setw(14) << "volume max" << std::setw(14) << "volume mean" << "sign flips" << std::endl;
+
+	size_t cellCount = static_cast<size_t>(resolution) * resolution * resolution;
+
+	SdfGraph graph;
+	SdfProgram program = graph.Compile(SdfShapes::Minion(graph));
+	std::vector<float> seed(cellCount);
+	program.Bake(resolution, 0.f, seed.data());
+
+	std::vector<float> vectorField(cellCount * 4);
+	NoiseBaker(NoiseParameters(), resolution).Bake(vectorField.data());
+
+	for (GrowthPreset preset : { GrowthPreset::MoltenCore, GrowthPreset::DemonBunny, GrowthPreset::Coral, GrowthPreset::Mushroom })
+	{
+		GrowthSimulator dense(resolution, preset);
+		GrowthSimulator sparse(resolution, preset);
+		dense.SetSparse(false);
+		sparse.SetSparse(true);
+
+		for (GrowthSimulator * s : { &dense, &sparse })
+		{
+			s->SetVolume(seed.data());
+			s->SetVectorField(vectorField.data());
+		}
+
+		duration<double, std::milli> denseTime(0.0);
+		duration<double, std::milli> sparseTime(0.0);
+		size_t activeBricks = 0;
+
+		for (int i = 0; i < steps; ++i)
+		{
+			float totalTime = (i + 1) * GROWTH_FRAME_TIME;
+
+			high_resolution_clock::time_point start = high_resolution_clock::now();
+			dense.Step(totalTime);
+			denseTime += high_resolution_clock::now() - start;
+
+			start = high_resolution_clock::now();
+			sparse.Step(totalTime);
+			sparseTime += high_resolution_clock::now() - start;
+
+			activeBricks += sparse.GetActiveBrickCount();
+		}
+
+		// Where the growth is visible, the band of the dense result, and everywhere: the noise expansion inside and the
+		// curl have no activation window, so away from the band they only act in the dense steps
+		float maxError = 0.f;
+		double errorSum = 0.0;
+		size_t bandCells = 0;
+		float volumeMaxError = 0.f;
+		double volumeErrorSum = 0.0;
+		size_t signFlips = 0;
+
+		for (size_t c = 0; c < cellCount; ++c)
+		{
+			float d = dense.GetVolume()[c];
+			float error = std::abs(sparse.GetVolume()[c] - d);
+
+			signFlips += (d < 0.f) != (sparse.GetVolume()[c] < 0.f);
+			volumeMaxError = std::max(volumeMaxError, error);
+			volumeErrorSum += error;
+
+			if (std::abs(d) <= .1f)
+			{
+				maxError = std::max(maxError, error);
+				errorSum += error;
+				++bandCells;
+			}
+		}
+
+		std::cout << std::left << std::setw(16) << GrowthBehaviour::GetPresetName(preset) << std::fixed << std::setprecision(1) << std::setw(12) << denseTime.count() / steps
+			<< std::setw(12) << sparseTime.count() / steps << std::setw(10) << denseTime.count() / sparseTime.count() << std::setw(12) << 100.0 * activeBricks / (static_cast<double>(steps) * sparse.GetBrickCount())
+			<< std::scientific << std::setprecision(2) << std::setw(14) << maxError << std::setw(14) << errorSum / std::max(bandCells, size_t(1))
+			<< std::setw(14) << volumeMaxError << std::setw(14) << volumeErrorSum / cellCount << std::defaultfloat << std::setprecision(6) << signFlips << std::endl;
+	}
+
+	std::cout << "---------------------------------------------" << std::endl;
+}
+
+void Benchmark::GrowthBehaviours(int resolution, int steps)
+{
+	std::cout << "---------------------------------------------" << std::endl;
+	std::cout << "Growth behaviours, " << resolution << "^3 cells, " << steps << " dense steps from 1 s, " << Parallel::GetThreadCount() << " threads" << std::endl;
+	std::cout << std::left << std::setw(16) << "behaviour" << std::setw(8) << "terms" << std::setw(16) << "band" << std::setw(10) << "normal" << std::setw(10) << "field"
+		<< std::setw(12) << "curvature" << std::setw(12) << "step ms" << "text mismatches" << std::endl;
+
+	size_t cellCount = static_cast<size_t>(resolution) * resolution * resolution;
+
+	SdfGraph graph;
+	SdfProgram program = graph.Compile(SdfShapes::Minion(graph));
+	std::vector<float> seed(cellCount);
+	program.Bake(resolution, 0.f, seed.data());
+
+	std::vector<float> vectorField(cellCount * 4);
+	NoiseBaker(NoiseParameters(), resolution).Bake(vectorField.data());
+
+	std::vector<std::pair<std::string, GrowthBehaviour>> behaviours;
+
+	for (GrowthPreset preset : { GrowthPreset::MoltenCore, GrowthPreset::DemonBunny, GrowthPreset::Coral, GrowthPreset::Mushroom })
+		behaviours.push_back(std::make_pair(GrowthBehaviour::GetPresetName(preset), GrowthBehaviour::FromPreset(preset)));
+
+	// Every term with its defaults, what a shader without specialization would evaluate
+	GrowthBehaviour everything;
+	std::string error;
+
+	if (!GrowthBehaviour::Parse("curvature-offset 5\ngravity\ncurvature\nrepulsion\nnoise\ncurl\nplanar\n", everything, error))
+	{
+		std::cout << error << std::endl;
+		return;
+	}
+
+	behaviours.push_back(std::make_pair("all terms", everything));
+
+	for (const std::pair<std::string, GrowthBehaviour>& named : behaviours)
+	{
+		const GrowthBehaviour& behaviour = named.second;
+		GrowthBehaviour parsed;
+
+		if (!GrowthBehaviour::Parse(behaviour.ToString(), parsed, error))
+		{
+			std::cout << named.first << ": " << error << std::endl;
+			continue;
+		}
+
+		GrowthSimulator simulator(resolution, behaviour);
+		GrowthSimulator fromText(resolution, parsed);
+
+		for (GrowthSimulator * s : { &simulator, &fromText })
+		{
+			s->SetSparse(false);
+			s->SetVolume(seed.data());
+			s->SetVectorField(vectorField.data());
+		}
+
+		duration<double, std::milli> stepTime(0.0);
+		size_t mismatches = 0;
+
+		for (int i = 0; i < steps; ++i)
+		{
+			float totalTime = 1.f + i * GROWTH_FRAME_TIME;
+
+			high_resolution_clock::time_point start = high_resolution_clock::now();
+			simulator.Step(totalTime);
+			stepTime += high_resolution_clock::now() - start;
+
+			fromText.Step(totalTime);
+		}
+
+		for (size_t c = 0; c < cellCount; ++c)
+			mismatches += std::memcmp(&simulator.GetVolume()[c], &fromText.GetVolume()[c], sizeof(float)) != 0;
+
+		int terms = behaviour.gravity.enabled + behaviour.curvature.enabled + behaviour.repulsion.enabled + behaviour.noise.enabled + behaviour.curl.enabled + behaviour.planar.enabled;
+		ActivationWindow band = behaviour.GetActiveBand();
+
+		std::ostringstream bandText;
+		bandText << band.min << " " << band.max;
+
+		std::cout << std::left << std::setw(16) << named.first << std::setw(8) << terms << std::setw(16) << bandText.str() << std::setw(10) << (behaviour.UsesNormal() ? "yes" : "no")
+			<< std::setw(10) << (behaviour.UsesVectorField() ? "yes" : "no") << std::setw(12) << (behaviour.UsesCurvature() ? "yes" : "no")
+			<< std::fixed << std::setprecision(1) << std::setw(12) << stepTime.count() / steps << std::defaultfloat << std::setprecision(6) << mismatches << std::endl;
+	}
+
+	std::cout << "---------------------------------------------" << std::endl;
+}
+
+void Benchmark::DerivativeField(int resolution, int steps)
+{
+	std::cout << "---------------------------------------------" << std::endl;
+	std::cout << "Derivative field, " << resolution << "^3 cells, " << steps << " dense steps from 1 s, " << Parallel::GetThreadCount() << " threads" << std::endl;
+	std::cout << std::left << std::setw(16) << "preset" << std::setw(12) << "loads off" << std::setw(16) << "loads on" << std::setw(10) << "off ms" << std::setw(10) << "on ms"
+		<< std::setw(14) << "max error" << std::setw(14) << "mean error" << "sign flips" << std::endl;
+
+	size_t cellCount = static_cast<size_t>(resolution) * resolution * resolution;
+
+	SdfGraph graph;
+	SdfProgram program = graph.Compile(SdfShapes::Minion(graph));
+	std::vector<float> seed(cellCount);
+	program.Bake(resolution, 0.f, seed.data());
+
+	std::vector<float> vectorField(cellCount * 4);
+	NoiseBaker(NoiseParameters(), resolution).Bake(vectorField.data());
+
+	for (GrowthPreset preset : { GrowthPreset::MoltenCore, GrowthPreset::DemonBunny, GrowthPreset::Coral, GrowthPreset::Mushroom })
+	{
+		GrowthBehaviour behaviour = GrowthBehaviour::FromPreset(preset);
+		GrowthSimulator full(resolution, behaviour);
+		GrowthSimulator field(resolution, behaviour);
+		field.SetDerivativeField(true);
+
+		for (GrowthSimulator * s : { &full, &field })
+		{
+			s->SetSparse(false);
+			s->SetVolume(seed.data());
+			s->SetVectorField(vectorField.data());
+		}
+
+		duration<double, std::milli> fullTime(0.0);
+		duration<double, std::milli> fieldTime(0.0);
+
+		for (int i = 0; i < steps; ++i)
+		{
+			float totalTime = 1.f + i * GROWTH_FRAME_TIME;
+
+			high_resolution_clock::time_point start = high_resolution_clock::now();
+			full.Step(totalTime);
+			fullTime += high_resolution_clock::now() - start;
+
+			start = high_resolution_clock::now();
+			field.Step(totalTime);
+			fieldTime += high_resolution_clock::now() - start;
+		}
+
+		// Only where the growth is visible, the band of the full precision result
+		float maxError = 0.f;
+		double errorSum = 0.0;
+		size_t bandCells = 0;
+		size_t signFlips = 0;
+
+		for (size_t c = 0; c < cellCount; ++c)
+		{
+			float d = full.GetVolume()[c];
+			float error = std::abs(field.GetVolume()[c] - d);
+
+			signFlips += (d < 0.f) != (field.GetVolume()[c] < 0.f);
+
+			if (std::abs(d) <= .1f)
+			{
+				maxError = std::max(maxError, error);
+				errorSum += error;
+				++bandCells;
+			}
+		}
+
+		// Kernel plus the pass before it, which also stores one texel
+		std::ostringstream loadsOn;
+		loadsOn << KernelLoads(behaviour, true) << " + " << DerivativePassLoads(behaviour);
+
+		std::cout << std::left << std::setw(16) << GrowthBehaviour::GetPresetName(preset) << std::setw(12) << KernelLoads(behaviour, false) << std::setw(16) << loadsOn.str()
+			<< std::fixed << std::setprecision(1) << std::setw(10) << fullTime.count() / steps << std::setw(10) << fieldTime.count() / steps
+			<< std::scientific << std::setprecision(2) << std::setw(14) << maxError << std::setw(14) << errorSum / std::max(bandCells, size_t(1)) << std::defaultfloat << std::setprecision(6)
+			<< signFlips << std::endl;
+	}
+
+	std::cout << "---------------------------------------------" << std::endl;
+}
+
+void Benchmark::SeparableRelaxation(int resolution, int steps)
+{
+	std::cout << "---------------------------------------------" << std::endl;
+	std::cout << "Separable relaxation, mushroom, " << resolution << "^3 cells, " << steps << " dense steps from 1 s, " << Parallel::GetThreadCount() << " threads" << std::endl;
+	std::cout << std::left << std::setw(8) << "radius" << std::setw(12) << "loads loop" << std::setw(12) << "loads sums" << std::setw(12) << "loop ms" << std::setw(12) << "sums ms"
+		<< std::setw(14) << "max error" << std::setw(14) << "mean error" << "sign flips" << std::endl;
+
+	size_t cellCount = static_cast<size_t>(resolution) * resolution * resolution;
+
+	SdfGraph graph;
+	SdfProgram program = graph.Compile(SdfShapes::Minion(graph));
+	std::vector<float> seed(cellCount);
+	program.Bake(resolution, 0.f, seed.data());
+
+	std::vector<float> vectorField(cellCount * 4);
+	NoiseBaker(NoiseParameters(), resolution).Bake(vectorField.data());
+
+	for (int radius : { 1, 2, 4, 8, 16 })
+	{
+		GrowthBehaviour behaviour = GrowthBehaviour::FromPreset(GrowthPreset::Mushroom);
+		behaviour.relaxationRadius = radius;
+
+		GrowthSimulator loop(resolution, behaviour);
+		GrowthSimulator sums(resolution, behaviour);
+		loop.SetSeparableRelaxation(false);
+		sums.SetSeparableRelaxation(true);
+
+		for (GrowthSimulator * s : { &loop, &sums })
+		{
+			s->SetSparse(false);
+			s->SetVolume(seed.data());
+			s->SetVectorField(vectorField.data());
+		}
+
+		duration<double, std::milli> loopTime(0.0);
+		duration<double, std::milli> sumsTime(0.0);
+
+		for (int i = 0; i < steps; ++i)
+		{
+			float totalTime = 1.f + i * GROWTH_FRAME_TIME;
+
+			high_resolution_clock::time_point start = high_resolution_clock::now();
+			loop.Step(totalTime);
+			loopTime += high_resolution_clock::now() - start;
+
+			start = high_resolution_clock::now();
+			sums.Step(totalTime);
+			sumsTime += high_resolution_clock::now() - start;
+		}
+
+		// Only where the growth is visible, the band of the loop result
+		float maxError = 0.f;
+		double errorSum = 0.0;
+		size_t bandCells = 0;
+		size_t signFlips = 0;
+
+		for (size_t c = 0; c < cellCount; ++c)
+		{
+			float d = loop.GetVolume()[c];
+			float error = std::abs(sums.GetVolume()[c] - d);
+
+			signFlips += (d < 0.f) != (sums.GetVolume()[c] < 0.f);
+
+			if (std::abs(d) <= .1f)
+			{
+				maxError = std::max(maxError, error);
+				errorSum += error;
+				++bandCells;
+			}
+		}
+
+		// Radius 1 keeps the loop in both
+		bool separable = sums.UsesSeparableRelaxation();
+
+		std::cout << std::left << std::setw(8) << radius << std::setw(12) << RelaxationLoads(radius, false) << std::setw(12) << RelaxationLoads(radius, separable)
+			<< std::fixed << std::setprecision(1) << std::setw(12) << loopTime.count() / steps << std::setw(12) << sumsTime.count() / steps
+			<< std::scientific << std::setprecision(2) << std::setw(14) << maxError << std::setw(14) << errorSum / std::max(bandCells, size_t(1)) << std::defaultfloat << std::setprecision(6)
+			<< signFlips << std::endl;
+	}
+
+	std::cout << "---------------------------------------------" << std::endl;
+}
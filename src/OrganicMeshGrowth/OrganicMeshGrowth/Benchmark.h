@@ -0,0 +1,71 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// Offline measurements, run with --benchmark [name], see main.cpp
+namespace Benchmark {
+	// Compares the parallel obj parser against tinyobj, reporting MB/s for every mesh
+	void ObjParsing(const std::vector<std::string>& meshes, int iterations);
+
+	// Builds each mesh with every split method and counts node visits and triangle tests per generator voxel
+	void KdTreeSplits(const std::vector<std::string>& meshes, int resolution);
+
+	// Builds each mesh with 1, 2, 4... threads, checking the output matches the single threaded build
+	void KdTreeBuildScaling(const std::vector<std::string>& meshes, int iterations);
+
+	// Compares the memory and query cost of full and packed triangles, and how far apart their distances are
+	void TriangleLayouts(const std::vector<std::string>& meshes, int resolution);
+
+	// Checks the stackless kd-tree traversal against a brute force search over every triangle, at several tree depths
+	void KdTreeTraversal(const std::vector<std::string>& meshes, int resolution);
+
+	// Sweeps maxDepth and maxLeafSize, putting the build stats next to measured per-voxel traversal percentiles
+	void KdTreeParameters(const std::vector<std::string>& meshes, int resolution);
+
+	// Times the CPU sdf baker against the scalar MeshQuery traversal, checking both produce the same grid
+	void SdfBaking(const std::vector<std::string>& meshes, int resolution);
+
+	// Narrow band baking against the full bake: speedup, band voxels must match exactly, far field error from the Eikonal fill
+	void NarrowBandBaking(const std::vector<std::string>& meshes, int resolution, int bandWidth);
+
+	// Bakes with each SdfSignMethod and counts voxels whose sign disagrees with a brute force winding number
+	void SignMethods(const std::vector<std::string>& meshes, int resolution);
+
+	// Per voxel traversal against one candidate gather per brick, work per voxel and both CPU bakers, checking all grids match
+	void BrickCulling(const std::vector<std::string>& meshes, int resolution);
+
+	// Coarse to fine baking against the full bake: exact queries skipped, refined voxels must match, error of the interpolated ones
+	void HierarchicalBaking(const std::vector<std::string>& meshes, int resolution, int coarseResolution);
+
+	// Closest triangle and barycentric outputs of the baker: cost over a distance only bake, the triangle must give back
+	// the baked distance, and how far the unpacked barycentrics put the closest point, with brick culling off and on
+	void ClosestFeatures(const std::vector<std::string>& meshes, int resolution);
+
+	// Vector field noise hashed per texel like the shader, against NoiseBaker's lattice tables, scalar and vectorized
+	void NoiseBaking(int resolution);
+
+	// The generator's procedural shapes as SdfGraph programs: every brick running the full tape, interval pruned octree
+	// (must match bit for bit) and with far bricks interpolated, instructions run per voxel and the far field error
+	void ProceduralShapes(int resolution);
+
+	// Every growth preset on the minion seed: the scalar reference step against the brick parallel, vectorized one (must match
+	// bit for bit), ms per step and how far the surface moved
+	void GrowthSimulation(int resolution, int steps);
+
+	// Dense steps against sparse ones from the first frame on the minion: ms per step, the share of bricks updated and how
+	// far the sparse result drifts from the dense one, within .1 of the surface and over the whole volume
+	void SparseGrowth(int resolution, int steps);
+
+	// Growth behaviours: every preset written out as text and parsed back must grow the same bits, and the cost of a
+	// step against the terms each behaviour enables, up to all of them at once
+	void GrowthBehaviours(int resolution, int steps);
+
+	// Every preset with the derivative field off and on: sdf loads per updated cell of kernel.comp against the kernel plus
+	// derivatives.comp, ms per step, and how far the half float normals and curvature move the surface
+	void DerivativeField(int resolution, int steps);
+
+	// Relaxation radii from 1 to 16 with the kernel loop and with the separable sums: loads per cell, ms per step, and
+	// how far the different rounding of the box mean moves the surface
+	void SeparableRelaxation(int resolution, int steps);
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+namespace FileUtils {
+	// Creates the directory if it does not exist yet. Only the last path component is created.
+	bool EnsureDirectory(const std::string& path);
+
+	// Moves source over destination in a single step, so readers never see a partially written file
+	bool ReplaceFile(const std::string& source, const std::string& destination);
+
+	// Fast 64 bit non cryptographic hash (xxHash64), used to key the on-disk caches
+	uint64_t Hash(const void * data, size_t size, uint64_t seed = 0);
+}
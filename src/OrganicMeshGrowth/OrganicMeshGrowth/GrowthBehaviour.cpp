@@ -0,0 +1,393 @@
+#include "GrowthBehaviour.h"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+namespace {
+	bool ReadFloats(std::istringstream& stream, float * values, int count)
+	{
+		for (int i = 0; i < count; ++i)
+			if (!(stream >> values[i]))
+				return false;
+
+		return true;
+	}
+
+	bool ReadWindow(std::istringstream& stream, ActivationWindow& window)
+	{
+		float values[2];
+
+		if (!ReadFloats(stream, values, 2) || !(values[0] < values[1]))
+			return false;
+
+		window.min = values[0];
+		window.max = values[1];
+		return true;
+	}
+
+	void Include(ActivationWindow& band, bool& empty, const ActivationWindow& window)
+	{
+		band.min = empty ? window.min : std::min(band.min, window.min);
+		band.max = empty ? window.max : std::max(band.max, window.max);
+		empty = false;
+	}
+}
+
+ActivationWindow GrowthBehaviour::GetActiveBand() const
+{
+	ActivationWindow band = { 0.f, -1.f };
+	bool empty = true;
+
+	if (gravity.enabled)
+		Include(band, empty, gravity.window);
+
+	if (curvature.enabled)
+		Include(band, empty, curvature.window);
+
+	if (repulsion.enabled)
+		Include(band, empty, repulsion.window);
+
+	if (planar.enabled)
+		Include(band, empty, planar.window);
+
+	return band;
+}
+
+bool GrowthBehaviour::UsesNormal() const
+{
+	return gravity.enabled || repulsion.enabled || curl.enabled || planar.enabled;
+}
+
+bool GrowthBehaviour::UsesVectorField() const
+{
+	return noise.enabled || curl.enabled || planar.enabled;
+}
+
+bool GrowthBehaviour::UsesCurvature() const
+{
+	return curvatureOffset > 0 && (curvature.enabled || (gravity.enabled && gravity.curvatureWeighted));
+}
+
+GrowthBehaviour GrowthBehaviour::FromPreset(GrowthPreset preset)
+{
+	GrowthBehaviour behaviour;
+
+	switch (preset)
+	{
+	case GrowthPreset::MoltenCore:
+		behaviour.relaxation = 100.f;
+		behaviour.gravity.enabled = true;
+		behaviour.gravity.strength = 15.f;
+		behaviour.gravity.window = { -.2f, .5f };
+		behaviour.repulsion.enabled = true;
+		behaviour.noise.enabled = true;
+		break;
+	case GrowthPreset::DemonBunny:
+		behaviour.relaxation = 50.f;
+		behaviour.curvatureOffset = 10;
+		behaviour.curvature.enabled = true;
+		behaviour.curvature.strength = 130.f;
+		behaviour.curvature.window = { -.1f, .2f };
+		behaviour.repulsion.enabled = true;
+		behaviour.noise.enabled = true;
+		break;
+	case GrowthPreset::Coral:
+		behaviour.relaxation = 50.f;
+		behaviour.curvatureOffset = 4;
+		behaviour.curvature.enabled = true;
+		behaviour.curvature.strength = 100.f;
+		behaviour.curvature.window = { -.1f, .1f };
+		behaviour.repulsion.enabled = true;
+		behaviour.noise.enabled = true;
+		behaviour.noise.fadeStart = 0.f;
+		behaviour.noise.fadeEnd = 4.f;
+		break;
+	default:
+		behaviour.relaxation = 15.f;
+		behaviour.curvatureOffset = 5;
+		behaviour.gravity.enabled = true;
+		behaviour.gravity.strength = 100.f;
+		behaviour.gravity.curvatureWeighted = true;
+		behaviour.gravity.window = { -.1f, .1f };
+		behaviour.repulsion.enabled = true;
+		behaviour.repulsion.delta = .1f;
+		behaviour.curl.enabled = true;
+		behaviour.curl.strength = .1f;
+		behaviour.planar.enabled = true;
+		break;
+	}
+
+	return behaviour;
+}
+
+bool GrowthBehaviour::ParsePreset(const std::string& name, GrowthPreset& preset)
+{
+	const GrowthPreset presets[] = { GrowthPreset::MoltenCore, GrowthPreset::DemonBunny, GrowthPreset::Coral, GrowthPreset::Mushroom };
+
+	for (GrowthPreset p : presets)
+	{
+		if (name == GetPresetName(p))
+		{
+			preset = p;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+const char * GrowthBehaviour::GetPresetName(GrowthPreset preset)
+{
+	switch (preset)
+	{
+	case GrowthPreset::MoltenCore:
+		return "molten-core";
+	case GrowthPreset::DemonBunny:
+		return "demon-bunny";
+	case GrowthPreset::Coral:
+		return "coral";
+	default:
+		return "mushroom";
+	}
+}
+
+bool GrowthBehaviour::Parse(const std::string& text, GrowthBehaviour& behaviour, std::string& error)
+{
+	// Only what the text lists is enabled
+	GrowthBehaviour parsed;
+	std::istringstream lines(text);
+	std::string line;
+	int lineNumber = 0;
+
+	while (std::getline(lines, line))
+	{
+		++lineNumber;
+		line = line.substr(0, line.find('#'));
+
+		std::istringstream stream(line);
+		std::string term;
+
+		if (!(stream >> term))
+			continue;
+
+		bool valid = true;
+		std::string parameter;
+
+		if (term == "relaxation")
+		{
+			valid = static_cast<bool>(stream >> parsed.relaxation);
+
+			while (valid && stream >> parameter)
+			{
+				if (parameter == "radius")
+					valid = static_cast<bool>(stream >> parsed.relaxationRadius) && parsed.relaxationRadius >= 1;
+				else
+					valid = false;
+			}
+		}
+		else if (term == "curvature-offset")
+		{
+			valid = static_cast<bool>(stream >> parsed.curvatureOffset) && parsed.curvatureOffset >= 0;
+		}
+		else if (term == "gravity")
+		{
+			parsed.gravity.enabled = true;
+
+			while (valid && stream >> parameter)
+			{
+				if (parameter == "strength")
+					valid = ReadFloats(stream, &parsed.gravity.strength, 1);
+				else if (parameter == "curvature-weighted")
+					parsed.gravity.curvatureWeighted = true;
+				else if (parameter == "window")
+					valid = ReadWindow(stream, parsed.gravity.window);
+				else
+					valid = false;
+			}
+		}
+		else if (term == "curvature")
+		{
+			parsed.curvature.enabled = true;
+
+			while (valid && stream >> parameter)
+			{
+				if (parameter == "strength")
+					valid = ReadFloats(stream, &parsed.curvature.strength, 1);
+				else if (parameter == "window")
+					valid = ReadWindow(stream, parsed.curvature.window);
+				else
+					valid = false;
+			}
+		}
+		else if (term == "repulsion")
+		{
+			parsed.repulsion.enabled = true;
+
+			while (valid && stream >> parameter)
+			{
+				if (parameter == "strength")
+					valid = ReadFloats(stream, &parsed.repulsion.strength, 1);
+				else if (parameter == "delta")
+					valid = ReadFloats(stream, &parsed.repulsion.delta, 1) && parsed.repulsion.delta > 0.f;
+				else if (parameter == "window")
+					valid = ReadWindow(stream, parsed.repulsion.window);
+				else
+					valid = false;
+			}
+		}
+		else if (term == "noise")
+		{
+			parsed.noise.enabled = true;
+
+			while (valid && stream >> parameter)
+			{
+				if (parameter == "strength")
+					valid = ReadFloats(stream, &parsed.noise.strength, 1);
+				else if (parameter == "fade")
+					valid = ReadFloats(stream, &parsed.noise.fadeStart, 1) && ReadFloats(stream, &parsed.noise.fadeEnd, 1)
+						&& parsed.noise.fadeStart < parsed.noise.fadeEnd;
+				else
+					valid = false;
+			}
+		}
+		else if (term == "curl")
+		{
+			parsed.curl.enabled = true;
+
+			while (valid && stream >> parameter)
+			{
+				if (parameter == "strength")
+					valid = ReadFloats(stream, &parsed.curl.strength, 1);
+				else
+					valid = false;
+			}
+		}
+		else if (term == "planar")
+		{
+			parsed.planar.enabled = true;
+
+			while (valid && stream >> parameter)
+			{
+				if (parameter == "strength")
+					valid = ReadFloats(stream, &parsed.planar.strength, 1);
+				else if (parameter == "direction")
+				{
+					// kernel.comp and PlanarExpansion take it as a unit vector
+					valid = ReadFloats(stream, &parsed.planar.direction.x, 1) && ReadFloats(stream, &parsed.planar.direction.y, 1) && ReadFloats(stream, &parsed.planar.direction.z, 1)
+						&& glm::dot(parsed.planar.direction, parsed.planar.direction) > 0.f;
+
+					if (valid)
+						parsed.planar.direction = glm::normalize(parsed.planar.direction);
+				}
+				else if (parameter == "window")
+					valid = ReadWindow(stream, parsed.planar.window);
+				else if (parameter == "noise-fade")
+					valid = ReadFloats(stream, &parsed.planar.noiseFadeStart, 1) && ReadFloats(stream, &parsed.planar.noiseFadeEnd, 1)
+						&& parsed.planar.noiseFadeStart < parsed.planar.noiseFadeEnd;
+				else
+					valid = false;
+			}
+		}
+		else
+		{
+			error = "Unknown term " + term + " on line " + std::to_string(lineNumber);
+			return false;
+		}
+
+		// Anything left over after the value of curvature-offset
+		if (valid && stream >> parameter)
+			valid = false;
+
+		if (!valid)
+		{
+			error = "Invalid " + term + " parameters on line " + std::to_string(lineNumber);
+			return false;
+		}
+	}
+
+	if ((parsed.curvature.enabled || (parsed.gravity.enabled && parsed.gravity.curvatureWeighted)) && parsed.curvatureOffset == 0)
+	{
+		error = "The curvature terms need a curvature-offset";
+		return false;
+	}
+
+	behaviour = parsed;
+	return true;
+}
+
+bool GrowthBehaviour::Load(const std::string& filename, GrowthBehaviour& behaviour, std::string& error)
+{
+	std::ifstream file(filename);
+
+	if (!file)
+	{
+		error = "Could not open " + filename;
+		return false;
+	}
+
+	std::stringstream text;
+	text << file.rdbuf();
+
+	if (!Parse(text.str(), behaviour, error))
+	{
+		error = filename + ": " + error;
+		return false;
+	}
+
+	return true;
+}
+
+bool GrowthBehaviour::FromName(const std::string& name, GrowthBehaviour& behaviour, std::string& error)
+{
+	GrowthPreset preset;
+
+	if (ParsePreset(name, preset))
+	{
+		behaviour = FromPreset(preset);
+		return true;
+	}
+
+	return Load(name, behaviour, error);
+}
+
+std::string GrowthBehaviour::ToString() const
+{
+	std::ostringstream text;
+	text << "relaxation " << relaxation;
+
+	if (relaxationRadius > 1)
+		text << " radius " << relaxationRadius;
+
+	text << "\n";
+
+	if (curvatureOffset > 0)
+		text << "curvature-offset " << curvatureOffset << "\n";
+
+	if (gravity.enabled)
+		text << "gravity strength " << gravity.strength << (gravity.curvatureWeighted ? " curvature-weighted" : "") << " window " << gravity.window.min << " " << gravity.window.max << "\n";
+
+	if (curvature.enabled)
+		text << "curvature strength " << curvature.strength << " window " << curvature.window.min << " " << curvature.window.max << "\n";
+
+	if (repulsion.enabled)
+		text << "repulsion strength " << repulsion.strength << " delta " << repulsion.delta << " window " << repulsion.window.min << " " << repulsion.window.max << "\n";
+
+	if (noise.enabled)
+	{
+		text << "noise strength " << noise.strength;
+
+		if (noise.fadeEnd > noise.fadeStart)
+			text << " fade " << noise.fadeStart << " " << noise.fadeEnd;
+
+		text << "\n";
+	}
+
+	if (curl.enabled)
+		text << "curl strength " << curl.strength << "\n";
+
+	if (planar.enabled)
+		text << "planar strength " << planar.strength << " direction " << planar.direction.x << " " << planar.direction.y << " " << planar.direction.z
+			<< " window " << planar.window.min << " " << planar.window.max << " noise-fade " << planar.noiseFadeStart << " " << planar.noiseFadeEnd << "\n";
+
+	return text.str();
+}
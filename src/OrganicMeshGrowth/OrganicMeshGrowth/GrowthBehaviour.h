@@ -0,0 +1,126 @@
+#pragma once
+
+#include <string>
+#include <glm/glm.hpp>
+
+// The behaviours kernel.comp used to pick at compile time with MOLTEN_CORE, DEMON_BUNNY, CORAL or MUSHROOM.
+// Their constants are tuned for 256^3.
+enum class GrowthPreset
+{
+	MoltenCore,		// Relaxation 100, gravity, noise expansion inside and repulsion
+	DemonBunny,		// Relaxation 50, curvature (10 cells), repulsion and noise expansion
+	Coral,			// Relaxation 50, curvature (4 cells), repulsion and noise expansion fading out over 4 seconds
+	Mushroom		// Relaxation 15, curvature weighted gravity (5 cells), curl, repulsion and vertical planar expansion
+};
+
+// The sdf range a term is active in, activation() in kernel.comp
+struct ActivationWindow
+{
+	float min;
+	float max;
+};
+
+// What the kernel adds to the relaxation of every cell: a list of terms, each with its weights and activation window.
+// The renderer turns it into the specialization constants of kernel.comp, so disabled terms and the texture reads only
+// they need are compiled out of the pipeline, and GrowthSimulator evaluates the same terms on the CPU.
+// The terms are always added in the order below.
+//
+// Text form, one term per line, # starts a comment. Terms that aren't listed are disabled, parameters that aren't
+// given keep the defaults below. The mushroom preset:
+//
+//   relaxation 15
+//   curvature-offset 5
+//   gravity strength 100 curvature-weighted window -0.1 0.1
+//   repulsion strength 1000.1 delta 0.1 window 0 0.1
+//   curl strength 0.1
+//   planar strength 6 direction 0 1 0 window -0.1 0.05 noise-fade 2 3
+struct GrowthBehaviour
+{
+	// Strength of the relaxation kernel, and its radius in cells: the box average over (2 radius + 1)^3 cells.
+	// Written "relaxation 15 radius 4", radii above 1 run as separable sums with KERNEL_SEPARABLE_RELAXATION.
+	float relaxation = 50.f;
+	int relaxationRadius = 1;
+
+	// Distance in cells of the curv2 taps the curvature and the curvature weighted gravity read, 0 reads none
+	int curvatureOffset = 0;
+
+	// gravityDisplacement, pulls cells facing down. Curvature weighted multiplies the strength by curv2.
+	struct
+	{
+		bool enabled = false;
+		float strength = 15.f;
+		bool curvatureWeighted = false;
+		ActivationWindow window = { -.2f, .5f };
+	} gravity;
+
+	// curvatureDisplacement, grows where curv2 is positive
+	struct
+	{
+		bool enabled = false;
+		float strength = 100.f;
+		ActivationWindow window = { -.1f, .1f };
+	} curvature;
+
+	// repulsionDisplacement, pushes cells away from the surface up to delta along the normal hemisphere
+	struct
+	{
+		bool enabled = false;
+		float strength = 1000.1f;
+		float delta = .025f;
+		ActivationWindow window = { 0.f, .1f };
+	} repulsion;
+
+	// noiseExpansionDisplacement inside the surface. Written "fade 0 4" it fades out between the fade times, the end
+	// has to be later. Without it both stay 0 and the noise never fades.
+	struct
+	{
+		bool enabled = false;
+		float strength = 50.15f;
+		float fadeStart = 0.f;
+		float fadeEnd = 0.f;
+	} noise;
+
+	// vectorFieldDisplacement, along the curl of the vector field everywhere
+	struct
+	{
+		bool enabled = false;
+		float strength = .1f;
+	} curl;
+
+	// planarExpansionDisplacement, grows perpendicular to a direction. The intensity starts at .5 and moves to the
+	// Worley noise of the vector field between the noise fade times, the end has to be later. The direction is
+	// normalized when parsed, a zero direction is rejected.
+	struct
+	{
+		bool enabled = false;
+		float strength = 6.f;
+		glm::vec3 direction = glm::vec3(0.f, 1.f, 0.f);
+		ActivationWindow window = { -.1f, .05f };
+		float noiseFadeStart = 2.f;
+		float noiseFadeEnd = 3.f;
+	} planar;
+
+	// Union of the windows of the enabled terms, where cells keep their brick active in sparse updates.
+	// Without windowed terms min is above max and no cell is ever in it.
+	ActivationWindow GetActiveBand() const;
+
+	// Whether the terms read the normal, the vector field or curv2, so the kernel can skip those taps
+	bool UsesNormal() const;
+	bool UsesVectorField() const;
+	bool UsesCurvature() const;
+
+	static GrowthBehaviour FromPreset(GrowthPreset preset);
+
+	// molten-core, demon-bunny, coral or mushroom
+	static bool ParsePreset(const std::string& name, GrowthPreset& preset);
+	static const char * GetPresetName(GrowthPreset preset);
+
+	// The text form above, error says which line was wrong
+	static bool Parse(const std::string& text, GrowthBehaviour& behaviour, std::string& error);
+	static bool Load(const std::string& filename, GrowthBehaviour& behaviour, std::string& error);
+
+	// A preset name or a behaviour file
+	static bool FromName(const std::string& name, GrowthBehaviour& behaviour, std::string& error);
+
+	std::string ToString() const;
+};
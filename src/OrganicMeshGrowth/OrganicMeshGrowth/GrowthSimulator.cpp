@@ -0,0 +1,910 @@
+#include "GrowthSimulator.h"
+#include "Parallel.h"
+#include <glm/gtc/packing.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+// Step, its AVX2 rows and StepReference only match bit for bit when every multiply and add rounds on its own, like the
+// source says. Built with FMA (-mfma, /arch:AVX2) the compiler would fuse some of them, differently in each path.
+#if defined(__clang__)
+#pragma STDC FP_CONTRACT OFF
+#elif defined(__GNUC__)
+#pragma GCC optimize("fp-contract=off")
+#elif defined(_MSC_VER)
+#pragma fp_contract(off)
+#endif
+
+namespace {
+	const float TWO_PI = 6.28318530718f;
+
+	// The flag bricks.comp sets on active brick entries that only copy the previous volume
+	const uint32_t COPY_BRICK = 0x80000000u;
+
+	// The GLSL builtins, in the order the shader evaluates them
+	inline float Clamp(float x, float minValue, float maxValue)
+	{
+		return std::min(std::max(x, minValue), maxValue);
+	}
+
+	inline float SmoothStep(float edge0, float edge1, float x)
+	{
+		float t = Clamp((x - edge0) / (edge1 - edge0), 0.f, 1.f);
+		return t * t * (3.f - 2.f * t);
+	}
+
+	inline float Mix(float a, float b, float t)
+	{
+		return a * (1.f - t) + b * t;
+	}
+
+	inline float Dot(const glm::vec3& a, const glm::vec3& b)
+	{
+		return (a.x * b.x + a.y * b.y) + a.z * b.z;
+	}
+
+	// A zero vector stays zero instead of turning into NaNs that the relaxation would spread over the volume
+	inline glm::vec3 Normalize(const glm::vec3& v)
+	{
+		float lengthSquared = Dot(v, v);
+
+		if (lengthSquared == 0.f)
+			return glm::vec3(0.f);
+
+		float inverseLength = 1.f / std::sqrt(lengthSquared);
+		return v * inverseLength;
+	}
+
+	inline float Activation(float sdf, float sdfMin, float sdfMax)
+	{
+		float x = Clamp((sdf - sdfMin) / (sdfMax - sdfMin), 0.f, 1.f);
+		return Clamp((1.f + std::cos((x + .5f) * 6.28f)) / 2.10f, 0.f, 1.f);
+	}
+
+	// Bob Jenkins' one-at-a-time hash and floatConstruct, the random of kernel.comp
+	inline uint32_t Hash(uint32_t x)
+	{
+		x += (x << 10u);
+		x ^= (x >> 6u);
+		x += (x << 3u);
+		x ^= (x >> 11u);
+		x += (x << 15u);
+		return x;
+	}
+
+	inline float Random(uint32_t& seed)
+	{
+		seed = Hash(seed);
+
+		uint32_t bits = (seed & 0x007FFFFFu) | 0x3F800000u;
+		float f;
+		memcpy(&f, &bits, sizeof(f));
+		return f - 1.f;
+	}
+
+	// The shader builds the tangent basis for every sample, it only depends on the normal so callers build it once
+	inline void TangentBasis(const glm::vec3& normal, glm::vec3& v, glm::vec3& u)
+	{
+		v = Normalize(glm::cross(normal, glm::vec3(0.f, 0.f, 1.f)));
+		u = Normalize(glm::cross(v, normal));
+	}
+
+	inline glm::vec3 CosineWeightedSample(const glm::vec3& normal, const glm::vec3& v, const glm::vec3& u, uint32_t& seed)
+	{
+		float u1 = Random(seed);
+		float u2 = Random(seed);
+
+		float r = std::sqrt(u1);
+		float theta = TWO_PI * u2;
+
+		float x = r * std::cos(theta);
+		float y = r * std::sin(theta);
+		float z = std::sqrt(std::max(0.f, 1.f - u1));
+
+		return Normalize(v * x + u * y + normal * z);
+	}
+
+	// The vector field displacements of kernel.comp
+	inline float Gravity(const glm::vec3& normal, float gravity, float simulationDeltaTime)
+	{
+		return std::max(0.f, -normal.y) * -gravity * simulationDeltaTime;
+	}
+
+	inline float CurvatureDisplacement(float curvature, float strength, float simulationDeltaTime)
+	{
+		return std::max(0.f, curvature) * -strength * simulationDeltaTime;
+	}
+
+	inline float VectorFieldDisplacement(const glm::vec4& field, const glm::vec3& normal, float strength, float simulationDeltaTime)
+	{
+		return std::max(0.f, -Dot(glm::vec3(field), normal)) * -strength * simulationDeltaTime;
+	}
+
+	inline float NoiseExpansion(const glm::vec4& field, float strength, float simulationDeltaTime)
+	{
+		float expansion = SmoothStep(.7f, 1.f, field.w);
+		return -expansion * strength * simulationDeltaTime;
+	}
+
+	inline float PlanarExpansion(const glm::vec3& normal, const glm::vec3& direction, float strength, float simulationDeltaTime)
+	{
+		float cosTheta = SmoothStep(0.f, 1.f, Clamp(1.f - std::abs(Dot(normal, direction)), 0.f, 1.f));
+		return -cosTheta * strength * simulationDeltaTime;
+	}
+
+	// step(current.sdf, 0.0)
+	inline float Inside(float sdf)
+	{
+		return 0.f < sdf ? 0.f : 1.f;
+	}
+
+	inline size_t CellIndex(int resolution, const glm::ivec3& coord)
+	{
+		return (static_cast<size_t>(coord.z) * resolution + coord.y) * resolution + coord.x;
+	}
+
+	// The RGBA16F texels of the derivative field, rounded like imageStore
+	inline glm::vec4 QuantizeDerivatives(const glm::vec4& derivatives)
+	{
+		return glm::vec4(glm::unpackHalf1x16(glm::packHalf1x16(derivatives.x)), glm::unpackHalf1x16(glm::packHalf1x16(derivatives.y)),
+			glm::unpackHalf1x16(glm::packHalf1x16(derivatives.z)), glm::unpackHalf1x16(glm::packHalf1x16(derivatives.w)));
+	}
+
+#ifdef __AVX2__
+	inline const float * SourceRow(const float * source, int resolution, int x, int y, int z)
+	{
+		return source + (static_cast<size_t>(z) * resolution + y) * resolution + x;
+	}
+
+	// Relaxation of 8 cells along x whose stencils stay in the grid. Same operations in the same order as
+	// GrowthSimulator::ComputeRelaxation, no FMA, so both paths round identically.
+	void InteriorRelaxation8(const float * source, int resolution, const glm::ivec3& coord, float strength, float simulationDeltaTime, float * relaxation)
+	{
+		__m256 center = _mm256_loadu_ps(SourceRow(source, resolution, coord.x, coord.y, coord.z));
+		__m256 vStrength = _mm256_set1_ps(strength);
+		__m256 vDeltaTime = _mm256_set1_ps(simulationDeltaTime);
+		__m256 sum = _mm256_setzero_ps();
+
+		for (int k = -1; k <= 1; ++k)
+		{
+			for (int j = -1; j <= 1; ++j)
+			{
+				const float * neighbors = SourceRow(source, resolution, coord.x, coord.y + j, coord.z + k);
+
+				for (int i = -1; i <= 1; ++i)
+					sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(neighbors + i), center), vStrength), vDeltaTime));
+			}
+		}
+
+		_mm256_store_ps(relaxation, _mm256_div_ps(sum, _mm256_set1_ps(27.f)));
+	}
+
+	// Normal and curvature of 8 cells along x, like GrowthSimulator::ComputeDerivatives
+	void InteriorDerivatives8(const float * source, int resolution, const glm::ivec3& coord, int curvatureOffset, float * nx, float * ny, float * nz, float * curvature)
+	{
+		auto row = [&](int y, int z) {
+			return SourceRow(source, resolution, coord.x, y, z);
+		};
+
+		const float * centerRow = row(coord.y, coord.z);
+
+		__m256 dx = _mm256_sub_ps(_mm256_loadu_ps(centerRow + 3), _mm256_loadu_ps(centerRow - 3));
+		__m256 dy = _mm256_sub_ps(_mm256_loadu_ps(row(coord.y + 3, coord.z)), _mm256_loadu_ps(row(coord.y - 3, coord.z)));
+		__m256 dz = _mm256_sub_ps(_mm256_loadu_ps(row(coord.y, coord.z + 3)), _mm256_loadu_ps(row(coord.y, coord.z - 3)));
+
+		__m256 lengthSquared = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz));
+		__m256 inverseLength = _mm256_div_ps(_mm256_set1_ps(1.f), _mm256_sqrt_ps(lengthSquared));
+		__m256 degenerate = _mm256_cmp_ps(lengthSquared, _mm256_setzero_ps(), _CMP_EQ_OQ);
+
+		_mm256_store_ps(nx, _mm256_andnot_ps(degenerate, _mm256_mul_ps(dx, inverseLength)));
+		_mm256_store_ps(ny, _mm256_andnot_ps(degenerate, _mm256_mul_ps(dy, inverseLength)));
+		_mm256_store_ps(nz, _mm256_andnot_ps(degenerate, _mm256_mul_ps(dz, inverseLength)));
+
+		if (curvatureOffset == 0)
+		{
+			_mm256_store_ps(curvature, _mm256_setzero_ps());
+			return;
+		}
+
+		int o = curvatureOffset;
+		__m256 taps = _mm256_add_ps(_mm256_loadu_ps(centerRow + o), _mm256_loadu_ps(centerRow - o));
+		taps = _mm256_add_ps(taps, _mm256_loadu_ps(row(coord.y + o, coord.z)));
+		taps = _mm256_add_ps(taps, _mm256_loadu_ps(row(coord.y - o, coord.z)));
+		taps = _mm256_add_ps(taps, _mm256_loadu_ps(row(coord.y, coord.z + o)));
+		taps = _mm256_add_ps(taps, _mm256_loadu_ps(row(coord.y, coord.z - o)));
+
+		__m256 laplacian = _mm256_sub_ps(taps, _mm256_mul_ps(_mm256_set1_ps(6.f), _mm256_loadu_ps(centerRow)));
+		_mm256_store_ps(curvature, _mm256_mul_ps(_mm256_set1_ps(.25f / o), laplacian));
+	}
+
+	// Sums of 8 cells along x over count cells stride apart, in the order of GrowthSimulator::BoxSum
+	void BoxSum8(const float * first, ptrdiff_t stride, int count, float * sums)
+	{
+		__m256 sum = _mm256_setzero_ps();
+
+		for (int i = 0; i < count; ++i)
+			sum = _mm256_add_ps(sum, _mm256_loadu_ps(first + i * stride));
+
+		_mm256_storeu_ps(sums, sum);
+	}
+#endif
+}
+
+GrowthSimulator::GrowthSimulator(int resolution, const GrowthBehaviour& behaviour) : resolution(resolution), behaviour(behaviour)
+{
+	relaxationStrength = behaviour.relaxation;
+	relaxationRadius = behaviour.relaxationRadius;
+	curvatureOffset = behaviour.UsesCurvature() ? behaviour.curvatureOffset : 0;
+
+	ActivationWindow band = behaviour.GetActiveBand();
+	bandMin = band.min;
+	bandMax = band.max;
+
+	size_t cellCount = static_cast<size_t>(resolution) * resolution * resolution;
+	volumes[0].resize(cellCount);
+	volumes[1].resize(cellCount);
+	vectorField.resize(cellCount * 4);
+
+	bricksPerAxis = (resolution + GROWTH_BRICK_SIZE - 1) / GROWTH_BRICK_SIZE;
+	brickInBand.resize(bricksPerAxis * bricksPerAxis * bricksPerAxis);
+	brickUpdated.resize(brickInBand.size());
+	activeBricks.reserve(brickInBand.size());
+	ResetActiveBricks();
+
+	SetDerivativeField(GROWTH_DERIVATIVE_FIELD);
+	SetSeparableRelaxation(GROWTH_SEPARABLE_RELAXATION);
+}
+
+GrowthSimulator::GrowthSimulator(int resolution, GrowthPreset preset) : GrowthSimulator(resolution, GrowthBehaviour::FromPreset(preset))
+{
+}
+
+void GrowthSimulator::SetVolume(const float * distances)
+{
+	std::copy(distances, distances + volumes[current].size(), volumes[current].begin());
+	ResetActiveBricks();
+}
+
+void GrowthSimulator::SetSparse(bool sparse)
+{
+	this->sparse = sparse;
+}
+
+bool GrowthSimulator::IsSparse() const
+{
+	return sparse;
+}
+
+void GrowthSimulator::SetDerivativeField(bool derivativeField)
+{
+	this->derivativeField = derivativeField;
+
+	if (derivativeField)
+		derivatives.resize(volumes[0].size());
+	else
+		std::vector<glm::vec4>().swap(derivatives);
+}
+
+bool GrowthSimulator::UsesDerivativeField() const
+{
+	return derivativeField;
+}
+
+void GrowthSimulator::SetSeparableRelaxation(bool separableRelaxation)
+{
+	this->separableRelaxation = separableRelaxation;
+
+	for (std::vector<float>& sums : boxSums)
+	{
+		if (UsesSeparableRelaxation())
+			sums.resize(volumes[0].size());
+		else
+			std::vector<float>().swap(sums);
+	}
+}
+
+bool GrowthSimulator::UsesSeparableRelaxation() const
+{
+	return separableRelaxation && relaxationRadius > 1;
+}
+
+int GrowthSimulator::GetActiveBrickCount() const
+{
+	return activeBrickCount;
+}
+
+int GrowthSimulator::GetBrickCount() const
+{
+	return static_cast<int>(brickInBand.size());
+}
+
+void GrowthSimulator::SetVectorField(const float * texels)
+{
+	std::copy(texels, texels + vectorField.size(), vectorField.begin());
+}
+
+const float * GrowthSimulator::GetVolume() const
+{
+	return volumes[current].data();
+}
+
+int GrowthSimulator::GetResolution() const
+{
+	return resolution;
+}
+
+const GrowthBehaviour& GrowthSimulator::GetBehaviour() const
+{
+	return behaviour;
+}
+
+void GrowthSimulator::ResetActiveBricks()
+{
+	std::fill(brickInBand.begin(), brickInBand.end(), 1);
+	std::fill(brickUpdated.begin(), brickUpdated.end(), 1);
+}
+
+void GrowthSimulator::UpdateActiveBricks()
+{
+	activeBricks.clear();
+	haloBricks.clear();
+	activeBrickCount = 0;
+
+	int halo = GetHaloBricks();
+
+	for (int brick = 0; brick < GetBrickCount(); ++brick)
+	{
+		glm::ivec3 b(brick % bricksPerAxis, (brick / bricksPerAxis) % bricksPerAxis, brick / (bricksPerAxis * bricksPerAxis));
+		glm::ivec3 minBounds = glm::max(b - 1, glm::ivec3(0));
+		glm::ivec3 maxBounds = glm::min(b + 1, glm::ivec3(bricksPerAxis - 1));
+		bool active = false;
+
+		for (int k = minBounds.z; k <= maxBounds.z && !active; ++k)
+			for (int j = minBounds.y; j <= maxBounds.y && !active; ++j)
+				for (int i = minBounds.x; i <= maxBounds.x && !active; ++i)
+					active = brickInBand[(k * bricksPerAxis + j) * bricksPerAxis + i] != 0;
+
+		if (active)
+		{
+			activeBricks.push_back(brick);
+			++activeBrickCount;
+		}
+		else if (brickUpdated[brick])
+		{
+			activeBricks.push_back(brick | COPY_BRICK);
+		}
+
+		brickUpdated[brick] = active ? 1 : 0;
+
+		if (halo > 0)
+		{
+			// Within the halo of an updated brick, so within 1 + halo of one in the band
+			glm::ivec3 haloMin = glm::max(b - 1 - halo, glm::ivec3(0));
+			glm::ivec3 haloMax = glm::min(b + 1 + halo, glm::ivec3(bricksPerAxis - 1));
+			bool inHalo = active;
+
+			for (int k = haloMin.z; k <= haloMax.z && !inHalo; ++k)
+				for (int j = haloMin.y; j <= haloMax.y && !inHalo; ++j)
+					for (int i = haloMin.x; i <= haloMax.x && !inHalo; ++i)
+						inHalo = brickInBand[(k * bricksPerAxis + j) * bricksPerAxis + i] != 0;
+
+			if (inHalo)
+				haloBricks.push_back(brick);
+		}
+	}
+}
+
+int GrowthSimulator::GetHaloBricks() const
+{
+	return UsesSeparableRelaxation() ? (relaxationRadius + GROWTH_BRICK_SIZE - 1) / GROWTH_BRICK_SIZE : 0;
+}
+
+bool GrowthSimulator::UsesAVX2()
+{
+#ifdef __AVX2__
+	return true;
+#else
+	return false;
+#endif
+}
+
+int GrowthSimulator::GetStencilReach() const
+{
+	// Normals sample 3 cells away, relaxation 1
+	return std::max(3, curvatureOffset);
+}
+
+// imageLoad out of bounds, which reads 0 with robust access
+float GrowthSimulator::Load(const float * source, const glm::ivec3& coord) const
+{
+	if (coord.x < 0 || coord.y < 0 || coord.z < 0 || coord.x >= resolution || coord.y >= resolution || coord.z >= resolution)
+		return 0.f;
+
+	return source[CellIndex(resolution, coord)];
+}
+
+float GrowthSimulator::LoadClamped(const float * source, const glm::ivec3& coord) const
+{
+	return source[CellIndex(resolution, glm::clamp(coord, glm::ivec3(0), glm::ivec3(resolution - 1)))];
+}
+
+float GrowthSimulator::ComputeRelaxation(const float * source, const glm::ivec3& coord, float simulationDeltaTime) const
+{
+	float center = source[CellIndex(resolution, coord)];
+
+	// The kernel loop of main(), KernelSum counts the neighbours inside the grid
+	glm::ivec3 minBounds = glm::clamp(coord - relaxationRadius, glm::ivec3(0), glm::ivec3(resolution - 1));
+	glm::ivec3 maxBounds = glm::clamp(coord + relaxationRadius, glm::ivec3(0), glm::ivec3(resolution - 1));
+
+	if (UsesSeparableRelaxation())
+	{
+		// The x, y and z passes in their order, for one cell
+		float boxSum = 0.f;
+
+		for (int k = minBounds.z; k <= maxBounds.z; ++k)
+		{
+			float planeSum = 0.f;
+
+			for (int j = minBounds.y; j <= maxBounds.y; ++j)
+			{
+				float rowSum = 0.f;
+
+				for (int i = minBounds.x; i <= maxBounds.x; ++i)
+					rowSum += source[CellIndex(resolution, glm::ivec3(i, j, k))];
+
+				planeSum += rowSum;
+			}
+
+			boxSum += planeSum;
+		}
+
+		return BoxRelaxation(boxSum, coord, center, simulationDeltaTime);
+	}
+
+	float sum = 0.f;
+	float kernelSum = 0.f;
+
+	for (int k = minBounds.z; k <= maxBounds.z; ++k)
+	{
+		for (int j = minBounds.y; j <= maxBounds.y; ++j)
+		{
+			for (int i = minBounds.x; i <= maxBounds.x; ++i)
+			{
+				sum += ((source[CellIndex(resolution, glm::ivec3(i, j, k))] - center) * relaxationStrength) * simulationDeltaTime;
+				kernelSum += 1.f;
+			}
+		}
+	}
+
+	return sum / kernelSum;
+}
+
+float GrowthSimulator::BoxRelaxation(float boxSum, const glm::ivec3& coord, float center, float simulationDeltaTime) const
+{
+	// separableRelaxation() in kernel.comp
+	glm::ivec3 minBounds = glm::max(coord - relaxationRadius, glm::ivec3(0));
+	glm::ivec3 maxBounds = glm::min(coord + relaxationRadius, glm::ivec3(resolution - 1));
+	glm::ivec3 count = maxBounds - minBounds + 1;
+
+	return (boxSum / static_cast<float>(count.x * count.y * count.z) - center) * relaxationStrength * simulationDeltaTime;
+}
+
+float GrowthSimulator::BoxSum(const float * input, const glm::ivec3& coord, int axis) const
+{
+	glm::ivec3 cell = coord;
+	int first = std::max(coord[axis] - relaxationRadius, 0);
+	int last = std::min(coord[axis] + relaxationRadius, resolution - 1);
+	float sum = 0.f;
+
+	for (int i = first; i <= last; ++i)
+	{
+		cell[axis] = i;
+		sum += input[CellIndex(resolution, cell)];
+	}
+
+	return sum;
+}
+
+void GrowthSimulator::BoxSumBrick(int brick, int axis, const float * input, float * output) const
+{
+	glm::ivec3 first = glm::ivec3(brick % bricksPerAxis, (brick / bricksPerAxis) % bricksPerAxis, brick / (bricksPerAxis * bricksPerAxis)) * GROWTH_BRICK_SIZE;
+	glm::ivec3 last = glm::min(first + GROWTH_BRICK_SIZE, glm::ivec3(resolution));
+
+#ifdef __AVX2__
+	ptrdiff_t stride = axis == 0 ? 1 : (axis == 1 ? resolution : static_cast<ptrdiff_t>(resolution) * resolution);
+
+	// Along y and z every cell of a row sums the same span, along x only once the box is inside the grid
+	int vectorFirst = axis == 0 ? std::max(first.x, relaxationRadius) : first.x;
+	int vectorLast = axis == 0 ? std::min(last.x, resolution - relaxationRadius) : last.x;
+#endif
+
+	for (int z = first.z; z < last.z; ++z)
+	{
+		for (int y = first.y; y < last.y; ++y)
+		{
+			size_t row = (static_cast<size_t>(z) * resolution + y) * resolution;
+			int x = first.x;
+
+#ifdef __AVX2__
+			for (; x < std::min(vectorFirst, last.x); ++x)
+				output[row + x] = BoxSum(input, glm::ivec3(x, y, z), axis);
+
+			for (; x + 8 <= vectorLast; x += 8)
+			{
+				glm::ivec3 coord(x, y, z);
+				int firstCell = std::max(coord[axis] - relaxationRadius, 0);
+				int lastCell = std::min(coord[axis] + relaxationRadius, resolution - 1);
+
+				BoxSum8(input + row + x + (firstCell - coord[axis]) * stride, stride, lastCell - firstCell + 1, output + row + x);
+			}
+#endif
+
+			for (; x < last.x; ++x)
+				output[row + x] = BoxSum(input, glm::ivec3(x, y, z), axis);
+		}
+	}
+}
+
+void GrowthSimulator::ComputeBoxSums(const float * source)
+{
+	int haloCount = sparse ? static_cast<int>(haloBricks.size()) : GetBrickCount();
+	auto haloBrick = [&](int i) { return sparse ? static_cast<int>(haloBricks[i]) : i; };
+
+	// relaxation.comp along x and y, far enough around the updated bricks for their boxes
+	Parallel::For(haloCount, [&](int i) { BoxSumBrick(haloBrick(i), 0, source, boxSums[0].data()); });
+	Parallel::For(haloCount, [&](int i) { BoxSumBrick(haloBrick(i), 1, boxSums[0].data(), boxSums[1].data()); });
+
+	// The z sums kernel.comp adds up inline, only for the bricks it updates
+	if (sparse)
+	{
+		Parallel::For(static_cast<int>(activeBricks.size()), [&](int i) {
+			if (!(activeBricks[i] & COPY_BRICK))
+				BoxSumBrick(static_cast<int>(activeBricks[i]), 2, boxSums[1].data(), boxSums[0].data());
+		});
+	}
+	else
+	{
+		Parallel::For(GetBrickCount(), [&](int brick) { BoxSumBrick(brick, 2, boxSums[1].data(), boxSums[0].data()); });
+	}
+}
+
+glm::vec4 GrowthSimulator::ComputeDerivatives(const float * source, const glm::ivec3& coord) const
+{
+	// sdfNormal(coord, 3)
+	float dx = LoadClamped(source, coord + glm::ivec3(3, 0, 0)) - LoadClamped(source, coord - glm::ivec3(3, 0, 0));
+	float dy = LoadClamped(source, coord + glm::ivec3(0, 3, 0)) - LoadClamped(source, coord - glm::ivec3(0, 3, 0));
+	float dz = LoadClamped(source, coord + glm::ivec3(0, 0, 3)) - LoadClamped(source, coord - glm::ivec3(0, 0, 3));
+	glm::vec4 derivatives(Normalize(glm::vec3(dx, dy, dz)), 0.f);
+
+	// curv2, whose taps are not clamped
+	if (curvatureOffset > 0)
+	{
+		int o = curvatureOffset;
+		float t1 = Load(source, coord + glm::ivec3(o, 0, 0));
+		float t2 = Load(source, coord - glm::ivec3(o, 0, 0));
+		float t3 = Load(source, coord + glm::ivec3(0, o, 0));
+		float t4 = Load(source, coord - glm::ivec3(0, o, 0));
+		float t5 = Load(source, coord + glm::ivec3(0, 0, o));
+		float t6 = Load(source, coord - glm::ivec3(0, 0, o));
+
+		derivatives.w = (.25f / o) * (t1 + t2 + t3 + t4 + t5 + t6 - 6.f * source[CellIndex(resolution, coord)]);
+	}
+
+	return derivatives;
+}
+
+GrowthSimulator::Stencils GrowthSimulator::ComputeStencils(const float * source, const glm::ivec3& coord, float simulationDeltaTime) const
+{
+	size_t index = CellIndex(resolution, coord);
+	glm::vec4 derivatives = derivativeField ? this->derivatives[index] : ComputeDerivatives(source, coord);
+	float relaxation = UsesSeparableRelaxation() ? BoxRelaxation(boxSums[0][index], coord, source[index], simulationDeltaTime) : ComputeRelaxation(source, coord, simulationDeltaTime);
+
+	Stencils stencils = { relaxation, glm::vec3(derivatives), derivatives.w };
+	return stencils;
+}
+
+float GrowthSimulator::Repulsion(const float * source, const glm::ivec3& coord, const glm::vec3& normal, float delta, float strength, float totalTime, float simulationDeltaTime) const
+{
+	const uint32_t sampleCount = 8;
+
+	uint32_t seed = static_cast<uint32_t>(coord.x + resolution * coord.y + resolution * resolution * coord.z + static_cast<int>(totalTime * 1000.f));
+	glm::vec3 position = glm::vec3(coord) / static_cast<float>(resolution);
+	float totalRepulsion = 0.f;
+
+	glm::vec3 v, u;
+	TangentBasis(normal, v, u);
+
+	for (uint32_t i = 0; i < sampleCount; ++i)
+	{
+		glm::vec3 direction = CosineWeightedSample(normal, v, u, seed);
+		float d = delta * (Random(seed) * .5f + .5f);
+		glm::vec3 compared = position + direction * d;
+
+		float repulsion = Load(source, glm::ivec3(compared * static_cast<float>(resolution))) * Dot(normal, direction) * (1.f - (d / delta));
+		totalRepulsion += -std::min(0.f, repulsion);
+	}
+
+	return (totalRepulsion / static_cast<float>(sampleCount)) * strength * simulationDeltaTime;
+}
+
+float GrowthSimulator::UpdateCell(const float * source, const glm::ivec3& coord, const Stencils& stencils, float totalTime, float simulationDeltaTime) const
+{
+	size_t index = CellIndex(resolution, coord);
+	float sdf = source[index];
+	const glm::vec3& normal = stencils.normal;
+	glm::vec4 field(vectorField[index * 4], vectorField[index * 4 + 1], vectorField[index * 4 + 2], vectorField[index * 4 + 3]);
+
+	float displacement = 0.f;
+
+	if (behaviour.gravity.enabled)
+	{
+		float strength = behaviour.gravity.curvatureWeighted ? stencils.curvature * behaviour.gravity.strength : behaviour.gravity.strength;
+		displacement += Gravity(normal, strength, simulationDeltaTime) * Activation(sdf, behaviour.gravity.window.min, behaviour.gravity.window.max);
+	}
+
+	if (behaviour.curvature.enabled)
+		displacement += CurvatureDisplacement(stencils.curvature, behaviour.curvature.strength, simulationDeltaTime) * Activation(sdf, behaviour.curvature.window.min, behaviour.curvature.window.max);
+
+	if (behaviour.repulsion.enabled)
+	{
+		float repulsion = Repulsion(source, coord, normal, behaviour.repulsion.delta, behaviour.repulsion.strength, totalTime, simulationDeltaTime);
+		displacement += repulsion * Activation(sdf, behaviour.repulsion.window.min, behaviour.repulsion.window.max);
+	}
+
+	if (behaviour.noise.enabled)
+	{
+		float noise = NoiseExpansion(field, behaviour.noise.strength, simulationDeltaTime) * Inside(sdf);
+
+		if (behaviour.noise.fadeEnd > behaviour.noise.fadeStart)
+			noise *= 1.f - SmoothStep(behaviour.noise.fadeStart, behaviour.noise.fadeEnd, totalTime);
+
+		displacement += noise;
+	}
+
+	if (behaviour.curl.enabled)
+		displacement += VectorFieldDisplacement(field, normal, behaviour.curl.strength, simulationDeltaTime);
+
+	if (behaviour.planar.enabled)
+	{
+		float timeFactor = 1.f - SmoothStep(behaviour.planar.noiseFadeStart, behaviour.planar.noiseFadeEnd, totalTime);
+		float intensity = Mix(field.w, .5f, timeFactor);
+		displacement += PlanarExpansion(normal, behaviour.planar.direction, intensity * behaviour.planar.strength, simulationDeltaTime)
+			* Activation(sdf, behaviour.planar.window.min, behaviour.planar.window.max);
+	}
+
+	float delta = stencils.relaxation + displacement;
+	float timeFactor = (1.f - SmoothStep(35.f, 40.f, totalTime)) * SmoothStep(0.f, .2f, totalTime);
+
+	return sdf + delta * timeFactor;
+}
+
+bool GrowthSimulator::StepBrick(int brick, const float * source, float * target, float totalTime, float simulationDeltaTime) const
+{
+	glm::ivec3 first = glm::ivec3(brick % bricksPerAxis, (brick / bricksPerAxis) % bricksPerAxis, brick / (bricksPerAxis * bricksPerAxis)) * GROWTH_BRICK_SIZE;
+	glm::ivec3 last = glm::min(first + GROWTH_BRICK_SIZE, glm::ivec3(resolution));
+
+#ifdef __AVX2__
+	int reach = GetStencilReach();
+#endif
+
+	for (int z = first.z; z < last.z; ++z)
+	{
+		for (int y = first.y; y < last.y; ++y)
+		{
+			float * targetRow = target + (static_cast<size_t>(z) * resolution + y) * resolution;
+			int x = first.x;
+
+#ifdef __AVX2__
+			// Rows whose y and z stencils stay inside, x runs 8 cells at a time once it is far enough from the border
+			if (y >= reach && y < resolution - reach && z >= reach && z < resolution - reach)
+			{
+				for (; x < std::min(reach, last.x); ++x)
+					targetRow[x] = UpdateCell(source, glm::ivec3(x, y, z), ComputeStencils(source, glm::ivec3(x, y, z), simulationDeltaTime), totalTime, simulationDeltaTime);
+
+				alignas(32) float relaxation[8];
+				alignas(32) float nx[8];
+				alignas(32) float ny[8];
+				alignas(32) float nz[8];
+				alignas(32) float curvature[8];
+
+				for (; x + 8 <= std::min(last.x, resolution - reach); x += 8)
+				{
+					if (UsesSeparableRelaxation())
+					{
+						for (int l = 0; l < 8; ++l)
+						{
+							size_t index = CellIndex(resolution, glm::ivec3(x + l, y, z));
+							relaxation[l] = BoxRelaxation(boxSums[0][index], glm::ivec3(x + l, y, z), source[index], simulationDeltaTime);
+						}
+					}
+					else if (relaxationRadius == 1)
+					{
+						InteriorRelaxation8(source, resolution, glm::ivec3(x, y, z), relaxationStrength, simulationDeltaTime, relaxation);
+					}
+					else
+					{
+						for (int l = 0; l < 8; ++l)
+							relaxation[l] = ComputeRelaxation(source, glm::ivec3(x + l, y, z), simulationDeltaTime);
+					}
+
+					if (!derivativeField)
+						InteriorDerivatives8(source, resolution, glm::ivec3(x, y, z), curvatureOffset, nx, ny, nz, curvature);
+
+					for (int l = 0; l < 8; ++l)
+					{
+						Stencils stencils = { relaxation[l], glm::vec3(nx[l], ny[l], nz[l]), curvature[l] };
+
+						if (derivativeField)
+						{
+							const glm::vec4& derivatives = this->derivatives[CellIndex(resolution, glm::ivec3(x + l, y, z))];
+							stencils.normal = glm::vec3(derivatives);
+							stencils.curvature = derivatives.w;
+						}
+
+						targetRow[x + l] = UpdateCell(source, glm::ivec3(x + l, y, z), stencils, totalTime, simulationDeltaTime);
+					}
+				}
+			}
+#endif
+
+			for (; x < last.x; ++x)
+				targetRow[x] = UpdateCell(source, glm::ivec3(x, y, z), ComputeStencils(source, glm::ivec3(x, y, z), simulationDeltaTime), totalTime, simulationDeltaTime);
+		}
+	}
+
+	bool inBand = false;
+
+	for (int z = first.z; z < last.z; ++z)
+	{
+		for (int y = first.y; y < last.y; ++y)
+		{
+			const float * targetRow = target + (static_cast<size_t>(z) * resolution + y) * resolution;
+
+			for (int x = first.x; x < last.x; ++x)
+				inBand |= targetRow[x] >= bandMin && targetRow[x] <= bandMax;
+		}
+	}
+
+	return inBand;
+}
+
+void GrowthSimulator::CopyBrick(int brick, const float * source, float * target) const
+{
+	glm::ivec3 first = glm::ivec3(brick % bricksPerAxis, (brick / bricksPerAxis) % bricksPerAxis, brick / (bricksPerAxis * bricksPerAxis)) * GROWTH_BRICK_SIZE;
+	glm::ivec3 last = glm::min(first + GROWTH_BRICK_SIZE, glm::ivec3(resolution));
+
+	for (int z = first.z; z < last.z; ++z)
+	{
+		for (int y = first.y; y < last.y; ++y)
+		{
+			size_t row = (static_cast<size_t>(z) * resolution + y) * resolution;
+			std::copy(source + row + first.x, source + row + last.x, target + row + first.x);
+		}
+	}
+}
+
+void GrowthSimulator::DerivativeBrick(int brick, const float * source)
+{
+	glm::ivec3 first = glm::ivec3(brick % bricksPerAxis, (brick / bricksPerAxis) % bricksPerAxis, brick / (bricksPerAxis * bricksPerAxis)) * GROWTH_BRICK_SIZE;
+	glm::ivec3 last = glm::min(first + GROWTH_BRICK_SIZE, glm::ivec3(resolution));
+
+#ifdef __AVX2__
+	int reach = GetStencilReach();
+#endif
+
+	for (int z = first.z; z < last.z; ++z)
+	{
+		for (int y = first.y; y < last.y; ++y)
+		{
+			glm::vec4 * row = derivatives.data() + (static_cast<size_t>(z) * resolution + y) * resolution;
+			int x = first.x;
+
+#ifdef __AVX2__
+			if (y >= reach && y < resolution - reach && z >= reach && z < resolution - reach)
+			{
+				for (; x < std::min(reach, last.x); ++x)
+					row[x] = QuantizeDerivatives(ComputeDerivatives(source, glm::ivec3(x, y, z)));
+
+				alignas(32) float nx[8];
+				alignas(32) float ny[8];
+				alignas(32) float nz[8];
+				alignas(32) float curvature[8];
+
+				for (; x + 8 <= std::min(last.x, resolution - reach); x += 8)
+				{
+					InteriorDerivatives8(source, resolution, glm::ivec3(x, y, z), curvatureOffset, nx, ny, nz, curvature);
+
+					for (int l = 0; l < 8; ++l)
+						row[x + l] = QuantizeDerivatives(glm::vec4(nx[l], ny[l], nz[l], curvature[l]));
+				}
+			}
+#endif
+
+			for (; x < last.x; ++x)
+				row[x] = QuantizeDerivatives(ComputeDerivatives(source, glm::ivec3(x, y, z)));
+		}
+	}
+}
+
+void GrowthSimulator::Step(float totalTime, float simulationDeltaTime)
+{
+	const float * source = volumes[current].data();
+	float * target = volumes[1 - current].data();
+
+	if (sparse)
+	{
+		UpdateActiveBricks();
+
+		if (UsesSeparableRelaxation())
+			ComputeBoxSums(source);
+
+		// The derivatives.comp pass over the same list, copied bricks don't read it
+		if (derivativeField)
+		{
+			Parallel::For(static_cast<int>(activeBricks.size()), [&](int i) {
+				if (!(activeBricks[i] & COPY_BRICK))
+					DerivativeBrick(static_cast<int>(activeBricks[i]), source);
+			});
+		}
+
+		Parallel::For(static_cast<int>(activeBricks.size()), [&](int i) {
+			int brick = static_cast<int>(activeBricks[i] & ~COPY_BRICK);
+
+			if (activeBricks[i] & COPY_BRICK)
+				CopyBrick(brick, source, target);
+			else
+				brickInBand[brick] = StepBrick(brick, source, target, totalTime, simulationDeltaTime) ? 1 : 0;
+		});
+	}
+	else
+	{
+		if (UsesSeparableRelaxation())
+			ComputeBoxSums(source);
+
+		if (derivativeField)
+			Parallel::For(GetBrickCount(), [&](int brick) { DerivativeBrick(brick, source); });
+
+		// Keeps the bricks up to date, so sparse steps can follow
+		Parallel::For(GetBrickCount(), [&](int brick) {
+			brickInBand[brick] = StepBrick(brick, source, target, totalTime, simulationDeltaTime) ? 1 : 0;
+		});
+
+		std::fill(brickUpdated.begin(), brickUpdated.end(), 1);
+		activeBrickCount = GetBrickCount();
+	}
+
+	current = 1 - current;
+}
+
+void GrowthSimulator::StepReference(float totalTime, float simulationDeltaTime)
+{
+	const float * source = volumes[current].data();
+	float * target = volumes[1 - current].data();
+
+	for (int z = 0; z < resolution; ++z)
+	{
+		for (int y = 0; y < resolution; ++y)
+		{
+			for (int x = 0; x < resolution; ++x)
+			{
+				glm::ivec3 coord(x, y, z);
+				glm::vec4 derivatives = ComputeDerivatives(source, coord);
+
+				// Rounded like the derivative field, without one
+				if (derivativeField)
+					derivatives = QuantizeDerivatives(derivatives);
+
+				Stencils stencils = { ComputeRelaxation(source, coord, simulationDeltaTime), glm::vec3(derivatives), derivatives.w };
+				target[CellIndex(resolution, coord)] = UpdateCell(source, coord, stencils, totalTime, simulationDeltaTime);
+			}
+		}
+	}
+
+	ResetActiveBricks();
+	activeBrickCount = GetBrickCount();
+	current = 1 - current;
+}
@@ -0,0 +1,171 @@
+#pragma once
+
+#include "GrowthBehaviour.h"
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+// Cells per side of the bricks Step hands out to threads, the kernel.comp workgroup size
+#define GROWTH_BRICK_SIZE 8
+
+// Only update the bricks near the surface, like KERNEL_SPARSE_BRICKS on the GPU. See SetSparse.
+#define GROWTH_SPARSE_BRICKS true
+
+// Normal and curvature of every updated cell in a pass of their own, rounded to half floats, like KERNEL_DERIVATIVE_FIELD.
+// See SetDerivativeField.
+#define GROWTH_DERIVATIVE_FIELD false
+
+// Relaxation radii above 1 as box sums along x, y and z, like KERNEL_SEPARABLE_RELAXATION. See SetSeparableRelaxation.
+#define GROWTH_SEPARABLE_RELAXATION true
+
+// Time::simulationDeltaTime in Scene.h, fixed on the GPU as well
+#define GROWTH_SIMULATION_DELTA_TIME .0001f
+
+// The GPU advances totalTime by the frame time and runs one kernel dispatch per frame. Offline, every step is one 60 Hz frame.
+#define GROWTH_FRAME_TIME (1.f / 60.f)
+
+// kernel.comp fades the growth out between 35 and 40 seconds, nothing changes after this many frames
+#define GROWTH_FULL_STEPS 2400
+
+// CPU version of the deformation pass in kernel.comp, for growth runs without a Vulkan device or window and as a
+// reference for shader changes. Every step is the per cell update of main(): relaxation over the (2 radius + 1)^3
+// neighbourhood plus the terms of the behaviour, read from one volume of a ping-pong pair and written to the other.
+// Bricks run on every core. Inside them, cells whose stencils stay in the grid get their relaxation, normal and curvature
+// 8 along x at a time when built with AVX2, the rest and the displacements are scalar. Cells only read the previous
+// volume, so the result does not depend on the thread count, and StepReference gives the same bits.
+// In sparse mode only bricks near a brick with a cell inside the activation band of the behaviour are updated, the rest of
+// the volume keeps its values. That is what kernel.comp and bricks.comp do with KERNEL_SPARSE_BRICKS.
+class GrowthSimulator
+{
+public:
+	GrowthSimulator(int resolution, const GrowthBehaviour& behaviour);
+	GrowthSimulator(int resolution, GrowthPreset preset);
+
+	// resolution^3 distances, x fastest, like SdfBaker::Bake
+	void SetVolume(const float * distances);
+
+	// resolution^3 RGBA texels, like NoiseBaker::Bake. Behaviours that don't read it can leave it zero.
+	void SetVectorField(const float * texels);
+
+	// One kernel dispatch at totalTime, then the volumes swap
+	void Step(float totalTime, float simulationDeltaTime = GROWTH_SIMULATION_DELTA_TIME);
+
+	// Same update, one cell at a time on the calling thread, always dense
+	void StepReference(float totalTime, float simulationDeltaTime = GROWTH_SIMULATION_DELTA_TIME);
+
+	// Sparse steps update the bricks that had a cell between the band limits after their last update, and their 26
+	// neighbours, so the band can grow one brick per step. Far from the surface the activations of every term are
+	// practically zero, but the relaxation, the inside noise expansion and the curl still move cells a little there,
+	// which sparse steps skip.
+	void SetSparse(bool sparse);
+	bool IsSparse() const;
+
+	// Every step first writes the normal and curvature of the cells it updates into a volume of half float texels, the
+	// derivatives.comp pass, and the update reads them from there. The reference step rounds them the same way.
+	void SetDerivativeField(bool derivativeField);
+	bool UsesDerivativeField() const;
+
+	// Behaviours with a relaxation radius above 1: every step first sums the box of each cell one axis at a time, x and
+	// y over the bricks within the radius of an updated one (relaxation.comp) and z over the updated ones (inline in
+	// kernel.comp), 3 (2 radius + 1) reads per cell instead of (2 radius + 1)^3. The box mean then rounds differently
+	// from the kernel loop, the reference step sums in the same order. Radius 1 keeps the loop either way.
+	void SetSeparableRelaxation(bool separableRelaxation);
+	bool UsesSeparableRelaxation() const;
+
+	// Bricks the last step updated, out of GetBrickCount
+	int GetActiveBrickCount() const;
+	int GetBrickCount() const;
+
+	// The volume the last step wrote
+	const float * GetVolume() const;
+
+	int GetResolution() const;
+	const GrowthBehaviour& GetBehaviour() const;
+
+	// Whether this file was built with AVX2, which the CPU must then have, see Parallel::HasAVX2
+	static bool UsesAVX2();
+
+private:
+	// What main() gathers from the neighbourhood before the displacements
+	struct Stencils
+	{
+		float relaxation;		// Kernel sum over the neighbours, divided by their count
+		glm::vec3 normal;		// sdfNormal(coord, 3), zero where the gradient is
+		float curvature;		// curv2 at the behaviour offset, 0 when no term reads it
+	};
+
+	// Any cell: neighbourhood bounded to the grid, normals from clamped reads, curvature reading 0 outside.
+	// With the derivative field, the normal and curvature come from there.
+	Stencils ComputeStencils(const float * source, const glm::ivec3& coord, float simulationDeltaTime) const;
+	float ComputeRelaxation(const float * source, const glm::ivec3& coord, float simulationDeltaTime) const;
+
+	// The separable relaxation from the sum of the box inside the grid
+	float BoxRelaxation(float boxSum, const glm::ivec3& coord, float center, float simulationDeltaTime) const;
+
+	// Sum of the 2 radius + 1 cells along an axis inside the grid, and the pass writing it for a whole brick
+	float BoxSum(const float * input, const glm::ivec3& coord, int axis) const;
+	void BoxSumBrick(int brick, int axis, const float * input, float * output) const;
+
+	// The three passes, leaving the box sums of the cells the step updates in boxSums[0]
+	void ComputeBoxSums(const float * source);
+
+	// Normal in xyz, curvature in w
+	glm::vec4 ComputeDerivatives(const float * source, const glm::ivec3& coord) const;
+
+	// The terms of the behaviour and the time fade of main()
+	float UpdateCell(const float * source, const glm::ivec3& coord, const Stencils& stencils, float totalTime, float simulationDeltaTime) const;
+
+	// Returns whether a written cell is inside the band
+	bool StepBrick(int brick, const float * source, float * target, float totalTime, float simulationDeltaTime) const;
+	void CopyBrick(int brick, const float * source, float * target) const;
+	void DerivativeBrick(int brick, const float * source);
+
+	// The bricks.comp pass: every brick next to one in the band is updated, bricks that were updated last step and
+	// aren't anymore are copied once so both volumes agree on them. With the separable relaxation, also lists the
+	// bricks within GetHaloBricks of an updated one.
+	void UpdateActiveBricks();
+
+	// Bricks the box of a cell can reach into, 0 without the separable relaxation
+	int GetHaloBricks() const;
+
+	// Every brick in the band and updated, as after SetVolume
+	void ResetActiveBricks();
+
+	// Cells this close to the border need the bounded scalar stencils
+	int GetStencilReach() const;
+
+	float Load(const float * source, const glm::ivec3& coord) const;
+	float LoadClamped(const float * source, const glm::ivec3& coord) const;
+
+	// repulsionDisplacement, 8 random samples along the normal hemisphere
+	float Repulsion(const float * source, const glm::ivec3& coord, const glm::vec3& normal, float delta, float strength, float totalTime, float simulationDeltaTime) const;
+
+	int resolution;
+	GrowthBehaviour behaviour;
+	float relaxationStrength;
+	int relaxationRadius;
+	int curvatureOffset;		// 0 when no term reads curv2
+
+	// GrowthBehaviour::GetActiveBand, ACTIVE_BAND_MIN and ACTIVE_BAND_MAX in kernel.comp
+	float bandMin;
+	float bandMax;
+
+	bool sparse = GROWTH_SPARSE_BRICKS;
+	int bricksPerAxis;
+	std::vector<uint8_t> brickInBand;
+	std::vector<uint8_t> brickUpdated;
+	std::vector<uint32_t> activeBricks;		// Brick indices, with COPY_BRICK set for the ones that are only copied
+	int activeBrickCount = 0;
+	std::vector<uint32_t> haloBricks;		// Only filled with the separable relaxation
+
+	std::vector<float> volumes[2];
+	int current = 0;
+
+	std::vector<float> vectorField;
+
+	bool derivativeField = false;
+	std::vector<glm::vec4> derivatives;		// Only allocated with the derivative field
+
+	bool separableRelaxation = false;
+	std::vector<float> boxSums[2];		// The x sums then the y sums, then the whole box. Only allocated when it runs.
+};
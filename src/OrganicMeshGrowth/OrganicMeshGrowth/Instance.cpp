@@ -1,3 +1,4 @@
+#include <atomic>
 #include <stdexcept>
 #include <set>
 #include <vector>
@@ -14,6 +15,10 @@ namespace {
         "VK_LAYER_LUNARG_standard_validation"
     };
 
+    // Reported from whichever thread made the call
+    std::atomic<int> validationErrors(0);
+    std::atomic<int> validationWarnings(0);
+
     // Get the required list of extensions based on whether validation layers are enabled
     std::vector<const char*> getRequiredExtensions() {
         std::vector<const char*> extensions;
@@ -36,6 +41,11 @@ namespace {
         const char* msg,
         void *userData) {
 
+        if (flags & VK_DEBUG_REPORT_ERROR_BIT_EXT)
+            validationErrors++;
+        else
+            validationWarnings++;
+
         fprintf(stderr, "Validation layer: %s\n", msg);
         return VK_FALSE;
     }
@@ -133,6 +143,14 @@ VkFormat Instance::GetSupportedFormat(const std::vector<VkFormat>& candidates, V
     throw std::runtime_error("Failed to find supported format");
 }
 
+int Instance::GetValidationErrorCount() const {
+    return validationErrors;
+}
+
+int Instance::GetValidationWarningCount() const {
+    return validationWarnings;
+}
+
 void Instance::initDebugReport() {
     if (ENABLE_VALIDATION) {
         // Specify details for callback
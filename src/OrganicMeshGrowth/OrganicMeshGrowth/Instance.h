@@ -28,6 +28,10 @@ public:
 
     Device* CreateDevice(QueueFlagBits requiredQueues, VkPhysicalDeviceFeatures deviceFeatures);
 
+    // Messages the validation layers reported so far, always 0 without ENABLE_VALIDATION
+    int GetValidationErrorCount() const;
+    int GetValidationWarningCount() const;
+
     ~Instance();
 
 private:
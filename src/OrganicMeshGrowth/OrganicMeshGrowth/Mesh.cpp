@@ -0,0 +1,1085 @@
+#include "Mesh.h"
+#include "ObjParser.h"
+#include "Parallel.h"
+#include "TaskScheduler.h"
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <stack>
+#include <glm/gtc/constants.hpp>
+#include <glm/gtc/packing.hpp>
+
+using namespace std::chrono;
+
+// Binned SAH parameters. Costs are relative: a node visit against a triangle distance test.
+#define SAH_BIN_COUNT 32
+#define SAH_TRAVERSAL_COST 1.f
+#define SAH_INTERSECTION_COST 1.5f
+
+// Nodes bigger than this bin and partition their triangles on all threads
+#define KD_PARALLEL_PARTITION_SIZE (64 * 1024)
+#define KD_PARTITION_BLOCK_SIZE (16 * 1024)
+
+// Subtrees smaller than this are built serially inside a single task
+#define KD_TASK_MIN_SIZE 2048
+
+// Node layout: the top of the tree is stored breadth first, filling the generator's shared node cache
+// (SHARED_NODE_COUNT in generator.comp), and every subtree below in treelets of a few levels
+#define KD_SHARED_NODE_COUNT 4096
+#define KD_TREELET_DEPTH 3
+
+glm::vec3 AABB::aabb[] = { glm::vec3(1, 1, 1),glm::vec3(1, -1, -1), glm::vec3(1, 1, -1), glm::vec3(1, -1, 1),
+glm::vec3(-1, 1, 1), glm::vec3(-1, -1, -1), glm::vec3(-1, 1, -1), glm::vec3(-1, -1, 1) };
+
+AABB AABB::Encapsulate(AABB bounds)
+{
+	glm::vec3 min = glm::min(this->min, bounds.min);
+	glm::vec3 max = glm::max(this->max, bounds.max);
+	return AABB(min, max);
+}
+
+AABB AABB::Transform(const glm::mat4x4 &transform)
+{
+	// If infinite box, prevent overflowing
+	if (min.x == -std::numeric_limits<float>::infinity() || min.y == -std::numeric_limits<float>::infinity() || min.z == -std::numeric_limits<float>::infinity()
+		|| max.x == std::numeric_limits<float>::infinity() || max.y == std::numeric_limits<float>::infinity() || max.z == std::numeric_limits<float>::infinity())
+	{
+		return *this;
+	}
+
+	float maxX = -std::numeric_limits<float>::infinity();
+	float maxY = -std::numeric_limits<float>::infinity();
+	float maxZ = -std::numeric_limits<float>::infinity();
+
+	float minX = std::numeric_limits<float>::infinity();
+	float minY = std::numeric_limits<float>::infinity();
+	float minZ = std::numeric_limits<float>::infinity();
+
+	glm::vec3 halfSize = (max - center);
+
+	for (int i = 0; i < 8; i++)
+	{
+		glm::vec3 v = center + (AABB::aabb[i] * halfSize);
+		glm::vec3 tPoint = glm::vec3(transform * glm::vec4(v.x, v.y, v.z, 1.));
+
+		maxX = glm::max(tPoint.x, maxX);
+		maxY = glm::max(tPoint.y, maxY);
+		maxZ = glm::max(tPoint.z, maxZ);
+
+		minX = glm::min(tPoint.x, minX);
+		minY = glm::min(tPoint.y, minY);
+		minZ = glm::min(tPoint.z, minZ);
+	}
+
+	glm::vec3 newMin = glm::vec3(minX, minY, minZ);
+	glm::vec3 newMax = glm::vec3(maxX, maxY, maxZ);
+
+	return AABB(newMin, newMax);
+}
+
+#define SOUP_BLOCK_SIZE (64 * 1024)
+
+TriangleSoup::TriangleSoup() : count(0), vertexCount(0), vertices(nullptr), indices(nullptr), v1(nullptr), v2(nullptr), v3(nullptr), boundsMin(nullptr), boundsMax(nullptr), centroids(nullptr)
+{
+}
+
+void TriangleSoup::Allocate(Arena& arena, int count, int vertexCount)
+{
+	this->count = count;
+	this->vertexCount = vertexCount;
+	vertices = arena.AllocateArray<glm::vec3>(vertexCount);
+	indices = arena.AllocateArray<int>(count * 3);
+	v1 = arena.AllocateArray<glm::vec3>(count);
+	v2 = arena.AllocateArray<glm::vec3>(count);
+	v3 = arena.AllocateArray<glm::vec3>(count);
+	boundsMin = arena.AllocateArray<glm::vec3>(count);
+	boundsMax = arena.AllocateArray<glm::vec3>(count);
+	centroids = arena.AllocateArray<glm::vec3>(count);
+}
+
+void TriangleSoup::Load(Arena& arena, const ObjData& obj, float scaleMultiplier)
+{
+	glm::vec3 minBounds = glm::vec3(std::numeric_limits<float>::max());
+	glm::vec3 maxBounds = glm::vec3(-std::numeric_limits<float>::max());
+
+	for (const glm::vec3& v : obj.positions)
+	{
+		minBounds = glm::min(minBounds, v);
+		maxBounds = glm::max(maxBounds, v);
+	}
+
+	glm::vec3 centerPivot = (maxBounds + minBounds) * .5f;
+	glm::vec3 meshSize = glm::abs((maxBounds - minBounds) * .5f / scaleMultiplier);
+	float meshUniformSize = glm::max(meshSize.x, glm::max(meshSize.y, meshSize.z)) + .00001;
+
+	Allocate(arena, static_cast<int>(obj.indices.size() / 3), static_cast<int>(obj.positions.size()));
+
+	int vertexBlockCount = (vertexCount + SOUP_BLOCK_SIZE - 1) / SOUP_BLOCK_SIZE;
+
+	Parallel::For(vertexBlockCount, [&](int block) {
+		int end = glm::min(vertexCount, (block + 1) * SOUP_BLOCK_SIZE);
+
+		// Transform
+		for (int v = block * SOUP_BLOCK_SIZE; v < end; ++v)
+			vertices[v] = (obj.positions[v] - centerPivot) / meshUniformSize;
+	});
+
+	int blockCount = (count + SOUP_BLOCK_SIZE - 1) / SOUP_BLOCK_SIZE;
+
+	// Every stream is written in a single pass over the faces
+	Parallel::For(blockCount, [&](int block) {
+		int end = glm::min(count, (block + 1) * SOUP_BLOCK_SIZE);
+
+		for (int t = block * SOUP_BLOCK_SIZE; t < end; ++t)
+		{
+			indices[t * 3 + 0] = obj.indices[t * 3 + 0];
+			indices[t * 3 + 1] = obj.indices[t * 3 + 1];
+			indices[t * 3 + 2] = obj.indices[t * 3 + 2];
+
+			glm::vec3 p1 = vertices[indices[t * 3 + 0]];
+			glm::vec3 p2 = vertices[indices[t * 3 + 1]];
+			glm::vec3 p3 = vertices[indices[t * 3 + 2]];
+
+			glm::vec3 min = glm::min(p1, glm::min(p2, p3)) - glm::vec3(glm::epsilon<float>());
+			glm::vec3 max = glm::max(p1, glm::max(p2, p3)) + glm::vec3(glm::epsilon<float>());
+
+			v1[t] = p1;
+			v2[t] = p2;
+			v3[t] = p3;
+			boundsMin[t] = min;
+			boundsMax[t] = max;
+			centroids[t] = (min + max) * .5f;
+		}
+	});
+}
+
+glm::vec3 axisPlaneNormals[] = { glm::vec3(1.f,0,0), glm::vec3(0,1.f,0), glm::vec3(0,0,1.f) };
+
+namespace {
+	enum PartitionSide
+	{
+		SIDE_LEFT = 1,
+		SIDE_RIGHT = 2
+	};
+
+	// Triangle bounds as seen by a node: either the soup bounds, or bounds clipped to the node box.
+	// Triangles clipped away completely have inverted bounds, so they end up in neither child.
+	struct NodeBounds
+	{
+		const glm::vec3 * min;
+		const glm::vec3 * max;
+		const int * triangles;	// Maps node positions to soup indices, null when min and max are per node
+
+		inline int Index(int i) const
+		{
+			return triangles != nullptr ? triangles[i] : i;
+		}
+	};
+
+	// A triangle goes left if its bounds start before the plane, and right if they end after it,
+	// so one crossing the plane is referenced by both children
+	inline int Classify(const NodeBounds& bounds, int i, int axis, float split)
+	{
+		int index = bounds.Index(i);
+		int side = 0;
+
+		if (bounds.min[index][axis] <= split)
+			side |= SIDE_LEFT;
+
+		if (bounds.max[index][axis] >= split)
+			side |= SIDE_RIGHT;
+
+		return side;
+	}
+
+	// Splits the triangles in two lists, keeping the input order in both. Big nodes classify blocks
+	// in parallel and then scatter them at offsets given by a prefix sum, which yields the same lists.
+	void Partition(const NodeBounds& bounds, const std::vector<int>& triangles, int axis, float split, std::vector<int>& left, std::vector<int>& right)
+	{
+		int count = static_cast<int>(triangles.size());
+
+		if (count < KD_PARALLEL_PARTITION_SIZE)
+		{
+			for (int i = 0; i < count; i++)
+			{
+				int side = Classify(bounds, i, axis, split);
+
+				if (side & SIDE_LEFT)
+					left.push_back(triangles[i]);
+
+				if (side & SIDE_RIGHT)
+					right.push_back(triangles[i]);
+			}
+
+			return;
+		}
+
+		int blockCount = (count + KD_PARTITION_BLOCK_SIZE - 1) / KD_PARTITION_BLOCK_SIZE;
+		std::vector<unsigned char> sides(count);
+		std::vector<int> leftOffsets(blockCount + 1, 0);
+		std::vector<int> rightOffsets(blockCount + 1, 0);
+
+		Parallel::For(blockCount, [&](int block) {
+			int end = glm::min(count, (block + 1) * KD_PARTITION_BLOCK_SIZE);
+			int leftCount = 0;
+			int rightCount = 0;
+
+			for (int i = block * KD_PARTITION_BLOCK_SIZE; i < end; i++)
+			{
+				int side = Classify(bounds, i, axis, split);
+				sides[i] = static_cast<unsigned char>(side);
+				leftCount += (side & SIDE_LEFT) != 0;
+				rightCount += (side & SIDE_RIGHT) != 0;
+			}
+
+			leftOffsets[block + 1] = leftCount;
+			rightOffsets[block + 1] = rightCount;
+		});
+
+		for (int block = 0; block < blockCount; block++)
+		{
+			leftOffsets[block + 1] += leftOffsets[block];
+			rightOffsets[block + 1] += rightOffsets[block];
+		}
+
+		left.resize(leftOffsets.back());
+		right.resize(rightOffsets.back());
+
+		Parallel::For(blockCount, [&](int block) {
+			int end = glm::min(count, (block + 1) * KD_PARTITION_BLOCK_SIZE);
+			int leftIndex = leftOffsets[block];
+			int rightIndex = rightOffsets[block];
+
+			for (int i = block * KD_PARTITION_BLOCK_SIZE; i < end; i++)
+			{
+				if (sides[i] & SIDE_LEFT)
+					left[leftIndex++] = triangles[i];
+
+				if (sides[i] & SIDE_RIGHT)
+					right[rightIndex++] = triangles[i];
+			}
+		});
+	}
+
+	// Where the bounds of each triangle start and end along every axis
+	struct SAHBins
+	{
+		int start[3][SAH_BIN_COUNT];
+		int end[3][SAH_BIN_COUNT];
+	};
+
+	void BinTriangles(const NodeBounds& bounds, int begin, int end, const glm::vec3& minVector, const glm::vec3& binScale, SAHBins& bins)
+	{
+		for (int i = begin; i < end; i++)
+		{
+			int index = bounds.Index(i);
+
+			// Clipped away
+			if (bounds.min[index].x > bounds.max[index].x)
+				continue;
+
+			glm::vec3 start = (bounds.min[index] - minVector) * binScale;
+			glm::vec3 stop = (bounds.max[index] - minVector) * binScale;
+
+			for (int a = 0; a < 3; a++)
+			{
+				bins.start[a][glm::clamp(static_cast<int>(start[a]), 0, SAH_BIN_COUNT - 1)]++;
+				bins.end[a][glm::clamp(static_cast<int>(stop[a]), 0, SAH_BIN_COUNT - 1)]++;
+			}
+		}
+	}
+
+	inline float SurfaceArea(const glm::vec3& extent)
+	{
+		return 2.f * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+	}
+
+	// Sets axis and split to the cheapest plane, returns false if making a leaf is cheaper
+	bool FindSAHSplit(const NodeBounds& bounds, int count, const glm::vec3& minVector, const glm::vec3& maxVector, int& axis, float& split)
+	{
+		glm::vec3 extent = maxVector - minVector;
+		glm::vec3 binScale;
+
+		for (int a = 0; a < 3; a++)
+			binScale[a] = extent[a] > glm::epsilon<float>() ? SAH_BIN_COUNT / extent[a] : 0.f;
+
+		SAHBins bins = {};
+
+		if (count < KD_PARALLEL_PARTITION_SIZE)
+		{
+			BinTriangles(bounds, 0, count, minVector, binScale, bins);
+		}
+		else
+		{
+			// Counts are integers, so merging per block histograms gives exactly the serial result
+			int blockCount = (count + KD_PARTITION_BLOCK_SIZE - 1) / KD_PARTITION_BLOCK_SIZE;
+			std::vector<SAHBins> blockBins(blockCount);
+
+			Parallel::For(blockCount, [&](int block) {
+				blockBins[block] = SAHBins();
+				BinTriangles(bounds, block * KD_PARTITION_BLOCK_SIZE, glm::min(count, (block + 1) * KD_PARTITION_BLOCK_SIZE), minVector, binScale, blockBins[block]);
+			});
+
+			for (const SAHBins& b : blockBins)
+			{
+				for (int a = 0; a < 3; a++)
+				{
+					for (int i = 0; i < SAH_BIN_COUNT; i++)
+					{
+						bins.start[a][i] += b.start[a][i];
+						bins.end[a][i] += b.end[a][i];
+					}
+				}
+			}
+		}
+
+		float area = SurfaceArea(extent);
+
+		// Cost of keeping this node as a leaf
+		float bestCost = count * SAH_INTERSECTION_COST;
+		int bestAxis = -1;
+		int bestPlane = -1;
+
+		for (int a = 0; a < 3; a++)
+		{
+			// If axis cannot be subdivided, skip it
+			if (binScale[a] == 0.f)
+				continue;
+
+			int leftCount = 0;
+			int rightCount = 0;
+
+			for (int i = 0; i < SAH_BIN_COUNT; i++)
+				rightCount += bins.end[a][i];
+
+			for (int plane = 1; plane < SAH_BIN_COUNT; plane++)
+			{
+				leftCount += bins.start[a][plane - 1];
+				rightCount -= bins.end[a][plane - 1];
+
+				glm::vec3 leftExtent = extent;
+				glm::vec3 rightExtent = extent;
+				leftExtent[a] = extent[a] * plane / SAH_BIN_COUNT;
+				rightExtent[a] = extent[a] - leftExtent[a];
+
+				float cost = SAH_TRAVERSAL_COST + SAH_INTERSECTION_COST * (SurfaceArea(leftExtent) * leftCount + SurfaceArea(rightExtent) * rightCount) / area;
+
+				if (cost < bestCost)
+				{
+					bestCost = cost;
+					bestAxis = a;
+					bestPlane = plane;
+				}
+			}
+		}
+
+		if (bestAxis == -1)
+			return false;
+
+		axis = bestAxis;
+		split = minVector[bestAxis] + extent[bestAxis] * bestPlane / SAH_BIN_COUNT;
+		return true;
+	}
+
+	// Bounds of the part of a triangle inside a box (Sutherland-Hodgman against the six planes).
+	// Returns false if the triangle does not touch the box.
+	bool ClipTriangleBounds(const glm::vec3& v1, const glm::vec3& v2, const glm::vec3& v3, const glm::vec3& boxMin, const glm::vec3& boxMax, glm::vec3& outMin, glm::vec3& outMax)
+	{
+		// Every plane adds at most one vertex
+		glm::vec3 polygons[2][10];
+		int counts[2] = { 3, 0 };
+		int current = 0;
+
+		polygons[0][0] = v1;
+		polygons[0][1] = v2;
+		polygons[0][2] = v3;
+
+		for (int plane = 0; plane < 6; plane++)
+		{
+			int a = plane % 3;
+			bool lower = plane < 3;
+
+			const glm::vec3 * input = polygons[current];
+			glm::vec3 * output = polygons[1 - current];
+			int inputCount = counts[current];
+			int outputCount = 0;
+
+			for (int i = 0; i < inputCount; i++)
+			{
+				const glm::vec3& p = input[i];
+				const glm::vec3& q = input[(i + 1) % inputCount];
+
+				// Positive inside
+				float dp = lower ? p[a] - boxMin[a] : boxMax[a] - p[a];
+				float dq = lower ? q[a] - boxMin[a] : boxMax[a] - q[a];
+
+				if (dp >= 0.f)
+					output[outputCount++] = p;
+
+				if ((dp >= 0.f) != (dq >= 0.f))
+				{
+					glm::vec3 intersection = p + (q - p) * (dp / (dp - dq));
+
+					// Snap to the plane, so rounding never leaves the point outside
+					intersection[a] = lower ? boxMin[a] : boxMax[a];
+					output[outputCount++] = intersection;
+				}
+			}
+
+			counts[1 - current] = outputCount;
+			current = 1 - current;
+
+			if (outputCount == 0)
+				return false;
+		}
+
+		outMin = polygons[current][0];
+		outMax = polygons[current][0];
+
+		for (int i = 1; i < counts[current]; i++)
+		{
+			outMin = glm::min(outMin, polygons[current][i]);
+			outMax = glm::max(outMax, polygons[current][i]);
+		}
+
+		return true;
+	}
+
+	// Spatial split mode: bounds of every triangle restricted to the node box
+	void ClipToNode(const TriangleSoup& soup, const std::vector<int>& triangles, const glm::vec3& minVector, const glm::vec3& maxVector, std::vector<glm::vec3>& clippedMin, std::vector<glm::vec3>& clippedMax)
+	{
+		int count = static_cast<int>(triangles.size());
+		int blockCount = (count + KD_PARTITION_BLOCK_SIZE - 1) / KD_PARTITION_BLOCK_SIZE;
+
+		// Same tolerance the soup bounds have
+		glm::vec3 epsilon = glm::vec3(glm::epsilon<float>());
+		glm::vec3 boxMin = minVector - epsilon;
+		glm::vec3 boxMax = maxVector + epsilon;
+
+		clippedMin.resize(count);
+		clippedMax.resize(count);
+
+		auto clipBlock = [&](int block) {
+			int end = glm::min(count, (block + 1) * KD_PARTITION_BLOCK_SIZE);
+
+			for (int i = block * KD_PARTITION_BLOCK_SIZE; i < end; i++)
+			{
+				int tri = triangles[i];
+				glm::vec3 min = soup.boundsMin[tri];
+				glm::vec3 max = soup.boundsMax[tri];
+
+				// Most triangles are completely inside the node
+				if (glm::all(glm::greaterThanEqual(min, boxMin)) && glm::all(glm::lessThanEqual(max, boxMax)))
+				{
+					clippedMin[i] = min;
+					clippedMax[i] = max;
+				}
+				else if (ClipTriangleBounds(soup.v1[tri], soup.v2[tri], soup.v3[tri], boxMin, boxMax, min, max))
+				{
+					clippedMin[i] = glm::max(min - epsilon, boxMin);
+					clippedMax[i] = glm::min(max + epsilon, boxMax);
+				}
+				else
+				{
+					clippedMin[i] = glm::vec3(std::numeric_limits<float>::max());
+					clippedMax[i] = glm::vec3(-std::numeric_limits<float>::max());
+				}
+			}
+		};
+
+		if (count < KD_PARALLEL_PARTITION_SIZE)
+		{
+			for (int block = 0; block < blockCount; block++)
+				clipBlock(block);
+		}
+		else
+		{
+			Parallel::For(blockCount, clipBlock);
+		}
+	}
+}
+
+Mesh::MeshNode::MeshNode(const TriangleSoup& soup, std::vector<int> originalTriangles, glm::vec3 min, glm::vec3 max, int depth, const BuildSettings& settings)
+{
+	glm::vec3 extent = glm::abs(max - min);
+
+	if (extent.x > extent.y && extent.x > extent.z)
+		this->axis = 0;
+	else if (extent.y > extent.x && extent.y > extent.z)
+		this->axis = 1;
+	else
+		this->axis = 2;
+
+	this->left = nullptr;
+	this->right = nullptr;
+	this->split = 0;
+	this->BuildNode(soup, originalTriangles, min, max, depth, settings);
+	this->compactIndex = -1;
+}
+
+Mesh::MeshNode::~MeshNode()
+{
+	if (this->left != nullptr)
+		delete left;
+
+	if (this->right != nullptr)
+		delete right;
+}
+
+void Mesh::MeshNode::BuildNode(const TriangleSoup& soup, std::vector<int>& triangles, const glm::vec3 &minVector, const glm::vec3 &maxVector, int depth, const BuildSettings& settings)
+{
+	if (static_cast<int>(triangles.size()) > settings.maxLeafSize && depth < settings.maxDepth)
+	{
+		std::vector<glm::vec3> clippedMin;
+		std::vector<glm::vec3> clippedMax;
+		NodeBounds bounds;
+
+		if (settings.spatialSplits)
+		{
+			ClipToNode(soup, triangles, minVector, maxVector, clippedMin, clippedMax);
+			bounds.min = clippedMin.data();
+			bounds.max = clippedMax.data();
+			bounds.triangles = nullptr;
+		}
+		else
+		{
+			bounds.min = soup.boundsMin;
+			bounds.max = soup.boundsMax;
+			bounds.triangles = triangles.data();
+		}
+
+		if (settings.splitMethod == KdSplitMethod::SAH)
+		{
+			// No plane is cheaper than testing every triangle
+			if (!FindSAHSplit(bounds, static_cast<int>(triangles.size()), minVector, maxVector, axis, split))
+			{
+				this->nodeTriangles.swap(triangles);
+				this->left = nullptr;
+				this->right = nullptr;
+				return;
+			}
+		}
+		else
+		{
+			float minAxis = minVector[axis];
+			float maxAxis = maxVector[axis];
+
+			// If axis cannot be subdivided, we stop, to prevent jumping
+			// between axis indefinitely
+			if (glm::abs(minAxis - maxAxis) < glm::epsilon<float>())
+			{
+				this->nodeTriangles.swap(triangles);
+				this->left = nullptr;
+				this->right = nullptr;
+				return;
+			}
+
+			split = GetSplitPoint(soup, triangles, minVector[axis], maxVector[axis]);
+		}
+
+		glm::vec3 axisNormal = axisPlaneNormals[axis];
+
+		std::vector<int> leftShapes;
+		std::vector<int> rightShapes;
+		Partition(bounds, triangles, axis, split, leftShapes, rightShapes);
+
+		// The children own their triangles from now on
+		std::vector<int>().swap(triangles);
+		std::vector<glm::vec3>().swap(clippedMin);
+		std::vector<glm::vec3>().swap(clippedMax);
+
+		glm::vec3 leftMax = maxVector - (axisNormal * glm::abs(maxVector[axis] - split));
+		glm::vec3 rightMin = minVector + (axisNormal * glm::abs(split - minVector[axis]));
+
+		if (leftShapes.size() + rightShapes.size() >= KD_TASK_MIN_SIZE)
+		{
+			TaskGroup group;
+
+			group.Run([&]() {
+				this->left = new MeshNode(soup, std::move(leftShapes), minVector, leftMax, depth + 1, settings);
+			});
+
+			this->right = new MeshNode(soup, std::move(rightShapes), rightMin, maxVector, depth + 1, settings);
+			group.Wait();
+		}
+		else
+		{
+			this->left = new MeshNode(soup, std::move(leftShapes), minVector, leftMax, depth + 1, settings);
+			this->right = new MeshNode(soup, std::move(rightShapes), rightMin, maxVector, depth + 1, settings);
+		}
+	}
+	else
+	{
+		this->nodeTriangles.swap(triangles);
+		this->left = nullptr;
+		this->right = nullptr;
+	}
+}
+
+float Mesh::MeshNode::GetSplitPoint(const TriangleSoup& soup, const std::vector<int> &triangles, float minAxis, float maxAxis)
+{
+	// Spatial median
+	float center = (maxAxis + minAxis) * .5f;
+
+	// Object median
+	float objMedian = 0;
+
+	for (size_t i = 0; i < triangles.size(); i++)
+		objMedian += soup.centroids[triangles[i]][axis];
+
+	objMedian /= triangles.size();
+
+	return (center + objMedian) * .5f;
+}
+
+int Mesh::MeshNode::GetNodeCount()
+{
+	if (IsLeaf())
+		return 1;
+	else
+		return 1 + left->GetNodeCount() + right->GetNodeCount();
+}
+
+int Mesh::MeshNode::TriangleCount()
+{
+	if (IsLeaf())
+		return this->nodeTriangles.size();
+	else
+		return left->TriangleCount() + right->TriangleCount();
+}
+
+int Mesh::MeshNode::GetDepth()
+{
+	if (IsLeaf())
+		return 1;
+
+	return glm::max(left->GetDepth(), right->GetDepth()) + 1;
+}
+
+void Mesh::MeshNode::GatherStats(const glm::vec3& min, const glm::vec3& max, KdTreeStats& stats, float& weightedCost)
+{
+	stats.nodeCount++;
+
+	// Same surface area weighting as FindSAHSplit
+	float area = SurfaceArea(max - min);
+
+	if (IsLeaf())
+	{
+		int count = static_cast<int>(nodeTriangles.size());
+
+		stats.leafCount++;
+		stats.emptyLeafCount += count == 0 ? 1 : 0;
+		stats.triangleReferences += count;
+		stats.leafSizeHistogram[glm::min(count, KD_STATS_HISTOGRAM_SIZE - 1)]++;
+
+		weightedCost += area * count * SAH_INTERSECTION_COST;
+		return;
+	}
+
+	weightedCost += area * SAH_TRAVERSAL_COST;
+
+	glm::vec3 leftMax = max;
+	glm::vec3 rightMin = min;
+	leftMax[axis] = split;
+	rightMin[axis] = split;
+
+	left->GatherStats(min, leftMax, stats, weightedCost);
+	right->GatherStats(rightMin, max, stats, weightedCost);
+}
+
+bool Mesh::MeshNode::IsLeaf()
+{
+	return left == nullptr && right == nullptr;
+}
+
+Mesh::Mesh(int maxDepth, int maxLeafSize, const TriangleSoup& triangles, KdSplitMethod splitMethod, bool spatialSplits, TriangleLayout triangleLayout) : maxDepth(maxDepth), maxLeafSize(maxLeafSize), splitMethod(splitMethod), spatialSplits(spatialSplits), triangleLayout(triangleLayout), compactNodes(nullptr), compactNodeSize(0), compactPairParents(nullptr), compactPairParentSize(0), compactTriangles(nullptr), compactTriangleSize(0), packedTriangles(nullptr), packedTriangleSize(0), compactLeafIndices(nullptr), compactLeafIndexSize(0), triangles(triangles), root(nullptr)
+{
+}
+
+Mesh::~Mesh()
+{
+	if (this->root != nullptr)
+		delete this->root;
+
+	if (this->compactNodes != nullptr)
+		delete[] this->compactNodes;
+
+
+	if (this->compactTriangles != nullptr)
+		delete[] this->compactTriangles;
+
+	if (this->packedTriangles != nullptr)
+		delete[] this->packedTriangles;
+
+	if (this->compactPairParents != nullptr)
+		delete[] this->compactPairParents;
+
+	if (this->compactLeafIndices != nullptr)
+		delete[] this->compactLeafIndices;
+}
+
+AABB Mesh::CalculateAABB()
+{
+	if (triangles.count == 0)
+		return AABB();
+
+	glm::vec3 min = triangles.boundsMin[0];
+	glm::vec3 max = triangles.boundsMax[0];
+
+	for (int i = 1; i < triangles.count; i++)
+	{
+		min = glm::min(min, triangles.boundsMin[i]);
+		max = glm::max(max, triangles.boundsMax[i]);
+	}
+
+	return AABB(min, max);
+}
+
+void Mesh::Build()
+{
+	std::vector<int> indices(triangles.count);
+
+	for (int i = 0; i < triangles.count; i++)
+		indices[i] = i;
+
+	BuildSettings settings;
+	settings.maxDepth = this->maxDepth;
+	settings.maxLeafSize = this->maxLeafSize;
+	settings.splitMethod = this->splitMethod;
+	settings.spatialSplits = this->spatialSplits;
+
+	high_resolution_clock::time_point start = high_resolution_clock::now();
+	meshBounds = this->CalculateAABB();
+	high_resolution_clock::time_point boundsEnd = high_resolution_clock::now();
+
+	this->root = new MeshNode(triangles, std::move(indices), meshBounds.min, meshBounds.max, 0, settings);
+	high_resolution_clock::time_point treeEnd = high_resolution_clock::now();
+
+	// Compact() releases the node tree, so everything is gathered before
+	this->stats = KdTreeStats();
+	this->stats.depth = this->root->GetDepth();
+	this->stats.triangleCount = triangles.count;
+
+	float weightedCost = 0.f;
+	this->root->GatherStats(meshBounds.min, meshBounds.max, this->stats, weightedCost);
+
+	float rootArea = SurfaceArea(meshBounds.max - meshBounds.min);
+	this->stats.estimatedCost = rootArea > 0.f ? weightedCost / rootArea : weightedCost;
+
+	high_resolution_clock::time_point compactStart = high_resolution_clock::now();
+	this->Compact();
+	high_resolution_clock::time_point compactEnd = high_resolution_clock::now();
+
+	this->stats.boundsTime = duration<double, std::milli>(boundsEnd - start).count();
+	this->stats.treeTime = duration<double, std::milli>(treeEnd - boundsEnd).count();
+	this->stats.compactTime = duration<double, std::milli>(compactEnd - compactStart).count();
+}
+
+const KdTreeStats& Mesh::GetStats() const
+{
+	return this->stats;
+}
+
+float KdTreeStats::DuplicationFactor() const
+{
+	return triangleCount > 0 ? triangleReferences / static_cast<float>(triangleCount) : 0.f;
+}
+
+float KdTreeStats::EmptyLeafRatio() const
+{
+	return leafCount > 0 ? emptyLeafCount / static_cast<float>(leafCount) : 0.f;
+}
+
+void KdTreeStats::Print() const
+{
+	// Callers may have left std::cout in fixed or scientific notation
+	std::ios_base::fmtflags flags = std::cout.flags();
+	std::streamsize precision = std::cout.precision();
+	std::cout << std::defaultfloat << std::setprecision(4);
+
+	std::cout << "kd-tree depth " << depth << ", " << nodeCount << " nodes, " << leafCount << " leaves" << std::endl;
+	std::cout << "kd-tree triangle references " << triangleReferences << " for " << triangleCount << " triangles (x" << DuplicationFactor() << ")" << std::endl;
+	std::cout << "kd-tree empty leaves " << emptyLeafCount << " (" << EmptyLeafRatio() * 100.f << "%)" << std::endl;
+	std::cout << "kd-tree estimated query cost " << estimatedCost << std::endl;
+	std::cout << "kd-tree memory: nodes " << nodeMemory / 1024 << " kb, total " << totalMemory / (1024 * 1024) << " MB" << std::endl;
+	std::cout << "kd-tree build ms: bounds " << boundsTime << ", tree " << treeTime << ", compact " << compactTime << std::endl;
+	std::cout << "kd-tree leaf sizes:";
+
+	for (int i = 0; i < KD_STATS_HISTOGRAM_SIZE; i++)
+		std::cout << " " << i << (i == KD_STATS_HISTOGRAM_SIZE - 1 ? "+" : "") << ":" << leafSizeHistogram[i];
+
+	std::cout << std::endl;
+
+	std::cout.flags(flags);
+	std::cout.precision(precision);
+}
+
+namespace {
+	void WriteTriangleData(const TriangleSoup& triangles, int triangle, TriangleData & tri)
+	{
+		// v1
+		tri.v1 = triangles.v1[triangle];
+		tri.v2 = triangles.v2[triangle];
+		tri.v3 = triangles.v3[triangle];
+
+		// Offsets
+		tri.v21 = glm::vec4(tri.v2 - tri.v1, 0.f);
+		tri.v32 = glm::vec4(tri.v3 - tri.v2, 0.f);
+		tri.v13 = glm::vec4(tri.v1 - tri.v3, 0.f);
+
+		// Magnitudes
+		tri.v21.w = 1.f / glm::dot(tri.v21, tri.v21);
+		tri.v32.w = 1.f / glm::dot(tri.v32, tri.v32);
+		tri.v13.w = 1.f / glm::dot(tri.v13, tri.v13);
+
+		// Unnormalized normal
+		tri.normal = glm::normalize(glm::cross(glm::vec3(tri.v21), glm::vec3(tri.v13)));
+
+		tri.t21 = glm::cross(glm::vec3(tri.v21), glm::vec3(tri.normal));
+		tri.t32 = glm::cross(glm::vec3(tri.v32), glm::vec3(tri.normal));
+		tri.t13 = glm::cross(glm::vec3(tri.v13), glm::vec3(tri.normal));
+
+		// We bent the normals a bit! This hack is good to have *reasonable and fast* triangle orientation
+		tri.t21 = glm::normalize(tri.t21 + glm::vec3(tri.normal) * .03f);
+		tri.t32 = glm::normalize(tri.t32 + glm::vec3(tri.normal) * .03f);
+		tri.t13 = glm::normalize(tri.t13 + glm::vec3(tri.normal) * .03f);
+
+		glm::vec3 c = (tri.v1 + tri.v2 + tri.v3) / 3.f;
+		float radius = glm::max(glm::length(c - tri.v1), glm::max(glm::length(c - tri.v2), glm::length(c - tri.v3)));
+
+		tri.center = glm::vec4(c.x, c.y, c.z, radius);
+	}
+
+	// Same values as WriteTriangleData, minus everything the shader can rebuild from the vertices
+	void WritePackedTriangle(const TriangleSoup& triangles, int triangle, PackedTriangle & packed)
+	{
+		TriangleData tri;
+		WriteTriangleData(triangles, triangle, tri);
+
+		packed.v1 = static_cast<uint32_t>(triangles.indices[triangle * 3 + 0]);
+		packed.v2 = static_cast<uint32_t>(triangles.indices[triangle * 3 + 1]);
+		packed.v3 = static_cast<uint32_t>(triangles.indices[triangle * 3 + 2]);
+		packed.normal = OctEncoding::Encode(tri.normal);
+		packed.t21 = OctEncoding::Encode(tri.t21);
+		packed.t32 = OctEncoding::Encode(tri.t32);
+		packed.t13 = OctEncoding::Encode(tri.t13);
+		packed.radius = tri.center.w;
+	}
+}
+
+uint32_t OctEncoding::Encode(const glm::vec3& direction)
+{
+	glm::vec3 n = direction / (glm::abs(direction.x) + glm::abs(direction.y) + glm::abs(direction.z));
+	glm::vec2 e = glm::vec2(n.x, n.y);
+
+	// Fold the lower hemisphere over the diagonals
+	if (n.z < 0.f)
+	{
+		e.x = (1.f - glm::abs(n.y)) * (n.x >= 0.f ? 1.f : -1.f);
+		e.y = (1.f - glm::abs(n.x)) * (n.y >= 0.f ? 1.f : -1.f);
+	}
+
+	return glm::packSnorm2x16(e);
+}
+
+glm::vec3 OctEncoding::Decode(uint32_t encoded)
+{
+	glm::vec2 e = glm::unpackSnorm2x16(encoded);
+	glm::vec3 n = glm::vec3(e.x, e.y, 1.f - glm::abs(e.x) - glm::abs(e.y));
+	float t = glm::max(-n.z, 0.f);
+
+	n.x += n.x >= 0.f ? -t : t;
+	n.y += n.y >= 0.f ? -t : t;
+	return glm::normalize(n);
+}
+
+CompactKdTree Mesh::GetCompactKdTree() const
+{
+	CompactKdTree tree;
+	tree.nodes = this->compactNodes;
+	tree.nodeCount = this->compactNodeSize / sizeof(CompactNode);
+	tree.pairParents = this->compactPairParents;
+	tree.pairCount = this->compactPairParentSize / sizeof(int);
+	tree.triangleLayout = this->triangleLayout;
+	tree.triangles = this->compactTriangles;
+	tree.packedTriangles = this->packedTriangles;
+	tree.triangleCount = this->triangles.count;
+	tree.vertices = this->triangleLayout == TriangleLayout::Packed ? this->triangles.vertices : nullptr;
+	tree.vertexCount = this->triangleLayout == TriangleLayout::Packed ? this->triangles.vertexCount : 0;
+	tree.leafIndices = this->compactLeafIndices;
+	tree.leafIndexCount = this->compactLeafIndexSize / sizeof(int);
+	return tree;
+}
+
+void Mesh::Compact()
+{
+	// Children go in pairs at even indices, so an inner root leaves slot 1 unused
+	int nodeCount = this->root->GetNodeCount() + (this->root->IsLeaf() ? 0 : 1);
+	int leafIndexCount = this->root->TriangleCount();
+	int triangleCount = triangles.count;
+
+	bool packed = this->triangleLayout == TriangleLayout::Packed;
+
+	int pairCount = (nodeCount + 1) / 2;
+
+	// Value initialized so padding is deterministic when the arrays are written to the mesh cache
+	this->compactNodes = new CompactNode[nodeCount]();
+	this->compactPairParents = new int[pairCount];
+	this->compactLeafIndices = new int[leafIndexCount];
+
+	if (packed)
+		this->packedTriangles = new PackedTriangle[triangleCount]();
+	else
+		this->compactTriangles = new TriangleData[triangleCount]();
+
+	this->compactNodeSize = nodeCount * sizeof(CompactNode);
+	this->compactPairParentSize = pairCount * sizeof(int);
+	this->compactTriangleSize = packed ? 0 : triangleCount * sizeof(TriangleData);
+	this->packedTriangleSize = packed ? triangleCount * sizeof(PackedTriangle) : 0;
+	this->compactLeafIndexSize = leafIndexCount * sizeof(int);
+
+	// Packed triangles share the soup vertices
+	int vertexMemory = packed ? triangles.vertexCount * sizeof(glm::vec3) : 0;
+	this->stats.nodeMemory = compactNodeSize;
+	this->stats.totalMemory = compactNodeSize + compactPairParentSize + compactTriangleSize + packedTriangleSize + vertexMemory + compactLeafIndexSize;
+
+	std::vector<MeshNode*> layout(nodeCount, nullptr);
+	int nextIndex = 2;
+
+	auto placeChildren = [&](MeshNode * node) {
+		node->left->compactIndex = nextIndex;
+		node->right->compactIndex = nextIndex + 1;
+		layout[nextIndex] = node->left;
+		layout[nextIndex + 1] = node->right;
+		nextIndex += 2;
+	};
+
+	this->root->compactIndex = 0;
+	layout[0] = this->root;
+
+	// Breadth first while the pairs fit in the shared node cache. Inner nodes whose children
+	// did not fit become the parents of treelets.
+	std::deque<MeshNode*> queue;
+	std::vector<MeshNode*> topParents;
+	queue.push_back(this->root);
+
+	while (!queue.empty())
+	{
+		MeshNode * node = queue.front();
+		queue.pop_front();
+
+		if (node->IsLeaf())
+			continue;
+
+		if (nextIndex + 2 <= KD_SHARED_NODE_COUNT)
+		{
+			placeChildren(node);
+			queue.push_back(node->left);
+			queue.push_back(node->right);
+		}
+		else
+		{
+			topParents.push_back(node);
+		}
+	}
+
+	// Each treelet holds KD_TREELET_DEPTH levels below its parent, breadth first,
+	// and treelets follow each other depth first
+	std::deque<std::pair<MeshNode*, int>> treeletQueue;
+	std::stack<MeshNode*> treeletParents;
+
+	for (auto it = topParents.rbegin(); it != topParents.rend(); ++it)
+		treeletParents.push(*it);
+
+	while (!treeletParents.empty())
+	{
+		treeletQueue.push_back(std::make_pair(treeletParents.top(), 0));
+		treeletParents.pop();
+
+		std::vector<MeshNode*> nextParents;
+
+		while (!treeletQueue.empty())
+		{
+			MeshNode * node = treeletQueue.front().first;
+			int level = treeletQueue.front().second;
+			treeletQueue.pop_front();
+
+			if (node->IsLeaf())
+				continue;
+
+			if (level < KD_TREELET_DEPTH)
+			{
+				placeChildren(node);
+				treeletQueue.push_back(std::make_pair(node->left, level + 1));
+				treeletQueue.push_back(std::make_pair(node->right, level + 1));
+			}
+			else
+			{
+				nextParents.push_back(node);
+			}
+		}
+
+		// Reversed, so the leftmost treelet comes next
+		for (auto it = nextParents.rbegin(); it != nextParents.rend(); ++it)
+			treeletParents.push(*it);
+	}
+
+	// Leaves reference the leaf index array in layout order too
+	int triangleOffset = 0;
+
+	// The root pair has no parent
+	compactPairParents[0] = -1;
+
+	for (int i = 0; i < nodeCount; i++)
+	{
+		MeshNode * node = layout[i];
+		CompactNode & cNode = compactNodes[i];
+
+		// The unused slot is an empty leaf
+		if (node == nullptr)
+		{
+			cNode.flags = KD_NODE_LEAF;
+			cNode.primitiveStartOffset = 0;
+		}
+		else if (node->IsLeaf())
+		{
+			// Leaves only reference triangles, every triangle is stored once
+			int triCount = node->nodeTriangles.size();
+
+			cNode.flags = KD_NODE_LEAF | (static_cast<uint32_t>(triCount) << 2);
+			cNode.primitiveStartOffset = static_cast<uint32_t>(triangleOffset);
+
+			if (triCount > 0)
+				memcpy(compactLeafIndices + triangleOffset, node->nodeTriangles.data(), triCount * sizeof(int));
+
+			triangleOffset += triCount;
+		}
+		else
+		{
+			cNode.flags = static_cast<uint32_t>(node->axis) | (static_cast<uint32_t>(node->left->compactIndex) << 2);
+			cNode.split = node->split;
+			compactPairParents[node->left->compactIndex / 2] = i;
+		}
+	}
+
+	int blockCount = (triangleCount + KD_PARTITION_BLOCK_SIZE - 1) / KD_PARTITION_BLOCK_SIZE;
+
+	Parallel::For(blockCount, [&](int block) {
+		int end = glm::min(triangleCount, (block + 1) * KD_PARTITION_BLOCK_SIZE);
+
+		for (int i = block * KD_PARTITION_BLOCK_SIZE; i < end; i++)
+		{
+			if (packed)
+				WritePackedTriangle(triangles, i, packedTriangles[i]);
+			else
+				WriteTriangleData(triangles, i, compactTriangles[i]);
+		}
+	});
+
+	// Now that everything is copied and compacted, we can delete our root
+	delete this->root;
+	this->root = nullptr;
+}
@@ -0,0 +1,250 @@
+#pragma once
+
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "Arena.h"
+
+struct ObjData;
+
+struct TriangleData {
+	GLM_ALIGN(16) glm::vec3 v1, v2, v3;
+	GLM_ALIGN(16) glm::vec4 v21, v32, v13;
+	GLM_ALIGN(16) glm::vec3 normal;// , n1, n2, n3;
+	GLM_ALIGN(16) glm::vec3 t21, t32, t13;
+	GLM_ALIGN(16) glm::vec4 center; // (center, radius)
+};
+
+// Indices into the shared vertex array plus octahedral encoded directions, 32 bytes instead of 176.
+// The generator rebuilds the edges and their inverse lengths from the vertices.
+struct PackedTriangle
+{
+	uint32_t v1, v2, v3;
+	uint32_t normal;			// Two snorm16, see OctEncoding
+	uint32_t t21, t32, t13;		// Bent edge tangents, same encoding
+	float radius;				// Bounding sphere around the vertex average
+};
+
+enum class TriangleLayout
+{
+	Full,	// TriangleData, with everything the distance test needs precomputed
+	Packed	// PackedTriangle and a shared vertex array
+};
+
+// Unit vectors folded onto an octahedron and stored as two snorm16 in a single uint
+namespace OctEncoding {
+	uint32_t Encode(const glm::vec3& direction);
+	glm::vec3 Decode(uint32_t encoded);
+}
+
+#define KD_NODE_LEAF 3
+
+// 8 byte kd-tree node. The children of an inner node are stored next to each other, left first,
+// so only the index of the left one is kept.
+struct CompactNode
+{
+	uint32_t flags;	// Bits 0-1: split axis, or KD_NODE_LEAF. Bits 2-31: left child, or triangle count for leaves
+
+	union
+	{
+		float split;					// Inner nodes
+		uint32_t primitiveStartOffset;	// Leaves, into the leaf index array
+	};
+
+	inline bool IsLeaf() const { return (flags & 3u) == KD_NODE_LEAF; }
+	inline int GetAxis() const { return static_cast<int>(flags & 3u); }
+	inline int GetLeftChild() const { return static_cast<int>(flags >> 2); }
+	inline int GetRightChild() const { return static_cast<int>(flags >> 2) + 1; }
+	inline int GetPrimitiveCount() const { return static_cast<int>(flags >> 2); }
+};
+
+// Non owning view of a compacted kd-tree, either built in memory or mapped from a cache file
+struct CompactKdTree
+{
+	const CompactNode * nodes;
+	int nodeCount;
+
+	// Parent of every sibling pair, indexed by node / 2. Lets traversals walk back up without a stack.
+	const int * pairParents;
+	int pairCount;
+
+	TriangleLayout triangleLayout;
+
+	// Only the array matching the layout is set
+	const TriangleData * triangles;
+	const PackedTriangle * packedTriangles;
+	int triangleCount;
+
+	// Referenced by packed triangles
+	const glm::vec3 * vertices;
+	int vertexCount;
+
+	// Leaves reference ranges of this array, which holds indices into triangles
+	const int * leafIndices;
+	int leafIndexCount;
+};
+
+class AABB
+{
+public:
+	AABB(const glm::vec3& min, const glm::vec3& max) : min(min), max(max), center((min + max) * .5f) {}
+	AABB() : min(glm::vec3(0.f)), max(glm::vec3(0.f)), center((min + max) * .5f) {}
+
+	// Intersection is handled in device
+	AABB Encapsulate(AABB bounds);
+	AABB Transform(const glm::mat4x4& transform);
+
+	glm::vec3 min;
+	glm::vec3 max;
+	glm::vec3 center;
+
+private:
+	static glm::vec3 aabb[];
+};
+
+// Mesh triangles stored as structure of arrays, so the builder touches only the streams it needs.
+// The arrays are owned by the Arena they were allocated from.
+struct TriangleSoup
+{
+	TriangleSoup();
+
+	void Allocate(Arena& arena, int count, int vertexCount);
+
+	// Centers the mesh and scales it to fit in [-scaleMultiplier, scaleMultiplier], then fills every stream
+	void Load(Arena& arena, const ObjData& obj, float scaleMultiplier);
+
+	int count;
+	int vertexCount;
+
+	// Indexed copy of the mesh, three vertex indices per triangle
+	glm::vec3 * vertices;
+	int * indices;
+
+	glm::vec3 * v1;
+	glm::vec3 * v2;
+	glm::vec3 * v3;
+
+	glm::vec3 * boundsMin;
+	glm::vec3 * boundsMax;
+	glm::vec3 * centroids;	// Center of the bounds, used to classify triangles against split planes
+};
+
+enum class KdSplitMethod
+{
+	Median,	// Halfway between the spatial and the object median of the longest axis
+	SAH		// Binned surface area heuristic over all three axes
+};
+
+#define KD_STATS_HISTOGRAM_SIZE 16
+
+// Filled by every Mesh::Build, to tune maxDepth and maxLeafSize with numbers instead of by eye
+struct KdTreeStats
+{
+	int depth = 0;
+	int nodeCount = 0;
+	int leafCount = 0;
+	int emptyLeafCount = 0;
+	int triangleCount = 0;
+	int triangleReferences = 0;		// Leaf entries, a triangle split by planes counts once per leaf
+
+	int leafSizeHistogram[KD_STATS_HISTOGRAM_SIZE] = {};	// Leaves by triangle count, the last bucket also holds every bigger leaf
+
+	// Expected cost of a query with the build SAH constants, in triangle-test-equivalents
+	float estimatedCost = 0.f;
+
+	// Bytes of the compact nodes, and of everything Compact() allocates plus shared vertices
+	int nodeMemory = 0;
+	int totalMemory = 0;
+
+	// Milliseconds per build phase
+	double boundsTime = 0.0;
+	double treeTime = 0.0;
+	double compactTime = 0.0;
+
+	float DuplicationFactor() const;
+	float EmptyLeafRatio() const;
+
+	void Print() const;
+};
+
+// kd-tree implementation for meshes
+class Mesh
+{
+public:
+	Mesh(int maxDepth, int maxLeafSize, const TriangleSoup& triangles, KdSplitMethod splitMethod = KdSplitMethod::SAH, bool spatialSplits = false, TriangleLayout triangleLayout = TriangleLayout::Full);
+	~Mesh();
+
+	void Build();
+
+	const KdTreeStats& GetStats() const;
+
+	// Packed trees reference the soup vertices, so the soup has to outlive the returned view
+	CompactKdTree GetCompactKdTree() const;
+
+	int maxDepth;
+	AABB meshBounds;
+	int maxLeafSize;
+	KdSplitMethod splitMethod;
+	bool spatialSplits;	// Clip triangles against split planes, so they are only referenced by leaves they really cross
+	TriangleLayout triangleLayout;
+
+	CompactNode * compactNodes;
+	int compactNodeSize;
+
+	int * compactPairParents;
+	int compactPairParentSize;
+
+	TriangleData * compactTriangles;
+	int compactTriangleSize;
+
+	PackedTriangle * packedTriangles;
+	int packedTriangleSize;
+
+	int * compactLeafIndices;
+	int compactLeafIndexSize;
+
+protected:
+	struct BuildSettings
+	{
+		int maxDepth;
+		int maxLeafSize;
+		KdSplitMethod splitMethod;
+		bool spatialSplits;
+	};
+
+	struct MeshNode
+	{
+	public:
+		MeshNode(const TriangleSoup& soup, std::vector<int> triangles, glm::vec3 min, glm::vec3 max, int depth, const BuildSettings& settings);
+		~MeshNode();
+
+		void BuildNode(const TriangleSoup& soup, std::vector<int> &triangles, const glm::vec3& minVector, const glm::vec3& maxVector, int depth, const BuildSettings& settings);
+		float GetSplitPoint(const TriangleSoup& soup, const std::vector<int> &triangles, float minAxis, float maxAxis);
+
+		bool IsLeaf();
+		int GetNodeCount();
+		int TriangleCount();
+		int GetDepth();
+
+		// Node bounds are not stored, they are rebuilt from the splits on the way down
+		void GatherStats(const glm::vec3& min, const glm::vec3& max, KdTreeStats& stats, float& weightedCost);
+
+	public:
+		std::vector<int> nodeTriangles;	// Indices into the triangle soup
+		MeshNode * left;
+		MeshNode * right;
+
+		float split;
+		int axis;
+		int compactIndex; // For compaction
+	};
+
+	TriangleSoup triangles;
+	MeshNode * root;
+	KdTreeStats stats;
+
+	AABB CalculateAABB();
+	void Compact();
+
+};
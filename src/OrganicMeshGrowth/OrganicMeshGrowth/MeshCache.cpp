@@ -0,0 +1,226 @@
+#include "MeshCache.h"
+#include "FileUtils.h"
+#include <cstdio>
+#include <cstring>
+
+#define MESH_CACHE_ALIGNMENT 16
+
+namespace {
+	const char MAGIC[8] = { 'O', 'M', 'G', 'M', 'E', 'S', 'H', '\0' };
+
+	struct MeshCacheHeader
+	{
+		char magic[8];
+		uint32_t version;
+		uint32_t headerSize;
+		uint64_t key;
+
+		int32_t nodeCount;
+		int32_t triangleCount;
+		int32_t leafIndexCount;
+		int32_t vertexCount;
+		int32_t triangleLayout;
+		int32_t pairCount;
+
+		uint64_t nodeOffset;
+		uint64_t pairParentOffset;
+		uint64_t triangleOffset;
+		uint64_t vertexOffset;
+		uint64_t leafIndexOffset;
+		uint64_t fileSize;
+	};
+
+	inline uint64_t TriangleSize(TriangleLayout layout)
+	{
+		return layout == TriangleLayout::Packed ? sizeof(PackedTriangle) : sizeof(TriangleData);
+	}
+
+	inline uint64_t Align(uint64_t offset)
+	{
+		return (offset + MESH_CACHE_ALIGNMENT - 1) & ~static_cast<uint64_t>(MESH_CACHE_ALIGNMENT - 1);
+	}
+
+	bool WritePadded(FILE * f, const void * data, size_t size, uint64_t & offset)
+	{
+		static const char zeros[MESH_CACHE_ALIGNMENT] = {};
+
+		if (size > 0 && fwrite(data, 1, size, f) != size)
+			return false;
+
+		offset += size;
+		size_t padding = static_cast<size_t>(Align(offset) - offset);
+
+		if (padding > 0 && fwrite(zeros, 1, padding, f) != padding)
+			return false;
+
+		offset += padding;
+		return true;
+	}
+}
+
+MeshCache::MeshCache()
+{
+	memset(&tree, 0, sizeof(tree));
+}
+
+bool MeshCache::ComputeKey(const std::string& objFilename, float scaleMultiplier, int maxDepth, int maxLeafSize, KdSplitMethod splitMethod, bool spatialSplits, TriangleLayout triangleLayout, uint64_t& key)
+{
+	MappedFile obj;
+
+	if (!obj.Open(objFilename))
+		return false;
+
+	// Anything that changes the baked output must be part of the key
+	struct {
+		uint32_t version;
+		uint32_t nodeSize;
+		uint32_t triangleSize;
+		uint32_t packedTriangleSize;
+		float scaleMultiplier;
+		int32_t maxDepth;
+		int32_t maxLeafSize;
+		int32_t splitMethod;
+		int32_t spatialSplits;
+		int32_t triangleLayout;
+	} parameters;
+
+	parameters.version = MESH_CACHE_VERSION;
+	parameters.nodeSize = sizeof(CompactNode);
+	parameters.triangleSize = sizeof(TriangleData);
+	parameters.packedTriangleSize = sizeof(PackedTriangle);
+	parameters.scaleMultiplier = scaleMultiplier;
+	parameters.maxDepth = maxDepth;
+	parameters.maxLeafSize = maxLeafSize;
+	parameters.splitMethod = static_cast<int32_t>(splitMethod);
+	parameters.spatialSplits = spatialSplits ? 1 : 0;
+	parameters.triangleLayout = static_cast<int32_t>(triangleLayout);
+
+	uint64_t contentHash = FileUtils::Hash(obj.GetData(), obj.GetSize());
+	key = FileUtils::Hash(&parameters, sizeof(parameters), contentHash);
+	return true;
+}
+
+std::string MeshCache::GetCachePath(uint64_t key)
+{
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(key));
+	return std::string(MESH_CACHE_DIRECTORY) + "/" + name + ".omgmesh";
+}
+
+bool MeshCache::Save(const std::string& filename, uint64_t key, const CompactKdTree& tree)
+{
+	if (!FileUtils::EnsureDirectory(MESH_CACHE_DIRECTORY))
+		return false;
+
+	MeshCacheHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.version = MESH_CACHE_VERSION;
+	header.headerSize = sizeof(MeshCacheHeader);
+	header.key = key;
+	header.nodeCount = tree.nodeCount;
+	header.triangleCount = tree.triangleCount;
+	header.leafIndexCount = tree.leafIndexCount;
+	header.vertexCount = tree.vertexCount;
+	header.triangleLayout = static_cast<int32_t>(tree.triangleLayout);
+	header.pairCount = tree.pairCount;
+	header.nodeOffset = Align(sizeof(MeshCacheHeader));
+	header.pairParentOffset = Align(header.nodeOffset + sizeof(CompactNode) * static_cast<uint64_t>(tree.nodeCount));
+	header.triangleOffset = Align(header.pairParentOffset + sizeof(int32_t) * static_cast<uint64_t>(tree.pairCount));
+	header.vertexOffset = Align(header.triangleOffset + TriangleSize(tree.triangleLayout) * tree.triangleCount);
+	header.leafIndexOffset = Align(header.vertexOffset + sizeof(glm::vec3) * static_cast<uint64_t>(tree.vertexCount));
+	header.fileSize = Align(header.leafIndexOffset + sizeof(int32_t) * static_cast<uint64_t>(tree.leafIndexCount));
+
+	std::string temporaryFilename = filename + ".tmp";
+	FILE * f = fopen(temporaryFilename.c_str(), "wb");
+
+	if (f == nullptr)
+		return false;
+
+	uint64_t offset = 0;
+	bool success = WritePadded(f, &header, sizeof(header), offset)
+		&& WritePadded(f, tree.nodes, sizeof(CompactNode) * tree.nodeCount, offset)
+		&& WritePadded(f, tree.pairParents, sizeof(int32_t) * tree.pairCount, offset)
+		&& WritePadded(f, tree.triangleLayout == TriangleLayout::Packed ? static_cast<const void*>(tree.packedTriangles) : tree.triangles, TriangleSize(tree.triangleLayout) * tree.triangleCount, offset)
+		&& WritePadded(f, tree.vertices, sizeof(glm::vec3) * tree.vertexCount, offset)
+		&& WritePadded(f, tree.leafIndices, sizeof(int32_t) * tree.leafIndexCount, offset)
+		&& offset == header.fileSize;
+
+	success = fclose(f) == 0 && success;
+
+	if (!success || !FileUtils::ReplaceFile(temporaryFilename, filename))
+	{
+		remove(temporaryFilename.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+bool MeshCache::Open(const std::string& filename, uint64_t key)
+{
+	Close();
+
+	if (!file.Open(filename))
+		return false;
+
+	const char * data = file.GetData();
+	size_t size = file.GetSize();
+
+	if (size < sizeof(MeshCacheHeader))
+	{
+		Close();
+		return false;
+	}
+
+	MeshCacheHeader header;
+	memcpy(&header, data, sizeof(header));
+
+	// A stale or foreign file is just a cache miss
+	bool valid = memcmp(header.magic, MAGIC, sizeof(MAGIC)) == 0
+		&& header.version == MESH_CACHE_VERSION
+		&& header.headerSize == sizeof(MeshCacheHeader)
+		&& header.key == key
+		&& header.fileSize == size
+		&& header.nodeCount > 0 && header.pairCount == (header.nodeCount + 1) / 2 && header.triangleCount >= 0 && header.leafIndexCount >= 0 && header.vertexCount >= 0
+		&& (header.triangleLayout == static_cast<int32_t>(TriangleLayout::Full) || header.triangleLayout == static_cast<int32_t>(TriangleLayout::Packed))
+		&& header.nodeOffset % MESH_CACHE_ALIGNMENT == 0 && header.pairParentOffset % MESH_CACHE_ALIGNMENT == 0 && header.triangleOffset % MESH_CACHE_ALIGNMENT == 0
+		&& header.vertexOffset % MESH_CACHE_ALIGNMENT == 0 && header.leafIndexOffset % MESH_CACHE_ALIGNMENT == 0
+		&& header.nodeOffset >= sizeof(MeshCacheHeader)
+		&& header.nodeOffset + sizeof(CompactNode) * static_cast<uint64_t>(header.nodeCount) <= header.pairParentOffset
+		&& header.pairParentOffset + sizeof(int32_t) * static_cast<uint64_t>(header.pairCount) <= header.triangleOffset
+		&& header.triangleOffset + TriangleSize(static_cast<TriangleLayout>(header.triangleLayout)) * header.triangleCount <= header.vertexOffset
+		&& header.vertexOffset + sizeof(glm::vec3) * static_cast<uint64_t>(header.vertexCount) <= header.leafIndexOffset
+		&& header.leafIndexOffset + sizeof(int32_t) * static_cast<uint64_t>(header.leafIndexCount) <= size;
+
+	if (!valid)
+	{
+		Close();
+		return false;
+	}
+
+	tree.nodes = reinterpret_cast<const CompactNode*>(data + header.nodeOffset);
+	tree.nodeCount = header.nodeCount;
+	tree.pairParents = reinterpret_cast<const int*>(data + header.pairParentOffset);
+	tree.pairCount = header.pairCount;
+	tree.triangleLayout = static_cast<TriangleLayout>(header.triangleLayout);
+	tree.triangles = tree.triangleLayout == TriangleLayout::Full ? reinterpret_cast<const TriangleData*>(data + header.triangleOffset) : nullptr;
+	tree.packedTriangles = tree.triangleLayout == TriangleLayout::Packed ? reinterpret_cast<const PackedTriangle*>(data + header.triangleOffset) : nullptr;
+	tree.triangleCount = header.triangleCount;
+	tree.vertices = reinterpret_cast<const glm::vec3*>(data + header.vertexOffset);
+	tree.vertexCount = header.vertexCount;
+	tree.leafIndices = reinterpret_cast<const int*>(data + header.leafIndexOffset);
+	tree.leafIndexCount = header.leafIndexCount;
+	return true;
+}
+
+void MeshCache::Close()
+{
+	file.Close();
+	memset(&tree, 0, sizeof(tree));
+}
+
+const CompactKdTree& MeshCache::GetKdTree() const
+{
+	return tree;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "MappedFile.h"
+#include "Mesh.h"
+
+// Bump this whenever the kd-tree builder or the layout of CompactNode/TriangleData/PackedTriangle changes
+#define MESH_CACHE_VERSION 5
+#define MESH_CACHE_DIRECTORY "cache"
+
+// Baked .omgmesh file: a header followed by the node, triangle, vertex and leaf index arrays, stored exactly
+// as the generator consumes them. Files are keyed by a hash of everything the kd-tree depends on.
+class MeshCache
+{
+public:
+	MeshCache();
+
+	// Hashes the obj contents together with the build parameters. Returns false if the file cannot be read.
+	static bool ComputeKey(const std::string& objFilename, float scaleMultiplier, int maxDepth, int maxLeafSize, KdSplitMethod splitMethod, bool spatialSplits, TriangleLayout triangleLayout, uint64_t& key);
+	static std::string GetCachePath(uint64_t key);
+
+	// Writes to a temporary file and then moves it in place, so a crash never leaves a truncated cache
+	static bool Save(const std::string& filename, uint64_t key, const CompactKdTree& tree);
+
+	// Maps the file and validates it against the key. The tree stays valid until Close() or destruction.
+	bool Open(const std::string& filename, uint64_t key);
+	void Close();
+
+	const CompactKdTree& GetKdTree() const;
+
+private:
+	MappedFile file;
+	CompactKdTree tree;
+};
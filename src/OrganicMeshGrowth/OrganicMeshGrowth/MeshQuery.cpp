@@ -0,0 +1,494 @@
+#include "MeshQuery.h"
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+namespace {
+	inline float Dot2(const glm::vec3& v)
+	{
+		return glm::dot(v, v);
+	}
+
+	inline float Saturate(float x)
+	{
+		return glm::clamp(x, 0.f, 1.f);
+	}
+
+	// Largest distance from p to a point in the box
+	inline float FarthestCornerDistance(const glm::vec3& boxMin, const glm::vec3& boxMax, const glm::vec3& p)
+	{
+		return glm::length(glm::max(glm::abs(boxMin - p), glm::abs(boxMax - p)));
+	}
+
+	// Lower bound of udTriangleFast over the box. Outside the bounding sphere it is the distance to its center,
+	// inside it the triangle distance, which is at least the distance to the center minus the radius.
+	inline float LowestFastDistance(const glm::vec3& boxMin, const glm::vec3& boxMax, const glm::vec4& sphere)
+	{
+		glm::vec3 center(sphere);
+		float boxDistance = glm::length(glm::max(glm::max(boxMin - center, center - boxMax), glm::vec3(0.f)));
+		return boxDistance >= sphere.w ? boxDistance : boxDistance - sphere.w;
+	}
+
+	// Nearest rank percentile, values are reordered
+	uint32_t Percentile(std::vector<uint32_t>& values, float p)
+	{
+		size_t rank = static_cast<size_t>(p * (values.size() - 1) + .5f);
+		std::nth_element(values.begin(), values.begin() + rank, values.end());
+		return values[rank];
+	}
+
+	CounterPercentiles Summarize(std::vector<uint32_t>& values)
+	{
+		CounterPercentiles result;
+
+		if (values.empty())
+			return result;
+
+		uint64_t sum = 0;
+
+		for (uint32_t v : values)
+			sum += v;
+
+		result.mean = sum / static_cast<double>(values.size());
+		result.max = *std::max_element(values.begin(), values.end());
+		result.p50 = Percentile(values, .5f);
+		result.p90 = Percentile(values, .9f);
+		result.p99 = Percentile(values, .99f);
+		return result;
+	}
+}
+
+MeshQuery::MeshQuery(const CompactKdTree& tree) : tree(tree)
+{
+}
+
+TriangleData MeshQuery::LoadTriangle(int triangleIndex) const
+{
+	if (tree.triangleLayout == TriangleLayout::Full)
+		return tree.triangles[triangleIndex];
+
+	const PackedTriangle& packed = tree.packedTriangles[triangleIndex];
+
+	TriangleData t;
+	t.v1 = tree.vertices[packed.v1];
+	t.v2 = tree.vertices[packed.v2];
+	t.v3 = tree.vertices[packed.v3];
+
+	t.v21 = glm::vec4(t.v2 - t.v1, 0.f);
+	t.v32 = glm::vec4(t.v3 - t.v2, 0.f);
+	t.v13 = glm::vec4(t.v1 - t.v3, 0.f);
+	t.v21.w = 1.f / glm::dot(t.v21, t.v21);
+	t.v32.w = 1.f / glm::dot(t.v32, t.v32);
+	t.v13.w = 1.f / glm::dot(t.v13, t.v13);
+
+	t.normal = OctEncoding::Decode(packed.normal);
+	t.t21 = OctEncoding::Decode(packed.t21);
+	t.t32 = OctEncoding::Decode(packed.t32);
+	t.t13 = OctEncoding::Decode(packed.t13);
+	t.center = glm::vec4((t.v1 + t.v2 + t.v3) / 3.f, packed.radius);
+	return t;
+}
+
+glm::vec4 MeshQuery::BoundingSphere(int triangleIndex) const
+{
+	if (tree.triangleLayout == TriangleLayout::Full)
+		return tree.triangles[triangleIndex].center;
+
+	const PackedTriangle& packed = tree.packedTriangles[triangleIndex];
+	glm::vec3 c = (tree.vertices[packed.v1] + tree.vertices[packed.v2] + tree.vertices[packed.v3]) / 3.f;
+	return glm::vec4(c, packed.radius);
+}
+
+float MeshQuery::TriangleDistance(int triangleIndex, const glm::vec3& p) const
+{
+	TriangleData t = LoadTriangle(triangleIndex);
+
+	glm::vec3 p1 = p - t.v1;
+	glm::vec3 p2 = p - t.v2;
+	glm::vec3 p3 = p - t.v3;
+
+	// Projections on boundaries
+	float t1 = glm::dot(t.t21, p1);
+	float t2 = glm::dot(t.t32, p2);
+	float t3 = glm::dot(t.t13, p3);
+	float a = -.005f;
+	float b = 0.f;
+	float outsideFace = glm::smoothstep(a, b, t1) + glm::smoothstep(a, b, t2) + glm::smoothstep(a, b, t3);
+
+	if (outsideFace > 2.995f)
+	{
+		float s = -glm::sign(glm::dot(t.normal, p1));
+		return glm::abs(glm::dot(t.normal, p1)) * s;
+	}
+	else
+	{
+		glm::vec3 v21 = glm::vec3(t.v21);
+		glm::vec3 v32 = glm::vec3(t.v32);
+		glm::vec3 v13 = glm::vec3(t.v13);
+
+		float d1 = Dot2(v21 * Saturate(glm::dot(v21, p1) * t.v21.w) - p1);
+		float d2 = Dot2(v32 * Saturate(glm::dot(v32, p2) * t.v32.w) - p2);
+		float d3 = Dot2(v13 * Saturate(glm::dot(v13, p3) * t.v13.w) - p3);
+
+		float edgeDistance = glm::min(glm::min(d1, d2), d3);
+		return glm::sqrt(edgeDistance);
+	}
+}
+
+float MeshQuery::TriangleDistanceFast(int triangleIndex, const glm::vec3& p) const
+{
+	glm::vec4 sphere = BoundingSphere(triangleIndex);
+
+	float d = glm::length(p - glm::vec3(sphere));
+
+	if (d < sphere.w)
+		return TriangleDistance(triangleIndex, p);
+
+	return d;
+}
+
+float MeshQuery::Distance(const glm::vec3& p) const
+{
+	MeshQueryStats stats;
+	return Distance(p, stats);
+}
+
+float MeshQuery::Distance(const glm::vec3& p, MeshQueryStats& stats) const
+{
+	bool finished = false;
+	int closestTriangleIndex = ClosestTriangle(p, stats, finished);
+
+	if (closestTriangleIndex == -1)
+		return 10.f;
+
+	// The shader only applies the offset when the step budget runs out
+	float distance = TriangleDistance(closestTriangleIndex, p);
+	return finished ? distance : distance - .0115f;
+}
+
+int MeshQuery::ClosestTriangle(const glm::vec3& p, MeshQueryStats& stats, bool& finished) const
+{
+	int currentNode = 0;
+	int steps = 0;
+	bool descending = true;
+
+	float currentDistance = 10.f;
+
+	int closestTriangleIndex = -1;
+	finished = false;
+
+	stats.queries++;
+
+	// Stackless: after a subtree is done we climb through the pair parents and only
+	// enter a far sibling if the splitting plane is closer than the current distance.
+	// This visits the same nodes in the same order as the old stack traversal.
+	while (steps++ < QUERY_MAX_STEPS)
+	{
+		if (descending)
+		{
+			const CompactNode& node = tree.nodes[currentNode];
+			stats.nodeVisits++;
+
+			if (node.IsLeaf())
+			{
+				int primitiveCount = node.GetPrimitiveCount();
+
+				stats.leafVisits++;
+				stats.triangleTests += primitiveCount;
+
+				// Check intersection with all primitives inside this node
+				for (int i = 0; i < primitiveCount; i++)
+				{
+					int triangleIndex = tree.leafIndices[node.primitiveStartOffset + i];
+					float triangleDistance = TriangleDistanceFast(triangleIndex, p);
+
+					if (glm::abs(triangleDistance) < glm::abs(currentDistance))
+					{
+						currentDistance = triangleDistance;
+						closestTriangleIndex = triangleIndex;
+					}
+				}
+
+				descending = false;
+			}
+			else
+			{
+				float dist = p[node.GetAxis()] - node.split;
+				currentNode = dist >= 0.f ? node.GetRightChild() : node.GetLeftChild();
+			}
+		}
+		else
+		{
+			if (currentNode == 0)
+			{
+				finished = true;
+				break;
+			}
+
+			int parentNode = tree.pairParents[currentNode / 2];
+			const CompactNode& parent = tree.nodes[parentNode];
+			stats.backtracks++;
+
+			float dist = p[parent.GetAxis()] - parent.split;
+			int nearNode = dist >= 0.f ? parent.GetRightChild() : parent.GetLeftChild();
+
+			// Coming back from the near child, the far one may still hold something closer
+			if (currentNode == nearNode && glm::abs(currentDistance) >= glm::abs(dist))
+			{
+				currentNode ^= 1;
+				descending = true;
+			}
+			else
+			{
+				currentNode = parentNode;
+			}
+		}
+	}
+
+	return closestTriangleIndex;
+}
+
+bool MeshQuery::GatherCandidates(const glm::vec3& boxMin, const glm::vec3& boxMax, std::vector<int>& candidates, MeshQueryStats& stats) const
+{
+	candidates.clear();
+
+	glm::vec3 center = (boxMin + boxMax) * .5f;
+	bool finished = false;
+	int closest = ClosestTriangle(center, stats, finished);
+
+	if (closest == -1)
+		return true;
+
+	// udTriangleFast never returns more than the distance to the triangle centroid, which lies on the triangle,
+	// so nothing in the box is further than its farthest corner from the centroid of any triangle. And since it is
+	// never less than the true distance, only triangles and cells within this bound of the box can win anywhere in it
+	// (BRICK_CULLING_SLACK covers the plane distance near faces).
+	// Starts from the triangle closest to the center. The first walk only shrinks it with every triangle in reach,
+	// the second collects what the final bound lets through, so the candidates never overflow on a loose bound.
+	float bound = FarthestCornerDistance(boxMin, boxMax, glm::vec3(BoundingSphere(closest))) + BRICK_CULLING_SLACK;
+
+	for (int pass = 0; pass < 2; ++pass)
+	{
+		bool collect = pass == 1;
+
+		// Same stackless walk, but entering every child whose half space reaches the bound
+		int currentNode = 0;
+		bool descending = true;
+
+		while (true)
+		{
+			if (descending)
+			{
+				const CompactNode& node = tree.nodes[currentNode];
+				stats.nodeVisits++;
+
+				if (node.IsLeaf())
+				{
+					int primitiveCount = node.GetPrimitiveCount();
+
+					stats.leafVisits++;
+
+					for (int i = 0; i < primitiveCount; i++)
+					{
+						int triangleIndex = tree.leafIndices[node.primitiveStartOffset + i];
+						glm::vec4 sphere = BoundingSphere(triangleIndex);
+
+						if (LowestFastDistance(boxMin, boxMax, sphere) > bound)
+							continue;
+
+						if (!collect)
+						{
+							bound = glm::min(bound, FarthestCornerDistance(boxMin, boxMax, glm::vec3(sphere)) + BRICK_CULLING_SLACK);
+							continue;
+						}
+
+						// Far from the surface bricks see most of the mesh, better to traverse per voxel
+						if (candidates.size() == BRICK_MAX_CANDIDATES)
+						{
+							candidates.clear();
+							return false;
+						}
+
+						candidates.push_back(triangleIndex);
+					}
+
+					descending = false;
+				}
+				else
+				{
+					// One of the two half spaces always contains the box
+					bool leftReachable = boxMin[node.GetAxis()] - node.split <= bound;
+					currentNode = leftReachable ? node.GetLeftChild() : node.GetRightChild();
+				}
+			}
+			else
+			{
+				if (currentNode == 0)
+					break;
+
+				int parentNode = tree.pairParents[currentNode / 2];
+				const CompactNode& parent = tree.nodes[parentNode];
+				stats.backtracks++;
+
+				// Left children are even, their right sibling may still be in reach
+				if ((currentNode & 1) == 0 && parent.split - boxMax[parent.GetAxis()] <= bound)
+				{
+					currentNode ^= 1;
+					descending = true;
+				}
+				else
+				{
+					currentNode = parentNode;
+				}
+			}
+		}
+	}
+
+	// Spatial splits reference triangles from several leaves
+	std::sort(candidates.begin(), candidates.end());
+	candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+	return true;
+}
+
+float MeshQuery::CandidateDistance(const glm::vec3& p, const std::vector<int>& candidates, MeshQueryStats& stats) const
+{
+	int closestTriangleIndex = CandidateTriangle(p, candidates, stats);
+
+	if (closestTriangleIndex == -1)
+		return 10.f;
+
+	return TriangleDistance(closestTriangleIndex, p);
+}
+
+int MeshQuery::CandidateTriangle(const glm::vec3& p, const std::vector<int>& candidates, MeshQueryStats& stats) const
+{
+	float currentDistance = 10.f;
+	int closestTriangleIndex = -1;
+
+	stats.queries++;
+	stats.triangleTests += candidates.size();
+
+	for (int triangleIndex : candidates)
+	{
+		float triangleDistance = TriangleDistanceFast(triangleIndex, p);
+
+		if (glm::abs(triangleDistance) < glm::abs(currentDistance))
+		{
+			currentDistance = triangleDistance;
+			closestTriangleIndex = triangleIndex;
+		}
+	}
+
+	return closestTriangleIndex;
+}
+
+glm::vec3 MeshQuery::ClosestBarycentrics(int triangleIndex, const glm::vec3& p) const
+{
+	TriangleData t = LoadTriangle(triangleIndex);
+
+	// Ericson, Real-Time Collision Detection 5.1.5: which Voronoi region of the triangle p falls in
+	glm::vec3 ab = t.v2 - t.v1;
+	glm::vec3 ac = t.v3 - t.v1;
+	glm::vec3 ap = p - t.v1;
+
+	float d1 = glm::dot(ab, ap);
+	float d2 = glm::dot(ac, ap);
+
+	if (d1 <= 0.f && d2 <= 0.f)
+		return glm::vec3(1.f, 0.f, 0.f);
+
+	glm::vec3 bp = p - t.v2;
+	float d3 = glm::dot(ab, bp);
+	float d4 = glm::dot(ac, bp);
+
+	if (d3 >= 0.f && d4 <= d3)
+		return glm::vec3(0.f, 1.f, 0.f);
+
+	float vc = d1 * d4 - d3 * d2;
+
+	if (vc <= 0.f && d1 >= 0.f && d3 <= 0.f) {
+		float v = d1 / (d1 - d3);
+		return glm::vec3(1.f - v, v, 0.f);
+	}
+
+	glm::vec3 cp = p - t.v3;
+	float d5 = glm::dot(ab, cp);
+	float d6 = glm::dot(ac, cp);
+
+	if (d6 >= 0.f && d5 <= d6)
+		return glm::vec3(0.f, 0.f, 1.f);
+
+	float vb = d5 * d2 - d1 * d6;
+
+	if (vb <= 0.f && d2 >= 0.f && d6 <= 0.f) {
+		float w = d2 / (d2 - d6);
+		return glm::vec3(1.f - w, 0.f, w);
+	}
+
+	float va = d3 * d6 - d5 * d4;
+
+	if (va <= 0.f && (d4 - d3) >= 0.f && (d5 - d6) >= 0.f) {
+		float w = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+		return glm::vec3(0.f, 1.f - w, w);
+	}
+
+	// Inside the face, degenerate triangles end up here with a zero denominator
+	float denominator = va + vb + vc;
+
+	if (denominator <= 0.f)
+		return glm::vec3(1.f, 0.f, 0.f);
+
+	float v = vb / denominator;
+	float w = vc / denominator;
+	return glm::vec3(1.f - v - w, v, w);
+}
+
+float MeshQuery::BruteForceDistance(const glm::vec3& p) const
+{
+	float currentDistance = 10.f;
+	int closestTriangleIndex = -1;
+
+	for (int i = 0; i < tree.triangleCount; i++)
+	{
+		float triangleDistance = TriangleDistanceFast(i, p);
+
+		if (glm::abs(triangleDistance) < glm::abs(currentDistance))
+		{
+			currentDistance = triangleDistance;
+			closestTriangleIndex = i;
+		}
+	}
+
+	if (closestTriangleIndex == -1)
+		return currentDistance;
+
+	return TriangleDistance(closestTriangleIndex, p);
+}
+
+void TraversalCounters::Reduce(const uint32_t * counters, size_t count, CounterPercentiles& nodeFetches, CounterPercentiles& triangleTests)
+{
+	std::vector<uint32_t> values(count);
+
+	for (size_t i = 0; i < count; ++i)
+		values[i] = counters[i] & 0xFFFF;
+
+	nodeFetches = Summarize(values);
+
+	for (size_t i = 0; i < count; ++i)
+		values[i] = counters[i] >> 16;
+
+	triangleTests = Summarize(values);
+}
+
+void TraversalCounters::Print(const uint32_t * counters, size_t count)
+{
+	CounterPercentiles nodeFetches;
+	CounterPercentiles triangleTests;
+	Reduce(counters, count, nodeFetches, triangleTests);
+
+	std::cout << "---------------------------------------------" << std::endl;
+	std::cout << "generator traversal over " << count << " voxels" << std::endl;
+	std::cout << "node fetches:   mean " << nodeFetches.mean << ", p50 " << nodeFetches.p50 << ", p90 " << nodeFetches.p90 << ", p99 " << nodeFetches.p99 << ", max " << nodeFetches.max << std::endl;
+	std::cout << "triangle tests: mean " << triangleTests.mean << ", p50 " << triangleTests.p50 << ", p90 " << triangleTests.p90 << ", p99 " << triangleTests.p99 << ", max " << triangleTests.max << std::endl;
+	std::cout << "---------------------------------------------" << std::endl;
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "Mesh.h"
+
+// Descents plus backtracks per query, same budget as MAX_TRAVERSAL_STEPS in generator.comp
+#define QUERY_MAX_STEPS 16384
+
+// Brick culling margin for the plane distance udTriangleSquared returns just outside a face, which can
+// be a little under the true distance. Same as BRICK_CULLING_SLACK in generator.comp.
+#define BRICK_CULLING_SLACK .01f
+
+// Bricks with more candidates than this fall back to the per voxel traversal, also BRICK_CANDIDATE_CAPACITY in generator.comp
+#define BRICK_MAX_CANDIDATES 1024
+
+// Work done by distance queries, accumulated over many calls
+struct MeshQueryStats
+{
+	uint64_t queries = 0;
+	uint64_t nodeVisits = 0;		// Nodes fetched, inner and leaves
+	uint64_t leafVisits = 0;
+	uint64_t backtracks = 0;		// Steps back up to a parent
+	uint64_t triangleTests = 0;		// udTriangleFast calls
+};
+
+// Mean and percentiles of a per-voxel counter
+struct CounterPercentiles
+{
+	double mean = 0.0;
+	uint32_t p50 = 0;
+	uint32_t p90 = 0;
+	uint32_t p99 = 0;
+	uint32_t max = 0;
+};
+
+// Per-voxel counters written by the instrumented generator pass (TRAVERSAL_STATS in generator.comp).
+// Node fetches go in the low 16 bits and triangle tests in the high 16 bits, both saturated.
+namespace TraversalCounters {
+	inline uint32_t Pack(uint64_t nodeFetches, uint64_t triangleTests)
+	{
+		return static_cast<uint32_t>(nodeFetches < 0xFFFF ? nodeFetches : 0xFFFF) | (static_cast<uint32_t>(triangleTests < 0xFFFF ? triangleTests : 0xFFFF) << 16);
+	}
+
+	void Reduce(const uint32_t * counters, size_t count, CounterPercentiles& nodeFetches, CounterPercentiles& triangleTests);
+	void Print(const uint32_t * counters, size_t count);
+}
+
+// CPU version of the kd-tree traversal in generator.comp, used to measure and validate trees offline.
+// Any change to generateMeshSDF should be mirrored here.
+class MeshQuery
+{
+public:
+	MeshQuery(const CompactKdTree& tree);
+
+	float Distance(const glm::vec3& p) const;
+	float Distance(const glm::vec3& p, MeshQueryStats& stats) const;
+
+	// Tests every triangle, the reference the traversal is validated against
+	float BruteForceDistance(const glm::vec3& p) const;
+
+	// The triangle the traversal picks for p, -1 for an empty tree. finished is false when the step budget ran out.
+	// It can differ from the brute force pick: a point just outside a face, within the bent tangents, gets the plane
+	// distance, which can be several times below the true one. The far side of a split is pruned by its true distance,
+	// so such a triangle behind the plane is skipped. On deep trees that happens for a few voxels (teapot at depth 20,
+	// 32^3: 3 voxels, 0.005 apart), and the pick is then the one closer in true distance. No slack bounds it.
+	int ClosestTriangle(const glm::vec3& p, MeshQueryStats& stats, bool& finished) const;
+
+	// Brick culling, BRICK_CULLING in generator.comp. Every triangle that can be closest to some point in the box,
+	// sorted by index so ties resolve like the brute force search. Empty only for an empty tree.
+	// Returns false if there are more than BRICK_MAX_CANDIDATES.
+	bool GatherCandidates(const glm::vec3& boxMin, const glm::vec3& boxMax, std::vector<int>& candidates, MeshQueryStats& stats) const;
+
+	// Closest of the candidates, then its exact distance
+	float CandidateDistance(const glm::vec3& p, const std::vector<int>& candidates, MeshQueryStats& stats) const;
+	int CandidateTriangle(const glm::vec3& p, const std::vector<int>& candidates, MeshQueryStats& stats) const;
+
+	// Both layouts go through these, like fetchTriangle and triangleBoundingSphere in the shader
+	TriangleData LoadTriangle(int triangleIndex) const;
+	glm::vec4 BoundingSphere(int triangleIndex) const;
+
+	// udTriangleSquared and udTriangleFast
+	float TriangleDistance(int triangleIndex, const glm::vec3& p) const;
+	float TriangleDistanceFast(int triangleIndex, const glm::vec3& p) const;
+
+	// Weights of v1, v2 and v3 for the point of the triangle closest to p, closestBarycentrics in the shader
+	glm::vec3 ClosestBarycentrics(int triangleIndex, const glm::vec3& p) const;
+
+private:
+
+	CompactKdTree tree;
+};
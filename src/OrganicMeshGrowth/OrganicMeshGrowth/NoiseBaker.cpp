@@ -0,0 +1,407 @@
+#include "NoiseBaker.h"
+#include "FileUtils.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <cmath>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+// The tables, Texel and the AVX2 Bake must round every multiply and add on their own to agree with each other and with
+// the shader hashing in Benchmark::NoiseBaking, so no fused multiply-adds even when the target has FMA
+#if defined(__clang__)
+#pragma STDC FP_CONTRACT OFF
+#elif defined(__GNUC__)
+#pragma GCC optimize("fp-contract=off")
+#elif defined(_MSC_VER)
+#pragma fp_contract(off)
+#endif
+
+namespace {
+	// Offsets of N2 and N3 in curl3D
+	const glm::vec3 CURL_OFFSETS[3] = { glm::vec3(0.f), glm::vec3(27.f, 13.f, 41.f), glm::vec3(35.f, 85.f, -30.f) };
+
+	inline float Fract(float x)
+	{
+		return x - std::floor(x);
+	}
+
+	// GLSL mix, not glm::mix, so the SIMD path can use the same operations
+	inline float Mix(float a, float b, float t)
+	{
+		return a * (1.f - t) + b * t;
+	}
+
+	inline float Dot(const glm::vec3& a, const glm::vec3& b)
+	{
+		return (a.x * b.x + a.y * b.y) + a.z * b.z;
+	}
+
+	inline float Fade(float t)
+	{
+		float t3 = t * t * t;
+		return 6.f * t3 * t * t - 15.f * t3 * t + 10.f * t3;
+	}
+
+	// lcg in generator.comp, a linear congruential generator seeded with a hash
+	inline float Lcg(float x)
+	{
+		float a = x * 25214903917.f + 28411.f;
+		return (a - 1306633.f * std::floor(a / 1306633.f)) / 1306633.f;
+	}
+
+	inline float SmoothStep(float edge0, float edge1, float x)
+	{
+		float t = std::min(std::max((x - edge0) / (edge1 - edge0), 0.f), 1.f);
+		return t * t * (3.f - 2.f * t);
+	}
+
+#ifdef __AVX2__
+	// Same operation order as the scalar helpers above, no FMA, so both paths round identically
+	inline __m256 Dot(__m256 ax, __m256 ay, __m256 az, __m256 bx, __m256 by, __m256 bz)
+	{
+		return _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ax, bx), _mm256_mul_ps(ay, by)), _mm256_mul_ps(az, bz));
+	}
+
+	inline __m256 Mix(__m256 a, __m256 b, __m256 t)
+	{
+		return _mm256_add_ps(_mm256_mul_ps(a, _mm256_sub_ps(_mm256_set1_ps(1.f), t)), _mm256_mul_ps(b, t));
+	}
+
+	inline __m256 Fade(__m256 t)
+	{
+		__m256 t3 = _mm256_mul_ps(_mm256_mul_ps(t, t), t);
+		__m256 a = _mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(6.f), t3), t), t);
+		__m256 b = _mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(15.f), t3), t);
+		return _mm256_add_ps(_mm256_sub_ps(a, b), _mm256_mul_ps(_mm256_set1_ps(10.f), t3));
+	}
+#endif
+}
+
+int NoiseBaker::Lattice::Index(const glm::ivec3& cell) const
+{
+	glm::ivec3 local = cell - origin;
+	return (local.z * size.y + local.y) * size.x + local.x;
+}
+
+NoiseBaker::NoiseBaker(const NoiseParameters& parameters, int resolution) : parameters(parameters), resolution(resolution)
+{
+	// Texel c samples c / resolution * 2 - 1, like main() in generator.comp
+	glm::vec3 first(-1.f);
+	glm::vec3 last((static_cast<float>(resolution - 1) / resolution) * 2.f - 1.f);
+
+	glm::vec3 curlLowest = glm::min(first * parameters.curlFrequency, last * parameters.curlFrequency) + parameters.curlOffset - std::abs(parameters.curlEpsilon);
+	glm::vec3 curlHighest = glm::max(first * parameters.curlFrequency, last * parameters.curlFrequency) + parameters.curlOffset + std::abs(parameters.curlEpsilon);
+
+	for (int i = 0; i < 3; ++i)
+		BuildGradients(curlLowest + CURL_OFFSETS[i], curlHighest + CURL_OFFSETS[i], gradients[i]);
+
+	// worley3D truncates towards zero and then looks at the neighbouring cells. One more cell of margin for rounding.
+	glm::vec3 worleyLowest = glm::min(first * parameters.worleyFrequency, last * parameters.worleyFrequency) + parameters.worleyOffset;
+	glm::vec3 worleyHighest = glm::max(first * parameters.worleyFrequency, last * parameters.worleyFrequency) + parameters.worleyOffset;
+
+	featurePoints.origin = glm::ivec3(worleyLowest) - 2;
+	featurePoints.size = glm::ivec3(worleyHighest) + 3 - featurePoints.origin;
+
+	size_t count = static_cast<size_t>(featurePoints.size.x) * featurePoints.size.y * featurePoints.size.z;
+	featurePoints.x.resize(count);
+	featurePoints.y.resize(count);
+	featurePoints.z.resize(count);
+
+	for (int z = 0; z < featurePoints.size.z; ++z)
+		for (int y = 0; y < featurePoints.size.y; ++y)
+			for (int x = 0; x < featurePoints.size.x; ++x)
+			{
+				glm::ivec3 cell = featurePoints.origin + glm::ivec3(x, y, z);
+				glm::vec3 point = FeaturePoint(glm::vec3(cell));
+				int index = featurePoints.Index(cell);
+
+				featurePoints.x[index] = point.x;
+				featurePoints.y[index] = point.y;
+				featurePoints.z[index] = point.z;
+			}
+}
+
+void NoiseBaker::BuildGradients(const glm::vec3& lowest, const glm::vec3& highest, Lattice& lattice)
+{
+	// Perlin reads floor(p) and floor(p) + 1, with a cell of margin on each side for rounding
+	lattice.origin = glm::ivec3(glm::floor(lowest)) - 1;
+	lattice.size = glm::ivec3(glm::floor(highest)) + 3 - lattice.origin;
+
+	size_t count = static_cast<size_t>(lattice.size.x) * lattice.size.y * lattice.size.z;
+	lattice.x.resize(count);
+	lattice.y.resize(count);
+	lattice.z.resize(count);
+
+	for (int z = 0; z < lattice.size.z; ++z)
+		for (int y = 0; y < lattice.size.y; ++y)
+			for (int x = 0; x < lattice.size.x; ++x)
+			{
+				glm::ivec3 corner = lattice.origin + glm::ivec3(x, y, z);
+				glm::vec3 gradient = Gradient(glm::vec3(corner));
+				int index = lattice.Index(corner);
+
+				lattice.x[index] = gradient.x;
+				lattice.y[index] = gradient.y;
+				lattice.z[index] = gradient.z;
+			}
+}
+
+glm::vec3 NoiseBaker::Gradient(const glm::vec3& corner)
+{
+	// hash3D and gradient3D
+	float i = Dot(corner, glm::vec3(123.4031f, 46.5244876f, 91.106168f));
+	float h = Fract(std::sin(i * 7.13f) * 268573.103291f);
+	float r1 = Lcg(Lcg(h));
+	float r2 = Lcg(Lcg(r1));
+	return glm::normalize(glm::vec3(h, r1, r2) * 2.f - 1.f);
+}
+
+glm::vec3 NoiseBaker::FeaturePoint(const glm::vec3& cell)
+{
+	// hash3, offset into the cell
+	const glm::vec3 k(0.3183099f, 0.23678794f, .9456743512f);
+	glm::vec3 p = cell * k + glm::vec3(k.y, k.x, k.z);
+	float f = Fract(p.x * p.y * p.z * (p.x + p.y + p.z));
+	glm::vec3 h = 13.f * k * f;
+	return cell + glm::vec3(Fract(h.x), Fract(h.y), Fract(h.z));
+}
+
+uint64_t NoiseBaker::ComputeKey(const NoiseParameters& parameters)
+{
+	uint32_t version = NOISE_BAKER_VERSION;
+	return FileUtils::Hash(&parameters, sizeof(parameters), FileUtils::Hash(&version, sizeof(version)));
+}
+
+bool NoiseBaker::UsesAVX2()
+{
+#ifdef __AVX2__
+	return true;
+#else
+	return false;
+#endif
+}
+
+float NoiseBaker::Perlin(const Lattice& lattice, const glm::vec3& p) const
+{
+	glm::vec3 cell = glm::floor(p);
+	int base = lattice.Index(glm::ivec3(cell));
+	float influences[8];
+
+	for (int corner = 0; corner < 8; ++corner)
+	{
+		glm::ivec3 offset(corner & 1, (corner >> 1) & 1, corner >> 2);
+		int index = base + (offset.z * lattice.size.y + offset.y) * lattice.size.x + offset.x;
+		influences[corner] = Dot(p - (cell + glm::vec3(offset)), glm::vec3(lattice.x[index], lattice.y[index], lattice.z[index]));
+	}
+
+	float fX = Fade(p.x - cell.x);
+	float fY = Fade(p.y - cell.y);
+	float fZ = Fade(p.z - cell.z);
+
+	float m1 = Mix(Mix(influences[0], influences[1], fX), Mix(influences[2], influences[3], fX), fY);
+	float m2 = Mix(Mix(influences[4], influences[5], fX), Mix(influences[6], influences[7], fX), fY);
+	return Mix(m1, m2, fZ) * 0.707213578f + .5f;
+}
+
+float NoiseBaker::Worley(const glm::vec3& p) const
+{
+	glm::ivec3 pos(p);
+	float nearest = 100000.f * 100000.f;
+
+	// The closest center is also the one with the smallest squared distance, so only one square root
+	for (int k = -1; k <= 1; ++k)
+		for (int j = -1; j <= 1; ++j)
+			for (int i = -1; i <= 1; ++i)
+			{
+				int index = featurePoints.Index(pos + glm::ivec3(i, j, k));
+				glm::vec3 d = glm::vec3(featurePoints.x[index], featurePoints.y[index], featurePoints.z[index]) - p;
+				nearest = std::min(nearest, Dot(d, d));
+			}
+
+	return std::sqrt(nearest);
+}
+
+glm::vec4 NoiseBaker::Texel(const glm::ivec3& coord) const
+{
+	glm::vec3 nPos = (glm::vec3(coord) / static_cast<float>(resolution)) * 2.f - 1.f;
+
+	// curl3D
+	glm::vec3 p = nPos * parameters.curlFrequency + parameters.curlOffset;
+	float e = parameters.curlEpsilon;
+	glm::vec3 ex(e, 0.f, 0.f);
+	glm::vec3 ey(0.f, e, 0.f);
+	glm::vec3 ez(0.f, 0.f, e);
+
+	float dN1dy = Perlin(gradients[0], p + ey) - Perlin(gradients[0], p - ey);
+	float dN1dz = Perlin(gradients[0], p + ez) - Perlin(gradients[0], p - ez);
+
+	float dN2dx = Perlin(gradients[1], p + ex + CURL_OFFSETS[1]) - Perlin(gradients[1], p - ex + CURL_OFFSETS[1]);
+	float dN2dz = Perlin(gradients[1], p + ez + CURL_OFFSETS[1]) - Perlin(gradients[1], p - ez + CURL_OFFSETS[1]);
+
+	float dN3dx = Perlin(gradients[2], p + ex + CURL_OFFSETS[2]) - Perlin(gradients[2], p - ex + CURL_OFFSETS[2]);
+	float dN3dy = Perlin(gradients[2], p + ey + CURL_OFFSETS[2]) - Perlin(gradients[2], p - ey + CURL_OFFSETS[2]);
+
+	glm::vec3 curl = glm::vec3(dN3dy - dN2dz, dN1dz - dN3dx, dN2dx - dN1dy) / e;
+
+	float worley = Worley(nPos * parameters.worleyFrequency + parameters.worleyOffset);
+	return glm::vec4(curl, 1.f - SmoothStep(parameters.worleyInner, parameters.worleyOuter, worley));
+}
+
+#ifdef __AVX2__
+namespace {
+	struct Vec8
+	{
+		__m256 x, y, z;
+	};
+
+	inline Vec8 Add(const Vec8& a, const glm::vec3& b)
+	{
+		return { _mm256_add_ps(a.x, _mm256_set1_ps(b.x)), _mm256_add_ps(a.y, _mm256_set1_ps(b.y)), _mm256_add_ps(a.z, _mm256_set1_ps(b.z)) };
+	}
+
+	inline Vec8 Sub(const Vec8& a, const glm::vec3& b)
+	{
+		return { _mm256_sub_ps(a.x, _mm256_set1_ps(b.x)), _mm256_sub_ps(a.y, _mm256_set1_ps(b.y)), _mm256_sub_ps(a.z, _mm256_set1_ps(b.z)) };
+	}
+
+	// Perlin for 8 points, reading a lattice of size.x * size.y * size.z gradients
+	inline __m256 Perlin8(const float * gx, const float * gy, const float * gz, const glm::ivec3& origin, const glm::ivec3& size, const Vec8& p)
+	{
+		__m256 cx = _mm256_floor_ps(p.x);
+		__m256 cy = _mm256_floor_ps(p.y);
+		__m256 cz = _mm256_floor_ps(p.z);
+
+		__m256i lx = _mm256_sub_epi32(_mm256_cvtps_epi32(cx), _mm256_set1_epi32(origin.x));
+		__m256i ly = _mm256_sub_epi32(_mm256_cvtps_epi32(cy), _mm256_set1_epi32(origin.y));
+		__m256i lz = _mm256_sub_epi32(_mm256_cvtps_epi32(cz), _mm256_set1_epi32(origin.z));
+		__m256i base = _mm256_add_epi32(_mm256_mullo_epi32(_mm256_add_epi32(_mm256_mullo_epi32(lz, _mm256_set1_epi32(size.y)), ly), _mm256_set1_epi32(size.x)), lx);
+
+		__m256 influences[8];
+
+		for (int corner = 0; corner < 8; ++corner)
+		{
+			int ox = corner & 1;
+			int oy = (corner >> 1) & 1;
+			int oz = corner >> 2;
+			__m256i index = _mm256_add_epi32(base, _mm256_set1_epi32((oz * size.y + oy) * size.x + ox));
+
+			__m256 dx = _mm256_sub_ps(p.x, _mm256_add_ps(cx, _mm256_set1_ps(static_cast<float>(ox))));
+			__m256 dy = _mm256_sub_ps(p.y, _mm256_add_ps(cy, _mm256_set1_ps(static_cast<float>(oy))));
+			__m256 dz = _mm256_sub_ps(p.z, _mm256_add_ps(cz, _mm256_set1_ps(static_cast<float>(oz))));
+
+			influences[corner] = Dot(dx, dy, dz, _mm256_i32gather_ps(gx, index, 4), _mm256_i32gather_ps(gy, index, 4), _mm256_i32gather_ps(gz, index, 4));
+		}
+
+		__m256 fX = Fade(_mm256_sub_ps(p.x, cx));
+		__m256 fY = Fade(_mm256_sub_ps(p.y, cy));
+		__m256 fZ = Fade(_mm256_sub_ps(p.z, cz));
+
+		__m256 m1 = Mix(Mix(influences[0], influences[1], fX), Mix(influences[2], influences[3], fX), fY);
+		__m256 m2 = Mix(Mix(influences[4], influences[5], fX), Mix(influences[6], influences[7], fX), fY);
+		return _mm256_add_ps(_mm256_mul_ps(Mix(m1, m2, fZ), _mm256_set1_ps(0.707213578f)), _mm256_set1_ps(.5f));
+	}
+}
+#endif
+
+void NoiseBaker::BakeRow(int y, int z, float * row) const
+{
+	int x = 0;
+
+#ifdef __AVX2__
+	const NoiseParameters& np = parameters;
+	__m256 lanes = _mm256_setr_ps(0.f, 1.f, 2.f, 3.f, 4.f, 5.f, 6.f, 7.f);
+	__m256 nY = _mm256_set1_ps((static_cast<float>(y) / resolution) * 2.f - 1.f);
+	__m256 nZ = _mm256_set1_ps((static_cast<float>(z) / resolution) * 2.f - 1.f);
+
+	auto perlin = [&](int lattice, const Vec8& p) {
+		const Lattice& l = gradients[lattice];
+		return Perlin8(l.x.data(), l.y.data(), l.z.data(), l.origin, l.size, p);
+	};
+
+	for (; x + 8 <= resolution; x += 8)
+	{
+		__m256 nx = _mm256_sub_ps(_mm256_mul_ps(_mm256_div_ps(_mm256_add_ps(_mm256_set1_ps(static_cast<float>(x)), lanes), _mm256_set1_ps(static_cast<float>(resolution))), _mm256_set1_ps(2.f)), _mm256_set1_ps(1.f));
+		Vec8 nPos = { nx, nY, nZ };
+
+		Vec8 p = { _mm256_mul_ps(nPos.x, _mm256_set1_ps(np.curlFrequency)), _mm256_mul_ps(nPos.y, _mm256_set1_ps(np.curlFrequency)), _mm256_mul_ps(nPos.z, _mm256_set1_ps(np.curlFrequency)) };
+		p = Add(p, np.curlOffset);
+
+		float e = np.curlEpsilon;
+		glm::vec3 ex(e, 0.f, 0.f);
+		glm::vec3 ey(0.f, e, 0.f);
+		glm::vec3 ez(0.f, 0.f, e);
+
+		__m256 dN1dy = _mm256_sub_ps(perlin(0, Add(p, ey)), perlin(0, Sub(p, ey)));
+		__m256 dN1dz = _mm256_sub_ps(perlin(0, Add(p, ez)), perlin(0, Sub(p, ez)));
+
+		__m256 dN2dx = _mm256_sub_ps(perlin(1, Add(Add(p, ex), CURL_OFFSETS[1])), perlin(1, Add(Sub(p, ex), CURL_OFFSETS[1])));
+		__m256 dN2dz = _mm256_sub_ps(perlin(1, Add(Add(p, ez), CURL_OFFSETS[1])), perlin(1, Add(Sub(p, ez), CURL_OFFSETS[1])));
+
+		__m256 dN3dx = _mm256_sub_ps(perlin(2, Add(Add(p, ex), CURL_OFFSETS[2])), perlin(2, Add(Sub(p, ex), CURL_OFFSETS[2])));
+		__m256 dN3dy = _mm256_sub_ps(perlin(2, Add(Add(p, ey), CURL_OFFSETS[2])), perlin(2, Add(Sub(p, ey), CURL_OFFSETS[2])));
+
+		__m256 epsilon = _mm256_set1_ps(e);
+		__m256 curlX = _mm256_div_ps(_mm256_sub_ps(dN3dy, dN2dz), epsilon);
+		__m256 curlY = _mm256_div_ps(_mm256_sub_ps(dN1dz, dN3dx), epsilon);
+		__m256 curlZ = _mm256_div_ps(_mm256_sub_ps(dN2dx, dN1dy), epsilon);
+
+		// worley3D over the 27 cells around the truncated position
+		Vec8 w = { _mm256_mul_ps(nPos.x, _mm256_set1_ps(np.worleyFrequency)), _mm256_mul_ps(nPos.y, _mm256_set1_ps(np.worleyFrequency)), _mm256_mul_ps(nPos.z, _mm256_set1_ps(np.worleyFrequency)) };
+		w = Add(w, np.worleyOffset);
+
+		__m256i lx = _mm256_sub_epi32(_mm256_cvttps_epi32(w.x), _mm256_set1_epi32(featurePoints.origin.x));
+		__m256i ly = _mm256_sub_epi32(_mm256_cvttps_epi32(w.y), _mm256_set1_epi32(featurePoints.origin.y));
+		__m256i lz = _mm256_sub_epi32(_mm256_cvttps_epi32(w.z), _mm256_set1_epi32(featurePoints.origin.z));
+		__m256i base = _mm256_add_epi32(_mm256_mullo_epi32(_mm256_add_epi32(_mm256_mullo_epi32(lz, _mm256_set1_epi32(featurePoints.size.y)), ly), _mm256_set1_epi32(featurePoints.size.x)), lx);
+		__m256 nearest = _mm256_set1_ps(100000.f * 100000.f);
+
+		for (int k = -1; k <= 1; ++k)
+			for (int j = -1; j <= 1; ++j)
+				for (int i = -1; i <= 1; ++i)
+				{
+					__m256i index = _mm256_add_epi32(base, _mm256_set1_epi32((k * featurePoints.size.y + j) * featurePoints.size.x + i));
+					__m256 dx = _mm256_sub_ps(_mm256_i32gather_ps(featurePoints.x.data(), index, 4), w.x);
+					__m256 dy = _mm256_sub_ps(_mm256_i32gather_ps(featurePoints.y.data(), index, 4), w.y);
+					__m256 dz = _mm256_sub_ps(_mm256_i32gather_ps(featurePoints.z.data(), index, 4), w.z);
+					nearest = _mm256_min_ps(nearest, Dot(dx, dy, dz, dx, dy, dz));
+				}
+
+		__m256 worley = _mm256_sqrt_ps(nearest);
+		__m256 t = _mm256_div_ps(_mm256_sub_ps(worley, _mm256_set1_ps(np.worleyInner)), _mm256_set1_ps(np.worleyOuter - np.worleyInner));
+		t = _mm256_min_ps(_mm256_max_ps(t, _mm256_setzero_ps()), _mm256_set1_ps(1.f));
+		__m256 step = _mm256_mul_ps(_mm256_mul_ps(t, t), _mm256_sub_ps(_mm256_set1_ps(3.f), _mm256_mul_ps(_mm256_set1_ps(2.f), t)));
+		__m256 curlW = _mm256_sub_ps(_mm256_set1_ps(1.f), step);
+
+		// 8 texels of 4 channels: transpose 4x8 into 8 vec4
+		alignas(32) float channels[4][8];
+		_mm256_store_ps(channels[0], curlX);
+		_mm256_store_ps(channels[1], curlY);
+		_mm256_store_ps(channels[2], curlZ);
+		_mm256_store_ps(channels[3], curlW);
+
+		for (int lane = 0; lane < 8; ++lane)
+			for (int c = 0; c < 4; ++c)
+				row[(x + lane) * 4 + c] = channels[c][lane];
+	}
+#endif
+
+	for (; x < resolution; ++x)
+	{
+		glm::vec4 texel = Texel(glm::ivec3(x, y, z));
+		row[x * 4 + 0] = texel.x;
+		row[x * 4 + 1] = texel.y;
+		row[x * 4 + 2] = texel.z;
+		row[x * 4 + 3] = texel.w;
+	}
+}
+
+void NoiseBaker::Bake(float * texels) const
+{
+	Parallel::For(resolution * resolution, [&](int row) {
+		int y = row % resolution;
+		int z = row / resolution;
+		BakeRow(y, z, texels + static_cast<size_t>(row) * resolution * 4);
+	});
+}
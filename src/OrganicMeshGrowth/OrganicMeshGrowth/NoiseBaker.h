@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+// Bump this whenever the baked noise changes for the same parameters, it is part of the cache key
+#define NOISE_BAKER_VERSION 1
+
+// Everything that changes the vector field, with the values generator.comp always used. Only floats, so the
+// struct can be hashed as is for the cache key.
+struct NoiseParameters
+{
+	// xyz: curl3D(p * curlFrequency + curlOffset, curlEpsilon)
+	float curlFrequency = 2.f;
+	glm::vec3 curlOffset = glm::vec3(10.123f, 10.64f, 15.f);
+	float curlEpsilon = .01f;
+
+	// w: 1 - smoothstep(worleyInner, worleyOuter, worley3D(p * worleyFrequency + worleyOffset))
+	float worleyFrequency = 5.f;
+	glm::vec3 worleyOffset = glm::vec3(10.f);
+	float worleyInner = .075f;
+	float worleyOuter = .5f;
+};
+
+// CPU version of the vector field pass in generator.comp. The shader hashes eight lattice corners with sin for every
+// Perlin evaluation, twelve evaluations per texel for the curl, plus 27 Worley cells. Here the gradients and feature
+// points of every lattice cell the volume can reach are hashed once into tables, and texels only look them up,
+// 8 along x at a time when built with AVX2.
+class NoiseBaker
+{
+public:
+	// The tables cover the positions of a resolution^3 volume, sampled like the generator
+	NoiseBaker(const NoiseParameters& parameters, int resolution);
+
+	// resolution^3 RGBA floats, x fastest: curl in xyz and Worley in w
+	void Bake(float * texels) const;
+
+	// One texel, scalar. Bake writes the same values.
+	glm::vec4 Texel(const glm::ivec3& coord) const;
+
+	// Key for VolumeCache, independent of the mesh and generator shader
+	static uint64_t ComputeKey(const NoiseParameters& parameters);
+
+	// The hashes of generator.comp, what the tables are filled with
+	static glm::vec3 Gradient(const glm::vec3& corner);
+	static glm::vec3 FeaturePoint(const glm::vec3& cell);
+
+	// Whether this file was built with AVX2, which the CPU must then have, see Parallel::HasAVX2
+	static bool UsesAVX2();
+
+private:
+	// One attribute per array, so 8 corners can be gathered into one register
+	struct Lattice
+	{
+		glm::ivec3 origin;
+		glm::ivec3 size;
+		std::vector<float> x, y, z;
+
+		int Index(const glm::ivec3& cell) const;
+	};
+
+	// Covers every corner Perlin samples between lowest and highest
+	static void BuildGradients(const glm::vec3& lowest, const glm::vec3& highest, Lattice& lattice);
+
+	float Perlin(const Lattice& lattice, const glm::vec3& p) const;
+	float Worley(const glm::vec3& p) const;
+
+	void BakeRow(int y, int z, float * row) const;
+
+	NoiseParameters parameters;
+	int resolution;
+
+	// N1, N2 and N3 of the curl, each at its own offset
+	Lattice gradients[3];
+	Lattice featurePoints;
+};
@@ -0,0 +1,438 @@
+#include "ObjParser.h"
+#include "MappedFile.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+
+#define TINYOBJLOADER_IMPLEMENTATION
+#include "tiny_obj_loader.h"
+
+// Chunks smaller than this are not worth a thread
+#define OBJ_MIN_CHUNK_SIZE (256 * 1024)
+#define OBJ_CHUNKS_PER_THREAD 4
+
+namespace {
+	struct RelativeIndex
+	{
+		int slot;		// Where in the chunk index array this index is
+		int vertexCount; // How many vertices the chunk had parsed when the face was found
+	};
+
+	struct ObjChunk
+	{
+		const char * begin;
+		const char * end;
+
+		std::vector<glm::vec3> positions;
+		std::vector<int> indices;
+		std::vector<RelativeIndex> relativeIndices;
+
+		// Set when the chunk contains something only tinyobj knows how to deal with
+		bool unsupported;
+	};
+
+	const double powersOfTen[] = {
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+
+	inline bool IsDigit(char c)
+	{
+		return c >= '0' && c <= '9';
+	}
+
+	inline bool IsBlank(char c)
+	{
+		return c == ' ' || c == '\t' || c == '\r';
+	}
+
+	inline void SkipBlanks(const char *& p, const char * end)
+	{
+		while (p < end && IsBlank(*p))
+			p++;
+	}
+
+	// Parses [+-]digits[.digits][(e|E)[+-]digits]. The mantissa is accumulated as an integer, and below 2^53 with an
+	// exponent within 22 one double multiplication or division rounds it correctly. Rounding that double to float again
+	// only goes wrong when it lands exactly halfway between two floats, so those, subnormals and everything else go to
+	// strtof.
+	bool ParseFloat(const char *& p, const char * end, float & value)
+	{
+		const char * s = p;
+		bool negative = false;
+
+		if (s < end && (*s == '-' || *s == '+'))
+			negative = *s++ == '-';
+
+		uint64_t mantissa = 0;
+		int exponent = 0;
+		int significantDigits = 0;
+		bool anyDigit = false;
+
+		while (s < end && IsDigit(*s))
+		{
+			if (significantDigits < 19)
+			{
+				mantissa = mantissa * 10 + (*s - '0');
+				significantDigits += mantissa != 0;
+			}
+			else
+				exponent++;
+
+			anyDigit = true;
+			s++;
+		}
+
+		if (s < end && *s == '.')
+		{
+			s++;
+
+			while (s < end && IsDigit(*s))
+			{
+				if (significantDigits < 19)
+				{
+					mantissa = mantissa * 10 + (*s - '0');
+					significantDigits += mantissa != 0;
+					exponent--;
+				}
+
+				anyDigit = true;
+				s++;
+			}
+		}
+
+		if (!anyDigit)
+			return false;
+
+		if (s < end && (*s == 'e' || *s == 'E'))
+		{
+			s++;
+			bool negativeExponent = false;
+
+			if (s < end && (*s == '-' || *s == '+'))
+				negativeExponent = *s++ == '-';
+
+			if (s >= end || !IsDigit(*s))
+				return false;
+
+			int e = 0;
+			while (s < end && IsDigit(*s))
+			{
+				if (e < 10000)
+					e = e * 10 + (*s - '0');
+				s++;
+			}
+
+			exponent += negativeExponent ? -e : e;
+		}
+
+		// Things like "1.0f", "nan" or "inf" end up here
+		if (s < end && !IsBlank(*s) && *s != '\n')
+			return false;
+
+		if (mantissa < (uint64_t(1) << 53) && exponent >= -22 && exponent <= 22)
+		{
+			double v = static_cast<double>(mantissa);
+
+			if (exponent >= 0)
+				v *= powersOfTen[exponent];
+			else
+				v /= powersOfTen[-exponent];
+
+			// The 29 bits float drops are exactly one half
+			uint64_t bits;
+			std::memcpy(&bits, &v, sizeof(bits));
+			bool halfway = (bits & 0x1fffffff) == 0x10000000;
+
+			if (!halfway && (v == 0.0 || (v >= std::numeric_limits<float>::min() && v <= std::numeric_limits<float>::max())))
+			{
+				value = static_cast<float>(negative ? -v : v);
+				p = s;
+				return true;
+			}
+		}
+
+		// The token isn't null terminated in the mapped file
+		std::string token(p, s);
+		value = std::strtof(token.c_str(), nullptr);
+		p = s;
+		return true;
+	}
+
+	// Parses the vertex index of a face token (v, v/vt, v//vn or v/vt/vn), skipping the rest of it
+	bool ParseFaceIndex(const char *& p, const char * end, int & value)
+	{
+		const char * s = p;
+		bool negative = false;
+
+		if (s < end && (*s == '-' || *s == '+'))
+			negative = *s++ == '-';
+
+		if (s >= end || !IsDigit(*s))
+			return false;
+
+		long long v = 0;
+		while (s < end && IsDigit(*s))
+		{
+			v = v * 10 + (*s - '0');
+
+			if (v > std::numeric_limits<int>::max())
+				return false;
+
+			s++;
+		}
+
+		// Zero is not a valid obj index
+		if (v == 0)
+			return false;
+
+		while (s < end && !IsBlank(*s) && *s != '\n')
+			s++;
+
+		value = static_cast<int>(negative ? -v : v);
+		p = s;
+		return true;
+	}
+
+	void ParseChunk(ObjChunk & chunk)
+	{
+		const char * p = chunk.begin;
+		const char * end = chunk.end;
+
+		// Rough guess of the amount of records in this chunk, to avoid most reallocations
+		size_t expectedRecords = static_cast<size_t>(end - p) / 48;
+		chunk.positions.reserve(expectedRecords / 2);
+		chunk.indices.reserve(expectedRecords * 3);
+
+		std::vector<int> face;
+		face.reserve(16);
+
+		while (p < end)
+		{
+			SkipBlanks(p, end);
+
+			const char * lineEnd = static_cast<const char*>(memchr(p, '\n', end - p));
+
+			if (lineEnd == nullptr)
+				lineEnd = end;
+
+			if (lineEnd - p > 1 && (p[1] == ' ' || p[1] == '\t'))
+			{
+				if (p[0] == 'v')
+				{
+					const char * q = p + 2;
+					glm::vec3 v;
+
+					for (int i = 0; i < 3; ++i)
+					{
+						SkipBlanks(q, lineEnd);
+
+						if (!ParseFloat(q, lineEnd, v[i]))
+						{
+							chunk.unsupported = true;
+							return;
+						}
+					}
+
+					// Anything after xyz (w, vertex colors) is ignored, as tinyobj does
+					chunk.positions.push_back(v);
+				}
+				else if (p[0] == 'f')
+				{
+					const char * q = p + 2;
+					face.clear();
+
+					while (true)
+					{
+						SkipBlanks(q, lineEnd);
+
+						if (q >= lineEnd)
+							break;
+
+						int index;
+						if (!ParseFaceIndex(q, lineEnd, index))
+						{
+							chunk.unsupported = true;
+							return;
+						}
+
+						face.push_back(index);
+					}
+
+					// Polygon -> triangle fan conversion
+					for (size_t k = 2; k < face.size(); ++k)
+					{
+						int triangle[3] = { face[0], face[k - 1], face[k] };
+
+						for (int i = 0; i < 3; ++i)
+						{
+							if (triangle[i] > 0)
+							{
+								chunk.indices.push_back(triangle[i] - 1);
+							}
+							else
+							{
+								// Relative to the vertices parsed so far, resolved when all chunks are merged
+								RelativeIndex relative;
+								relative.slot = static_cast<int>(chunk.indices.size());
+								relative.vertexCount = static_cast<int>(chunk.positions.size());
+								chunk.relativeIndices.push_back(relative);
+								chunk.indices.push_back(triangle[i]);
+							}
+						}
+					}
+				}
+			}
+
+			p = lineEnd + 1;
+		}
+	}
+}
+
+bool ObjParser::Load(const std::string& filename, ObjData& data, std::string& error)
+{
+	MappedFile file;
+
+	if (!file.Open(filename))
+	{
+		error = "Cannot open file " + filename;
+		return false;
+	}
+
+	const char * fileData = file.GetData();
+	size_t fileSize = file.GetSize();
+
+	// Split the file in line aligned chunks
+	size_t chunkCount = Parallel::GetThreadCount() * OBJ_CHUNKS_PER_THREAD;
+	size_t chunkSize = std::max(fileSize / chunkCount, static_cast<size_t>(OBJ_MIN_CHUNK_SIZE));
+
+	std::vector<ObjChunk> chunks;
+	const char * fileEnd = fileData + fileSize;
+	const char * chunkBegin = fileData;
+
+	while (chunkBegin < fileEnd)
+	{
+		const char * chunkEnd = chunkBegin + std::min(chunkSize, static_cast<size_t>(fileEnd - chunkBegin));
+
+		if (chunkEnd < fileEnd)
+		{
+			const char * newline = static_cast<const char*>(memchr(chunkEnd, '\n', fileEnd - chunkEnd));
+			chunkEnd = newline != nullptr ? newline + 1 : fileEnd;
+		}
+
+		ObjChunk chunk;
+		chunk.begin = chunkBegin;
+		chunk.end = chunkEnd;
+		chunk.unsupported = false;
+		chunks.push_back(chunk);
+
+		chunkBegin = chunkEnd;
+	}
+
+	Parallel::For(static_cast<int>(chunks.size()), [&](int i) {
+		ParseChunk(chunks[i]);
+	});
+
+	for (const ObjChunk& chunk : chunks)
+	{
+		if (chunk.unsupported)
+		{
+			file.Close();
+			return LoadWithTinyObj(filename, data, error);
+		}
+	}
+
+	// Where each chunk goes in the flat arrays
+	std::vector<size_t> vertexOffsets(chunks.size() + 1, 0);
+	std::vector<size_t> indexOffsets(chunks.size() + 1, 0);
+
+	for (size_t i = 0; i < chunks.size(); ++i)
+	{
+		vertexOffsets[i + 1] = vertexOffsets[i] + chunks[i].positions.size();
+		indexOffsets[i + 1] = indexOffsets[i] + chunks[i].indices.size();
+	}
+
+	size_t vertexCount = vertexOffsets.back();
+	data.positions.resize(vertexCount);
+	data.indices.resize(indexOffsets.back());
+
+	std::atomic<bool> invalidIndex(false);
+
+	Parallel::For(static_cast<int>(chunks.size()), [&](int i) {
+		ObjChunk & chunk = chunks[i];
+
+		for (const RelativeIndex& relative : chunk.relativeIndices)
+			chunk.indices[relative.slot] += static_cast<int>(vertexOffsets[i]) + relative.vertexCount;
+
+		for (int index : chunk.indices)
+		{
+			if (index < 0 || static_cast<size_t>(index) >= vertexCount)
+			{
+				invalidIndex = true;
+				break;
+			}
+		}
+
+		if (!chunk.positions.empty())
+			memcpy(&data.positions[vertexOffsets[i]], chunk.positions.data(), chunk.positions.size() * sizeof(glm::vec3));
+
+		if (!chunk.indices.empty())
+			memcpy(&data.indices[indexOffsets[i]], chunk.indices.data(), chunk.indices.size() * sizeof(int));
+
+		// Release chunk memory as soon as possible
+		std::vector<glm::vec3>().swap(chunk.positions);
+		std::vector<int>().swap(chunk.indices);
+	});
+
+	if (invalidIndex)
+	{
+		error = "Face references a vertex that does not exist in " + filename;
+		return false;
+	}
+
+	return true;
+}
+
+bool ObjParser::LoadWithTinyObj(const std::string& filename, ObjData& data, std::string& error)
+{
+	tinyobj::attrib_t attrib;
+	std::vector<tinyobj::shape_t> shapes;
+	std::vector<tinyobj::material_t> materials;
+
+	if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &error, filename.c_str()))
+		return false;
+
+	data.positions.resize(attrib.vertices.size() / 3);
+
+	for (size_t i = 0; i < data.positions.size(); ++i)
+		data.positions[i] = glm::vec3(attrib.vertices[i * 3 + 0], attrib.vertices[i * 3 + 1], attrib.vertices[i * 3 + 2]);
+
+	data.indices.clear();
+
+	for (size_t m = 0; m < shapes.size(); ++m)
+	{
+		size_t indexOffset = 0;
+
+		for (size_t f = 0; f < shapes[m].mesh.num_face_vertices.size(); ++f)
+		{
+			int faceVertices = shapes[m].mesh.num_face_vertices[f];
+
+			// Faces are already triangulated by tinyobj; anything else is ignored
+			if (faceVertices == 3)
+			{
+				data.indices.push_back(shapes[m].mesh.indices[indexOffset + 0].vertex_index);
+				data.indices.push_back(shapes[m].mesh.indices[indexOffset + 1].vertex_index);
+				data.indices.push_back(shapes[m].mesh.indices[indexOffset + 2].vertex_index);
+			}
+
+			indexOffset += faceVertices;
+		}
+	}
+
+	return true;
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+
+// Flat triangle soup read from an .obj file. Polygons are fan triangulated, the same way tinyobj does it.
+struct ObjData
+{
+	std::vector<glm::vec3> positions;
+	std::vector<int> indices; // Three zero-based position indices per triangle
+};
+
+namespace ObjParser {
+	// Memory maps the file, splits it into line aligned chunks and parses v/f records on all cores.
+	// Files with syntax the fast path does not understand (inf/nan, incomplete vertices...) go through tinyobj.
+	bool Load(const std::string& filename, ObjData& data, std::string& error);
+
+	// Single threaded tinyobj path, used as fallback and as benchmark reference
+	bool LoadWithTinyObj(const std::string& filename, ObjData& data, std::string& error);
+}
@@ -0,0 +1,94 @@
+#include "Parallel.h"
+#include "TaskScheduler.h"
+#include <atomic>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <cpuid.h>
+#endif
+
+unsigned int Parallel::GetThreadCount()
+{
+	return TaskScheduler::Get().GetThreadCount();
+}
+
+bool Parallel::HasAVX2()
+{
+	unsigned int leaf1[4] = {};
+	unsigned int leaf7[4] = {};
+	unsigned long long xcr0 = 0;
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+	int info[4];
+	__cpuid(info, 0);
+
+	if (info[0] < 7)
+		return false;
+
+	__cpuid(info, 1);
+	for (int i = 0; i < 4; ++i)
+		leaf1[i] = static_cast<unsigned int>(info[i]);
+
+	__cpuidex(info, 7, 0);
+	for (int i = 0; i < 4; ++i)
+		leaf7[i] = static_cast<unsigned int>(info[i]);
+
+	if (leaf1[2] & (1u << 27))
+		xcr0 = _xgetbv(0);
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+	if (__get_cpuid_max(0, nullptr) < 7)
+		return false;
+
+	__get_cpuid(1, &leaf1[0], &leaf1[1], &leaf1[2], &leaf1[3]);
+	__get_cpuid_count(7, 0, &leaf7[0], &leaf7[1], &leaf7[2], &leaf7[3]);
+
+	if (leaf1[2] & (1u << 27)) {
+		unsigned int low, high;
+		__asm__("xgetbv" : "=a"(low), "=d"(high) : "c"(0));
+		xcr0 = (static_cast<unsigned long long>(high) << 32) | low;
+	}
+#else
+	return false;
+#endif
+
+	// FMA and AVX in leaf 1, AVX2 in leaf 7, and the OS saving the ymm registers (XCR0 bits 1 and 2)
+	bool fma = (leaf1[2] & (1u << 12)) != 0;
+	bool avx = (leaf1[2] & (1u << 28)) != 0;
+	bool avx2 = (leaf7[1] & (1u << 5)) != 0;
+	return fma && avx && avx2 && (xcr0 & 6) == 6;
+}
+
+void Parallel::For(int count, const std::function<void(int)>& body)
+{
+	if (count <= 0)
+		return;
+
+	int threadCount = static_cast<int>(GetThreadCount());
+
+	if (threadCount > count)
+		threadCount = count;
+
+	if (threadCount <= 1)
+	{
+		for (int i = 0; i < count; ++i)
+			body(i);
+
+		return;
+	}
+
+	std::atomic<int> next(0);
+
+	auto worker = [&]() {
+		for (int i = next++; i < count; i = next++)
+			body(i);
+	};
+
+	TaskGroup group;
+
+	for (int t = 0; t < threadCount - 1; ++t)
+		group.Run(worker);
+
+	worker();
+	group.Wait();
+}
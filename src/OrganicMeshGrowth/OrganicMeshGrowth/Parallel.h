@@ -0,0 +1,15 @@
+#pragma once
+
+#include <functional>
+
+namespace Parallel {
+	unsigned int GetThreadCount();
+
+	// Whether the CPU and OS run AVX2 and FMA code, which the x64 builds of SdfBaker.cpp, NoiseBaker.cpp and
+	// GrowthSimulator.cpp need. Lives here because this file is built without them.
+	bool HasAVX2();
+
+	// Runs body(i) for every i in [0, count), handing out iterations dynamically to the TaskScheduler threads.
+	// The calling thread participates, and the call returns when every iteration finished.
+	void For(int count, const std::function<void(int)>& body);
+}
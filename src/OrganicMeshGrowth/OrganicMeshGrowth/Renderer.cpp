@@ -5,15 +5,169 @@
 #include "Camera.h"
 #include "Image.h"
 #include "Texture3D.h"
+#include "MeshQuery.h"
+#include "SdfBaker.h"
+#include "BufferUtils.h"
+#include "FileUtils.h"
+#include "MappedFile.h"
+#include "VolumeCache.h"
+#include "GrowthSimulator.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <iostream>
 
 static constexpr unsigned int WORKGROUP_SIZE = 32;
+static constexpr unsigned int GENERATOR_WORKGROUP_SIZE = 8; // WORKGROUP_SIZE in generator.comp
+
+static_assert(GENERATOR_COARSE_RESOLUTION == 0 || (GENERATOR_COARSE_RESOLUTION < SCENE_SDF_RESOLUTION && (GENERATOR_COARSE_RESOLUTION & (GENERATOR_COARSE_RESOLUTION - 1)) == 0),
+	"GENERATOR_COARSE_RESOLUTION must be a power of two below SCENE_SDF_RESOLUTION");
+
+// With GENERATOR_COARSE_RESOLUTION the coarse tiles run first, covering its resolution + 1 samples per axis
+static constexpr int GENERATOR_COARSE_TILES_PER_AXIS = GENERATOR_COARSE_RESOLUTION > 0 ? GENERATOR_COARSE_RESOLUTION / GENERATOR_TILE_SIZE + 1 : 0;
+static constexpr int GENERATOR_COARSE_TILE_COUNT = GENERATOR_COARSE_TILES_PER_AXIS * GENERATOR_COARSE_TILES_PER_AXIS * GENERATOR_COARSE_TILES_PER_AXIS;
+
+static constexpr unsigned int KERNEL_WORKGROUP_SIZE = 8; // WORKGROUP_SIZE in kernel.comp, the brick size
+static constexpr unsigned int KERNEL_BRICKS_PER_AXIS = SCENE_SDF_RESOLUTION / KERNEL_WORKGROUP_SIZE;
+static constexpr unsigned int KERNEL_BRICK_COUNT = KERNEL_BRICKS_PER_AXIS * KERNEL_BRICKS_PER_AXIS * KERNEL_BRICKS_PER_AXIS;
+static constexpr unsigned int BRICKS_WORKGROUP_SIZE = 64; // WORKGROUP_SIZE in bricks.comp
+static_assert(KERNEL_BRICKS_PER_AXIS == 32 && KERNEL_BRICK_COUNT % BRICKS_WORKGROUP_SIZE == 0, "BRICKS_PER_AXIS is 32 in bricks.comp, which runs one invocation per brick");
+
+// Start of the buffer behind ActiveBricks in kernel.comp and bricks.comp: the indirect dispatches of the kernel and
+// relaxation.comp, then the band, updated, list and halo list arrays of KERNEL_BRICK_COUNT uints each
+struct ActiveBricksHeader {
+	VkDispatchIndirectCommand dispatch;
+	uint32_t padding;
+	VkDispatchIndirectCommand haloDispatch;
+	uint32_t haloPadding;
+};
+
+// The std430 block is declared again in bricks.comp, kernel.comp, derivatives.comp and relaxation.comp as brickCount,
+// dispatchY, dispatchZ, padding, haloCount, haloDispatchY, haloDispatchZ, haloPadding, then the arrays
+static_assert(offsetof(ActiveBricksHeader, dispatch) == 0, "ActiveBricksHeader::dispatch must be brickCount in the shaders");
+static_assert(offsetof(ActiveBricksHeader, haloDispatch) == 16, "ActiveBricksHeader::haloDispatch must be haloCount in the shaders");
+static_assert(sizeof(ActiveBricksHeader) == 32, "The shader arrays start after 8 uints");
+
+static constexpr VkDeviceSize ACTIVE_BRICKS_BUFFER_SIZE = sizeof(ActiveBricksHeader) + 4 * KERNEL_BRICK_COUNT * sizeof(uint32_t);
+
+// Whether the kernel adds up the relaxation.comp sums instead of looping over the box, GrowthSimulator::UsesSeparableRelaxation
+static bool UsesSeparableRelaxation(const GrowthBehaviour& behaviour)
+{
+	return KERNEL_SEPARABLE_RELAXATION && behaviour.relaxationRadius > 1;
+}
+
+// The specialization constants of kernel.comp, one 4 byte field per constant_id in order
+struct KernelSpecialization {
+	VkBool32 sparseBricks;
+	float relaxation;
+	int32_t curvatureOffset;
+
+	VkBool32 gravityTerm;
+	float gravityStrength;
+	VkBool32 gravityCurvatureWeighted;
+	float gravityMin;
+	float gravityMax;
+
+	VkBool32 curvatureTerm;
+	float curvatureStrength;
+	float curvatureMin;
+	float curvatureMax;
+
+	VkBool32 repulsionTerm;
+	float repulsionStrength;
+	float repulsionDelta;
+	float repulsionMin;
+	float repulsionMax;
+
+	VkBool32 noiseTerm;
+	float noiseStrength;
+	VkBool32 noiseFade;
+	float noiseFadeStart;
+	float noiseFadeEnd;
+
+	VkBool32 curlTerm;
+	float curlStrength;
+
+	VkBool32 planarTerm;
+	float planarStrength;
+	glm::vec3 planarDirection;
+	float planarMin;
+	float planarMax;
+	float planarNoiseFadeStart;
+	float planarNoiseFadeEnd;
+
+	float activeBandMin;
+	float activeBandMax;
+
+	VkBool32 derivativeField;
+
+	int32_t relaxationRadius;
+	VkBool32 separableRelaxation;
+};
+
+static constexpr uint32_t KERNEL_SPECIALIZATION_CONSTANT_COUNT = 38;
+static_assert(sizeof(KernelSpecialization) == KERNEL_SPECIALIZATION_CONSTANT_COUNT * 4, "KernelSpecialization must have one 4 byte field per constant");
+
+// Where each constant_id of kernel.comp is in KernelSpecialization, by field name, so a field out of place can't shift
+// every constant after it
+static constexpr size_t KERNEL_SPECIALIZATION_OFFSETS[] = {
+	offsetof(KernelSpecialization, sparseBricks),             // 0 SPARSE_BRICKS
+	offsetof(KernelSpecialization, relaxation),               // 1 RELAXATION
+	offsetof(KernelSpecialization, curvatureOffset),          // 2 CURVATURE_OFFSET
+	offsetof(KernelSpecialization, gravityTerm),              // 3 GRAVITY_TERM
+	offsetof(KernelSpecialization, gravityStrength),          // 4 GRAVITY_STRENGTH
+	offsetof(KernelSpecialization, gravityCurvatureWeighted), // 5 GRAVITY_CURVATURE_WEIGHTED
+	offsetof(KernelSpecialization, gravityMin),               // 6 GRAVITY_MIN
+	offsetof(KernelSpecialization, gravityMax),               // 7 GRAVITY_MAX
+	offsetof(KernelSpecialization, curvatureTerm),            // 8 CURVATURE_TERM
+	offsetof(KernelSpecialization, curvatureStrength),        // 9 CURVATURE_STRENGTH
+	offsetof(KernelSpecialization, curvatureMin),             // 10 CURVATURE_MIN
+	offsetof(KernelSpecialization, curvatureMax),             // 11 CURVATURE_MAX
+	offsetof(KernelSpecialization, repulsionTerm),            // 12 REPULSION_TERM
+	offsetof(KernelSpecialization, repulsionStrength),        // 13 REPULSION_STRENGTH
+	offsetof(KernelSpecialization, repulsionDelta),           // 14 REPULSION_DELTA
+	offsetof(KernelSpecialization, repulsionMin),             // 15 REPULSION_MIN
+	offsetof(KernelSpecialization, repulsionMax),             // 16 REPULSION_MAX
+	offsetof(KernelSpecialization, noiseTerm),                // 17 NOISE_TERM
+	offsetof(KernelSpecialization, noiseStrength),            // 18 NOISE_STRENGTH
+	offsetof(KernelSpecialization, noiseFade),                // 19 NOISE_FADE
+	offsetof(KernelSpecialization, noiseFadeStart),           // 20 NOISE_FADE_START
+	offsetof(KernelSpecialization, noiseFadeEnd),             // 21 NOISE_FADE_END
+	offsetof(KernelSpecialization, curlTerm),                 // 22 CURL_TERM
+	offsetof(KernelSpecialization, curlStrength),             // 23 CURL_STRENGTH
+	offsetof(KernelSpecialization, planarTerm),               // 24 PLANAR_TERM
+	offsetof(KernelSpecialization, planarStrength),           // 25 PLANAR_STRENGTH
+	offsetof(KernelSpecialization, planarDirection) + 0,      // 26 PLANAR_DIRECTION_X
+	offsetof(KernelSpecialization, planarDirection) + 4,      // 27 PLANAR_DIRECTION_Y
+	offsetof(KernelSpecialization, planarDirection) + 8,      // 28 PLANAR_DIRECTION_Z
+	offsetof(KernelSpecialization, planarMin),                // 29 PLANAR_MIN
+	offsetof(KernelSpecialization, planarMax),                // 30 PLANAR_MAX
+	offsetof(KernelSpecialization, planarNoiseFadeStart),     // 31 PLANAR_NOISE_FADE_START
+	offsetof(KernelSpecialization, planarNoiseFadeEnd),       // 32 PLANAR_NOISE_FADE_END
+	offsetof(KernelSpecialization, activeBandMin),            // 33 ACTIVE_BAND_MIN
+	offsetof(KernelSpecialization, activeBandMax),            // 34 ACTIVE_BAND_MAX
+	offsetof(KernelSpecialization, derivativeField),          // 35 DERIVATIVE_FIELD
+	offsetof(KernelSpecialization, relaxationRadius),         // 36 RELAXATION_RADIUS
+	offsetof(KernelSpecialization, separableRelaxation)       // 37 SEPARABLE_RELAXATION
+};
+
+static_assert(sizeof(KERNEL_SPECIALIZATION_OFFSETS) / sizeof(size_t) == KERNEL_SPECIALIZATION_CONSTANT_COUNT, "One offset per constant_id");
+
+// Push constants of every generator dispatch, GeneratorTile in generator.comp
+struct GeneratorTile {
+	glm::ivec4 tileOrigin;
+	int32_t coarsePass;
+};
 
 Renderer::Renderer(Device* device, SwapChain* swapChain, Scene* scene, Camera* camera)
   : device(device),
     logicalDevice(device->GetVkDevice()),
     swapChain(swapChain),
     scene(scene),
-    camera(camera) {
+    camera(camera),
+    growthBehaviour(GrowthBehaviour::FromPreset(GrowthPreset::Mushroom)) {
 
 	currentFrameIndex = 0;
 
@@ -25,6 +179,7 @@ Renderer::Renderer(Device* device, SwapChain* swapChain, Scene* scene, Camera* c
     CreateSceneSDFDescriptorSetLayout();
 	CreateVectorFieldDescriptorSetLayout();
 	CreateGeneratorDescriptorSetLayout();
+	CreateActiveBricksDescriptorSetLayout();
 
     CreateDescriptorPool();
     
@@ -35,16 +190,23 @@ Renderer::Renderer(Device* device, SwapChain* swapChain, Scene* scene, Camera* c
     CreateSceneSDFDescriptorSet();
 	CreateVectorFieldDescriptorSet();
 	CreateGeneratorDescriptorSet();
+	CreateActiveBricksBuffer();
+	CreateActiveBricksDescriptorSet();
+	CreateDerivativeFieldDescriptorSet();
+	CreateRelaxationSumsDescriptorSets();
     
 	CreateFrameResources();
     CreateRaymarchingPipeline();
     CreateKernelComputePipeline();
 	CreateGeneratorComputePipeline();
+	CreateBricksComputePipeline();
+	CreateDerivativesComputePipeline();
+	CreateRelaxationComputePipelines();
 
     RecordCommandBuffers(true);
 	RecordCommandBuffers(false);
     RecordKernelComputeCommandBuffer();
-	RecordGeneratorComputeCommandBuffer();
+	CreateGeneratorBatchResources();
 }
 
 void Renderer::CreateCommandPools() {
@@ -60,7 +222,7 @@ void Renderer::CreateCommandPools() {
     VkCommandPoolCreateInfo computePoolInfo = {};
     computePoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
     computePoolInfo.queueFamilyIndex = device->GetInstance()->GetQueueFamilyIndices()[QueueFlags::Compute];
-    computePoolInfo.flags = 0;
+    computePoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT; // Generator batches are recorded again for every submit
 
     if (vkCreateCommandPool(logicalDevice, &computePoolInfo, nullptr, &computeCommandPool) != VK_SUCCESS) {
         throw std::runtime_error("Failed to create command pool");
@@ -229,7 +391,57 @@ void Renderer::CreateGeneratorDescriptorSetLayout()
 	indexLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
 	indexLayoutBinding.pImmutableSamplers = nullptr;
 
-    std::vector<VkDescriptorSetLayoutBinding> bindings = { storageLayoutBinding, sizeLayoutBinding, indexLayoutBinding };
+	VkDescriptorSetLayoutBinding leafIndexLayoutBinding = {};
+	leafIndexLayoutBinding.binding = 3;
+	leafIndexLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	leafIndexLayoutBinding.descriptorCount = 1;
+	leafIndexLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	leafIndexLayoutBinding.pImmutableSamplers = nullptr;
+
+	VkDescriptorSetLayoutBinding vertexLayoutBinding = {};
+	vertexLayoutBinding.binding = 4;
+	vertexLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	vertexLayoutBinding.descriptorCount = 1;
+	vertexLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	vertexLayoutBinding.pImmutableSamplers = nullptr;
+
+	VkDescriptorSetLayoutBinding pairParentLayoutBinding = {};
+	pairParentLayoutBinding.binding = 5;
+	pairParentLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	pairParentLayoutBinding.descriptorCount = 1;
+	pairParentLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	pairParentLayoutBinding.pImmutableSamplers = nullptr;
+
+	VkDescriptorSetLayoutBinding traversalStatsLayoutBinding = {};
+	traversalStatsLayoutBinding.binding = 6;
+	traversalStatsLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	traversalStatsLayoutBinding.descriptorCount = 1;
+	traversalStatsLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	traversalStatsLayoutBinding.pImmutableSamplers = nullptr;
+
+	VkDescriptorSetLayoutBinding coarseSDFLayoutBinding = {};
+	coarseSDFLayoutBinding.binding = 7;
+	coarseSDFLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	coarseSDFLayoutBinding.descriptorCount = 1;
+	coarseSDFLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	coarseSDFLayoutBinding.pImmutableSamplers = nullptr;
+
+	VkDescriptorSetLayoutBinding closestTrianglesLayoutBinding = {};
+	closestTrianglesLayoutBinding.binding = 8;
+	closestTrianglesLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	closestTrianglesLayoutBinding.descriptorCount = 1;
+	closestTrianglesLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	closestTrianglesLayoutBinding.pImmutableSamplers = nullptr;
+
+	VkDescriptorSetLayoutBinding closestBarycentricsLayoutBinding = {};
+	closestBarycentricsLayoutBinding.binding = 9;
+	closestBarycentricsLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	closestBarycentricsLayoutBinding.descriptorCount = 1;
+	closestBarycentricsLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	closestBarycentricsLayoutBinding.pImmutableSamplers = nullptr;
+
+    std::vector<VkDescriptorSetLayoutBinding> bindings = { storageLayoutBinding, sizeLayoutBinding, indexLayoutBinding, leafIndexLayoutBinding, vertexLayoutBinding, pairParentLayoutBinding, traversalStatsLayoutBinding, coarseSDFLayoutBinding,
+		closestTrianglesLayoutBinding, closestBarycentricsLayoutBinding };
 
     // Create the descriptor set layout
     VkDescriptorSetLayoutCreateInfo layoutInfo = {};
@@ -308,6 +520,28 @@ void Renderer::CreateVectorFieldDescriptorSetLayout()
 	}
 }
 
+void Renderer::CreateActiveBricksDescriptorSetLayout()
+{
+	VkDescriptorSetLayoutBinding storageLayoutBinding = {};
+	storageLayoutBinding.binding = 0;
+	storageLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	storageLayoutBinding.descriptorCount = 1;
+	storageLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	storageLayoutBinding.pImmutableSamplers = nullptr;
+
+	std::vector<VkDescriptorSetLayoutBinding> bindings = { storageLayoutBinding };
+
+	// Create the descriptor set layout
+	VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+	layoutInfo.pBindings = bindings.data();
+
+	if (vkCreateDescriptorSetLayout(logicalDevice, &layoutInfo, nullptr, &activeBricksDescriptorSetLayout) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create active bricks descriptor set layout");
+	}
+}
+
 void Renderer::CreateDescriptorPool() {
 
     // Describe which descriptor types that the descriptor sets will contain
@@ -325,12 +559,12 @@ void Renderer::CreateDescriptorPool() {
         { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER , 3 },
 
 		// 3D Texture 
-		{ VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 9 },
+		{ VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 14 },
 
 		// Mesh attribute buffer
 		{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER , 1 },
 
-		{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2}
+		{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 8}
     };
 
     VkDescriptorPoolCreateInfo poolInfo = {};
@@ -365,7 +599,7 @@ void Renderer::CreateGeneratorDescriptorSet()
 	generatorBufferInfo.offset = 0;
 	generatorBufferInfo.range = scene->GetMeshBufferSize();
 
-	std::array<VkWriteDescriptorSet, 3> descriptorWrites = {};
+	std::array<VkWriteDescriptorSet, 10> descriptorWrites = {};
 	descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
 	descriptorWrites[0].dstSet = generatorDescriptorSet;
 	descriptorWrites[0].dstBinding = 0;
@@ -406,6 +640,112 @@ void Renderer::CreateGeneratorDescriptorSet()
 	descriptorWrites[2].pImageInfo = nullptr;
 	descriptorWrites[2].pTexelBufferView = nullptr;
 
+	VkDescriptorBufferInfo leafIndexBufferInfo = {};
+	leafIndexBufferInfo.buffer = scene->GetMeshLeafIndexBuffer();
+	leafIndexBufferInfo.offset = 0;
+	leafIndexBufferInfo.range = VK_WHOLE_SIZE;
+
+	descriptorWrites[3].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	descriptorWrites[3].dstSet = generatorDescriptorSet;
+	descriptorWrites[3].dstBinding = 3;
+	descriptorWrites[3].dstArrayElement = 0;
+	descriptorWrites[3].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	descriptorWrites[3].descriptorCount = 1;
+	descriptorWrites[3].pBufferInfo = &leafIndexBufferInfo;
+	descriptorWrites[3].pImageInfo = nullptr;
+	descriptorWrites[3].pTexelBufferView = nullptr;
+
+	VkDescriptorBufferInfo vertexBufferInfo = {};
+	vertexBufferInfo.buffer = scene->GetMeshVertexBuffer();
+	vertexBufferInfo.offset = 0;
+	vertexBufferInfo.range = VK_WHOLE_SIZE;
+
+	descriptorWrites[4].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	descriptorWrites[4].dstSet = generatorDescriptorSet;
+	descriptorWrites[4].dstBinding = 4;
+	descriptorWrites[4].dstArrayElement = 0;
+	descriptorWrites[4].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	descriptorWrites[4].descriptorCount = 1;
+	descriptorWrites[4].pBufferInfo = &vertexBufferInfo;
+	descriptorWrites[4].pImageInfo = nullptr;
+	descriptorWrites[4].pTexelBufferView = nullptr;
+
+	VkDescriptorBufferInfo pairParentBufferInfo = {};
+	pairParentBufferInfo.buffer = scene->GetMeshPairParentBuffer();
+	pairParentBufferInfo.offset = 0;
+	pairParentBufferInfo.range = VK_WHOLE_SIZE;
+
+	descriptorWrites[5].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	descriptorWrites[5].dstSet = generatorDescriptorSet;
+	descriptorWrites[5].dstBinding = 5;
+	descriptorWrites[5].dstArrayElement = 0;
+	descriptorWrites[5].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	descriptorWrites[5].descriptorCount = 1;
+	descriptorWrites[5].pBufferInfo = &pairParentBufferInfo;
+	descriptorWrites[5].pImageInfo = nullptr;
+	descriptorWrites[5].pTexelBufferView = nullptr;
+
+	VkDescriptorBufferInfo traversalStatsBufferInfo = {};
+	traversalStatsBufferInfo.buffer = scene->GetTraversalStatsBuffer();
+	traversalStatsBufferInfo.offset = 0;
+	traversalStatsBufferInfo.range = VK_WHOLE_SIZE;
+
+	descriptorWrites[6].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	descriptorWrites[6].dstSet = generatorDescriptorSet;
+	descriptorWrites[6].dstBinding = 6;
+	descriptorWrites[6].dstArrayElement = 0;
+	descriptorWrites[6].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	descriptorWrites[6].descriptorCount = 1;
+	descriptorWrites[6].pBufferInfo = &traversalStatsBufferInfo;
+	descriptorWrites[6].pImageInfo = nullptr;
+	descriptorWrites[6].pTexelBufferView = nullptr;
+
+	VkDescriptorBufferInfo coarseSDFBufferInfo = {};
+	coarseSDFBufferInfo.buffer = scene->GetCoarseSDFBuffer();
+	coarseSDFBufferInfo.offset = 0;
+	coarseSDFBufferInfo.range = VK_WHOLE_SIZE;
+
+	descriptorWrites[7].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	descriptorWrites[7].dstSet = generatorDescriptorSet;
+	descriptorWrites[7].dstBinding = 7;
+	descriptorWrites[7].dstArrayElement = 0;
+	descriptorWrites[7].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	descriptorWrites[7].descriptorCount = 1;
+	descriptorWrites[7].pBufferInfo = &coarseSDFBufferInfo;
+	descriptorWrites[7].pImageInfo = nullptr;
+	descriptorWrites[7].pTexelBufferView = nullptr;
+
+	// Always bound, 1^3 when GENERATOR_CLOSEST_FEATURE leaves them out
+	VkDescriptorImageInfo closestTrianglesImageInfo = {};
+	closestTrianglesImageInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+	closestTrianglesImageInfo.imageView = scene->GetClosestTriangles()->GetImageView();
+	closestTrianglesImageInfo.sampler = scene->GetClosestTriangles()->GetSampler();
+
+	descriptorWrites[8].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	descriptorWrites[8].dstSet = generatorDescriptorSet;
+	descriptorWrites[8].dstBinding = 8;
+	descriptorWrites[8].dstArrayElement = 0;
+	descriptorWrites[8].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	descriptorWrites[8].descriptorCount = 1;
+	descriptorWrites[8].pBufferInfo = nullptr;
+	descriptorWrites[8].pImageInfo = &closestTrianglesImageInfo;
+	descriptorWrites[8].pTexelBufferView = nullptr;
+
+	VkDescriptorImageInfo closestBarycentricsImageInfo = {};
+	closestBarycentricsImageInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+	closestBarycentricsImageInfo.imageView = scene->GetClosestBarycentrics()->GetImageView();
+	closestBarycentricsImageInfo.sampler = scene->GetClosestBarycentrics()->GetSampler();
+
+	descriptorWrites[9].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	descriptorWrites[9].dstSet = generatorDescriptorSet;
+	descriptorWrites[9].dstBinding = 9;
+	descriptorWrites[9].dstArrayElement = 0;
+	descriptorWrites[9].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	descriptorWrites[9].descriptorCount = 1;
+	descriptorWrites[9].pBufferInfo = nullptr;
+	descriptorWrites[9].pImageInfo = &closestBarycentricsImageInfo;
+	descriptorWrites[9].pTexelBufferView = nullptr;
+
 	// Update descriptor sets
 	vkUpdateDescriptorSets(logicalDevice, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
 }
@@ -675,6 +1015,161 @@ void Renderer::CreateVectorFieldDescriptorSet()
 	vkUpdateDescriptorSets(logicalDevice, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
 }
 
+void Renderer::CreateActiveBricksBuffer()
+{
+	BufferUtils::CreateBuffer(device, ACTIVE_BRICKS_BUFFER_SIZE, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, activeBricksBuffer, activeBricksBufferMemory);
+
+	ResetActiveBricks();
+}
+
+void Renderer::ResetActiveBricks()
+{
+	VkCommandBufferAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	allocInfo.commandPool = computeCommandPool;
+	allocInfo.commandBufferCount = 1;
+
+	VkCommandBuffer commandBuffer;
+	if (vkAllocateCommandBuffers(logicalDevice, &allocInfo, &commandBuffer) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to allocate command buffer");
+	}
+
+	VkCommandBufferBeginInfo beginInfo = {};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+	if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to begin recording command buffer");
+	}
+
+	// Every brick in the band and updated, so the first frame runs them all and the next one knows which to copy.
+	// The dispatch is written before every frame.
+	vkCmdFillBuffer(commandBuffer, activeBricksBuffer, sizeof(ActiveBricksHeader), 2 * KERNEL_BRICK_COUNT * sizeof(uint32_t), 1);
+
+	if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to record command buffer");
+	}
+
+	VkSubmitInfo submitInfo = {};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &commandBuffer;
+
+	if (vkQueueSubmit(device->GetQueue(QueueFlags::Compute), 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to submit command buffer");
+	}
+
+	vkQueueWaitIdle(device->GetQueue(QueueFlags::Compute));
+	vkFreeCommandBuffers(logicalDevice, computeCommandPool, 1, &commandBuffer);
+}
+
+void Renderer::CreateActiveBricksDescriptorSet()
+{
+	// Describe the desciptor set
+	VkDescriptorSetLayout layouts[] = { activeBricksDescriptorSetLayout };
+	VkDescriptorSetAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = descriptorPool;
+	allocInfo.descriptorSetCount = 1;
+	allocInfo.pSetLayouts = layouts;
+
+	// Allocate descriptor sets
+	if (vkAllocateDescriptorSets(logicalDevice, &allocInfo, &activeBricksDescriptorSet) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to allocate active bricks descriptor set");
+	}
+
+	VkDescriptorBufferInfo bufferInfo = {};
+	bufferInfo.buffer = activeBricksBuffer;
+	bufferInfo.offset = 0;
+	bufferInfo.range = VK_WHOLE_SIZE;
+
+	std::vector<VkWriteDescriptorSet> descriptorWrites(1);
+	descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	descriptorWrites[0].dstSet = activeBricksDescriptorSet;
+	descriptorWrites[0].dstBinding = 0;
+	descriptorWrites[0].dstArrayElement = 0;
+	descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	descriptorWrites[0].descriptorCount = 1;
+	descriptorWrites[0].pBufferInfo = &bufferInfo;
+
+	// Update descriptor sets
+	vkUpdateDescriptorSets(logicalDevice, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+}
+
+void Renderer::CreateDerivativeFieldDescriptorSet()
+{
+	// Describe the desciptor set, a single storage image like the vector field
+	VkDescriptorSetLayout layouts[] = { vectorFieldDescriptorSetLayout };
+	VkDescriptorSetAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = descriptorPool;
+	allocInfo.descriptorSetCount = 1;
+	allocInfo.pSetLayouts = layouts;
+
+	// Allocate descriptor sets
+	if (vkAllocateDescriptorSets(logicalDevice, &allocInfo, &derivativeFieldDescriptorSet) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to allocate derivative field descriptor set");
+	}
+
+	std::vector<VkWriteDescriptorSet> descriptorWrites(1);
+
+	// Bind image and sampler resources to the descriptor
+	VkDescriptorImageInfo imageInfo = {};
+	imageInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+	imageInfo.imageView = scene->GetDerivativeField()->GetImageView();
+	imageInfo.sampler = scene->GetDerivativeField()->GetSampler();
+
+	descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	descriptorWrites[0].dstSet = derivativeFieldDescriptorSet;
+	descriptorWrites[0].dstBinding = 0;
+	descriptorWrites[0].dstArrayElement = 0;
+	descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	descriptorWrites[0].descriptorCount = 1;
+	descriptorWrites[0].pImageInfo = &imageInfo;
+
+	// Update descriptor sets
+	vkUpdateDescriptorSets(logicalDevice, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+}
+
+void Renderer::CreateRelaxationSumsDescriptorSets()
+{
+	// Describe the desciptor sets, r32f storage images like the sdf
+	VkDescriptorSetLayout layouts[] = { sceneSDFDescriptorSetLayout, sceneSDFDescriptorSetLayout };
+	VkDescriptorSetAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = descriptorPool;
+	allocInfo.descriptorSetCount = 2;
+	allocInfo.pSetLayouts = layouts;
+
+	// Allocate descriptor sets
+	if (vkAllocateDescriptorSets(logicalDevice, &allocInfo, relaxationSumsDescriptorSets) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to allocate relaxation sums descriptor sets");
+	}
+
+	std::vector<VkWriteDescriptorSet> descriptorWrites(2);
+	VkDescriptorImageInfo imageInfos[2] = {};
+
+	for (int i = 0; i < 2; ++i) {
+		// Bind image and sampler resources to the descriptor
+		imageInfos[i].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+		imageInfos[i].imageView = scene->GetRelaxationSums(i)->GetImageView();
+		imageInfos[i].sampler = scene->GetRelaxationSums(i)->GetSampler();
+
+		descriptorWrites[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrites[i].dstSet = relaxationSumsDescriptorSets[i];
+		descriptorWrites[i].dstBinding = 0;
+		descriptorWrites[i].dstArrayElement = 0;
+		descriptorWrites[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		descriptorWrites[i].descriptorCount = 1;
+		descriptorWrites[i].pImageInfo = &imageInfos[i];
+	}
+
+	// Update descriptor sets
+	vkUpdateDescriptorSets(logicalDevice, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+}
+
 void Renderer::CreateRaymarchingPipeline() {
     VkShaderModule vertShaderModule = ShaderModule::Create("shaders/graphics.vert.spv", logicalDevice);
     VkShaderModule fragShaderModule = ShaderModule::Create("shaders/graphics.frag.spv", logicalDevice);
@@ -844,7 +1339,73 @@ void Renderer::CreateKernelComputePipeline() {
     computeShaderStageInfo.module = computeShaderModule;
     computeShaderStageInfo.pName = "main";
 
-    std::vector<VkDescriptorSetLayout> descriptorSetLayouts = { cameraDescriptorSetLayout, timeDescriptorSetLayout, sceneSDFDescriptorSetLayout, sceneSDFDescriptorSetLayout, vectorFieldDescriptorSetLayout };
+	const GrowthBehaviour& behaviour = growthBehaviour;
+	ActivationWindow band = behaviour.GetActiveBand();
+
+	KernelSpecialization specializationData = {};
+	specializationData.sparseBricks = KERNEL_SPARSE_BRICKS ? VK_TRUE : VK_FALSE;
+	specializationData.relaxation = behaviour.relaxation;
+	specializationData.curvatureOffset = behaviour.UsesCurvature() ? behaviour.curvatureOffset : 0;
+
+	specializationData.gravityTerm = behaviour.gravity.enabled ? VK_TRUE : VK_FALSE;
+	specializationData.gravityStrength = behaviour.gravity.strength;
+	specializationData.gravityCurvatureWeighted = behaviour.gravity.curvatureWeighted ? VK_TRUE : VK_FALSE;
+	specializationData.gravityMin = behaviour.gravity.window.min;
+	specializationData.gravityMax = behaviour.gravity.window.max;
+
+	specializationData.curvatureTerm = behaviour.curvature.enabled ? VK_TRUE : VK_FALSE;
+	specializationData.curvatureStrength = behaviour.curvature.strength;
+	specializationData.curvatureMin = behaviour.curvature.window.min;
+	specializationData.curvatureMax = behaviour.curvature.window.max;
+
+	specializationData.repulsionTerm = behaviour.repulsion.enabled ? VK_TRUE : VK_FALSE;
+	specializationData.repulsionStrength = behaviour.repulsion.strength;
+	specializationData.repulsionDelta = behaviour.repulsion.delta;
+	specializationData.repulsionMin = behaviour.repulsion.window.min;
+	specializationData.repulsionMax = behaviour.repulsion.window.max;
+
+	specializationData.noiseTerm = behaviour.noise.enabled ? VK_TRUE : VK_FALSE;
+	specializationData.noiseStrength = behaviour.noise.strength;
+	specializationData.noiseFade = behaviour.noise.fadeEnd > behaviour.noise.fadeStart ? VK_TRUE : VK_FALSE;
+	specializationData.noiseFadeStart = behaviour.noise.fadeStart;
+	specializationData.noiseFadeEnd = behaviour.noise.fadeEnd;
+
+	specializationData.curlTerm = behaviour.curl.enabled ? VK_TRUE : VK_FALSE;
+	specializationData.curlStrength = behaviour.curl.strength;
+
+	specializationData.planarTerm = behaviour.planar.enabled ? VK_TRUE : VK_FALSE;
+	specializationData.planarStrength = behaviour.planar.strength;
+	specializationData.planarDirection = behaviour.planar.direction;
+	specializationData.planarMin = behaviour.planar.window.min;
+	specializationData.planarMax = behaviour.planar.window.max;
+	specializationData.planarNoiseFadeStart = behaviour.planar.noiseFadeStart;
+	specializationData.planarNoiseFadeEnd = behaviour.planar.noiseFadeEnd;
+
+	specializationData.activeBandMin = band.min;
+	specializationData.activeBandMax = band.max;
+
+	specializationData.derivativeField = KERNEL_DERIVATIVE_FIELD ? VK_TRUE : VK_FALSE;
+
+	specializationData.relaxationRadius = behaviour.relaxationRadius;
+	specializationData.separableRelaxation = UsesSeparableRelaxation(behaviour) ? VK_TRUE : VK_FALSE;
+
+	std::array<VkSpecializationMapEntry, KERNEL_SPECIALIZATION_CONSTANT_COUNT> specializationEntries = {};
+
+	for (uint32_t i = 0; i < KERNEL_SPECIALIZATION_CONSTANT_COUNT; ++i) {
+		specializationEntries[i].constantID = i;
+		specializationEntries[i].offset = static_cast<uint32_t>(KERNEL_SPECIALIZATION_OFFSETS[i]);
+		specializationEntries[i].size = 4;
+	}
+
+	VkSpecializationInfo specializationInfo = {};
+	specializationInfo.mapEntryCount = static_cast<uint32_t>(specializationEntries.size());
+	specializationInfo.pMapEntries = specializationEntries.data();
+	specializationInfo.dataSize = sizeof(specializationData);
+	specializationInfo.pData = &specializationData;
+
+	computeShaderStageInfo.pSpecializationInfo = &specializationInfo;
+
+    std::vector<VkDescriptorSetLayout> descriptorSetLayouts = { cameraDescriptorSetLayout, timeDescriptorSetLayout, sceneSDFDescriptorSetLayout, sceneSDFDescriptorSetLayout, vectorFieldDescriptorSetLayout, activeBricksDescriptorSetLayout, vectorFieldDescriptorSetLayout, sceneSDFDescriptorSetLayout };
 
     // Create pipeline layout
     VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
@@ -881,21 +1442,81 @@ void Renderer::CreateGeneratorComputePipeline()
 	// Set up programmable shaders
 	VkShaderModule computeShaderModule = ShaderModule::Create("shaders/generator.comp.spv", logicalDevice);
 
+	// Tells the generator how to read the mesh buffer (TRIANGLE_LAYOUT), and whether to write traversal counters (TRAVERSAL_STATS)
+	struct {
+		int32_t triangleLayout;
+		VkBool32 traversalStats;
+		VkBool32 brickCulling;
+		int32_t coarseResolution;
+		VkBool32 writeVectorField;
+		int32_t closestFeature;
+		int32_t brickCandidateCapacity;
+	} specializationData;
+
+	specializationData.triangleLayout = static_cast<int32_t>(scene->GetMeshTriangleLayout());
+	specializationData.traversalStats = GENERATOR_TRAVERSAL_STATS ? VK_TRUE : VK_FALSE;
+	specializationData.brickCulling = GENERATOR_BRICK_CULLING ? VK_TRUE : VK_FALSE;
+	specializationData.coarseResolution = GENERATOR_COARSE_RESOLUTION;
+	specializationData.writeVectorField = GENERATOR_CPU_NOISE ? VK_FALSE : VK_TRUE;
+	specializationData.closestFeature = static_cast<int32_t>(GENERATOR_CLOSEST_FEATURE);
+	specializationData.brickCandidateCapacity = GENERATOR_BRICK_CULLING ? BRICK_MAX_CANDIDATES : 1;
+
+	std::array<VkSpecializationMapEntry, 7> specializationEntries = {};
+	specializationEntries[0].constantID = 0;
+	specializationEntries[0].offset = offsetof(decltype(specializationData), triangleLayout);
+	specializationEntries[0].size = sizeof(int32_t);
+	specializationEntries[1].constantID = 1;
+	specializationEntries[1].offset = offsetof(decltype(specializationData), traversalStats);
+	specializationEntries[1].size = sizeof(VkBool32);
+	specializationEntries[2].constantID = 2;
+	specializationEntries[2].offset = offsetof(decltype(specializationData), brickCulling);
+	specializationEntries[2].size = sizeof(VkBool32);
+	specializationEntries[3].constantID = 3;
+	specializationEntries[3].offset = offsetof(decltype(specializationData), coarseResolution);
+	specializationEntries[3].size = sizeof(int32_t);
+	specializationEntries[4].constantID = 4;
+	specializationEntries[4].offset = offsetof(decltype(specializationData), writeVectorField);
+	specializationEntries[4].size = sizeof(VkBool32);
+	specializationEntries[5].constantID = 5;
+	specializationEntries[5].offset = offsetof(decltype(specializationData), closestFeature);
+	specializationEntries[5].size = sizeof(int32_t);
+	specializationEntries[6].constantID = 6;
+	specializationEntries[6].offset = offsetof(decltype(specializationData), brickCandidateCapacity);
+	specializationEntries[6].size = sizeof(int32_t);
+
+	// Everything that changes what the generator writes: its code, specialization and the sign pass after it. Tile and batch sizes don't.
+	MappedFile spirv;
+	VkBool32 windingSign = GENERATOR_WINDING_SIGN ? VK_TRUE : VK_FALSE;
+	generatorCacheKey = spirv.Open("shaders/generator.comp.spv") ? FileUtils::Hash(&windingSign, sizeof(windingSign), FileUtils::Hash(&specializationData, sizeof(specializationData), FileUtils::Hash(spirv.GetData(), spirv.GetSize()))) : 0;
+
+	VkSpecializationInfo specializationInfo = {};
+	specializationInfo.mapEntryCount = static_cast<uint32_t>(specializationEntries.size());
+	specializationInfo.pMapEntries = specializationEntries.data();
+	specializationInfo.dataSize = sizeof(specializationData);
+	specializationInfo.pData = &specializationData;
+
 	VkPipelineShaderStageCreateInfo computeShaderStageInfo = {};
 	computeShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 	computeShaderStageInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
 	computeShaderStageInfo.module = computeShaderModule;
 	computeShaderStageInfo.pName = "main";
+	computeShaderStageInfo.pSpecializationInfo = &specializationInfo;
 
 	std::vector<VkDescriptorSetLayout> descriptorSetLayouts = { sceneSDFDescriptorSetLayout, vectorFieldDescriptorSetLayout, generatorDescriptorSetLayout };
 
+	// Tile origin, volume resolution and whether it is a coarse tile, GeneratorTile in the shader
+	VkPushConstantRange tileRange = {};
+	tileRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	tileRange.offset = 0;
+	tileRange.size = sizeof(GeneratorTile);
+
 	// Create pipeline layout
 	VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
 	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
 	pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
 	pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data();
-	pipelineLayoutInfo.pushConstantRangeCount = 0;
-	pipelineLayoutInfo.pPushConstantRanges = 0;
+	pipelineLayoutInfo.pushConstantRangeCount = 1;
+	pipelineLayoutInfo.pPushConstantRanges = &tileRange;
 
 	if (vkCreatePipelineLayout(logicalDevice, &pipelineLayoutInfo, nullptr, &generatorComputePipelineLayout) != VK_SUCCESS) {
 		throw std::runtime_error("Failed to create pipeline layout");
@@ -919,6 +1540,209 @@ void Renderer::CreateGeneratorComputePipeline()
 	vkDestroyShaderModule(logicalDevice, computeShaderModule, nullptr);
 }
 
+void Renderer::CreateBricksComputePipeline()
+{
+	// Set up programmable shaders
+	VkShaderModule computeShaderModule = ShaderModule::Create("shaders/bricks.comp.spv", logicalDevice);
+
+	VkPipelineShaderStageCreateInfo computeShaderStageInfo = {};
+	computeShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	computeShaderStageInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	computeShaderStageInfo.module = computeShaderModule;
+	computeShaderStageInfo.pName = "main";
+
+	// The bricks relaxation.comp sums around the updated ones, enough to cover the radius. GrowthSimulator::GetHaloBricks
+	int32_t haloBricks = UsesSeparableRelaxation(growthBehaviour) ? (growthBehaviour.relaxationRadius + KERNEL_WORKGROUP_SIZE - 1) / KERNEL_WORKGROUP_SIZE : 0;
+
+	VkSpecializationMapEntry specializationEntry = {};
+	specializationEntry.constantID = 0;
+	specializationEntry.offset = 0;
+	specializationEntry.size = sizeof(int32_t);
+
+	VkSpecializationInfo specializationInfo = {};
+	specializationInfo.mapEntryCount = 1;
+	specializationInfo.pMapEntries = &specializationEntry;
+	specializationInfo.dataSize = sizeof(haloBricks);
+	specializationInfo.pData = &haloBricks;
+
+	computeShaderStageInfo.pSpecializationInfo = &specializationInfo;
+
+	std::vector<VkDescriptorSetLayout> descriptorSetLayouts = { activeBricksDescriptorSetLayout };
+
+	// Create pipeline layout
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
+	pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data();
+	pipelineLayoutInfo.pushConstantRangeCount = 0;
+	pipelineLayoutInfo.pPushConstantRanges = 0;
+
+	if (vkCreatePipelineLayout(logicalDevice, &pipelineLayoutInfo, nullptr, &bricksComputePipelineLayout) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create pipeline layout");
+	}
+
+	// Create compute pipeline
+	VkComputePipelineCreateInfo pipelineInfo = {};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineInfo.stage = computeShaderStageInfo;
+	pipelineInfo.layout = bricksComputePipelineLayout;
+	pipelineInfo.pNext = nullptr;
+	pipelineInfo.flags = 0;
+	pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+	pipelineInfo.basePipelineIndex = -1;
+
+	if (vkCreateComputePipelines(logicalDevice, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &bricksComputePipeline) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create compute pipeline");
+	}
+
+	// No need for shader modules anymore
+	vkDestroyShaderModule(logicalDevice, computeShaderModule, nullptr);
+}
+
+void Renderer::CreateDerivativesComputePipeline()
+{
+	// Set up programmable shaders
+	VkShaderModule computeShaderModule = ShaderModule::Create("shaders/derivatives.comp.spv", logicalDevice);
+
+	VkPipelineShaderStageCreateInfo computeShaderStageInfo = {};
+	computeShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	computeShaderStageInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	computeShaderStageInfo.module = computeShaderModule;
+	computeShaderStageInfo.pName = "main";
+
+	// The same brick list and curv2 offset as the kernel
+	struct {
+		VkBool32 sparseBricks;
+		int32_t curvatureOffset;
+	} specializationData;
+
+	specializationData.sparseBricks = KERNEL_SPARSE_BRICKS ? VK_TRUE : VK_FALSE;
+	specializationData.curvatureOffset = growthBehaviour.UsesCurvature() ? growthBehaviour.curvatureOffset : 0;
+
+	std::array<VkSpecializationMapEntry, 2> specializationEntries = {};
+	specializationEntries[0].constantID = 0;
+	specializationEntries[0].offset = offsetof(decltype(specializationData), sparseBricks);
+	specializationEntries[0].size = sizeof(VkBool32);
+	specializationEntries[1].constantID = 1;
+	specializationEntries[1].offset = offsetof(decltype(specializationData), curvatureOffset);
+	specializationEntries[1].size = sizeof(int32_t);
+
+	VkSpecializationInfo specializationInfo = {};
+	specializationInfo.mapEntryCount = static_cast<uint32_t>(specializationEntries.size());
+	specializationInfo.pMapEntries = specializationEntries.data();
+	specializationInfo.dataSize = sizeof(specializationData);
+	specializationInfo.pData = &specializationData;
+
+	computeShaderStageInfo.pSpecializationInfo = &specializationInfo;
+
+	std::vector<VkDescriptorSetLayout> descriptorSetLayouts = { sceneSDFDescriptorSetLayout, vectorFieldDescriptorSetLayout, activeBricksDescriptorSetLayout };
+
+	// Create pipeline layout
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
+	pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data();
+	pipelineLayoutInfo.pushConstantRangeCount = 0;
+	pipelineLayoutInfo.pPushConstantRanges = 0;
+
+	if (vkCreatePipelineLayout(logicalDevice, &pipelineLayoutInfo, nullptr, &derivativesComputePipelineLayout) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create pipeline layout");
+	}
+
+	// Create compute pipeline
+	VkComputePipelineCreateInfo pipelineInfo = {};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineInfo.stage = computeShaderStageInfo;
+	pipelineInfo.layout = derivativesComputePipelineLayout;
+	pipelineInfo.pNext = nullptr;
+	pipelineInfo.flags = 0;
+	pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+	pipelineInfo.basePipelineIndex = -1;
+
+	if (vkCreateComputePipelines(logicalDevice, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &derivativesComputePipeline) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create compute pipeline");
+	}
+
+	// No need for shader modules anymore
+	vkDestroyShaderModule(logicalDevice, computeShaderModule, nullptr);
+}
+
+void Renderer::CreateRelaxationComputePipelines()
+{
+	// Set up programmable shaders
+	VkShaderModule computeShaderModule = ShaderModule::Create("shaders/relaxation.comp.spv", logicalDevice);
+
+	// Input, output and the halo list
+	std::vector<VkDescriptorSetLayout> descriptorSetLayouts = { sceneSDFDescriptorSetLayout, sceneSDFDescriptorSetLayout, activeBricksDescriptorSetLayout };
+
+	// Create pipeline layout
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
+	pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data();
+	pipelineLayoutInfo.pushConstantRangeCount = 0;
+	pipelineLayoutInfo.pPushConstantRanges = 0;
+
+	if (vkCreatePipelineLayout(logicalDevice, &pipelineLayoutInfo, nullptr, &relaxationComputePipelineLayout) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create pipeline layout");
+	}
+
+	// One pipeline per axis, both with the radius of the kernel
+	for (int axis = 0; axis < 2; ++axis) {
+		VkPipelineShaderStageCreateInfo computeShaderStageInfo = {};
+		computeShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		computeShaderStageInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		computeShaderStageInfo.module = computeShaderModule;
+		computeShaderStageInfo.pName = "main";
+
+		struct {
+			VkBool32 sparseBricks;
+			int32_t axis;
+			int32_t relaxationRadius;
+		} specializationData;
+
+		specializationData.sparseBricks = KERNEL_SPARSE_BRICKS ? VK_TRUE : VK_FALSE;
+		specializationData.axis = axis;
+		specializationData.relaxationRadius = growthBehaviour.relaxationRadius;
+
+		std::array<VkSpecializationMapEntry, 3> specializationEntries = {};
+		specializationEntries[0].constantID = 0;
+		specializationEntries[0].offset = offsetof(decltype(specializationData), sparseBricks);
+		specializationEntries[0].size = sizeof(VkBool32);
+		specializationEntries[1].constantID = 1;
+		specializationEntries[1].offset = offsetof(decltype(specializationData), axis);
+		specializationEntries[1].size = sizeof(int32_t);
+		specializationEntries[2].constantID = 2;
+		specializationEntries[2].offset = offsetof(decltype(specializationData), relaxationRadius);
+		specializationEntries[2].size = sizeof(int32_t);
+
+		VkSpecializationInfo specializationInfo = {};
+		specializationInfo.mapEntryCount = static_cast<uint32_t>(specializationEntries.size());
+		specializationInfo.pMapEntries = specializationEntries.data();
+		specializationInfo.dataSize = sizeof(specializationData);
+		specializationInfo.pData = &specializationData;
+
+		computeShaderStageInfo.pSpecializationInfo = &specializationInfo;
+
+		// Create compute pipeline
+		VkComputePipelineCreateInfo pipelineInfo = {};
+		pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		pipelineInfo.stage = computeShaderStageInfo;
+		pipelineInfo.layout = relaxationComputePipelineLayout;
+		pipelineInfo.pNext = nullptr;
+		pipelineInfo.flags = 0;
+		pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+		pipelineInfo.basePipelineIndex = -1;
+
+		if (vkCreateComputePipelines(logicalDevice, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &relaxationComputePipelines[axis]) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create compute pipeline");
+		}
+	}
+
+	// No need for shader modules anymore
+	vkDestroyShaderModule(logicalDevice, computeShaderModule, nullptr);
+}
+
 void Renderer::CreateFrameResources() {
     imageViews.resize(swapChain->GetCount());
 
@@ -1021,6 +1845,109 @@ void Renderer::RecreateFrameResources() {
 	RecordCommandBuffers(false);
 }
 
+void Renderer::RecordActiveBricks(VkCommandBuffer commandBuffer)
+{
+	// The kernel of the previous frame, in an earlier submission, wrote the band and read the list and dispatch
+	VkMemoryBarrier previousBarrier = {};
+	previousBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	previousBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+	previousBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		0, 1, &previousBarrier, 0, nullptr, 0, nullptr);
+
+	// An empty dispatch that bricks.comp appends to, the data is copied into the command buffer when recording
+	ActiveBricksHeader header = {};
+	header.dispatch.x = 0;
+	header.dispatch.y = 1;
+	header.dispatch.z = 1;
+	header.haloDispatch.x = 0;
+	header.haloDispatch.y = 1;
+	header.haloDispatch.z = 1;
+
+	vkCmdUpdateBuffer(commandBuffer, activeBricksBuffer, 0, sizeof(header), &header);
+
+	VkMemoryBarrier headerBarrier = {};
+	headerBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	headerBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	headerBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &headerBarrier, 0, nullptr, 0, nullptr);
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, bricksComputePipeline);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, bricksComputePipelineLayout, 0, 1, &activeBricksDescriptorSet, 0, nullptr);
+	vkCmdDispatch(commandBuffer, KERNEL_BRICK_COUNT / BRICKS_WORKGROUP_SIZE, 1, 1);
+
+	VkMemoryBarrier listBarrier = {};
+	listBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	listBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	listBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		0, 1, &listBarrier, 0, nullptr, 0, nullptr);
+}
+
+void Renderer::RecordDerivativeField(VkCommandBuffer commandBuffer, VkDescriptorSet sourceSDFDescriptorSet)
+{
+	// The kernel of the previous frame read the field and wrote the sdf this pass reads
+	VkMemoryBarrier previousBarrier = {};
+	previousBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	previousBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT;
+	previousBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &previousBarrier, 0, nullptr, 0, nullptr);
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, derivativesComputePipeline);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, derivativesComputePipelineLayout, 0, 1, &sourceSDFDescriptorSet, 0, nullptr);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, derivativesComputePipelineLayout, 1, 1, &derivativeFieldDescriptorSet, 0, nullptr);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, derivativesComputePipelineLayout, 2, 1, &activeBricksDescriptorSet, 0, nullptr);
+
+	if (KERNEL_SPARSE_BRICKS)
+		vkCmdDispatchIndirect(commandBuffer, activeBricksBuffer, offsetof(ActiveBricksHeader, dispatch));
+	else
+		vkCmdDispatch(commandBuffer, KERNEL_BRICKS_PER_AXIS, KERNEL_BRICKS_PER_AXIS, KERNEL_BRICKS_PER_AXIS);
+
+	VkMemoryBarrier fieldBarrier = {};
+	fieldBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	fieldBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	fieldBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &fieldBarrier, 0, nullptr, 0, nullptr);
+}
+
+void Renderer::RecordRelaxationSums(VkCommandBuffer commandBuffer, VkDescriptorSet sourceSDFDescriptorSet)
+{
+	// The kernel of the previous frame read the sums and wrote the sdf this pass reads
+	VkMemoryBarrier previousBarrier = {};
+	previousBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	previousBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT;
+	previousBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &previousBarrier, 0, nullptr, 0, nullptr);
+
+	// Along x from the sdf into the first volume, then along y into the second one the kernel reads
+	VkDescriptorSet inputs[] = { sourceSDFDescriptorSet, relaxationSumsDescriptorSets[0] };
+
+	for (int axis = 0; axis < 2; ++axis) {
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, relaxationComputePipelines[axis]);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, relaxationComputePipelineLayout, 0, 1, &inputs[axis], 0, nullptr);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, relaxationComputePipelineLayout, 1, 1, &relaxationSumsDescriptorSets[axis], 0, nullptr);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, relaxationComputePipelineLayout, 2, 1, &activeBricksDescriptorSet, 0, nullptr);
+
+		if (KERNEL_SPARSE_BRICKS)
+			vkCmdDispatchIndirect(commandBuffer, activeBricksBuffer, offsetof(ActiveBricksHeader, haloDispatch));
+		else
+			vkCmdDispatch(commandBuffer, KERNEL_BRICKS_PER_AXIS, KERNEL_BRICKS_PER_AXIS, KERNEL_BRICKS_PER_AXIS);
+
+		VkMemoryBarrier sumsBarrier = {};
+		sumsBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		sumsBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		sumsBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &sumsBarrier, 0, nullptr, 0, nullptr);
+	}
+}
+
 void Renderer::RecordKernelComputeCommandBuffer() {
     // Specify the command pool and number of buffers to allocate
     VkCommandBufferAllocateInfo allocInfo = {};
@@ -1049,6 +1976,16 @@ void Renderer::RecordKernelComputeCommandBuffer() {
 			throw std::runtime_error("Failed to begin recording compute command buffer");
 		}
 
+		// Lists the bricks to update before the kernel binds anything, their pipeline layouts differ
+		if (KERNEL_SPARSE_BRICKS)
+			RecordActiveBricks(primaryKernelCommandBuffer);
+
+		if (KERNEL_DERIVATIVE_FIELD)
+			RecordDerivativeField(primaryKernelCommandBuffer, primarySceneSDFDescriptorSet);
+
+		if (UsesSeparableRelaxation(growthBehaviour))
+			RecordRelaxationSums(primaryKernelCommandBuffer, primarySceneSDFDescriptorSet);
+
 		// Bind to the compute pipeline
 		vkCmdBindPipeline(primaryKernelCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, kernelComputePipeline);
 
@@ -1067,7 +2004,19 @@ void Renderer::RecordKernelComputeCommandBuffer() {
 		// Bind descriptor set for vector field
 		vkCmdBindDescriptorSets(primaryKernelCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, kernelComputePipelineLayout, 4, 1, &vectorFieldDescriptorSet, 0, nullptr);
 
-		vkCmdDispatch(primaryKernelCommandBuffer, 32, 32, 32);
+		// Bind descriptor set for the active bricks
+		vkCmdBindDescriptorSets(primaryKernelCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, kernelComputePipelineLayout, 5, 1, &activeBricksDescriptorSet, 0, nullptr);
+
+		// Bind descriptor set for the derivative field
+		vkCmdBindDescriptorSets(primaryKernelCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, kernelComputePipelineLayout, 6, 1, &derivativeFieldDescriptorSet, 0, nullptr);
+
+		// Bind descriptor set for the relaxation sums
+		vkCmdBindDescriptorSets(primaryKernelCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, kernelComputePipelineLayout, 7, 1, &relaxationSumsDescriptorSets[1], 0, nullptr);
+
+		if (KERNEL_SPARSE_BRICKS)
+			vkCmdDispatchIndirect(primaryKernelCommandBuffer, activeBricksBuffer, offsetof(ActiveBricksHeader, dispatch));
+		else
+			vkCmdDispatch(primaryKernelCommandBuffer, KERNEL_BRICKS_PER_AXIS, KERNEL_BRICKS_PER_AXIS, KERNEL_BRICKS_PER_AXIS);
 
 		// ~ End recording ~
 		if (vkEndCommandBuffer(primaryKernelCommandBuffer) != VK_SUCCESS) {
@@ -1087,6 +2036,16 @@ void Renderer::RecordKernelComputeCommandBuffer() {
 			throw std::runtime_error("Failed to begin recording compute command buffer");
 		}
 
+		// Lists the bricks to update before the kernel binds anything, their pipeline layouts differ
+		if (KERNEL_SPARSE_BRICKS)
+			RecordActiveBricks(secondaryKernelCommandBuffer);
+
+		if (KERNEL_DERIVATIVE_FIELD)
+			RecordDerivativeField(secondaryKernelCommandBuffer, secondarySceneSDFDescriptorSet);
+
+		if (UsesSeparableRelaxation(growthBehaviour))
+			RecordRelaxationSums(secondaryKernelCommandBuffer, secondarySceneSDFDescriptorSet);
+
 		// Bind to the compute pipeline
 		vkCmdBindPipeline(secondaryKernelCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, kernelComputePipeline);
 
@@ -1105,7 +2064,19 @@ void Renderer::RecordKernelComputeCommandBuffer() {
 		// Bind descriptor set for vector field
 		vkCmdBindDescriptorSets(secondaryKernelCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, kernelComputePipelineLayout, 4, 1, &vectorFieldDescriptorSet, 0, nullptr);
 
-		vkCmdDispatch(secondaryKernelCommandBuffer, 32, 32, 32);
+		// Bind descriptor set for the active bricks
+		vkCmdBindDescriptorSets(secondaryKernelCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, kernelComputePipelineLayout, 5, 1, &activeBricksDescriptorSet, 0, nullptr);
+
+		// Bind descriptor set for the derivative field
+		vkCmdBindDescriptorSets(secondaryKernelCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, kernelComputePipelineLayout, 6, 1, &derivativeFieldDescriptorSet, 0, nullptr);
+
+		// Bind descriptor set for the relaxation sums
+		vkCmdBindDescriptorSets(secondaryKernelCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, kernelComputePipelineLayout, 7, 1, &relaxationSumsDescriptorSets[1], 0, nullptr);
+
+		if (KERNEL_SPARSE_BRICKS)
+			vkCmdDispatchIndirect(secondaryKernelCommandBuffer, activeBricksBuffer, offsetof(ActiveBricksHeader, dispatch));
+		else
+			vkCmdDispatch(secondaryKernelCommandBuffer, KERNEL_BRICKS_PER_AXIS, KERNEL_BRICKS_PER_AXIS, KERNEL_BRICKS_PER_AXIS);
 
 		// ~ End recording ~
 		if (vkEndCommandBuffer(secondaryKernelCommandBuffer) != VK_SUCCESS) {
@@ -1114,45 +2085,139 @@ void Renderer::RecordKernelComputeCommandBuffer() {
 	}
 }
 
-void Renderer::RecordGeneratorComputeCommandBuffer()
+void Renderer::CreateGeneratorBatchResources()
 {
+	generatorNextTile = 0;
+	generatorTilesPerBatch = 1;
+
+	generatorCommandBuffers.resize(GENERATOR_BATCHES_IN_FLIGHT);
+	generatorFences.resize(GENERATOR_BATCHES_IN_FLIGHT);
+
 	// Specify the command pool and number of buffers to allocate
 	VkCommandBufferAllocateInfo allocInfo = {};
 	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
 	allocInfo.commandPool = computeCommandPool;
 	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-	allocInfo.commandBufferCount = 1;
+	allocInfo.commandBufferCount = static_cast<uint32_t>(generatorCommandBuffers.size());
 
-	if (vkAllocateCommandBuffers(logicalDevice, &allocInfo, &generatorCommandBuffer) != VK_SUCCESS) {
+	if (vkAllocateCommandBuffers(logicalDevice, &allocInfo, generatorCommandBuffers.data()) != VK_SUCCESS) {
 		throw std::runtime_error("Failed to allocate command buffers");
 	}
 
+	VkFenceCreateInfo fenceInfo = {};
+	fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+	fenceInfo.flags = 0;
+
+	for (VkFence& fence : generatorFences) {
+		if (vkCreateFence(logicalDevice, &fenceInfo, nullptr, &fence) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create fence");
+		}
+	}
+
+	// Batches are timed on the GPU when the compute queue supports timestamps, otherwise from the CPU side
+	VkPhysicalDeviceProperties deviceProperties;
+	vkGetPhysicalDeviceProperties(device->GetInstance()->GetPhysicalDevice(), &deviceProperties);
+
+	uint32_t queueFamilyCount = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(device->GetInstance()->GetPhysicalDevice(), &queueFamilyCount, nullptr);
+	std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(device->GetInstance()->GetPhysicalDevice(), &queueFamilyCount, queueFamilies.data());
+
+	int computeFamily = device->GetInstance()->GetQueueFamilyIndices()[QueueFlags::Compute];
+	generatorTimestamps = queueFamilies[computeFamily].timestampValidBits > 0 && deviceProperties.limits.timestampPeriod > 0.f;
+	timestampPeriodMs = deviceProperties.limits.timestampPeriod * 1e-6;
+	timestampMask = queueFamilies[computeFamily].timestampValidBits < 64 ? (1ull << queueFamilies[computeFamily].timestampValidBits) - 1 : ~0ull;
+	generatorQueryPool = VK_NULL_HANDLE;
+
+	if (generatorTimestamps) {
+		VkQueryPoolCreateInfo queryPoolInfo = {};
+		queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		queryPoolInfo.queryCount = 2 * GENERATOR_BATCHES_IN_FLIGHT;
+
+		if (vkCreateQueryPool(logicalDevice, &queryPoolInfo, nullptr, &generatorQueryPool) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create query pool");
+		}
+	}
+}
+
+void Renderer::RecordGeneratorComputeCommandBuffer(int batch, int firstTile, int tileCount)
+{
+	VkCommandBuffer commandBuffer = generatorCommandBuffers[batch];
+
 	VkCommandBufferBeginInfo beginInfo = {};
 	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 	beginInfo.pInheritanceInfo = nullptr;
 
 	// ~ Start recording ~
-	if (vkBeginCommandBuffer(generatorCommandBuffer, &beginInfo) != VK_SUCCESS) {
+	if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
 		throw std::runtime_error("Failed to begin recording compute command buffer");
 	}
 
+	if (generatorTimestamps) {
+		vkCmdResetQueryPool(commandBuffer, generatorQueryPool, 2 * batch, 2);
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, generatorQueryPool, 2 * batch);
+	}
+
 	// Bind to the compute pipeline
-	vkCmdBindPipeline(generatorCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, generatorComputePipeline);
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, generatorComputePipeline);
 
 	// Bind descriptor set for 3D texture
-	vkCmdBindDescriptorSets(generatorCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, generatorComputePipelineLayout, 0, 1, &primarySceneSDFDescriptorSet, 0, nullptr);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, generatorComputePipelineLayout, 0, 1, &primarySceneSDFDescriptorSet, 0, nullptr);
 
 	// Bind descriptor set for vector field 
-	vkCmdBindDescriptorSets(generatorCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, generatorComputePipelineLayout, 1, 1, &vectorFieldDescriptorSet, 0, nullptr);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, generatorComputePipelineLayout, 1, 1, &vectorFieldDescriptorSet, 0, nullptr);
 
 	// Bind descriptor set for mesh data
-	vkCmdBindDescriptorSets(generatorCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, generatorComputePipelineLayout, 2, 1, &generatorDescriptorSet, 0, nullptr);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, generatorComputePipelineLayout, 2, 1, &generatorDescriptorSet, 0, nullptr);
+
+	// Tiles never overlap, so no barriers between them, only before the first fine tile reads the coarse ones
+	const int tilesPerAxis = SCENE_SDF_RESOLUTION / GENERATOR_TILE_SIZE;
+	const uint32_t groupsPerTile = GENERATOR_TILE_SIZE / GENERATOR_WORKGROUP_SIZE;
+
+	for (int tile = firstTile; tile < firstTile + tileCount; ++tile) {
+		GeneratorTile generatorTile;
+		glm::uvec3 groups(groupsPerTile);
+
+		if (tile < GENERATOR_COARSE_TILE_COUNT) {
+			const int axisTiles = GENERATOR_COARSE_TILES_PER_AXIS;
+			glm::ivec3 origin = glm::ivec3(tile % axisTiles, (tile / axisTiles) % axisTiles, tile / (axisTiles * axisTiles)) * GENERATOR_TILE_SIZE;
+
+			// The last tiles only hold a few samples
+			glm::ivec3 remaining = glm::ivec3(GENERATOR_COARSE_RESOLUTION + 1) - origin;
+			groups = glm::min(groups, glm::uvec3((remaining + static_cast<int>(GENERATOR_WORKGROUP_SIZE) - 1) / static_cast<int>(GENERATOR_WORKGROUP_SIZE)));
+			generatorTile.tileOrigin = glm::ivec4(origin, GENERATOR_COARSE_RESOLUTION);
+			generatorTile.coarsePass = 1;
+		}
+		else {
+			int fineTile = tile - GENERATOR_COARSE_TILE_COUNT;
+			glm::ivec3 origin = glm::ivec3(fineTile % tilesPerAxis, (fineTile / tilesPerAxis) % tilesPerAxis, fineTile / (tilesPerAxis * tilesPerAxis)) * GENERATOR_TILE_SIZE;
+
+			generatorTile.tileOrigin = glm::ivec4(origin, SCENE_SDF_RESOLUTION);
+			generatorTile.coarsePass = 0;
 
-	vkCmdDispatch(generatorCommandBuffer, 32, 32, 32);
+			// Also covers coarse tiles submitted in earlier batches, barriers apply to everything before them in the queue
+			if (fineTile == 0 && GENERATOR_COARSE_TILE_COUNT > 0) {
+				VkMemoryBarrier coarseBarrier = {};
+				coarseBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+				coarseBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+				coarseBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+				vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &coarseBarrier, 0, nullptr, 0, nullptr);
+			}
+		}
+
+		vkCmdPushConstants(commandBuffer, generatorComputePipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(GeneratorTile), &generatorTile);
+		vkCmdDispatch(commandBuffer, groups.x, groups.y, groups.z);
+	}
+
+	if (generatorTimestamps) {
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, generatorQueryPool, 2 * batch + 1);
+	}
 
 	// ~ End recording ~
-	if (vkEndCommandBuffer(generatorCommandBuffer) != VK_SUCCESS) {
+	if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
 		throw std::runtime_error("Failed to record generator compute command buffer");
 	}
 }
@@ -1238,33 +2303,518 @@ void Renderer::RecordCommandBuffers(bool primary) {
 	}
 }
 
-void Renderer::GenerateSceneSDF()
+bool Renderer::GenerateSceneSDF(const GeneratorProgress& progress)
 {
-	VkSubmitInfo generatorComputeSubmitInfo = {};
-	generatorComputeSubmitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	typedef std::chrono::high_resolution_clock Clock;
 
-	generatorComputeSubmitInfo.commandBufferCount = 1;
-	generatorComputeSubmitInfo.pCommandBuffers = &generatorCommandBuffer;
+	struct Batch {
+		int tileCount = 0;
+		bool pending = false;
+		Clock::time_point submitTime;
+	};
 
-	VkFence fence = VK_NULL_HANDLE;
-	VkFenceCreateInfo fenceInfo;
-	fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-	fenceInfo.flags = 0;
-	fenceInfo.pNext = NULL;
+	const int tilesPerAxis = SCENE_SDF_RESOLUTION / GENERATOR_TILE_SIZE;
+	const int tileCount = GENERATOR_COARSE_TILE_COUNT + tilesPerAxis * tilesPerAxis * tilesPerAxis;
+
+	// Before the generator, so it is there even when the sdf comes from the cache
+	if (generatorNextTile == 0 && GENERATOR_CPU_NOISE)
+		UpdateVectorField();
+
+	// A previous run with the same mesh and generator already left the volumes on disk
+	if (generatorNextTile == 0 && LoadGeneratorCache()) {
+		if (progress)
+			progress(tileCount, tileCount);
+
+		return true;
+	}
+
+	std::vector<Batch> batches(GENERATOR_BATCHES_IN_FLIGHT);
+	int completedTiles = generatorNextTile;
+	bool cancelled = false;
+	Clock::time_point previousCompletion = Clock::now();
+
+	// Waits for a batch without blocking the caller for more than GENERATOR_POLL_MS at a time, then
+	// sizes the next batches from what this one cost. Cancelling can't stop work already submitted.
+	auto finishBatch = [&](int batch) {
+		VkResult result;
+
+		while ((result = vkWaitForFences(logicalDevice, 1, &generatorFences[batch], VK_TRUE, GENERATOR_POLL_MS * 1000000ull)) == VK_TIMEOUT) {
+			if (progress && !progress(completedTiles, tileCount))
+				cancelled = true;
+		}
+
+		if (result != VK_SUCCESS) {
+			throw std::runtime_error("Failed to wait for fences");
+		}
+
+		double batchMs = 0.0;
+		Clock::time_point now = Clock::now();
+
+		if (generatorTimestamps) {
+			uint64_t timestamps[2];
+
+			if (vkGetQueryPoolResults(logicalDevice, generatorQueryPool, 2 * batch, 2, sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT) != VK_SUCCESS) {
+				throw std::runtime_error("Failed to read generator timestamps");
+			}
+
+			batchMs = ((timestamps[1] - timestamps[0]) & timestampMask) * timestampPeriodMs;
+		}
+		else {
+			// Batches run back to back, so this one started when it was submitted or when the previous one ended
+			batchMs = std::chrono::duration<double, std::milli>(now - std::max(batches[batch].submitTime, previousCompletion)).count();
+		}
+
+		previousCompletion = now;
+
+		// Tiles near the surface cost more than empty ones, so aim for half the budget and grow slowly
+		double tileMs = std::max(batchMs / batches[batch].tileCount, 1e-3);
+		int fittingTiles = static_cast<int>(GENERATOR_MAX_SUBMIT_MS * .5 / tileMs);
+		generatorTilesPerBatch = std::max(1, std::min(fittingTiles, std::min(2 * generatorTilesPerBatch, tileCount)));
+
+		completedTiles += batches[batch].tileCount;
+		batches[batch].pending = false;
+
+		if (vkResetFences(logicalDevice, 1, &generatorFences[batch]) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to reset fence");
+		}
+	};
+
+	int b = 0;
+
+	while (generatorNextTile < tileCount && !cancelled) {
+		if (batches[b].pending)
+			finishBatch(b);
+
+		if (cancelled)
+			break;
+
+		int count = std::min(generatorTilesPerBatch, tileCount - generatorNextTile);
+		RecordGeneratorComputeCommandBuffer(b, generatorNextTile, count);
+
+		VkSubmitInfo generatorComputeSubmitInfo = {};
+		generatorComputeSubmitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		generatorComputeSubmitInfo.commandBufferCount = 1;
+		generatorComputeSubmitInfo.pCommandBuffers = &generatorCommandBuffers[b];
+
+		if (vkQueueSubmit(device->GetQueue(QueueFlags::Compute), 1, &generatorComputeSubmitInfo, generatorFences[b]) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to submit generator command buffer");
+		}
+
+		batches[b].tileCount = count;
+		batches[b].pending = true;
+		batches[b].submitTime = Clock::now();
+		generatorNextTile += count;
+
+		if (progress && !progress(completedTiles, tileCount))
+			cancelled = true;
+
+		b = (b + 1) % GENERATOR_BATCHES_IN_FLIGHT;
+	}
+
+	// Oldest first, they finish in submission order
+	for (int i = 0; i < GENERATOR_BATCHES_IN_FLIGHT; ++i) {
+		int oldest = (b + i) % GENERATOR_BATCHES_IN_FLIGHT;
+
+		if (batches[oldest].pending)
+			finishBatch(oldest);
+	}
+
+	if (completedTiles < tileCount)
+		return false;
+
+	if (progress)
+		progress(completedTiles, tileCount);
+
+	// The buffer is host coherent, so the counters are visible once the fences signal
+	if (GENERATOR_TRAVERSAL_STATS)
+		TraversalCounters::Print(scene->GetTraversalStats(), scene->GetTraversalStatsCount());
+
+	if (GENERATOR_COARSE_RESOLUTION > 0) {
+		size_t voxelCount = static_cast<size_t>(SCENE_SDF_RESOLUTION) * SCENE_SDF_RESOLUTION * SCENE_SDF_RESOLUTION;
+		size_t exactCount = SdfHierarchy::CountRefinedVoxels(scene->GetCoarseSDF(), GENERATOR_COARSE_RESOLUTION, SCENE_SDF_RESOLUTION);
+
+		std::cout << "Hierarchical generator: " << exactCount << " exact queries (" << 100.0 * exactCount / voxelCount << "% of voxels), "
+			<< voxelCount - exactCount << " skipped, plus " << scene->GetCoarseSDFCount() << " coarse samples" << std::endl;
+	}
+
+	if (GENERATOR_WINDING_SIGN)
+		SignSceneSDF();
+
+	SaveGeneratorCache();
+	return true;
+}
+
+void Renderer::SignSceneSDF()
+{
+	Texture3D* sdf = scene->GetSceneSDF(0);
+	VkExtent3D extent = sdf->GetExtent();
+
+	if (sdf->GetFormat() != VK_FORMAT_R32_SFLOAT || extent.width != extent.height || extent.width != extent.depth) {
+		throw std::runtime_error("The winding number sign needs a cubic R32_SFLOAT sdf");
+	}
+
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+	std::vector<float> distances(static_cast<size_t>(sdf->GetByteSize() / sizeof(float)));
+	DownloadTexture3D(sdf, distances.data());
+	SdfBaker::SignWithWindingNumber(*scene->GetWindingNumber(), extent.width, distances.data());
+	UploadTexture3D(sdf, distances.data());
 
-	if (vkCreateFence(device->GetVkDevice(), &fenceInfo, nullptr, &fence) != VK_SUCCESS) {
-		throw std::runtime_error("Failed to create fence");
+	std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+	std::cout << "Winding number signs in " << elapsed.count() << " s" << std::endl;
+}
+
+bool Renderer::GetGeneratorCacheVolumes(std::vector<Texture3D*>& textures, std::vector<uint64_t>& keys)
+{
+	// The instrumented pass needs the traversal to run
+	if (!GENERATOR_CACHE || GENERATOR_TRAVERSAL_STATS || generatorCacheKey == 0 || scene->GetMeshCacheKey() == 0)
+		return false;
+
+	Texture3D* sdf = scene->GetSceneSDF(0);
+	VkExtent3D sdfExtent = sdf->GetExtent();
+
+	textures.push_back(sdf);
+	keys.push_back(VolumeCache::ComputeKey(generatorCacheKey, scene->GetMeshCacheKey(), sdfExtent.width, sdfExtent.height, sdfExtent.depth, sdf->GetFormat()));
+
+	// Cached by UpdateVectorField instead
+	if (!GENERATOR_CPU_NOISE) {
+		// The noise only depends on the voxel position, so every mesh shares one vector field. It is sampled on the sdf grid.
+		Texture3D* vectorField = scene->GetVectorField();
+		VkExtent3D vectorFieldExtent = vectorField->GetExtent();
+		uint64_t vectorFieldGeneratorKey = FileUtils::Hash(&sdfExtent, sizeof(sdfExtent), generatorCacheKey);
+
+		textures.push_back(vectorField);
+		keys.push_back(VolumeCache::ComputeKey(vectorFieldGeneratorKey, 0, vectorFieldExtent.width, vectorFieldExtent.height, vectorFieldExtent.depth, vectorField->GetFormat()));
 	}
 
-	if (vkQueueSubmit(device->GetQueue(QueueFlags::Compute), 1, &generatorComputeSubmitInfo, fence) != VK_SUCCESS) {
-		throw std::runtime_error("Failed to submit generator command buffer");
+	// Both are R32_UINT on the same grid, so each hashes its slot into the generator key
+	Texture3D* features[2] = { scene->GetClosestTriangles(), scene->GetClosestBarycentrics() };
+	int featureCount = static_cast<int>(GENERATOR_CLOSEST_FEATURE);
+
+	for (int i = 0; i < featureCount; ++i) {
+		VkExtent3D extent = features[i]->GetExtent();
+		uint64_t featureGeneratorKey = FileUtils::Hash(&i, sizeof(i), generatorCacheKey);
+
+		textures.push_back(features[i]);
+		keys.push_back(VolumeCache::ComputeKey(featureGeneratorKey, scene->GetMeshCacheKey(), extent.width, extent.height, extent.depth, features[i]->GetFormat()));
+	}
+
+	return true;
+}
+
+bool Renderer::LoadGeneratorCache()
+{
+	std::vector<Texture3D*> textures;
+	std::vector<uint64_t> keys;
+
+	if (!GetGeneratorCacheVolumes(textures, keys))
+		return false;
+
+	int count = static_cast<int>(keys.size());
+	std::vector<VolumeCache> caches(count);
+
+	// All or nothing, the generator writes them together
+	for (int i = 0; i < count; ++i) {
+		if (!caches[i].Open(VolumeCache::GetCachePath(keys[i]), keys[i], textures[i]->GetByteSize()))
+			return false;
 	}
 
-	if (vkWaitForFences(device->GetVkDevice(), 1, &fence, VK_TRUE, std::numeric_limits<uint64_t>::max()) != VK_SUCCESS) {
-		throw std::runtime_error("Failed to wait for fences");
+	for (int i = 0; i < count; ++i) {
+		VkDeviceSize size = textures[i]->GetByteSize();
+		VkBuffer stagingBuffer;
+		VkDeviceMemory stagingBufferMemory;
+		BufferUtils::CreateBuffer(device, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+
+		void* data;
+		vkMapMemory(logicalDevice, stagingBufferMemory, 0, size, 0, &data);
+		memcpy(data, caches[i].GetTexels(), static_cast<size_t>(size));
+		vkUnmapMemory(logicalDevice, stagingBufferMemory);
+
+		caches[i].Close();
+		textures[i]->CopyFromBuffer(computeCommandPool, stagingBuffer);
+
+		vkDestroyBuffer(logicalDevice, stagingBuffer, nullptr);
+		vkFreeMemory(logicalDevice, stagingBufferMemory, nullptr);
 	}
 
-	vkDestroyFence(device->GetVkDevice(), fence, nullptr);
+	std::cout << "Loaded generated volumes from " << VolumeCache::GetCachePath(keys[0]) << std::endl;
+	return true;
+}
+
+void Renderer::SaveGeneratorCache()
+{
+	std::vector<Texture3D*> textures;
+	std::vector<uint64_t> keys;
+
+	if (!GetGeneratorCacheVolumes(textures, keys))
+		return;
+
+	int count = static_cast<int>(keys.size());
+
+	for (int i = 0; i < count; ++i) {
+		std::string path = VolumeCache::GetCachePath(keys[i]);
+
+		// Shared vector fields are usually there already
+		VolumeCache existing;
+
+		if (existing.Open(path, keys[i], textures[i]->GetByteSize()))
+			continue;
+
+		VkDeviceSize size = textures[i]->GetByteSize();
+		VkBuffer readbackBuffer;
+		VkDeviceMemory readbackBufferMemory;
+		BufferUtils::CreateBuffer(device, size, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, readbackBuffer, readbackBufferMemory);
+
+		textures[i]->CopyToBuffer(computeCommandPool, readbackBuffer);
+
+		void* data;
+		vkMapMemory(logicalDevice, readbackBufferMemory, 0, size, 0, &data);
+
+		// Failing to write the cache only costs the next run a regeneration
+		if (!VolumeCache::Save(path, keys[i], textures[i]->GetExtent().width, textures[i]->GetExtent().height, textures[i]->GetExtent().depth, textures[i]->GetFormat(), data, size))
+			std::cout << "Could not write volume cache " << path << std::endl;
+
+		vkUnmapMemory(logicalDevice, readbackBufferMemory);
+		vkDestroyBuffer(logicalDevice, readbackBuffer, nullptr);
+		vkFreeMemory(logicalDevice, readbackBufferMemory, nullptr);
+	}
+}
+
+void Renderer::UpdateVectorField()
+{
+	Texture3D* vectorField = scene->GetVectorField();
+	VkExtent3D extent = vectorField->GetExtent();
+	VkDeviceSize size = vectorField->GetByteSize();
+
+	// The baker writes RGBA floats on a cubic grid
+	if (vectorField->GetFormat() != VK_FORMAT_R32G32B32A32_SFLOAT || extent.width != extent.height || extent.width != extent.depth) {
+		throw std::runtime_error("NoiseBaker needs a cubic R32G32B32A32_SFLOAT vector field");
+	}
+
+	uint64_t key = VolumeCache::ComputeKey(NoiseBaker::ComputeKey(noiseParameters), 0, extent.width, extent.height, extent.depth, vectorField->GetFormat());
+	std::string path = VolumeCache::GetCachePath(key);
+
+	// Baked into regular memory, the staging buffer may be write combined and the cache reads it back
+	std::vector<float> texels;
+	VolumeCache cache;
+	const void* source = nullptr;
+
+	if (GENERATOR_CACHE && cache.Open(path, key, size)) {
+		source = cache.GetTexels();
+		std::cout << "Loaded vector field from " << path << std::endl;
+	}
+	else {
+		texels.resize(static_cast<size_t>(size / sizeof(float)));
+
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		NoiseBaker baker(noiseParameters, extent.width);
+		baker.Bake(texels.data());
+		std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+
+		std::cout << "Baked vector field at " << extent.width << "^3 in " << elapsed.count() << " s" << (NoiseBaker::UsesAVX2() ? " (AVX2)" : "") << std::endl;
+		source = texels.data();
+
+		// Failing to write the cache only costs the next run a bake
+		if (GENERATOR_CACHE && !VolumeCache::Save(path, key, extent.width, extent.height, extent.depth, vectorField->GetFormat(), source, size))
+			std::cout << "Could not write volume cache " << path << std::endl;
+	}
+
+	UploadTexture3D(vectorField, source);
+	cache.Close();
+}
+
+void Renderer::UploadTexture3D(Texture3D* texture, const void* texels)
+{
+	VkDeviceSize size = texture->GetByteSize();
+	VkBuffer stagingBuffer;
+	VkDeviceMemory stagingBufferMemory;
+	BufferUtils::CreateBuffer(device, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+
+	void* data;
+	vkMapMemory(logicalDevice, stagingBufferMemory, 0, size, 0, &data);
+	memcpy(data, texels, static_cast<size_t>(size));
+	vkUnmapMemory(logicalDevice, stagingBufferMemory);
+
+	texture->CopyFromBuffer(computeCommandPool, stagingBuffer);
+
+	vkDestroyBuffer(logicalDevice, stagingBuffer, nullptr);
+	vkFreeMemory(logicalDevice, stagingBufferMemory, nullptr);
+}
+
+void Renderer::DownloadTexture3D(Texture3D* texture, void* texels)
+{
+	VkDeviceSize size = texture->GetByteSize();
+	VkBuffer readbackBuffer;
+	VkDeviceMemory readbackBufferMemory;
+	BufferUtils::CreateBuffer(device, size, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, readbackBuffer, readbackBufferMemory);
+
+	texture->CopyToBuffer(computeCommandPool, readbackBuffer);
+
+	void* data;
+	vkMapMemory(logicalDevice, readbackBufferMemory, 0, size, 0, &data);
+	memcpy(texels, data, static_cast<size_t>(size));
+	vkUnmapMemory(logicalDevice, readbackBufferMemory);
+
+	vkDestroyBuffer(logicalDevice, readbackBuffer, nullptr);
+	vkFreeMemory(logicalDevice, readbackBufferMemory, nullptr);
+}
+
+float Renderer::CompareKernelStep(float totalTime)
+{
+	Texture3D* source = scene->GetSceneSDF(0);
+	Texture3D* vectorField = scene->GetVectorField();
+	int resolution = static_cast<int>(source->GetExtent().width);
+
+	// GrowthSimulator reads both on one grid
+	if (vectorField->GetExtent().width != source->GetExtent().width) {
+		throw std::runtime_error("Comparing a kernel step needs the vector field at the sdf resolution");
+	}
+
+	vkDeviceWaitIdle(logicalDevice);
+
+	size_t cellCount = static_cast<size_t>(resolution) * resolution * resolution;
+	std::vector<float> sourceTexels(cellCount);
+	std::vector<float> vectorFieldTexels(4 * cellCount);
+	std::vector<float> stepTexels(cellCount);
+
+	DownloadTexture3D(source, sourceTexels.data());
+	DownloadTexture3D(vectorField, vectorFieldTexels.data());
+
+	// The primary kernel commands read volume 0 and write volume 1. Like the first CPU step, every brick is updated.
+	if (KERNEL_SPARSE_BRICKS)
+		ResetActiveBricks();
+
+	scene->SetTime(totalTime, GROWTH_FRAME_TIME);
+
+	VkSubmitInfo submitInfo = {};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &primaryKernelCommandBuffer;
+
+	if (vkQueueSubmit(device->GetQueue(QueueFlags::Compute), 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to submit kernel command buffer");
+	}
+
+	vkQueueWaitIdle(device->GetQueue(QueueFlags::Compute));
+	DownloadTexture3D(scene->GetSceneSDF(1), stepTexels.data());
+
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	GrowthSimulator simulator(resolution, growthBehaviour);
+	simulator.SetSparse(KERNEL_SPARSE_BRICKS);
+	simulator.SetDerivativeField(KERNEL_DERIVATIVE_FIELD);
+	simulator.SetSeparableRelaxation(KERNEL_SEPARABLE_RELAXATION);
+	simulator.SetVolume(sourceTexels.data());
+	simulator.SetVectorField(vectorFieldTexels.data());
+	simulator.Step(totalTime);
+	std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+
+	float maxError = 0.f;
+	double errorSum = 0.0;
+	size_t signFlips = 0;
+
+	for (size_t c = 0; c < cellCount; ++c) {
+		float error = std::abs(stepTexels[c] - simulator.GetVolume()[c]);
+		maxError = std::max(maxError, error);
+		errorSum += error;
+		signFlips += (stepTexels[c] < 0.f) != (simulator.GetVolume()[c] < 0.f);
+	}
+
+	std::cout << "Kernel step at " << totalTime << " s against GrowthSimulator (" << elapsed.count() << " s): max error " << maxError
+		<< ", mean error " << errorSum / cellCount << ", " << signFlips << " sign flips" << std::endl;
+
+	// The next frame reads the volume the step wrote
+	currentFrameIndex = 1;
+	return maxError;
+}
+
+void Renderer::LoadProceduralSDF(const SdfProgram& program)
+{
+	Texture3D* sdf = scene->GetSceneSDF(0);
+	VkExtent3D extent = sdf->GetExtent();
+
+	if (sdf->GetFormat() != VK_FORMAT_R32_SFLOAT || extent.width != extent.height || extent.width != extent.depth) {
+		throw std::runtime_error("Procedural sdfs need a cubic R32_SFLOAT scene sdf");
+	}
+
+	int resolution = static_cast<int>(extent.width);
+	float farDistance = SDF_GRAPH_FAR_CELLS * 2.f / resolution;
+
+	// The far distance changes the interpolated voxels, the mesh key slot stays empty
+	int farCells = SDF_GRAPH_FAR_CELLS;
+	uint64_t key = VolumeCache::ComputeKey(FileUtils::Hash(&farCells, sizeof(farCells), program.ComputeKey()), 0, extent.width, extent.height, extent.depth, sdf->GetFormat());
+	std::string path = VolumeCache::GetCachePath(key);
+
+	std::vector<float> distances;
+	VolumeCache cache;
+	const void* source = nullptr;
+
+	if (GENERATOR_CACHE && cache.Open(path, key, sdf->GetByteSize())) {
+		source = cache.GetTexels();
+		std::cout << "Loaded procedural sdf from " << path << std::endl;
+	}
+	else {
+		distances.resize(static_cast<size_t>(resolution) * resolution * resolution);
+
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		SdfBakeStats stats = program.Bake(resolution, farDistance, distances.data());
+		std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+
+		std::cout << "Baked procedural sdf at " << resolution << "^3 in " << elapsed.count() << " s, " << program.GetInstructionCount() << " instructions, "
+			<< static_cast<double>(stats.instructions) / distances.size() << " run per voxel, " << stats.interpolatedVoxels << " voxels interpolated" << std::endl;
+		source = distances.data();
+
+		if (GENERATOR_CACHE && !VolumeCache::Save(path, key, extent.width, extent.height, extent.depth, sdf->GetFormat(), source, sdf->GetByteSize()))
+			std::cout << "Could not write volume cache " << path << std::endl;
+	}
+
+	vkDeviceWaitIdle(logicalDevice);
+	UploadTexture3D(sdf, source);
+	cache.Close();
+}
+
+void Renderer::SetNoiseParameters(const NoiseParameters& parameters)
+{
+	noiseParameters = parameters;
+
+	// The kernel and the raymarcher read the vector field
+	vkDeviceWaitIdle(logicalDevice);
+	UpdateVectorField();
+}
+
+void Renderer::SetGrowthBehaviour(const GrowthBehaviour& behaviour)
+{
+	growthBehaviour = behaviour;
+
+	// Same SPIR-V, only the specialization changes, then the kernel command buffers bind the new pipelines
+	vkDeviceWaitIdle(logicalDevice);
+
+	vkFreeCommandBuffers(logicalDevice, computeCommandPool, 1, &primaryKernelCommandBuffer);
+	vkFreeCommandBuffers(logicalDevice, computeCommandPool, 1, &secondaryKernelCommandBuffer);
+	vkDestroyPipeline(logicalDevice, kernelComputePipeline, nullptr);
+	vkDestroyPipelineLayout(logicalDevice, kernelComputePipelineLayout, nullptr);
+	vkDestroyPipeline(logicalDevice, derivativesComputePipeline, nullptr);
+	vkDestroyPipelineLayout(logicalDevice, derivativesComputePipelineLayout, nullptr);
+	vkDestroyPipeline(logicalDevice, bricksComputePipeline, nullptr);
+	vkDestroyPipelineLayout(logicalDevice, bricksComputePipelineLayout, nullptr);
+	vkDestroyPipeline(logicalDevice, relaxationComputePipelines[0], nullptr);
+	vkDestroyPipeline(logicalDevice, relaxationComputePipelines[1], nullptr);
+	vkDestroyPipelineLayout(logicalDevice, relaxationComputePipelineLayout, nullptr);
+
+	// The halo of bricks.comp and the sums follow the relaxation radius
+	CreateKernelComputePipeline();
+	CreateDerivativesComputePipeline();
+	CreateBricksComputePipeline();
+	CreateRelaxationComputePipelines();
+	RecordKernelComputeCommandBuffer();
+
+	// The band moved, bricks outside the old one have to find out whether they are in the new one
+	if (KERNEL_SPARSE_BRICKS)
+		ResetActiveBricks();
+}
+
+const GrowthBehaviour& Renderer::GetGrowthBehaviour() const
+{
+	return growthBehaviour;
 }
 
 void Renderer::Frame() {
@@ -1322,17 +2872,35 @@ Renderer::~Renderer() {
    
 	vkFreeCommandBuffers(logicalDevice, computeCommandPool, 1, &primaryKernelCommandBuffer);
 	vkFreeCommandBuffers(logicalDevice, computeCommandPool, 1, &secondaryKernelCommandBuffer);
+	vkFreeCommandBuffers(logicalDevice, computeCommandPool, static_cast<uint32_t>(generatorCommandBuffers.size()), generatorCommandBuffers.data());
+
+	for (VkFence fence : generatorFences)
+		vkDestroyFence(logicalDevice, fence, nullptr);
+
+	if (generatorQueryPool != VK_NULL_HANDLE)
+		vkDestroyQueryPool(logicalDevice, generatorQueryPool, nullptr);
     
     vkDestroyPipeline(logicalDevice, raymarchingPipeline, nullptr);
     vkDestroyPipeline(logicalDevice, kernelComputePipeline, nullptr);
+	vkDestroyPipeline(logicalDevice, bricksComputePipeline, nullptr);
+	vkDestroyPipeline(logicalDevice, derivativesComputePipeline, nullptr);
+	vkDestroyPipeline(logicalDevice, relaxationComputePipelines[0], nullptr);
+	vkDestroyPipeline(logicalDevice, relaxationComputePipelines[1], nullptr);
 
     vkDestroyPipelineLayout(logicalDevice, raymarchingPipelineLayout, nullptr);
     vkDestroyPipelineLayout(logicalDevice, kernelComputePipelineLayout, nullptr);
+	vkDestroyPipelineLayout(logicalDevice, bricksComputePipelineLayout, nullptr);
+	vkDestroyPipelineLayout(logicalDevice, derivativesComputePipelineLayout, nullptr);
+	vkDestroyPipelineLayout(logicalDevice, relaxationComputePipelineLayout, nullptr);
 
     vkDestroyDescriptorSetLayout(logicalDevice, cameraDescriptorSetLayout, nullptr);
     vkDestroyDescriptorSetLayout(logicalDevice, modelDescriptorSetLayout, nullptr);
     vkDestroyDescriptorSetLayout(logicalDevice, timeDescriptorSetLayout, nullptr);
 	vkDestroyDescriptorSetLayout(logicalDevice, sceneSDFDescriptorSetLayout, nullptr);
+	vkDestroyDescriptorSetLayout(logicalDevice, activeBricksDescriptorSetLayout, nullptr);
+
+	vkDestroyBuffer(logicalDevice, activeBricksBuffer, nullptr);
+	vkFreeMemory(logicalDevice, activeBricksBufferMemory, nullptr);
 
     vkDestroyDescriptorPool(logicalDevice, descriptorPool, nullptr);
 
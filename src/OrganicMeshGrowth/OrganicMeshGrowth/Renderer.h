@@ -4,11 +4,18 @@
 #include "SwapChain.h"
 #include "Scene.h"
 #include "Camera.h"
+#include "NoiseBaker.h"
+#include "SdfGraph.h"
+#include "GrowthBehaviour.h"
+#include <functional>
 
 class Texture3D;
 
 class Renderer {
 public:
+	// Gets the finished and total generator tile counts between batches, returns false to cancel
+	typedef std::function<bool(int, int)> GeneratorProgress;
+
     Renderer() = delete;
     Renderer(Device* device, SwapChain* swapChain, Scene* scene, Camera* camera);
     ~Renderer();
@@ -23,6 +30,7 @@ public:
     void CreateSceneSDFDescriptorSetLayout();
 	void CreateVectorFieldDescriptorSetLayout();
 	void CreateGeneratorDescriptorSetLayout();
+	void CreateActiveBricksDescriptorSetLayout();
 
     void CreateDescriptorPool();
 
@@ -32,10 +40,17 @@ public:
     void CreateSceneSDFDescriptorSet();
 	void CreateVectorFieldDescriptorSet();
 	void CreateGeneratorDescriptorSet();
+	void CreateActiveBricksBuffer();
+	void CreateActiveBricksDescriptorSet();
+	void CreateDerivativeFieldDescriptorSet();
+	void CreateRelaxationSumsDescriptorSets();
 
     void CreateRaymarchingPipeline();
     void CreateKernelComputePipeline();
 	void CreateGeneratorComputePipeline();
+	void CreateBricksComputePipeline();
+	void CreateDerivativesComputePipeline();
+	void CreateRelaxationComputePipelines();
 
     void CreateFrameResources();
     void DestroyFrameResources();
@@ -43,12 +58,61 @@ public:
 
     void RecordCommandBuffers(bool primary);
     void RecordKernelComputeCommandBuffer();
-	void RecordGeneratorComputeCommandBuffer();
+	void CreateGeneratorBatchResources();
+	void RecordGeneratorComputeCommandBuffer(int batch, int firstTile, int tileCount);
+
+	// Runs the generator in batches of tiles, calling progress in between and while waiting.
+	// Returns false when cancelled, and calling it again resumes from the first tile not submitted yet.
+	bool GenerateSceneSDF(const GeneratorProgress& progress = nullptr);
+
+	// Generated sdf, vector field and closest feature volumes in the volume cache, see GENERATOR_CACHE.
+	// Only the ones the generator writes, the sdf always first.
+	bool GetGeneratorCacheVolumes(std::vector<Texture3D*>& textures, std::vector<uint64_t>& keys);
+	bool LoadGeneratorCache();
+	void SaveGeneratorCache();
+
+	// GENERATOR_WINDING_SIGN: reads the generated sdf back, signs it with the winding number of the mesh and uploads it
+	void SignSceneSDF();
+
+	// With GENERATOR_CPU_NOISE: bakes the vector field with NoiseBaker, or loads it from the volume cache, and uploads it.
+	// Changing the parameters waits for the device to go idle and leaves the sdf alone.
+	void UpdateVectorField();
+	void SetNoiseParameters(const NoiseParameters& parameters);
+
+	// Rebuilds the kernel pipeline from the same shader with the behaviour as specialization constants, so switching
+	// needs no shader compile. Waits for the device to go idle and keeps the sdf, growth goes on from where it was.
+	void SetGrowthBehaviour(const GrowthBehaviour& behaviour);
+	const GrowthBehaviour& GetGrowthBehaviour() const;
+
+	// Procedural seed instead of the mesh: bakes the program on the CPU (SdfProgram::Bake, far bricks interpolated) or loads
+	// it from the volume cache, and uploads it where the generator writes. Skips the generator entirely.
+	void LoadProceduralSDF(const SdfProgram& program);
+
+	// With KERNEL_SPARSE_BRICKS: marks every brick as near the surface, so the next frame updates the whole volume and
+	// finds the band again. Needed when the sdf is replaced once frames have started.
+	void ResetActiveBricks();
+
+	// Runs one kernel step at totalTime on scene sdf 0 and the same step with GrowthSimulator, with the same behaviour
+	// and KERNEL_ toggles, on the volume read back. Prints and returns the largest difference. Call it before the first
+	// frame: it waits for the device to go idle, and growth goes on from the GPU step.
+	float CompareKernelStep(float totalTime);
 
-	void GenerateSceneSDF();
     void Frame();
 
 private:
+	// Blocking copy of a whole volume through a staging buffer
+	void UploadTexture3D(Texture3D* texture, const void* texels);
+	void DownloadTexture3D(Texture3D* texture, void* texels);
+
+	// The bricks.comp pass that writes the indirect dispatch of the kernel, and the barriers around it
+	void RecordActiveBricks(VkCommandBuffer commandBuffer);
+
+	// With KERNEL_DERIVATIVE_FIELD: the derivatives.comp pass over the cells the kernel updates next, and the barriers around it
+	void RecordDerivativeField(VkCommandBuffer commandBuffer, VkDescriptorSet sourceSDFDescriptorSet);
+
+	// With KERNEL_SEPARABLE_RELAXATION and a radius above 1: the relaxation.comp sums along x and y the kernel adds up
+	void RecordRelaxationSums(VkCommandBuffer commandBuffer, VkDescriptorSet sourceSDFDescriptorSet);
+
     Device* device;
     VkDevice logicalDevice;
     SwapChain* swapChain;
@@ -70,6 +134,7 @@ private:
     VkDescriptorSetLayout sceneSDFDescriptorSetLayout;
 	VkDescriptorSetLayout vectorFieldDescriptorSetLayout;
 	VkDescriptorSetLayout generatorDescriptorSetLayout;
+	VkDescriptorSetLayout activeBricksDescriptorSetLayout;
 
 	VkDescriptorSet generatorDescriptorSet;
     VkDescriptorSet cameraDescriptorSet;
@@ -77,6 +142,9 @@ private:
 	VkDescriptorSet primarySceneSDFDescriptorSet;
 	VkDescriptorSet secondarySceneSDFDescriptorSet;
 	VkDescriptorSet vectorFieldDescriptorSet;
+	VkDescriptorSet activeBricksDescriptorSet;
+	VkDescriptorSet derivativeFieldDescriptorSet;
+	VkDescriptorSet relaxationSumsDescriptorSets[2];
 
     std::vector<VkDescriptorSet> primaryModelDescriptorSets;
 	std::vector<VkDescriptorSet> secondaryModelDescriptorSets;
@@ -84,10 +152,16 @@ private:
     VkPipelineLayout raymarchingPipelineLayout;
     VkPipelineLayout kernelComputePipelineLayout;
 	VkPipelineLayout generatorComputePipelineLayout;
+	VkPipelineLayout bricksComputePipelineLayout;
+	VkPipelineLayout derivativesComputePipelineLayout;
+	VkPipelineLayout relaxationComputePipelineLayout;
 
     VkPipeline raymarchingPipeline;
     VkPipeline kernelComputePipeline;
 	VkPipeline generatorComputePipeline;
+	VkPipeline bricksComputePipeline;
+	VkPipeline derivativesComputePipeline;
+	VkPipeline relaxationComputePipelines[2];		// Along x and along y
 
     VkImage depthImage;
     VkDeviceMemory depthImageMemory;
@@ -96,7 +170,28 @@ private:
     std::vector<VkImageView> imageViews;
     std::vector<VkFramebuffer> framebuffers;
 
-	VkCommandBuffer generatorCommandBuffer;
+	// One command buffer, fence and pair of timestamp queries per batch in flight
+	std::vector<VkCommandBuffer> generatorCommandBuffers;
+	std::vector<VkFence> generatorFences;
+	VkQueryPool generatorQueryPool;
+	bool generatorTimestamps;
+	double timestampPeriodMs;
+	uint64_t timestampMask;
+
+	int generatorNextTile;
+	int generatorTilesPerBatch;
+
+	// Hash of the generator SPIR-V and specialization constants, 0 if the shader file could not be read
+	uint64_t generatorCacheKey;
+
+	NoiseParameters noiseParameters;
+
+	// What kernel.comp is specialized with, the mushroom until SetGrowthBehaviour
+	GrowthBehaviour growthBehaviour;
+
+	// Band, updated and list arrays per brick after the indirect dispatch, see ActiveBricksHeader
+	VkBuffer activeBricksBuffer;
+	VkDeviceMemory activeBricksBufferMemory;
 
     VkCommandBuffer primaryKernelCommandBuffer;
 	VkCommandBuffer secondaryKernelCommandBuffer;
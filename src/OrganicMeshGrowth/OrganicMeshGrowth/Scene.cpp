@@ -1,13 +1,8 @@
 #include "Scene.h"
 #include "BufferUtils.h"
+#include "MeshCache.h"
+#include "ObjParser.h"
 #include <iostream>
-#include <stack>
-#include <glm/gtc/constants.hpp>
-
-#define SAH_SUBDIV 200
-
-#define TINYOBJLOADER_IMPLEMENTATION
-#include "tiny_obj_loader.h"
 
 Scene::Scene(Device* device) : device(device) {
     BufferUtils::CreateBuffer(device, sizeof(Time), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, timeBuffer, timeBufferMemory);
@@ -36,6 +31,15 @@ float Scene::UpdateTime() {
 	return time.deltaTime;
 }
 
+void Scene::SetTime(float totalTime, float deltaTime)
+{
+	time.deltaTime = deltaTime;
+	time.totalTime = totalTime;
+	startTime = high_resolution_clock::now();
+
+	memcpy(mappedData, &time, sizeof(Time));
+}
+
 void Scene::CreateSceneSDF()
 {
 	VkSamplerCreateInfo samplerInfo = {};
@@ -71,147 +75,140 @@ void Scene::CreateSceneSDF()
 	samplerInfo.maxLod = 0.0f;
 
 	for (int i = 0; i < 2; ++i) {
-		sceneSDF.push_back(new Texture3D(device, 256, 256, 256, VK_FORMAT_R32_SFLOAT, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, samplerInfo));
+		sceneSDF.push_back(new Texture3D(device, SCENE_SDF_RESOLUTION, SCENE_SDF_RESOLUTION, SCENE_SDF_RESOLUTION, VK_FORMAT_R32_SFLOAT, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, samplerInfo));
 	}
-}
 
-void Scene::LoadMesh(const std::string filename, float scaleMultiplier)
-{
-	tinyobj::attrib_t attrib;
-	std::vector<tinyobj::shape_t> shapes;
-	std::vector<tinyobj::material_t> materials;
-	std::string error;
+	// Indices can't be filtered, and the generator descriptor set always needs both images
+	VkSamplerCreateInfo featureSamplerInfo = samplerInfo;
+	featureSamplerInfo.magFilter = VK_FILTER_NEAREST;
+	featureSamplerInfo.minFilter = VK_FILTER_NEAREST;
 
-	bool loaded = tinyobj::LoadObj(&attrib, &shapes, &materials, &error, filename.c_str());
+	int triangleResolution = GENERATOR_CLOSEST_FEATURE != ClosestFeatureOutput::None ? SCENE_SDF_RESOLUTION : 1;
+	int barycentricsResolution = GENERATOR_CLOSEST_FEATURE == ClosestFeatureOutput::TriangleAndBarycentrics ? SCENE_SDF_RESOLUTION : 1;
 
-	if (!loaded)
-		throw std::exception(error.c_str());
+	closestTriangleTexture = new Texture3D(device, triangleResolution, triangleResolution, triangleResolution, VK_FORMAT_R32_UINT, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, featureSamplerInfo);
+	closestBarycentricsTexture = new Texture3D(device, barycentricsResolution, barycentricsResolution, barycentricsResolution, VK_FORMAT_R32_UINT, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, featureSamplerInfo);
 
-	this->meshTriangleCount = 0;
+	// The kernel descriptor set always needs it
+	int derivativeResolution = KERNEL_DERIVATIVE_FIELD ? SCENE_SDF_RESOLUTION : 1;
+	derivativeFieldTexture = new Texture3D(device, derivativeResolution, derivativeResolution, derivativeResolution, VK_FORMAT_R16G16B16A16_SFLOAT, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, samplerInfo);
 
-	glm::vec3 minBounds = glm::vec3(std::numeric_limits<float>::max());
-	glm::vec3 maxBounds = glm::vec3(-std::numeric_limits<float>::max());
+	// Same, the kernel only reads them with a radius above 1
+	int relaxationResolution = KERNEL_SEPARABLE_RELAXATION ? SCENE_SDF_RESOLUTION : 1;
 
-	for (int i = 0; i < shapes.size(); ++i)
-	{
-		for (int f = 0; f < shapes[i].mesh.num_face_vertices.size(); ++f)
-			if (shapes[i].mesh.num_face_vertices[f] == 3)
-				meshTriangleCount++;
-	}
+	for (int i = 0; i < 2; ++i)
+		relaxationSumsTextures[i] = new Texture3D(device, relaxationResolution, relaxationResolution, relaxationResolution, VK_FORMAT_R32_SFLOAT, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, samplerInfo);
 
-	for (int i = 0; i < attrib.vertices.size(); i += 3)
-	{
-		glm::vec3 v;
-		v.x = attrib.vertices[i + 0];
-		v.y = attrib.vertices[i + 1];
-		v.z = attrib.vertices[i + 2];
+	// Only sized for the whole grid when the instrumented pass is on, Vulkan does not allow empty buffers
+	VkDeviceSize traversalStatsSize = glm::max(GetTraversalStatsCount(), size_t(1)) * sizeof(uint32_t);
+	BufferUtils::CreateBuffer(device, traversalStatsSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, traversalStatsBuffer, traversalStatsBufferMemory);
+	vkMapMemory(device->GetVkDevice(), traversalStatsBufferMemory, 0, traversalStatsSize, 0, &traversalStatsMappedData);
 
-		minBounds = glm::min(minBounds, v);
-		maxBounds = glm::max(maxBounds, v);
-	}
+	VkDeviceSize coarseSDFSize = glm::max(GetCoarseSDFCount(), size_t(1)) * sizeof(float);
+	BufferUtils::CreateBuffer(device, coarseSDFSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, coarseSDFBuffer, coarseSDFBufferMemory);
+	vkMapMemory(device->GetVkDevice(), coarseSDFBufferMemory, 0, coarseSDFSize, 0, &coarseSDFMappedData);
+}
 
-	glm::vec3 centerPivot = (maxBounds + minBounds) * .5f;
-	glm::vec3 meshSize = glm::abs((maxBounds - minBounds) * .5f / scaleMultiplier);
-	float meshUniformSize = glm::max(meshSize.x, glm::max(meshSize.y, meshSize.z)) + .00001;
-	
-	int currentOffset = 0;
-	this->meshBufferObject = new TriangleData[meshTriangleCount];
+void Scene::LoadMesh(const std::string filename, float scaleMultiplier, int maxDepth, int maxLeafSize)
+{
+	uint64_t cacheKey = 0;
+	bool cacheable = MeshCache::ComputeKey(filename, scaleMultiplier, maxDepth, maxLeafSize, KD_TREE_SPLIT_METHOD, KD_TREE_SPATIAL_SPLITS, KD_TREE_TRIANGLE_LAYOUT, cacheKey);
 
-	std::vector<Triangle*> triangles;
+	// The generated volumes are keyed by the same hash
+	this->meshCacheKey = cacheable ? cacheKey : 0;
+	std::string cachePath = MeshCache::GetCachePath(cacheKey);
 
-	for (int m = 0; m < shapes.size(); ++m)
+	if (cacheable)
 	{
-		int indexOffset = 0;
+		MeshCache cache;
 
-		for (int f = 0; f < shapes[m].mesh.num_face_vertices.size(); ++f)
+		if (cache.Open(cachePath, cacheKey))
 		{
-			if (shapes[m].mesh.num_face_vertices[f] == 3)
-			{
-				int i1 = shapes[m].mesh.indices[indexOffset + 0].vertex_index;
-				int i2 = shapes[m].mesh.indices[indexOffset + 1].vertex_index;
-				int i3 = shapes[m].mesh.indices[indexOffset + 2].vertex_index;
-				indexOffset += 3;
-
-				TriangleData tri;
-
-				// v1
-				tri.v1.x = attrib.vertices[i1 * 3 + 0];
-				tri.v1.y = attrib.vertices[i1 * 3 + 1];
-				tri.v1.z = attrib.vertices[i1 * 3 + 2];
-
-				// v2
-				tri.v2.x = attrib.vertices[i2 * 3 + 0];
-				tri.v2.y = attrib.vertices[i2 * 3 + 1];
-				tri.v2.z = attrib.vertices[i2 * 3 + 2];
-
-				// v3
-				tri.v3.x = attrib.vertices[i3 * 3 + 0];
-				tri.v3.y = attrib.vertices[i3 * 3 + 1];
-				tri.v3.z = attrib.vertices[i3 * 3 + 2];
-
-				// Transform
-				tri.v1 = (tri.v1 - centerPivot) / meshUniformSize;
-				tri.v2 = (tri.v2 - centerPivot) / meshUniformSize;
-				tri.v3 = (tri.v3 - centerPivot) / meshUniformSize;
-
-				this->meshBufferObject[currentOffset] = tri;
-				currentOffset++;
-
-				Triangle * fullTri = new Triangle();
-				fullTri->p1 = tri.v1;
-				fullTri->p2 = tri.v2;
-				fullTri->p3 = tri.v3;
-
-				//// n1
-				//fullTri->n1.x = attrib.normals[i1 * 3 + 0];
-				//fullTri->n1.y = attrib.normals[i1 * 3 + 1];
-				//fullTri->n1.z = attrib.normals[i1 * 3 + 2];
-
-				//// n2
-				//fullTri->n2.x = attrib.normals[i2 * 3 + 0];
-				//fullTri->n2.y = attrib.normals[i2 * 3 + 1];
-				//fullTri->n2.z = attrib.normals[i2 * 3 + 2];
-
-				//// n3
-				//fullTri->n3.x = attrib.normals[i3 * 3 + 0];
-				//fullTri->n3.y = attrib.normals[i3 * 3 + 1];
-				//fullTri->n3.z = attrib.normals[i3 * 3 + 2];
-
-				triangles.push_back(fullTri);
-			}
-			else
-			{
-				// Ignore this face
-				indexOffset += shapes[m].mesh.num_face_vertices[f];
-			}
+			CreateMeshBuffers(cache.GetKdTree());
+			std::cout << "Loaded " << filename << " with " << meshTriangleCount << " triangles from " << cachePath << std::endl;
+			return;
 		}
 	}
 
-	Mesh kdMesh(9, 5, triangles);
+	// The obj arrays are released as soon as the triangles are in the soup
+	Arena arena;
+	TriangleSoup triangles;
+
+	{
+		ObjData obj;
+		std::string error;
+
+		if (!ObjParser::Load(filename, obj, error))
+			throw std::runtime_error(error);
+
+		triangles.Load(arena, obj, scaleMultiplier);
+	}
+
+	Mesh kdMesh(maxDepth, maxLeafSize, triangles, KD_TREE_SPLIT_METHOD, KD_TREE_SPATIAL_SPLITS, KD_TREE_TRIANGLE_LAYOUT);
 	kdMesh.Build();
+	kdMesh.GetStats().Print();
 
-	//this->meshBufferSize = sizeof(TriangleData) * meshTriangleCount;
-	this->meshBufferSize = kdMesh.compactTriangleSize;
+	CompactKdTree tree = kdMesh.GetCompactKdTree();
+	CreateMeshBuffers(tree);
 
-	//std::cout << centerPivot.x << ", " << centerPivot.y << ", " << centerPivot.z << std::endl;
-	//std::cout << meshUniformSize << std::endl;
-	//std::cout << "sizeof(TriangleData) " << sizeof(TriangleData) << std::endl;
 	std::cout << "Loaded " << filename << " with " << meshTriangleCount << " triangles" << std::endl;
 
-	// Triangle buffer
-	BufferUtils::CreateBuffer(device, kdMesh.compactTriangleSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, meshBuffer, meshBufferMemory);
-	vkMapMemory(device->GetVkDevice(), meshBufferMemory, 0, kdMesh.compactTriangleSize, 0, &meshMappedData);
-	memcpy(meshMappedData, kdMesh.compactTriangles, kdMesh.compactTriangleSize);
+	if (cacheable && !MeshCache::Save(cachePath, cacheKey, tree))
+		std::cout << "Could not write mesh cache " << cachePath << std::endl;
+}
+
+void Scene::CreateMeshBuffers(const CompactKdTree& tree)
+{
+	bool packed = tree.triangleLayout == TriangleLayout::Packed;
+
+	this->meshTriangleCount = tree.triangleCount;
+	this->meshTriangleLayout = tree.triangleLayout;
+	this->meshBufferSize = tree.triangleCount * (packed ? sizeof(PackedTriangle) : sizeof(TriangleData));
+
+	int nodeBufferSize = tree.nodeCount * sizeof(CompactNode);
+	int pairParentBufferSize = tree.pairCount * sizeof(int);
+
+	// Vulkan does not allow empty buffers
+	int leafIndexBufferSize = glm::max(tree.leafIndexCount, 1) * sizeof(int);
+	int vertexBufferSize = glm::max(tree.vertexCount, 1) * sizeof(glm::vec3);
+
+	// Triangle buffer, read as TriangleData or PackedTriangle depending on the layout
+	BufferUtils::CreateBuffer(device, meshBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, meshBuffer, meshBufferMemory);
+	vkMapMemory(device->GetVkDevice(), meshBufferMemory, 0, meshBufferSize, 0, &meshMappedData);
+	memcpy(meshMappedData, packed ? static_cast<const void*>(tree.packedTriangles) : tree.triangles, meshBufferSize);
+
+	// Vertices shared by packed triangles
+	BufferUtils::CreateBuffer(device, vertexBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, vertexBuffer, vertexBufferMemory);
+	vkMapMemory(device->GetVkDevice(), vertexBufferMemory, 0, vertexBufferSize, 0, &vertexMappedData);
+
+	if (tree.vertexCount > 0)
+		memcpy(vertexMappedData, tree.vertices, tree.vertexCount * sizeof(glm::vec3));
 
 	// kd-tree index buffer
-	BufferUtils::CreateBuffer(device, kdMesh.compactNodeSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, indexBuffer, indexBufferMemory);
-	vkMapMemory(device->GetVkDevice(), indexBufferMemory, 0, kdMesh.compactNodeSize, 0, &indexMappedData);
-	memcpy(indexMappedData, kdMesh.compactNodes, kdMesh.compactNodeSize);
+	BufferUtils::CreateBuffer(device, nodeBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, indexBuffer, indexBufferMemory);
+	vkMapMemory(device->GetVkDevice(), indexBufferMemory, 0, nodeBufferSize, 0, &indexMappedData);
+	memcpy(indexMappedData, tree.nodes, nodeBufferSize);
+
+	// Parent links for the stackless traversal
+	BufferUtils::CreateBuffer(device, pairParentBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, pairParentBuffer, pairParentBufferMemory);
+	vkMapMemory(device->GetVkDevice(), pairParentBufferMemory, 0, pairParentBufferSize, 0, &pairParentMappedData);
+	memcpy(pairParentMappedData, tree.pairParents, pairParentBufferSize);
+
+	// Triangle indices referenced by the leaves
+	BufferUtils::CreateBuffer(device, leafIndexBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, leafIndexBuffer, leafIndexBufferMemory);
+	vkMapMemory(device->GetVkDevice(), leafIndexBufferMemory, 0, leafIndexBufferSize, 0, &leafIndexMappedData);
+	memcpy(leafIndexMappedData, tree.leafIndices, tree.leafIndexCount * sizeof(int));
 
 	// Mesh attributes buffer
 	BufferUtils::CreateBuffer(device, sizeof(int), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, meshAttributeBuffer, meshAttributeBufferMemory);
 	vkMapMemory(device->GetVkDevice(), meshAttributeBufferMemory, 0, sizeof(int), 0, &meshAttributeMappedData);
 	memcpy(meshAttributeMappedData, &this->meshTriangleCount, sizeof(int));
+
+	// Keeps what it needs of the tree, which may be a mapped mesh cache about to close
+	if (GENERATOR_WINDING_SIGN) {
+		delete meshWindingNumber;
+		meshWindingNumber = new WindingNumber(tree);
+	}
 }
 
 VkBuffer Scene::GetMeshIndexBuffer()
@@ -219,6 +216,67 @@ VkBuffer Scene::GetMeshIndexBuffer()
 	return indexBuffer;
 }
 
+VkBuffer Scene::GetMeshLeafIndexBuffer()
+{
+	return leafIndexBuffer;
+}
+
+VkBuffer Scene::GetMeshPairParentBuffer()
+{
+	return pairParentBuffer;
+}
+
+VkBuffer Scene::GetTraversalStatsBuffer()
+{
+	return traversalStatsBuffer;
+}
+
+const uint32_t * Scene::GetTraversalStats() const
+{
+	return static_cast<const uint32_t*>(traversalStatsMappedData);
+}
+
+size_t Scene::GetTraversalStatsCount() const
+{
+	return GENERATOR_TRAVERSAL_STATS ? static_cast<size_t>(SCENE_SDF_RESOLUTION) * SCENE_SDF_RESOLUTION * SCENE_SDF_RESOLUTION : 0;
+}
+
+VkBuffer Scene::GetCoarseSDFBuffer()
+{
+	return coarseSDFBuffer;
+}
+
+const float * Scene::GetCoarseSDF() const
+{
+	return static_cast<const float*>(coarseSDFMappedData);
+}
+
+size_t Scene::GetCoarseSDFCount() const
+{
+	size_t samples = GENERATOR_COARSE_RESOLUTION + 1;
+	return GENERATOR_COARSE_RESOLUTION > 0 ? samples * samples * samples : 0;
+}
+
+VkBuffer Scene::GetMeshVertexBuffer()
+{
+	return vertexBuffer;
+}
+
+TriangleLayout Scene::GetMeshTriangleLayout()
+{
+	return meshTriangleLayout;
+}
+
+uint64_t Scene::GetMeshCacheKey() const
+{
+	return meshCacheKey;
+}
+
+const WindingNumber* Scene::GetWindingNumber() const
+{
+	return meshWindingNumber;
+}
+
 VkBuffer Scene::GetMeshBuffer()
 {
 	return meshBuffer;
@@ -268,7 +326,7 @@ void Scene::CreateVectorField()
 	samplerInfo.minLod = 0.0f;
 	samplerInfo.maxLod = 0.0f;
 	//VK_FORMAT_R8G8B8A8_UNORM
-	this->vectorFieldTexture = new Texture3D(device, 256, 256, 256, VK_FORMAT_R32G32B32A32_SFLOAT, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, samplerInfo);
+	this->vectorFieldTexture = new Texture3D(device, 256, 256, 256, VK_FORMAT_R32G32B32A32_SFLOAT, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, samplerInfo);
 }
 
 Texture3D * Scene::GetVectorField()
@@ -285,460 +343,72 @@ Texture3D * Scene::GetSceneSDF(int index)
 	return sceneSDF[index];
 }
 
-Scene::~Scene() {
-    vkUnmapMemory(device->GetVkDevice(), timeBufferMemory);
-    vkDestroyBuffer(device->GetVkDevice(), timeBuffer, nullptr);
-    vkFreeMemory(device->GetVkDevice(), timeBufferMemory, nullptr);
-
-	vkUnmapMemory(device->GetVkDevice(), meshBufferMemory);
-	vkDestroyBuffer(device->GetVkDevice(), meshBuffer, nullptr);
-	vkFreeMemory(device->GetVkDevice(), meshBufferMemory, nullptr);
-
-	vkUnmapMemory(device->GetVkDevice(), indexBufferMemory);
-	vkDestroyBuffer(device->GetVkDevice(), indexBuffer, nullptr);
-	vkFreeMemory(device->GetVkDevice(), indexBufferMemory, nullptr);
-
-	vkUnmapMemory(device->GetVkDevice(), meshAttributeBufferMemory);
-	vkDestroyBuffer(device->GetVkDevice(), meshAttributeBuffer, nullptr);
-	vkFreeMemory(device->GetVkDevice(), meshAttributeBufferMemory, nullptr);
-
-	for (Texture3D* t : sceneSDF)
-		delete t;
-
-	delete vectorFieldTexture;
-}
-
-glm::vec3 AABB::aabb[] = { glm::vec3(1, 1, 1),glm::vec3(1, -1, -1), glm::vec3(1, 1, -1), glm::vec3(1, -1, 1),
-glm::vec3(-1, 1, 1), glm::vec3(-1, -1, -1), glm::vec3(-1, 1, -1), glm::vec3(-1, -1, 1) };
-
-AABB AABB::Encapsulate(AABB bounds)
+Texture3D * Scene::GetClosestTriangles()
 {
-	glm::vec3 min = glm::min(this->min, bounds.min);
-	glm::vec3 max = glm::max(this->max, bounds.max);
-	return AABB(min, max);
+	return closestTriangleTexture;
 }
 
-AABB AABB::Transform(const glm::mat4x4 &transform)
+Texture3D * Scene::GetClosestBarycentrics()
 {
-	// If infinite box, prevent overflowing
-	if (min.x == -std::numeric_limits<float>::infinity() || min.y == -std::numeric_limits<float>::infinity() || min.z == -std::numeric_limits<float>::infinity()
-		|| max.x == std::numeric_limits<float>::infinity() || max.y == std::numeric_limits<float>::infinity() || max.z == std::numeric_limits<float>::infinity())
-	{
-		return *this;
-	}
-
-	float maxX = -std::numeric_limits<float>::infinity();
-	float maxY = -std::numeric_limits<float>::infinity();
-	float maxZ = -std::numeric_limits<float>::infinity();
-
-	float minX = std::numeric_limits<float>::infinity();
-	float minY = std::numeric_limits<float>::infinity();
-	float minZ = std::numeric_limits<float>::infinity();
-
-	glm::vec3 halfSize = (max - center);
-
-	for (int i = 0; i < 8; i++)
-	{
-		glm::vec3 v = center + (AABB::aabb[i] * halfSize);
-		glm::vec3 tPoint = glm::vec3(transform * glm::vec4(v.x, v.y, v.z, 1.));
-
-		maxX = glm::max(tPoint.x, maxX);
-		maxY = glm::max(tPoint.y, maxY);
-		maxZ = glm::max(tPoint.z, maxZ);
-
-		minX = glm::min(tPoint.x, minX);
-		minY = glm::min(tPoint.y, minY);
-		minZ = glm::min(tPoint.z, minZ);
-	}
-
-	glm::vec3 newMin = glm::vec3(minX, minY, minZ);
-	glm::vec3 newMax = glm::vec3(maxX, maxY, maxZ);
-
-	return AABB(newMin, newMax);
+	return closestBarycentricsTexture;
 }
 
-glm::vec3 axisPlaneNormals[] = { glm::vec3(1.f,0,0), glm::vec3(0,1.f,0), glm::vec3(0,0,1.f) };
-
-Mesh::MeshNode::MeshNode(const std::vector<Triangle *>& originalTriangles, glm::vec3 min, glm::vec3 max, int depth, int maxDepth, int threshold)
+Texture3D * Scene::GetDerivativeField()
 {
-	glm::vec3 extent = glm::abs(max - min);
-
-	if (extent.x > extent.y && extent.x > extent.z)
-		this->axis = 0;
-	else if (extent.y > extent.x && extent.y > extent.z)
-		this->axis = 1;
-	else
-		this->axis = 2;
-
-	this->left = nullptr;
-	this->right = nullptr;
-	this->split = 0;
-	this->BuildNode(originalTriangles, min, max, depth, maxDepth, threshold);
-	this->parentOffset = -1;
+	return derivativeFieldTexture;
 }
 
-Mesh::MeshNode::~MeshNode()
+Texture3D * Scene::GetRelaxationSums(int index)
 {
-	if (this->left != nullptr)
-		delete left;
-
-	if (this->right != nullptr)
-		delete right;
+	return relaxationSumsTextures[index];
 }
 
-void Mesh::MeshNode::BuildNode(const std::vector<Triangle *>& triangles, const glm::vec3 &minVector, const glm::vec3 &maxVector, int depth, int maxDepth, int threshold)
-{
-	if (triangles.size() > threshold && depth < maxDepth)
-	{
-		glm::vec3 axisNormal = axisPlaneNormals[axis];
-
-		float minAxis = minVector[axis];
-		float maxAxis = maxVector[axis];
-
-		// If axis cannot be subdivided, we stop, to prevent jumping
-		// between axis indefinitely
-		if (glm::abs(minAxis - maxAxis) < glm::epsilon<float>())
-		{
-			this->nodeTriangles = triangles;
-			this->left = nullptr;
-			this->right = nullptr;
-			return;
-		}
-
-		split = GetSplitPoint(triangles, minVector[axis], maxVector[axis]);
-
-		std::vector<Triangle*> leftShapes;
-		std::vector<Triangle*> rightShapes;
-
-		for (int i = 0; i < triangles.size(); i++)
-		{
-			Triangle * tri = triangles[i];
-			AABB bounds = tri->bounds;
-
-			float p = bounds.center[axis];
-
-			// If shape position is on right, surely its on right node
-			if (p > split) {
-				rightShapes.push_back(tri);
-
-				// But if bounding box collides with plane, add on left
-				// node
-				float min = bounds.min[axis];
-
-				if (min <= split)
-					leftShapes.push_back(tri);
-
-			}
-			else {
-				leftShapes.push_back(tri);
-
-				// But if bounding box collides with plane, add on right
-				// node
-				float max = bounds.max[axis];
-
-				if (max >= split)
-					rightShapes.push_back(tri);
-			}
-		}
-
-		glm::vec3 leftMax = maxVector - (axisNormal * glm::abs(maxVector[axis] - split));
-		glm::vec3 rightMin = minVector + (axisNormal * glm::abs(split - minVector[axis]));
-
-		this->left = new MeshNode(leftShapes, minVector, leftMax, depth + 1, maxDepth, threshold);
-		this->right = new MeshNode(rightShapes, rightMin, maxVector, depth + 1, maxDepth, threshold);
-	}
-	else
-	{
-		this->nodeTriangles = triangles;
-		this->left = nullptr;
-		this->right = nullptr;
-	}
-}
-
-float Mesh::MeshNode::CostFunction(float split, const std::vector<Triangle *>& triangles, float minAxis, float maxAxis)
-{
-	int leftCount = 0;
-	int rightCount = 0;
-
-	for (int i = 0; i < triangles.size(); i++)
-	{
-		Triangle * tri = triangles[i];
-		AABB bounds = tri->bounds;
-
-		float p = bounds.center[axis];
-
-		// If shape position is on right, surely its on right node
-		if (p > split) {
-			rightCount++;
-
-			// But if bounding box collides with plane, add on left
-			// node
-			float min = bounds.min[axis];
-
-			if (min <= split)
-				leftCount++;
-
-		}
-		else {
-			leftCount++;
-
-			// But if bounding box collides with plane, add on right
-			// node
-			float max = bounds.max[axis];
-
-			if (max >= split)
-				rightCount++;
-		}
-	}
-
-	// Here we simplify Surface area by using just the size on the split
-	// axis
-	float leftSize = split - minAxis;
-	float rightSize = maxAxis - split;
-
-	return (leftSize * leftCount) + (rightSize * rightCount);
-}
-
-float Mesh::MeshNode::GetSplitPoint(const std::vector<Triangle *> &triangles, float minAxis, float maxAxis)
-{
-	// Spatial median
-	float center = (maxAxis + minAxis) * .5f;
-
-	// Object median
-	float objMedian = 0;
-
-	for (int i = 0; i < triangles.size(); i++)
-		objMedian += triangles[i]->bounds.center[axis];
-
-	objMedian /= triangles.size();
-
-	float step = (center - objMedian) / SAH_SUBDIV;
-
-	float minCost = std::numeric_limits<float>::infinity();
-	float result = objMedian;
-
-	//if (glm::abs(step) > glm::epsilon<float>())
-	//{
-	//	// i is the proposed split point
-	//	for (float i = objMedian; i < center; i += step)
-	//	{
-	//		float cost = CostFunction(i, triangles, minAxis, maxAxis);
-
-	//		if (minCost > cost)
-	//		{
-	//			minCost = cost;
-	//			result = i;
-	//		}
-	//	}
-	//}
-
-	// return result;
-
-	return (center + objMedian) * .5f;
-}
-
-int Mesh::MeshNode::GetNodeCount()
-{
-	if (IsLeaf())
-		return 1;
-	else
-		return 1 + left->GetNodeCount() + right->GetNodeCount();
-}
-
-int Mesh::MeshNode::TriangleCount()
-{
-	if (IsLeaf())
-		return this->nodeTriangles.size();
-	else
-		return left->TriangleCount() + right->TriangleCount();
-}
-
-int Mesh::MeshNode::GetDepth()
-{
-	if (IsLeaf())
-		return 1;
-
-	return glm::max(left->GetDepth(), right->GetDepth()) + 1;
-}
-
-bool Mesh::MeshNode::IsLeaf()
-{
-	return left == nullptr && right == nullptr;
-}
-
-Mesh::Mesh(int maxDepth, int maxLeafSize, std::vector<Triangle*>& triangles) : maxDepth(maxDepth), maxLeafSize(maxLeafSize), root(nullptr), compactNodes(nullptr), triangles(triangles)
-{
-}
-
-Mesh::~Mesh()
-{
-	if (this->root != nullptr)
-		delete this->root;
-
-	if (this->compactNodes != nullptr)
-		delete[] this->compactNodes;
-
-
-	if (this->compactTriangles != nullptr)
-		delete[] this->compactTriangles;
-}
-
-AABB Mesh::CalculateAABB()
-{
-	AABB bounds;
-
-	if (triangles.size() > 0)
-		bounds = triangles[0]->bounds;
-
-	for (int i = 1; i < triangles.size(); i++)
-		bounds = bounds.Encapsulate(triangles[i]->bounds);
-
-	return bounds;
-}
-
-void Mesh::Build()
-{
-	for (int i = 0; i < triangles.size(); i++)
-	{
-		Triangle * t = triangles[i];
-		glm::vec3 min = glm::min(t->p1, glm::min(t->p2, t->p3));
-		glm::vec3 max = glm::max(t->p1, glm::max(t->p2, t->p3));
-		t->bounds = AABB(min - glm::vec3(glm::epsilon<float>()), max + glm::vec3(glm::epsilon<float>()));
-	}
-
-	meshBounds = this->CalculateAABB();
-	this->root = new MeshNode(triangles, meshBounds.min, meshBounds.max, 0, this->maxDepth, this->maxLeafSize);
-
-	std::cout << "---------------------------------------------" << std::endl;
-	std::cout << "kd-tree depth " << this->root->GetDepth() << std::endl;
-	std::cout << "kd-tree node count " << this->root->GetNodeCount() << std::endl;
-	std::cout << "kd-tree triangle count " << this->root->TriangleCount() << std::endl;
-
-	this->Compact();
-
-	std::cout << "---------------------------------------------" << std::endl;
-}
-
-void Mesh::Compact()
-{
-	int nodeCount = this->root->GetNodeCount();
-	int triangleCount = this->root->TriangleCount();
-	
-	this->compactNodes = new CompactNode[nodeCount];
-	this->compactTriangles = new TriangleData[triangleCount];
-
-	this->compactNodeSize = nodeCount * sizeof(CompactNode);
-	this->compactTriangleSize = triangleCount * sizeof(TriangleData);
-
-	int totalMemory = compactNodeSize + compactTriangleSize;
-	std::cout << "kd-tree node memory: " << (int)(compactNodeSize / (1024.f)) << " kb" << std::endl;
-	std::cout << "Total compact kd-tree memory: " << (int)(totalMemory / (1024.f * 1024.f)) << " MB" << std::endl;
-	std::cout << "Sizeof compact node " << sizeof(CompactNode) << std::endl;
+Scene::~Scene() {
+    vkUnmapMemory(device->GetVkDevice(), timeBufferMemory);
+    vkDestroyBuffer(device->GetVkDevice(), timeBuffer, nullptr);
+    vkFreeMemory(device->GetVkDevice(), timeBufferMemory, nullptr);
 
-	std::stack<MeshNode*> stack;
-	stack.push(this->root);
+	vkUnmapMemory(device->GetVkDevice(), meshBufferMemory);
+	vkDestroyBuffer(device->GetVkDevice(), meshBuffer, nullptr);
+	vkFreeMemory(device->GetVkDevice(), meshBufferMemory, nullptr);
 
-	int offset = 0;
-	int triangleOffset = 0;
+	vkUnmapMemory(device->GetVkDevice(), vertexBufferMemory);
+	vkDestroyBuffer(device->GetVkDevice(), vertexBuffer, nullptr);
+	vkFreeMemory(device->GetVkDevice(), vertexBufferMemory, nullptr);
 
-	while (!stack.empty())
-	{
-		MeshNode * node = stack.top();
-		stack.pop();
+	vkUnmapMemory(device->GetVkDevice(), indexBufferMemory);
+	vkDestroyBuffer(device->GetVkDevice(), indexBuffer, nullptr);
+	vkFreeMemory(device->GetVkDevice(), indexBufferMemory, nullptr);
 
-		if (node == nullptr)
-			continue;
+	vkUnmapMemory(device->GetVkDevice(), leafIndexBufferMemory);
+	vkDestroyBuffer(device->GetVkDevice(), leafIndexBuffer, nullptr);
+	vkFreeMemory(device->GetVkDevice(), leafIndexBufferMemory, nullptr);
 
-		// If this node is the child of a parent, let's set the current offset
-		if (node->parentOffset != -1)
-		{
-			int left = node->parentOffset % 2 == 0;
-			int parentOffset = node->parentOffset / 2;
-			//compactNodes[node->parentOffset] = offset;
-
-			if (left)
-				compactNodes[parentOffset].leftNode = offset;
-			else
-				compactNodes[parentOffset].rightNode = offset;
-		}
+	vkUnmapMemory(device->GetVkDevice(), pairParentBufferMemory);
+	vkDestroyBuffer(device->GetVkDevice(), pairParentBuffer, nullptr);
+	vkFreeMemory(device->GetVkDevice(), pairParentBufferMemory, nullptr);
 
-		CompactNode & cNode = compactNodes[offset];
-		cNode.leftNode = -1;
-		cNode.rightNode = -1;
-		cNode.split = node->split;
-		cNode.axis = node->axis;
+	vkUnmapMemory(device->GetVkDevice(), traversalStatsBufferMemory);
+	vkDestroyBuffer(device->GetVkDevice(), traversalStatsBuffer, nullptr);
+	vkFreeMemory(device->GetVkDevice(), traversalStatsBufferMemory, nullptr);
 
-		if (node->IsLeaf())
-		{
-			cNode.primitiveCount = node->nodeTriangles.size();
-			cNode.primitiveStartOffset = triangleOffset;
-
-			int triCount = node->nodeTriangles.size();
-
-			for (int i = 0; i < triCount; i++)
-			{
-				Triangle * triangle = node->nodeTriangles[i];
-				TriangleData & tri = compactTriangles[triangleOffset + i];
-
-				// v1
-				tri.v1 = triangle->p1;
-				tri.v2 = triangle->p2;
-				tri.v3 = triangle->p3;
-
-				// Offsets
-				tri.v21 = glm::vec4(tri.v2 - tri.v1, 0.f);
-				tri.v32 = glm::vec4(tri.v3 - tri.v2, 0.f);
-				tri.v13 = glm::vec4(tri.v1 - tri.v3, 0.f);
-
-				// Magnitudes
-				tri.v21.w = 1.f / glm::dot(tri.v21, tri.v21);
-				tri.v32.w = 1.f / glm::dot(tri.v32, tri.v32);
-				tri.v13.w = 1.f / glm::dot(tri.v13, tri.v13);
-
-				// Unnormalized normal
-				tri.normal = glm::normalize(glm::cross(glm::vec3(tri.v21), glm::vec3(tri.v13)));
-/*
-				tri.n1 = tri.normal;
-				tri.n2 = tri.normal;
-				tri.n3 = tri.normal;*/
-/*
-				tri.n1 = glm::vec4(glm::normalize(triangle->n1), 0.0f);
-				tri.n2 = glm::vec4(glm::normalize(triangle->n2), 0.0f);
-				tri.n3 = glm::vec4(glm::normalize(triangle->n3), 0.0f);*/
-				//tri.smoothNormal = glm::vec4(glm::normalize(triangle->n1 + triangle->n2 + triangle->n3), 0.0);
-
-				tri.t21 = glm::cross(glm::vec3(tri.v21), glm::vec3(tri.normal));
-				tri.t32 = glm::cross(glm::vec3(tri.v32), glm::vec3(tri.normal));
-				tri.t13 = glm::cross(glm::vec3(tri.v13), glm::vec3(tri.normal));
-
-				// We bent the normals a bit! This hack is good to have *reasonable and fast* triangle orientation
-				tri.t21 = glm::normalize(tri.t21 + glm::vec3(tri.normal) * .03f);
-				tri.t32 = glm::normalize(tri.t32 + glm::vec3(tri.normal) * .03f);
-				tri.t13 = glm::normalize(tri.t13 + glm::vec3(tri.normal) * .03f);
-
-				glm::vec3 c = (tri.v1 + tri.v2 + tri.v3) / 3.f;
-				float radius = glm::max(glm::length(c - tri.v1), glm::max(glm::length(c - tri.v2), glm::length(c - tri.v3)));
-				
-				tri.center = glm::vec4(c.x, c.y, c.z, radius);
-			}
-
-			triangleOffset += triCount;
-		}
-		else
-		{
-			cNode.primitiveCount = 0;
+	vkUnmapMemory(device->GetVkDevice(), coarseSDFBufferMemory);
+	vkDestroyBuffer(device->GetVkDevice(), coarseSDFBuffer, nullptr);
+	vkFreeMemory(device->GetVkDevice(), coarseSDFBufferMemory, nullptr);
 
-			node->left->parentOffset = offset * 2;
-			node->right->parentOffset = offset * 2 + 1;
+	vkUnmapMemory(device->GetVkDevice(), meshAttributeBufferMemory);
+	vkDestroyBuffer(device->GetVkDevice(), meshAttributeBuffer, nullptr);
+	vkFreeMemory(device->GetVkDevice(), meshAttributeBufferMemory, nullptr);
 
-			stack.push(node->left);
-			stack.push(node->right);
-		}
+	for (Texture3D* t : sceneSDF)
+		delete t;
 
-		offset++;
-	}
+	delete meshWindingNumber;
+	delete closestTriangleTexture;
+	delete closestBarycentricsTexture;
+	delete derivativeFieldTexture;
+	delete relaxationSumsTextures[0];
+	delete relaxationSumsTextures[1];
 
-	// Now that everything is copied and compacted, we can delete our root
-	delete this->root;
-	this->root = nullptr;
+	delete vectorFieldTexture;
 }
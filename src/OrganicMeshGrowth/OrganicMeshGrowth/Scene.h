@@ -3,125 +3,108 @@
 #include <glm/glm.hpp>
 #include <chrono>
 
+#include "Mesh.h"
 #include "Model.h"
 #include "Texture3D.h"
+#include "WindingNumber.h"
 
 using namespace std::chrono;
 
-struct TriangleData {
-	GLM_ALIGN(16) glm::vec3 v1, v2, v3;
-	GLM_ALIGN(16) glm::vec4 v21, v32, v13;
-	GLM_ALIGN(16) glm::vec3 normal;// , n1, n2, n3;
-	GLM_ALIGN(16) glm::vec3 t21, t32, t13;
-	GLM_ALIGN(16) glm::vec4 center; // (center, radius)
+// kd-tree build parameters, part of the mesh cache key. Depth and leaf size are the LoadMesh defaults.
+#define KD_TREE_MAX_DEPTH 12
+#define KD_TREE_MAX_LEAF_SIZE 5
+#define KD_TREE_SPLIT_METHOD KdSplitMethod::SAH
+#define KD_TREE_SPATIAL_SPLITS true
+#define KD_TREE_TRIANGLE_LAYOUT TriangleLayout::Packed
+
+#define SCENE_SDF_RESOLUTION 256
+
+// Instrumented generator pass: node fetches and triangle tests per voxel, printed as percentiles
+// after GenerateSceneSDF. Costs SCENE_SDF_RESOLUTION^3 * 4 bytes of host visible memory.
+#define GENERATOR_TRAVERSAL_STATS false
+
+// Each 8^3 workgroup gathers the triangles that can be closest to any of its voxels once, and its voxels only test
+// those, falling back to the per voxel traversal above BRICK_MAX_CANDIDATES. Pays off at high resolutions, where
+// bricks are small: at 256^3 it cuts triangle tests per voxel 2-7x, see Benchmark::BrickCulling. Off until it is timed
+// on a device: the first invocation gathers alone while the other 511 wait at the barrier, which can cost more than the
+// tests it saves, and bricks over the cap pay for the gather and the traversal.
+#define GENERATOR_BRICK_CULLING false
+
+// Coarse to fine generation: exact distances at this resolution first, then only for voxels in coarse cells that may
+// hold the surface, the rest interpolated. A power of two below SCENE_SDF_RESOLUTION (64 skips 75-93% of the queries
+// at 256^3), 0 queries every voxel. Off by default: interpolated voxels can be off by up to a cell or flip sign where
+// the full pass has a bent normal leak, and get no closest feature. See SdfHierarchy and Benchmark::HierarchicalBaking.
+#define GENERATOR_COARSE_RESOLUTION 0
+
+// The generator runs over cubic tiles of this many voxels, a multiple of its workgroup size (8),
+// submitted in batches so no single submit runs long enough to trigger a TDR reset
+#define GENERATOR_TILE_SIZE 32
+#define GENERATOR_BATCHES_IN_FLIGHT 2
+
+// Batches are sized from the measured cost of the previous one to stay under this much GPU time
+#define GENERATOR_MAX_SUBMIT_MS 100.0
+
+// How often the progress callback runs while waiting on a batch
+#define GENERATOR_POLL_MS 16
+
+// Keeps the generated sdf and vector field in MESH_CACHE_DIRECTORY, keyed by the mesh cache key, resolution and a hash of
+// the generator shader and its specialization constants. Later runs upload them instead of generating.
+#define GENERATOR_CACHE true
+
+// The vector field is baked on the CPU by NoiseBaker and cached on its own, keyed only by the noise parameters and
+// resolution, so switching meshes never bakes it again and the noise can change without touching the sdf.
+// The generator then skips its noise. Off, the generator writes both like before.
+#define GENERATOR_CPU_NOISE true
+
+// The generator signs distances with bent normals, which leak through holes and thin parts of scans. With this on, the
+// CPU then gives every voxel the sign of the generalized winding number instead, brick by brick like --bake does, and
+// only the magnitudes come from the GPU. Reads the sdf back and uploads it again, once per mesh with GENERATOR_CACHE.
+// See SdfBaker::SignWithWindingNumber and the "+ winding pass" rows of Benchmark::SignMethods.
+#define GENERATOR_WINDING_SIGN true
+
+// What the generator writes next to the distances, CLOSEST_FEATURE in generator.comp
+enum class ClosestFeatureOutput
+{
+	None,
+	Triangle,					// Index of the closest triangle per voxel, ClosestFeature::NO_TRIANGLE where none was queried
+	TriangleAndBarycentrics		// Plus the v2 and v3 weights of the closest point, packUnorm2x16
 };
 
+// Closest feature transform: the generator already finds the closest triangle of every voxel, this keeps it in
+// R32_UINT volumes for texture transfer and attribute lookups. Costs SCENE_SDF_RESOLUTION^3 * 4 bytes per volume,
+// the disabled ones are 1^3. With GENERATOR_COARSE_RESOLUTION above 0 the voxels it interpolates have no triangle.
+// See Benchmark::ClosestFeatures.
+#define GENERATOR_CLOSEST_FEATURE ClosestFeatureOutput::None
+
+// Every frame bricks.comp lists the 8^3 bricks next to one with a cell inside the activation band of the kernel.comp
+// behaviour, and the kernel only runs those with an indirect dispatch, so its cost follows the surface instead of the
+// volume. Bricks that drop out are copied once so both volumes agree. This changes the behaviours a little: the inside
+// noise expansion and the curl have no activation window, so outside the band they stop acting, as does the
+// relaxation. The band matches the dense result, the whole volume is within 1.1e-3 to 3.1e-3 depending on the behaviour
+// after 30 frames at 128^3 with no sign flips, see GrowthSimulator::SetSparse and Benchmark::SparseGrowth. Widening the
+// band for them would cover the interior or the whole volume. Off until --check-step shows the shaders match the CPU
+// on a device.
+#define KERNEL_SPARSE_BRICKS false
+
+// derivatives.comp writes the normal and curv2 of every cell the kernel updates into an RGBA16F volume first, and the
+// kernel reads one texel instead of their 13 taps. The taps just move to the extra pass, each behaviour reads them once
+// already, so it only pays off when the kernel is the bottleneck of the texture units. Costs SCENE_SDF_RESOLUTION^3 * 8
+// bytes, 1^3 when off. See GrowthSimulator::SetDerivativeField and Benchmark::DerivativeField.
+#define KERNEL_DERIVATIVE_FIELD false
+
+// Behaviours with a relaxation radius above 1 run relaxation.comp along x and y first and the kernel adds up the z
+// sums, 3 (2 radius + 1) loads per cell instead of the (2 radius + 1)^3 of the kernel loop, which is what makes wide
+// kernels usable at 256^3. Costs 2 * SCENE_SDF_RESOLUTION^3 * 4 bytes, 1^3 when off and the kernel loops over the box.
+// See GrowthSimulator::SetSeparableRelaxation and Benchmark::SeparableRelaxation. Off until --check-step with a wide
+// radius shows relaxation.comp and the kernel match the CPU on a device.
+#define KERNEL_SEPARABLE_RELAXATION false
+
 struct Time {
     float deltaTime = 0.0f;
     float totalTime = 0.0f;
 	float simulationDeltaTime = 0.0001f;
 };
 
-struct CompactNode
-{
-	GLM_ALIGN(4) int leftNode;	// The index of the left node
-	GLM_ALIGN(4) int rightNode;	// The index of the right node
-
-	GLM_ALIGN(4) int axis;		// The axis for this node
-	GLM_ALIGN(4) float split;	// The offset on this axis
-
-	GLM_ALIGN(4) int primitiveCount;			// The size of this leaf
-	GLM_ALIGN(4) int primitiveStartOffset;	// The offset where the triangles are
-
-	GLM_ALIGN(4) int pad1, pad2;
-};
-
-class AABB
-{
-public:
-	AABB(const glm::vec3& min, const glm::vec3& max) : min(min), max(max), center((min + max) * .5f) {}
-	AABB() : min(glm::vec3(0.f)), max(glm::vec3(0.f)), center((min + max) * .5f) {}
-
-	// Intersection is handled in device
-	AABB Encapsulate(AABB bounds);
-	AABB Transform(const glm::mat4x4& transform);
-
-	glm::vec3 min;
-	glm::vec3 max;
-	glm::vec3 center;
-
-private:
-	static glm::vec3 aabb[];
-};
-
-struct Triangle
-{
-	// Data
-	glm::vec3 p1;
-	glm::vec3 p2;
-	glm::vec3 p3;
-
-	//// Normals
-	//glm::vec3 n1;
-	//glm::vec3 n2;
-	//glm::vec3 n3;
-
-	AABB bounds;
-};
-
-// kd-tree implementation for meshes
-class Mesh
-{
-public:
-	Mesh(int maxDepth, int maxLeafSize, std::vector<Triangle*>& triangles);
-	~Mesh();
-
-	void Build();
-
-	int maxDepth;
-	AABB meshBounds;
-	int maxLeafSize;
-	
-	CompactNode * compactNodes;
-	int compactNodeSize;
-
-	TriangleData * compactTriangles;
-	int compactTriangleSize;
-
-protected:
-	struct MeshNode
-	{
-	public:
-		MeshNode(const std::vector<Triangle *> &triangles, glm::vec3 min, glm::vec3 max, int depth, int maxDepth, int threshold);
-		~MeshNode();
-
-		void BuildNode(const std::vector<Triangle *> &triangles, const glm::vec3& minVector, const glm::vec3& maxVector, int depth, int maxDepth, int threshold);
-		float CostFunction(float split, const std::vector<Triangle *> &triangles, float minAxis, float maxAxis);
-		float GetSplitPoint(const std::vector<Triangle *> &triangles, float minAxis, float maxAxis);
-
-		bool IsLeaf();
-		int GetNodeCount();
-		int TriangleCount();
-		int GetDepth();
-
-	public:
-		std::vector<Triangle *> nodeTriangles;
-		MeshNode * left;
-		MeshNode * right;
-
-		float split;
-		int axis;
-		int parentOffset; // For compaction
-	};
-
-	std::vector<Triangle*> triangles;
-	MeshNode * root;
-
-	AABB CalculateAABB();
-	void Compact();
-
-};
-
 class Scene {
 private:
     Device* device;
@@ -131,18 +114,42 @@ private:
     Time time;
 	std::vector<Texture3D*> sceneSDF;
 	Texture3D* vectorFieldTexture;
+	Texture3D* closestTriangleTexture;
+	Texture3D* closestBarycentricsTexture;
+	Texture3D* derivativeFieldTexture;
+	Texture3D* relaxationSumsTextures[2];
 
-	TriangleData * meshBufferObject;
 	VkBuffer meshBuffer;
 	VkDeviceMemory meshBufferMemory;
 	void * meshMappedData;
 	int meshTriangleCount;
+	TriangleLayout meshTriangleLayout;
+	uint64_t meshCacheKey = 0;
+	WindingNumber* meshWindingNumber = nullptr;
+
+	VkBuffer vertexBuffer;
+	VkDeviceMemory vertexBufferMemory;
+	void * vertexMappedData;
 
-	CompactNode * indexBufferObject;
 	VkBuffer indexBuffer;
 	VkDeviceMemory indexBufferMemory;
 	void * indexMappedData;
-	int indexCount;
+
+	VkBuffer leafIndexBuffer;
+	VkDeviceMemory leafIndexBufferMemory;
+	void * leafIndexMappedData;
+
+	VkBuffer pairParentBuffer;
+	VkDeviceMemory pairParentBufferMemory;
+	void * pairParentMappedData;
+
+	VkBuffer traversalStatsBuffer;
+	VkDeviceMemory traversalStatsBufferMemory;
+	void * traversalStatsMappedData;
+
+	VkBuffer coarseSDFBuffer;
+	VkDeviceMemory coarseSDFBufferMemory;
+	void * coarseSDFMappedData;
 
 	int meshBufferSize;
 	VkBuffer meshAttributeBuffer;
@@ -155,6 +162,8 @@ private:
 
 	high_resolution_clock::time_point startTime = high_resolution_clock::now();
 
+	void CreateMeshBuffers(const CompactKdTree& tree);
+
 public:
     Scene() = delete;
     Scene(Device* device);
@@ -170,9 +179,38 @@ public:
 	Texture3D* GetSceneSDF(int index);
 	void CreateSceneSDF();
 
-	void LoadMesh(std::string filename, float scaleMultiplier);
+	// Closest feature volumes of the generator, R32_UINT. Only SCENE_SDF_RESOLUTION^3 when GENERATOR_CLOSEST_FEATURE writes them.
+	Texture3D* GetClosestTriangles();
+	Texture3D* GetClosestBarycentrics();
+
+	// Normal and curv2 of the cells the kernel updates, RGBA16F. Only SCENE_SDF_RESOLUTION^3 with KERNEL_DERIVATIVE_FIELD.
+	Texture3D* GetDerivativeField();
+
+	// Box sums of relaxation.comp along x (0) and then y (1), R32F. Only SCENE_SDF_RESOLUTION^3 with KERNEL_SEPARABLE_RELAXATION.
+	Texture3D* GetRelaxationSums(int index);
+
+	void LoadMesh(std::string filename, float scaleMultiplier, int maxDepth = KD_TREE_MAX_DEPTH, int maxLeafSize = KD_TREE_MAX_LEAF_SIZE);
 
 	VkBuffer GetMeshIndexBuffer();
+	VkBuffer GetMeshLeafIndexBuffer();
+	VkBuffer GetMeshPairParentBuffer();
+
+	VkBuffer GetTraversalStatsBuffer();
+	const uint32_t * GetTraversalStats() const;
+	size_t GetTraversalStatsCount() const;
+
+	// Coarse level of the hierarchical generator, GENERATOR_COARSE_RESOLUTION + 1 samples per axis. Host visible, to count refined voxels.
+	VkBuffer GetCoarseSDFBuffer();
+	const float * GetCoarseSDF() const;
+	size_t GetCoarseSDFCount() const;
+	VkBuffer GetMeshVertexBuffer();
+	TriangleLayout GetMeshTriangleLayout();
+
+	// MeshCache key of the loaded mesh, which covers its contents, scale and kd-tree settings. 0 if the obj could not be hashed.
+	uint64_t GetMeshCacheKey() const;
+
+	// Of the loaded mesh, only built with GENERATOR_WINDING_SIGN
+	const WindingNumber* GetWindingNumber() const;
 	VkBuffer GetMeshBuffer();
 	VkBuffer GetMeshAttributeBuffer();
 	int GetMeshBufferSize();
@@ -181,4 +219,7 @@ public:
 	Texture3D* GetVectorField();
 
     float UpdateTime();
+
+	// Fixed time for a step that is compared offline, the next UpdateTime goes on from it
+	void SetTime(float totalTime, float deltaTime);
 };
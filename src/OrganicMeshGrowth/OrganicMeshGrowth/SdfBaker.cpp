@@ -0,0 +1,824 @@
+#include "SdfBaker.h"
+#include "FileUtils.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#define SDF_FILE_VERSION 1
+
+// Full rounds of the eight sweep orderings, stopping early once no voxel moved more than this fraction of a cell
+#define SDF_MAX_SWEEP_PASSES 4
+#define SDF_SWEEP_TOLERANCE .05f
+
+namespace {
+	const char MAGIC[8] = { 'O', 'M', 'G', 'S', 'D', 'F', '\0', '\0' };
+
+	// Followed by resolution^3 floats, x fastest
+	struct SdfFileHeader
+	{
+		char magic[8];
+		uint32_t version;
+		int32_t resolution;
+	};
+
+	// One array per attribute in triangleStreams
+	enum TriangleStream
+	{
+		CenterX, CenterY, CenterZ, Radius,
+		V1X, V1Y, V1Z,
+		V2X, V2Y, V2Z,
+		V3X, V3Y, V3Z,
+		V21X, V21Y, V21Z, V21W,
+		V32X, V32Y, V32Z, V32W,
+		V13X, V13Y, V13Z, V13W,
+		NormalX, NormalY, NormalZ,
+		T21X, T21Y, T21Z,
+		T32X, T32Y, T32Z,
+		T13X, T13Y, T13Z,
+		StreamCount
+	};
+
+	inline float Magnitude(const float * distances, size_t voxel)
+	{
+		return std::abs(distances[voxel]);
+	}
+
+	// One Godunov upwind update of |grad u| = 1 for a voxel, keeping the sign of its closest neighbour
+	inline void UpdateVoxel(int resolution, float h, int x, int y, int z, float * distances)
+	{
+		size_t stride[3] = { 1, static_cast<size_t>(resolution), static_cast<size_t>(resolution) * resolution };
+		int coord[3] = { x, y, z };
+		size_t voxel = x + stride[1] * y + stride[2] * z;
+
+		float axisMin[3];
+		float nearest = std::numeric_limits<float>::max();
+		float nearestValue = nearest;
+
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			float m = std::numeric_limits<float>::max();
+
+			if (coord[axis] > 0)
+			{
+				float v = distances[voxel - stride[axis]];
+				m = std::abs(v);
+
+				if (m < nearest)
+				{
+					nearest = m;
+					nearestValue = v;
+				}
+			}
+
+			if (coord[axis] < resolution - 1)
+			{
+				float v = distances[voxel + stride[axis]];
+				float av = std::abs(v);
+
+				if (av < nearest)
+				{
+					nearest = av;
+					nearestValue = v;
+				}
+
+				m = std::min(m, av);
+			}
+
+			axisMin[axis] = m;
+		}
+
+		if (nearest == std::numeric_limits<float>::max())
+			return;
+
+		// Sorted neighbour distances a <= b <= c
+		float a = std::min(std::min(axisMin[0], axisMin[1]), axisMin[2]);
+		float b = std::max(std::min(axisMin[0], axisMin[1]), std::min(std::max(axisMin[0], axisMin[1]), axisMin[2]));
+		float c = std::max(std::max(axisMin[0], axisMin[1]), axisMin[2]);
+
+		float u = a + h;
+
+		if (u > b)
+		{
+			u = .5f * (a + b + std::sqrt(2.f * h * h - (a - b) * (a - b)));
+
+			if (u > c)
+			{
+				float sum = a + b + c;
+				float discriminant = sum * sum - 3.f * (a * a + b * b + c * c - h * h);
+				u = (sum + std::sqrt(std::max(discriminant, 0.f))) / 3.f;
+			}
+		}
+
+		if (u < Magnitude(distances, voxel))
+			distances[voxel] = nearestValue < 0.f ? -u : u;
+	}
+
+	// Fast sweeping with the eight orderings. Inside one ordering a row along x only depends on the rows
+	// before it in y and z, so all rows with the same y + z are updated in parallel, each one in order.
+	// Band voxels are fixed. Returns the biggest change, to know when to stop.
+	float Sweep(int resolution, const std::vector<uint8_t>& band, float * distances)
+	{
+		float h = 2.f / resolution;
+		std::vector<float> rowChange(resolution);
+		float maxChange = 0.f;
+
+		for (int direction = 0; direction < 8; ++direction)
+		{
+			bool flipX = (direction & 1) != 0;
+			bool flipY = (direction & 2) != 0;
+			bool flipZ = (direction & 4) != 0;
+
+			for (int level = 0; level <= 2 * (resolution - 1); ++level)
+			{
+				int firstJ = std::max(0, level - (resolution - 1));
+				int lastJ = std::min(resolution - 1, level);
+
+				Parallel::For(lastJ - firstJ + 1, [&](int row) {
+					int j = firstJ + row;
+					int y = flipY ? resolution - 1 - j : j;
+					int z = flipZ ? resolution - 1 - (level - j) : level - j;
+					float change = 0.f;
+
+					for (int i = 0; i < resolution; ++i)
+					{
+						int x = flipX ? resolution - 1 - i : i;
+						size_t voxel = (static_cast<size_t>(z) * resolution + y) * resolution + x;
+
+						if (band[voxel])
+							continue;
+
+						float before = Magnitude(distances, voxel);
+						UpdateVoxel(resolution, h, x, y, z, distances);
+						change = std::max(change, before - Magnitude(distances, voxel));
+					}
+
+					rowChange[row] = change;
+				});
+
+				for (int row = 0; row <= lastJ - firstJ; ++row)
+					maxChange = std::max(maxChange, rowChange[row]);
+			}
+		}
+
+		return maxChange;
+	}
+
+#ifdef __AVX2__
+	// Plain multiplies and adds in the same order as the scalar code, no FMA, so both paths round identically
+	inline __m256 Dot(__m256 ax, __m256 ay, __m256 az, __m256 bx, __m256 by, __m256 bz)
+	{
+		return _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ax, bx), _mm256_mul_ps(ay, by)), _mm256_mul_ps(az, bz));
+	}
+
+	inline __m256 Saturate(__m256 x)
+	{
+		return _mm256_min_ps(_mm256_max_ps(x, _mm256_setzero_ps()), _mm256_set1_ps(1.f));
+	}
+
+	// glm::smoothstep(-.005, 0, x)
+	inline __m256 FaceStep(__m256 x)
+	{
+		const float a = -.005f;
+		const float b = 0.f;
+
+		__m256 t = Saturate(_mm256_div_ps(_mm256_sub_ps(x, _mm256_set1_ps(a)), _mm256_set1_ps(b - a)));
+		return _mm256_mul_ps(_mm256_mul_ps(t, t), _mm256_sub_ps(_mm256_set1_ps(3.f), _mm256_mul_ps(_mm256_set1_ps(2.f), t)));
+	}
+
+	// Squared distance from p to an edge, like d1, d2 and d3 in udTriangleSquared
+	inline __m256 EdgeDistance(const float * streams, int triangleCount, int edge, __m256i indices, __m256 mask, __m256 px, __m256 py, __m256 pz)
+	{
+		__m256 zero = _mm256_setzero_ps();
+		__m256 ex = _mm256_mask_i32gather_ps(zero, streams + (edge + 0) * triangleCount, indices, mask, 4);
+		__m256 ey = _mm256_mask_i32gather_ps(zero, streams + (edge + 1) * triangleCount, indices, mask, 4);
+		__m256 ez = _mm256_mask_i32gather_ps(zero, streams + (edge + 2) * triangleCount, indices, mask, 4);
+		__m256 ew = _mm256_mask_i32gather_ps(zero, streams + (edge + 3) * triangleCount, indices, mask, 4);
+
+		__m256 s = Saturate(_mm256_mul_ps(Dot(ex, ey, ez, px, py, pz), ew));
+		__m256 dx = _mm256_sub_ps(_mm256_mul_ps(ex, s), px);
+		__m256 dy = _mm256_sub_ps(_mm256_mul_ps(ey, s), py);
+		__m256 dz = _mm256_sub_ps(_mm256_mul_ps(ez, s), pz);
+		return Dot(dx, dy, dz, dx, dy, dz);
+	}
+
+	// udTriangleFast for up to 8 triangles. Lanes outside the mask are left undefined.
+	inline __m256 TriangleDistanceFast8(const float * streams, int triangleCount, __m256i indices, __m256 mask, const glm::vec3& p)
+	{
+		__m256 zero = _mm256_setzero_ps();
+		__m256 px = _mm256_set1_ps(p.x);
+		__m256 py = _mm256_set1_ps(p.y);
+		__m256 pz = _mm256_set1_ps(p.z);
+
+		__m256 cx = _mm256_sub_ps(px, _mm256_mask_i32gather_ps(zero, streams + CenterX * triangleCount, indices, mask, 4));
+		__m256 cy = _mm256_sub_ps(py, _mm256_mask_i32gather_ps(zero, streams + CenterY * triangleCount, indices, mask, 4));
+		__m256 cz = _mm256_sub_ps(pz, _mm256_mask_i32gather_ps(zero, streams + CenterZ * triangleCount, indices, mask, 4));
+		__m256 radius = _mm256_mask_i32gather_ps(zero, streams + Radius * triangleCount, indices, mask, 4);
+
+		__m256 d = _mm256_sqrt_ps(Dot(cx, cy, cz, cx, cy, cz));
+		__m256 inside = _mm256_and_ps(_mm256_cmp_ps(d, radius, _CMP_LT_OQ), mask);
+
+		// Most triangles are rejected by their bounding sphere
+		if (_mm256_movemask_ps(inside) == 0)
+			return d;
+
+		__m256 p1x = _mm256_sub_ps(px, _mm256_mask_i32gather_ps(zero, streams + V1X * triangleCount, indices, inside, 4));
+		__m256 p1y = _mm256_sub_ps(py, _mm256_mask_i32gather_ps(zero, streams + V1Y * triangleCount, indices, inside, 4));
+		__m256 p1z = _mm256_sub_ps(pz, _mm256_mask_i32gather_ps(zero, streams + V1Z * triangleCount, indices, inside, 4));
+		__m256 p2x = _mm256_sub_ps(px, _mm256_mask_i32gather_ps(zero, streams + V2X * triangleCount, indices, inside, 4));
+		__m256 p2y = _mm256_sub_ps(py, _mm256_mask_i32gather_ps(zero, streams + V2Y * triangleCount, indices, inside, 4));
+		__m256 p2z = _mm256_sub_ps(pz, _mm256_mask_i32gather_ps(zero, streams + V2Z * triangleCount, indices, inside, 4));
+		__m256 p3x = _mm256_sub_ps(px, _mm256_mask_i32gather_ps(zero, streams + V3X * triangleCount, indices, inside, 4));
+		__m256 p3y = _mm256_sub_ps(py, _mm256_mask_i32gather_ps(zero, streams + V3Y * triangleCount, indices, inside, 4));
+		__m256 p3z = _mm256_sub_ps(pz, _mm256_mask_i32gather_ps(zero, streams + V3Z * triangleCount, indices, inside, 4));
+
+		// Projections on the bent edge tangents
+		__m256 t1 = Dot(_mm256_mask_i32gather_ps(zero, streams + T21X * triangleCount, indices, inside, 4),
+			_mm256_mask_i32gather_ps(zero, streams + T21Y * triangleCount, indices, inside, 4),
+			_mm256_mask_i32gather_ps(zero, streams + T21Z * triangleCount, indices, inside, 4), p1x, p1y, p1z);
+		__m256 t2 = Dot(_mm256_mask_i32gather_ps(zero, streams + T32X * triangleCount, indices, inside, 4),
+			_mm256_mask_i32gather_ps(zero, streams + T32Y * triangleCount, indices, inside, 4),
+			_mm256_mask_i32gather_ps(zero, streams + T32Z * triangleCount, indices, inside, 4), p2x, p2y, p2z);
+		__m256 t3 = Dot(_mm256_mask_i32gather_ps(zero, streams + T13X * triangleCount, indices, inside, 4),
+			_mm256_mask_i32gather_ps(zero, streams + T13Y * triangleCount, indices, inside, 4),
+			_mm256_mask_i32gather_ps(zero, streams + T13Z * triangleCount, indices, inside, 4), p3x, p3y, p3z);
+
+		__m256 outsideFace = _mm256_add_ps(_mm256_add_ps(FaceStep(t1), FaceStep(t2)), FaceStep(t3));
+		__m256 overFace = _mm256_cmp_ps(outsideFace, _mm256_set1_ps(2.995f), _CMP_GT_OQ);
+
+		// |dot(n, p1)| * -sign(dot(n, p1)) is just the negated plane distance
+		__m256 planeDistance = Dot(_mm256_mask_i32gather_ps(zero, streams + NormalX * triangleCount, indices, inside, 4),
+			_mm256_mask_i32gather_ps(zero, streams + NormalY * triangleCount, indices, inside, 4),
+			_mm256_mask_i32gather_ps(zero, streams + NormalZ * triangleCount, indices, inside, 4), p1x, p1y, p1z);
+		__m256 faceDistance = _mm256_sub_ps(zero, planeDistance);
+
+		__m256 d1 = EdgeDistance(streams, triangleCount, V21X, indices, inside, p1x, p1y, p1z);
+		__m256 d2 = EdgeDistance(streams, triangleCount, V32X, indices, inside, p2x, p2y, p2z);
+		__m256 d3 = EdgeDistance(streams, triangleCount, V13X, indices, inside, p3x, p3y, p3z);
+		__m256 edgeDistance = _mm256_sqrt_ps(_mm256_min_ps(_mm256_min_ps(d1, d2), d3));
+
+		__m256 exact = _mm256_blendv_ps(edgeDistance, faceDistance, overFace);
+		return _mm256_blendv_ps(d, exact, inside);
+	}
+#endif
+}
+
+void SdfBaker::SolveEikonal(int resolution, const std::vector<uint8_t>& band, float * distances)
+{
+	// One pass of the eight orderings settles most of the grid, later ones only fix fronts that bend around the band
+	float h = 2.f / resolution;
+
+	for (int pass = 0; pass < SDF_MAX_SWEEP_PASSES; ++pass)
+	{
+		if (Sweep(resolution, band, distances) < h * SDF_SWEEP_TOLERANCE)
+			break;
+	}
+}
+
+SdfBaker::SdfBaker(const CompactKdTree& tree, SdfSignMethod signMethod, bool brickCulling) : tree(tree), query(tree), signMethod(signMethod), winding(tree), brickCulling(brickCulling)
+{
+#ifdef __AVX2__
+	int count = tree.triangleCount;
+	triangleStreams.resize(static_cast<size_t>(StreamCount) * count);
+	float * s = triangleStreams.data();
+
+	// Both layouts decode to the same values MeshQuery uses
+	Parallel::For(count, [&](int i) {
+		TriangleData t = query.LoadTriangle(i);
+		const float values[StreamCount] = {
+			t.center.x, t.center.y, t.center.z, t.center.w,
+			t.v1.x, t.v1.y, t.v1.z,
+			t.v2.x, t.v2.y, t.v2.z,
+			t.v3.x, t.v3.y, t.v3.z,
+			t.v21.x, t.v21.y, t.v21.z, t.v21.w,
+			t.v32.x, t.v32.y, t.v32.z, t.v32.w,
+			t.v13.x, t.v13.y, t.v13.z, t.v13.w,
+			t.normal.x, t.normal.y, t.normal.z,
+			t.t21.x, t.t21.y, t.t21.z,
+			t.t32.x, t.t32.y, t.t32.z,
+			t.t13.x, t.t13.y, t.t13.z
+		};
+
+		for (int c = 0; c < StreamCount; ++c)
+			s[static_cast<size_t>(c) * count + i] = values[c];
+	});
+#endif
+}
+
+bool SdfBaker::UsesAVX2()
+{
+#ifdef __AVX2__
+	return true;
+#else
+	return false;
+#endif
+}
+
+float SdfBaker::Distance(const glm::vec3& p) const
+{
+	int closestTriangle;
+	return Signed(p, NearestDistance(p, closestTriangle));
+}
+
+float SdfBaker::Signed(const glm::vec3& p, float distance) const
+{
+	if (signMethod == SdfSignMethod::BentNormals)
+		return distance;
+
+	return winding.IsInside(p) ? -glm::abs(distance) : glm::abs(distance);
+}
+
+float SdfBaker::NearestDistance(const glm::vec3& p, int& closestTriangle) const
+{
+#ifdef __AVX2__
+	// Same stackless traversal as MeshQuery::Distance, only the leaf test differs
+	const float * streams = triangleStreams.data();
+	const __m256i laneIndex = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+
+	int currentNode = 0;
+	int steps = 0;
+	bool descending = true;
+
+	float currentDistance = 10.f;
+
+	int closestTriangleIndex = -1;
+	bool finished = false;
+
+	while (steps++ < QUERY_MAX_STEPS)
+	{
+		if (descending)
+		{
+			const CompactNode& node = tree.nodes[currentNode];
+
+			if (node.IsLeaf())
+			{
+				int primitiveCount = node.GetPrimitiveCount();
+				const int * leafTriangles = tree.leafIndices + node.primitiveStartOffset;
+
+				for (int first = 0; first < primitiveCount; first += 8)
+				{
+					__m256i active = _mm256_cmpgt_epi32(_mm256_set1_epi32(primitiveCount - first), laneIndex);
+					__m256i indices = _mm256_maskload_epi32(leafTriangles + first, active);
+
+					alignas(32) float distances[8];
+					_mm256_store_ps(distances, TriangleDistanceFast8(streams, tree.triangleCount, indices, _mm256_castsi256_ps(active), p));
+
+					// In index order, so ties resolve like the scalar loop
+					int lanes = glm::min(primitiveCount - first, 8);
+
+					for (int l = 0; l < lanes; ++l)
+					{
+						if (glm::abs(distances[l]) < glm::abs(currentDistance))
+						{
+							currentDistance = distances[l];
+							closestTriangleIndex = leafTriangles[first + l];
+						}
+					}
+				}
+
+				descending = false;
+			}
+			else
+			{
+				float dist = p[node.GetAxis()] - node.split;
+				currentNode = dist >= 0.f ? node.GetRightChild() : node.GetLeftChild();
+			}
+		}
+		else
+		{
+			if (currentNode == 0)
+			{
+				finished = true;
+				break;
+			}
+
+			int parentNode = tree.pairParents[currentNode / 2];
+			const CompactNode& parent = tree.nodes[parentNode];
+
+			float dist = p[parent.GetAxis()] - parent.split;
+			int nearNode = dist >= 0.f ? parent.GetRightChild() : parent.GetLeftChild();
+
+			if (currentNode == nearNode && glm::abs(currentDistance) >= glm::abs(dist))
+			{
+				currentNode ^= 1;
+				descending = true;
+			}
+			else
+			{
+				currentNode = parentNode;
+			}
+		}
+	}
+
+	closestTriangle = closestTriangleIndex;
+
+	if (closestTriangleIndex == -1)
+		return currentDistance;
+
+	float distance = query.TriangleDistance(closestTriangleIndex, p);
+	return finished ? distance : distance - .0115f;
+#else
+	// Same as MeshQuery::Distance, keeping the triangle
+	MeshQueryStats stats;
+	bool finished = false;
+	closestTriangle = query.ClosestTriangle(p, stats, finished);
+
+	if (closestTriangle == -1)
+		return 10.f;
+
+	float distance = query.TriangleDistance(closestTriangle, p);
+	return finished ? distance : distance - .0115f;
+#endif
+}
+
+float SdfBaker::CandidateDistance(const glm::vec3& p, const std::vector<int>& candidates, int& closestTriangle) const
+{
+#ifdef __AVX2__
+	const float * streams = triangleStreams.data();
+	const __m256i laneIndex = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+	int count = static_cast<int>(candidates.size());
+
+	float currentDistance = 10.f;
+	int closestTriangleIndex = -1;
+
+	for (int first = 0; first < count; first += 8)
+	{
+		__m256i active = _mm256_cmpgt_epi32(_mm256_set1_epi32(count - first), laneIndex);
+		__m256i indices = _mm256_maskload_epi32(candidates.data() + first, active);
+
+		alignas(32) float distances[8];
+		_mm256_store_ps(distances, TriangleDistanceFast8(streams, tree.triangleCount, indices, _mm256_castsi256_ps(active), p));
+
+		int lanes = glm::min(count - first, 8);
+
+		for (int l = 0; l < lanes; ++l)
+		{
+			if (glm::abs(distances[l]) < glm::abs(currentDistance))
+			{
+				currentDistance = distances[l];
+				closestTriangleIndex = candidates[first + l];
+			}
+		}
+	}
+
+	closestTriangle = closestTriangleIndex;
+
+	if (closestTriangleIndex == -1)
+		return currentDistance;
+
+	return query.TriangleDistance(closestTriangleIndex, p);
+#else
+	MeshQueryStats stats;
+	closestTriangle = query.CandidateTriangle(p, candidates, stats);
+	return closestTriangle == -1 ? 10.f : query.TriangleDistance(closestTriangle, p);
+#endif
+}
+
+void SdfBaker::BakeBrick(int resolution, int brick, const uint8_t * band, float * distances, uint32_t * triangles, uint32_t * barycentrics) const
+{
+	int bricksPerAxis = (resolution + SDF_BRICK_SIZE - 1) / SDF_BRICK_SIZE;
+
+	int bx = (brick % bricksPerAxis) * SDF_BRICK_SIZE;
+	int by = ((brick / bricksPerAxis) % bricksPerAxis) * SDF_BRICK_SIZE;
+	int bz = (brick / (bricksPerAxis * bricksPerAxis)) * SDF_BRICK_SIZE;
+
+	// Gathered on the first voxel that needs it, narrow band bricks may have none
+	std::vector<int> candidates;
+	bool gathered = false;
+	bool culled = false;
+
+	for (int z = bz; z < glm::min(bz + SDF_BRICK_SIZE, resolution); ++z)
+	{
+		for (int y = by; y < glm::min(by + SDF_BRICK_SIZE, resolution); ++y)
+		{
+			for (int x = bx; x < glm::min(bx + SDF_BRICK_SIZE, resolution); ++x)
+			{
+				size_t voxel = (static_cast<size_t>(z) * resolution + y) * resolution + x;
+
+				if (band != nullptr && !band[voxel])
+					continue;
+
+				// Same sample positions as main() in generator.comp
+				glm::vec3 p = (glm::vec3(x, y, z) / static_cast<float>(resolution)) * 2.f - 1.f;
+
+				if (brickCulling && !gathered)
+				{
+					glm::ivec3 last = glm::min(glm::ivec3(bx, by, bz) + SDF_BRICK_SIZE, glm::ivec3(resolution)) - 1;
+					glm::vec3 brickMin = (glm::vec3(bx, by, bz) / static_cast<float>(resolution)) * 2.f - 1.f;
+					glm::vec3 brickMax = (glm::vec3(last) / static_cast<float>(resolution)) * 2.f - 1.f;
+
+					MeshQueryStats stats;
+					culled = query.GatherCandidates(brickMin, brickMax, candidates, stats);
+					gathered = true;
+				}
+
+				int closestTriangle = -1;
+				float distance = culled ? CandidateDistance(p, candidates, closestTriangle) : NearestDistance(p, closestTriangle);
+
+				if (triangles != nullptr)
+					triangles[voxel] = closestTriangle == -1 ? ClosestFeature::NO_TRIANGLE : static_cast<uint32_t>(closestTriangle);
+
+				if (barycentrics != nullptr)
+					barycentrics[voxel] = closestTriangle == -1 ? 0u : ClosestFeature::PackBarycentrics(query.ClosestBarycentrics(closestTriangle, p));
+
+				distances[voxel] = signMethod == SdfSignMethod::WindingNumberBricks ? distance : Signed(p, distance);
+			}
+		}
+	}
+
+	if (signMethod == SdfSignMethod::WindingNumberBricks)
+		SignBrick(winding, resolution, glm::ivec3(bx, by, bz), band, distances);
+}
+
+void SdfBaker::SignBrick(const WindingNumber& winding, int resolution, const glm::ivec3& brickStart, const uint8_t * band, float * distances)
+{
+	const int brickVoxels = SDF_BRICK_SIZE * SDF_BRICK_SIZE * SDF_BRICK_SIZE;
+	const glm::ivec3 offsets[6] = { glm::ivec3(-1, 0, 0), glm::ivec3(1, 0, 0), glm::ivec3(0, -1, 0), glm::ivec3(0, 1, 0), glm::ivec3(0, 0, -1), glm::ivec3(0, 0, 1) };
+
+	glm::ivec3 brickEnd = glm::min(brickStart + SDF_BRICK_SIZE, glm::ivec3(resolution));
+	float cellSize = 2.f / resolution;
+
+	// 0 unknown, otherwise the sign
+	int8_t signs[brickVoxels] = {};
+	int queue[brickVoxels];
+
+	auto globalIndex = [&](const glm::ivec3& c) {
+		return (static_cast<size_t>(c.z) * resolution + c.y) * resolution + c.x;
+	};
+
+	auto localIndex = [&](const glm::ivec3& c) {
+		glm::ivec3 l = c - brickStart;
+		return (l.z * SDF_BRICK_SIZE + l.y) * SDF_BRICK_SIZE + l.x;
+	};
+
+	for (int z = brickStart.z; z < brickEnd.z; ++z)
+	{
+		for (int y = brickStart.y; y < brickEnd.y; ++y)
+		{
+			for (int x = brickStart.x; x < brickEnd.x; ++x)
+			{
+				glm::ivec3 seed(x, y, z);
+
+				if (signs[localIndex(seed)] != 0 || (band != nullptr && !band[globalIndex(seed)]))
+					continue;
+
+				glm::vec3 p = (glm::vec3(seed) / static_cast<float>(resolution)) * 2.f - 1.f;
+				int8_t sign = winding.IsInside(p) ? -1 : 1;
+
+				int queueSize = 0;
+				signs[localIndex(seed)] = sign;
+				queue[queueSize++] = localIndex(seed);
+
+				while (queueSize > 0)
+				{
+					int l = queue[--queueSize];
+					glm::ivec3 c = brickStart + glm::ivec3(l % SDF_BRICK_SIZE, (l / SDF_BRICK_SIZE) % SDF_BRICK_SIZE, l / (SDF_BRICK_SIZE * SDF_BRICK_SIZE));
+					float distance = glm::abs(distances[globalIndex(c)]);
+
+					for (const glm::ivec3& offset : offsets)
+					{
+						glm::ivec3 n = c + offset;
+
+						if (glm::any(glm::lessThan(n, brickStart)) || glm::any(glm::greaterThanEqual(n, brickEnd)))
+							continue;
+
+						if (signs[localIndex(n)] != 0 || (band != nullptr && !band[globalIndex(n)]))
+							continue;
+
+						if (glm::min(distance, glm::abs(distances[globalIndex(n)])) <= cellSize)
+							continue;
+
+						signs[localIndex(n)] = sign;
+						queue[queueSize++] = localIndex(n);
+					}
+				}
+			}
+		}
+	}
+
+	for (int z = brickStart.z; z < brickEnd.z; ++z)
+	{
+		for (int y = brickStart.y; y < brickEnd.y; ++y)
+		{
+			for (int x = brickStart.x; x < brickEnd.x; ++x)
+			{
+				glm::ivec3 c(x, y, z);
+				int8_t sign = signs[localIndex(c)];
+
+				if (sign != 0)
+					distances[globalIndex(c)] = glm::abs(distances[globalIndex(c)]) * sign;
+			}
+		}
+	}
+}
+
+void SdfBaker::Bake(int resolution, float * distances, uint32_t * triangles, uint32_t * barycentrics) const
+{
+	// Neighbouring voxels take the same path down the tree, so bricks keep each thread on a small part of it
+	int bricksPerAxis = (resolution + SDF_BRICK_SIZE - 1) / SDF_BRICK_SIZE;
+
+	Parallel::For(bricksPerAxis * bricksPerAxis * bricksPerAxis, [&](int brick) {
+		BakeBrick(resolution, brick, nullptr, distances, triangles, barycentrics);
+	});
+}
+
+void SdfBaker::SignWithWindingNumber(const WindingNumber& winding, int resolution, float * distances)
+{
+	int bricksPerAxis = (resolution + SDF_BRICK_SIZE - 1) / SDF_BRICK_SIZE;
+
+	Parallel::For(bricksPerAxis * bricksPerAxis * bricksPerAxis, [&](int brick) {
+		glm::ivec3 brickStart(brick % bricksPerAxis, (brick / bricksPerAxis) % bricksPerAxis, brick / (bricksPerAxis * bricksPerAxis));
+		SignBrick(winding, resolution, brickStart * SDF_BRICK_SIZE, nullptr, distances);
+	});
+}
+
+size_t SdfBaker::RasterizeBand(int resolution, int bandWidth, std::vector<uint8_t>& band) const
+{
+	band.assign(static_cast<size_t>(resolution) * resolution * resolution, 0);
+
+	// Voxel c samples c / resolution * 2 - 1, so a position maps back to (p + 1) * resolution / 2
+	float toGrid = resolution * .5f;
+
+	for (int i = 0; i < tree.triangleCount; ++i)
+	{
+		TriangleData t = query.LoadTriangle(i);
+		glm::vec3 bmin = glm::min(glm::min(t.v1, t.v2), t.v3);
+		glm::vec3 bmax = glm::max(glm::max(t.v1, t.v2), t.v3);
+
+		glm::ivec3 from = glm::clamp(glm::ivec3(glm::floor((bmin + 1.f) * toGrid)) - bandWidth, glm::ivec3(0), glm::ivec3(resolution - 1));
+		glm::ivec3 to = glm::clamp(glm::ivec3(glm::ceil((bmax + 1.f) * toGrid)) + bandWidth, glm::ivec3(0), glm::ivec3(resolution - 1));
+
+		for (int z = from.z; z <= to.z; ++z)
+			for (int y = from.y; y <= to.y; ++y)
+				memset(&band[(static_cast<size_t>(z) * resolution + y) * resolution + from.x], 1, to.x - from.x + 1);
+	}
+
+	size_t bandCount = 0;
+
+	for (uint8_t inside : band)
+		bandCount += inside;
+
+	return bandCount;
+}
+
+size_t SdfBaker::BakeNarrowBand(int resolution, int bandWidth, float * distances) const
+{
+	std::vector<uint8_t> band;
+	size_t bandCount = RasterizeBand(resolution, bandWidth, band);
+
+	// Unknown voxels start infinitely far away
+	for (size_t i = 0; i < band.size(); ++i)
+		if (!band[i])
+			distances[i] = std::numeric_limits<float>::max();
+
+	int bricksPerAxis = (resolution + SDF_BRICK_SIZE - 1) / SDF_BRICK_SIZE;
+
+	Parallel::For(bricksPerAxis * bricksPerAxis * bricksPerAxis, [&](int brick) {
+		BakeBrick(resolution, brick, band.data(), distances, nullptr, nullptr);
+	});
+
+	SolveEikonal(resolution, band, distances);
+	return bandCount;
+}
+
+size_t SdfBaker::BakeHierarchical(int resolution, int coarseResolution, float * distances) const
+{
+	auto isPowerOfTwo = [](int x) { return x > 0 && (x & (x - 1)) == 0; };
+
+	if (!isPowerOfTwo(resolution) || !isPowerOfTwo(coarseResolution) || coarseResolution > resolution)
+		throw std::runtime_error("Hierarchical baking needs power of two resolutions, the coarse one no bigger than the fine one");
+
+	int samples = coarseResolution + 1;
+	std::vector<float> coarse(static_cast<size_t>(samples) * samples * samples);
+
+	Parallel::For(samples, [&](int z) {
+		for (int y = 0; y < samples; ++y)
+			for (int x = 0; x < samples; ++x)
+				coarse[SdfHierarchy::CoarseIndex(coarseResolution, x, y, z)] = Distance((glm::vec3(x, y, z) / static_cast<float>(coarseResolution)) * 2.f - 1.f);
+	});
+
+	// Refined cells go through the narrow band path, so bricks and signs work exactly like Bake
+	int ratio = resolution / coarseResolution;
+	std::vector<uint8_t> band(static_cast<size_t>(resolution) * resolution * resolution, 0);
+	size_t refinedCount = 0;
+
+	for (int cz = 0; cz < coarseResolution; ++cz)
+		for (int cy = 0; cy < coarseResolution; ++cy)
+			for (int cx = 0; cx < coarseResolution; ++cx)
+			{
+				if (!SdfHierarchy::RefineCell(coarse.data(), coarseResolution, resolution, glm::ivec3(cx, cy, cz)))
+					continue;
+
+				for (int z = cz * ratio; z < (cz + 1) * ratio; ++z)
+					for (int y = cy * ratio; y < (cy + 1) * ratio; ++y)
+						memset(&band[(static_cast<size_t>(z) * resolution + y) * resolution + cx * ratio], 1, ratio);
+
+				refinedCount += static_cast<size_t>(ratio) * ratio * ratio;
+			}
+
+	int bricksPerAxis = (resolution + SDF_BRICK_SIZE - 1) / SDF_BRICK_SIZE;
+
+	Parallel::For(bricksPerAxis * bricksPerAxis * bricksPerAxis, [&](int brick) {
+		BakeBrick(resolution, brick, band.data(), distances, nullptr, nullptr);
+	});
+
+	Parallel::For(resolution, [&](int z) {
+		for (int y = 0; y < resolution; ++y)
+			for (int x = 0; x < resolution; ++x)
+			{
+				size_t voxel = (static_cast<size_t>(z) * resolution + y) * resolution + x;
+
+				if (!band[voxel])
+					distances[voxel] = SdfHierarchy::Interpolate(coarse.data(), coarseResolution, resolution, glm::ivec3(x, y, z));
+			}
+	});
+
+	return refinedCount;
+}
+
+bool SdfBaker::Save(const std::string& filename, int resolution, const float * distances)
+{
+	SdfFileHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.version = SDF_FILE_VERSION;
+	header.resolution = resolution;
+
+	size_t count = static_cast<size_t>(resolution) * resolution * resolution;
+
+	std::string temporaryFilename = filename + ".tmp";
+	FILE * f = fopen(temporaryFilename.c_str(), "wb");
+
+	if (f == nullptr)
+		return false;
+
+	bool success = fwrite(&header, sizeof(header), 1, f) == 1
+		&& fwrite(distances, sizeof(float), count, f) == count;
+
+	success = fclose(f) == 0 && success;
+
+	if (!success || !FileUtils::ReplaceFile(temporaryFilename, filename))
+	{
+		remove(temporaryFilename.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+bool SdfHierarchy::RefineCell(const float * coarse, int coarseResolution, int resolution, const glm::ivec3& cell)
+{
+	float threshold = std::sqrt(3.f) * 2.f / coarseResolution + SDF_HIERARCHY_MARGIN * 2.f / resolution;
+	float nearest = std::numeric_limits<float>::max();
+	bool negative = false;
+	bool positive = false;
+
+	for (int corner = 0; corner < 8; ++corner)
+	{
+		float d = coarse[CoarseIndex(coarseResolution, cell.x + (corner & 1), cell.y + ((corner >> 1) & 1), cell.z + (corner >> 2))];
+		nearest = std::min(nearest, std::abs(d));
+		negative |= d < 0.f;
+		positive |= d >= 0.f;
+	}
+
+	return nearest < threshold || (negative && positive);
+}
+
+float SdfHierarchy::Interpolate(const float * coarse, int coarseResolution, int resolution, const glm::ivec3& voxel)
+{
+	int ratio = resolution / coarseResolution;
+	glm::ivec3 cell = voxel / ratio;
+	glm::vec3 t = glm::vec3(voxel - cell * ratio) / static_cast<float>(ratio);
+
+	auto sample = [&](int dx, int dy, int dz) {
+		return coarse[CoarseIndex(coarseResolution, cell.x + dx, cell.y + dy, cell.z + dz)];
+	};
+
+	// Same order as the shader: x, then y, then z
+	float x00 = glm::mix(sample(0, 0, 0), sample(1, 0, 0), t.x);
+	float x10 = glm::mix(sample(0, 1, 0), sample(1, 1, 0), t.x);
+	float x01 = glm::mix(sample(0, 0, 1), sample(1, 0, 1), t.x);
+	float x11 = glm::mix(sample(0, 1, 1), sample(1, 1, 1), t.x);
+	return glm::mix(glm::mix(x00, x10, t.y), glm::mix(x01, x11, t.y), t.z);
+}
+
+size_t SdfHierarchy::CountRefinedVoxels(const float * coarse, int coarseResolution, int resolution)
+{
+	size_t ratio = resolution / coarseResolution;
+	size_t refinedCells = 0;
+
+	for (int z = 0; z < coarseResolution; ++z)
+		for (int y = 0; y < coarseResolution; ++y)
+			for (int x = 0; x < coarseResolution; ++x)
+				refinedCells += RefineCell(coarse, coarseResolution, resolution, glm::ivec3(x, y, z));
+
+	return refinedCells * ratio * ratio * ratio;
+}
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "Mesh.h"
+#include "MeshQuery.h"
+#include "WindingNumber.h"
+
+// Voxels are baked in cubes of this size, one brick per task
+#define SDF_BRICK_SIZE 8
+
+// Cells around every triangle bounding box that get exact distances in BakeNarrowBand
+#define SDF_NARROW_BAND_WIDTH 3
+
+// Fine cells added to the coarse cell diagonal before a coarse cell counts as away from the surface.
+// Keep HIERARCHY_MARGIN in generator.comp in sync.
+#define SDF_HIERARCHY_MARGIN 2
+
+// Coarse to fine generation, shared by SdfBaker::BakeHierarchical and the generator (GENERATOR_COARSE_RESOLUTION).
+// The coarse grid has coarseResolution + 1 samples per axis at c / coarseResolution * 2 - 1, so with power of two
+// resolutions every fine voxel lies in one coarse cell and the ones on its lower corner land exactly on a sample.
+namespace SdfHierarchy {
+	inline size_t CoarseIndex(int coarseResolution, int x, int y, int z)
+	{
+		size_t samples = static_cast<size_t>(coarseResolution) + 1;
+		return (z * samples + y) * samples + x;
+	}
+
+	// A coarse cell may hold the surface when a corner is within its diagonal, or when its corners disagree on the sign.
+	// Distances are 1-Lipschitz, so if the surface crossed the cell every corner would be closer than the diagonal.
+	bool RefineCell(const float * coarse, int coarseResolution, int resolution, const glm::ivec3& cell);
+
+	// Trilinear, like the non refined voxels of the hierarchical generator pass
+	float Interpolate(const float * coarse, int coarseResolution, int resolution, const glm::ivec3& voxel);
+
+	// Fine voxels inside refined cells, the ones that need an exact query
+	size_t CountRefinedVoxels(const float * coarse, int coarseResolution, int resolution);
+}
+
+// Closest feature output of the generator (GENERATOR_CLOSEST_FEATURE) and SdfBaker::Bake. Triangles are indices into the
+// mesh triangle array, barycentrics the weights of v2 and v3 as two 16 bit unorms, v1 gets the rest.
+namespace ClosestFeature {
+	// Voxels without a closest triangle: interpolated by the hierarchical pass, or a mesh without triangles
+	const uint32_t NO_TRIANGLE = 0xFFFFFFFFu;
+
+	// packUnorm2x16 of the v2 and v3 weights
+	inline uint32_t PackBarycentrics(const glm::vec3& weights)
+	{
+		uint32_t v = static_cast<uint32_t>(glm::round(glm::clamp(weights.y, 0.f, 1.f) * 65535.f));
+		uint32_t w = static_cast<uint32_t>(glm::round(glm::clamp(weights.z, 0.f, 1.f) * 65535.f));
+		return v | (w << 16);
+	}
+
+	inline glm::vec3 UnpackBarycentrics(uint32_t packed)
+	{
+		float v = (packed & 0xFFFFu) / 65535.f;
+		float w = (packed >> 16) / 65535.f;
+		return glm::vec3(1.f - v - w, v, w);
+	}
+}
+
+// How inside and outside are decided
+enum class SdfSignMethod
+{
+	BentNormals,			// Closest triangle with bent edge tangents, like generator.comp
+	WindingNumber,			// Generalized winding number per voxel
+	WindingNumberBricks		// Winding number once per region of a brick that can't cross the surface, filled from there
+};
+
+// CPU version of the generator mesh distance pass. Walks the same compact kd-tree as generateMeshSDF,
+// so it bakes without a Vulkan device and doubles as a reference for the shader output.
+// When built with AVX2, leaves test 8 triangles at a time. With brick culling, every brick gathers its
+// candidate triangles once (MeshQuery::GatherCandidates) and its voxels only test those.
+class SdfBaker
+{
+public:
+	SdfBaker(const CompactKdTree& tree, SdfSignMethod signMethod = SdfSignMethod::BentNormals, bool brickCulling = false);
+
+	// Fills resolution^3 distances, x fastest, sampled at the same positions as generator.comp.
+	// triangles and barycentrics are optional, same layout, see ClosestFeature.
+	void Bake(int resolution, float * distances, uint32_t * triangles = nullptr, uint32_t * barycentrics = nullptr) const;
+
+	// Exact distances only for voxels within bandWidth cells of a triangle bounding box, bit-identical to Bake.
+	// The rest of the grid is solved as an Eikonal equation with parallel fast sweeping, taking the sign
+	// of the closest neighbour. Returns how many voxels were in the band.
+	size_t BakeNarrowBand(int resolution, int bandWidth, float * distances) const;
+
+	// Exact distances at coarseResolution, then only in the coarse cells that may hold the surface (SdfHierarchy::RefineCell),
+	// bit-identical to Bake there. The other voxels are interpolated from the coarse level. Both resolutions must be
+	// powers of two, coarseResolution at most resolution. Returns how many fine voxels were queried.
+	size_t BakeHierarchical(int resolution, int coarseResolution, float * distances) const;
+
+	// Marks every voxel within bandWidth cells of a triangle bounding box, returns how many
+	size_t RasterizeBand(int resolution, int bandWidth, std::vector<uint8_t>& band) const;
+
+	// Signed with the baker sign method, always per point
+	float Distance(const glm::vec3& p) const;
+
+	// Gives every distance the winding number sign, brick by brick like WindingNumberBricks. Only magnitudes are read,
+	// so it also fixes up distances signed some other way, like the bent normals of the generator.
+	static void SignWithWindingNumber(const WindingNumber& winding, int resolution, float * distances);
+
+	// Raw little endian floats after a small header, see SdfBaker.cpp
+	static bool Save(const std::string& filename, int resolution, const float * distances);
+
+	// Whether this file was built with AVX2, which the CPU must then have, see Parallel::HasAVX2
+	static bool UsesAVX2();
+
+private:
+	// Closest triangle distance with its bent normal sign, closestTriangle is -1 when there is none
+	float NearestDistance(const glm::vec3& p, int& closestTriangle) const;
+	float CandidateDistance(const glm::vec3& p, const std::vector<int>& candidates, int& closestTriangle) const;
+
+	// Applies the sign method to a bent normal distance
+	float Signed(const glm::vec3& p, float distance) const;
+
+	// Only voxels set in band are written, when there is one. Feature outputs are skipped when null.
+	void BakeBrick(int resolution, int brick, const uint8_t * band, float * distances, uint32_t * triangles, uint32_t * barycentrics) const;
+
+	// Flood fills winding number signs inside a brick. A voxel passes its sign to a neighbour when both of their
+	// distances are over a cell. Either one would keep the segment between them off the surface, but next to the rim
+	// of an open mesh the winding number turns around the boundary edge without crossing a triangle.
+	static void SignBrick(const WindingNumber& winding, int resolution, const glm::ivec3& brickStart, const uint8_t * band, float * distances);
+
+	static void SolveEikonal(int resolution, const std::vector<uint8_t>& band, float * distances);
+
+	CompactKdTree tree;
+	MeshQuery query;
+
+	SdfSignMethod signMethod;
+	WindingNumber winding;
+	bool brickCulling;
+
+	// Every triangle attribute as its own array of triangleCount floats, so 8 triangles can be gathered into one register
+	std::vector<float> triangleStreams;
+};
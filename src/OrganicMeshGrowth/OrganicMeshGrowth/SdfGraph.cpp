@@ -0,0 +1,1005 @@
+#include "SdfGraph.h"
+#include "FileUtils.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <stdexcept>
+#include <utility>
+
+namespace {
+	// Bounds are padded by this much relative to the value, so sin, cos and the primitives rounding differently at
+	// the box corners than at a voxel can't make a pruned branch win
+	const float INTERVAL_PADDING = 1e-5f;
+
+	bool IsPointOp(SdfOp op)
+	{
+		return op <= SdfOp::Repeat;
+	}
+
+	bool IsPrimitive(SdfOp op)
+	{
+		return op >= SdfOp::Sphere && op <= SdfOp::Plane;
+	}
+
+	inline float Length(float x, float y)
+	{
+		return std::sqrt(x * x + y * y);
+	}
+
+	inline float Length(float x, float y, float z)
+	{
+		return std::sqrt(x * x + y * y + z * z);
+	}
+
+	inline float Pow8(float x)
+	{
+		x *= x;
+		x *= x;
+		return x * x;
+	}
+
+	// The primitives of generator.comp, c points at the instruction constants
+	inline float Primitive(SdfOp op, const float * c, float x, float y, float z)
+	{
+		switch (op)
+		{
+		case SdfOp::Sphere:
+			return Length(x, y, z) - c[0];
+		case SdfOp::Box: {
+			float dx = std::abs(x) - c[0], dy = std::abs(y) - c[1], dz = std::abs(z) - c[2];
+			return Length(std::max(dx, 0.f), std::max(dy, 0.f), std::max(dz, 0.f)) + std::max(std::max(std::min(dx, 0.f), std::min(dy, 0.f)), std::min(dz, 0.f));
+		}
+		case SdfOp::Capsule: {
+			float pax = x - c[0], pay = y - c[1], paz = z - c[2];
+			float bax = c[3] - c[0], bay = c[4] - c[1], baz = c[5] - c[2];
+			float h = std::min(std::max((pax * bax + pay * bay + paz * baz) / (bax * bax + bay * bay + baz * baz), 0.f), 1.f);
+			return Length(pax - bax * h, pay - bay * h, paz - baz * h) - c[6];
+		}
+		case SdfOp::CappedCylinder: {
+			float dx = std::abs(Length(x, z)) - c[0], dy = std::abs(y) - c[1];
+			return std::min(std::max(dx, dy), 0.f) + Length(std::max(dx, 0.f), std::max(dy, 0.f));
+		}
+		case SdfOp::Torus:
+			return Length(Length(x, z) - c[0], y) - c[1];
+		case SdfOp::Torus82: {
+			float qx = Length(x, z) - c[0];
+			return std::pow(Pow8(qx) + Pow8(y), .125f) - c[1];
+		}
+		case SdfOp::Ellipsoid:
+			return (Length(x / c[0], y / c[1], z / c[2]) - 1.f) * std::min(std::min(c[0], c[1]), c[2]);
+		case SdfOp::Plane:
+			return y;
+		default:
+			return 0.f;
+		}
+	}
+
+	inline float Repeat(float x, float period, float extent)
+	{
+		if (period == 0.f)
+			return x;
+
+		float u = x + period * .5f;
+		return extent >= std::abs(u) ? (u - period * std::floor(u / period)) - period * .5f : x;
+	}
+
+	inline float SmoothMin(float a, float b, float k)
+	{
+		return std::min(a, b) - std::log1p(std::exp(-k * std::abs(a - b))) / k;
+	}
+
+	inline SdfInterval Hull(const SdfInterval& a, const SdfInterval& b)
+	{
+		return { std::min(a.lo, b.lo), std::max(a.hi, b.hi) };
+	}
+
+	inline SdfInterval Mul(const SdfInterval& a, const SdfInterval& b)
+	{
+		float p0 = a.lo * b.lo, p1 = a.lo * b.hi, p2 = a.hi * b.lo, p3 = a.hi * b.hi;
+		return { std::min(std::min(p0, p1), std::min(p2, p3)), std::max(std::max(p0, p1), std::max(p2, p3)) };
+	}
+
+	inline SdfInterval Scale(const SdfInterval& a, float c)
+	{
+		return c >= 0.f ? SdfInterval{ a.lo * c, a.hi * c } : SdfInterval{ a.hi * c, a.lo * c };
+	}
+
+	SdfInterval Cos(const SdfInterval& a)
+	{
+		const float twoPi = 6.28318530718f;
+
+		if (a.hi - a.lo >= twoPi)
+			return { -1.f, 1.f };
+
+		float cl = std::cos(a.lo), ch = std::cos(a.hi);
+		SdfInterval result = { std::min(cl, ch), std::max(cl, ch) };
+
+		// A maximum at 2k pi or a minimum at (2k + 1) pi inside
+		if (std::floor(a.hi / twoPi) > std::floor(a.lo / twoPi))
+			result.hi = 1.f;
+
+		if (std::floor(a.hi / twoPi - .5f) > std::floor(a.lo / twoPi - .5f))
+			result.lo = -1.f;
+
+		return { std::max(result.lo - INTERVAL_PADDING, -1.f), std::min(result.hi + INTERVAL_PADDING, 1.f) };
+	}
+
+	SdfInterval Sin(const SdfInterval& a)
+	{
+		const float halfPi = 1.57079632679f;
+		return Cos({ a.lo - halfPi, a.hi - halfPi });
+	}
+
+	SdfInterval RepeatInterval(const SdfInterval& x, float period, float extent)
+	{
+		if (period == 0.f)
+			return x;
+
+		SdfInterval u = { x.lo + period * .5f, x.hi + period * .5f };
+
+		// Entirely outside the repeated range
+		if (u.lo > extent || u.hi < -extent)
+			return x;
+
+		if (extent >= std::abs(u.lo) && extent >= std::abs(u.hi)) {
+			float cell = std::floor(u.lo / period);
+
+			// Within one period, the same shift for the whole interval
+			if (std::floor(u.hi / period) == cell)
+				return { (u.lo - period * cell) - period * .5f, (u.hi - period * cell) - period * .5f };
+		}
+
+		float half = period * .5f * (1.f + INTERVAL_PADDING) + INTERVAL_PADDING;
+		return Hull(x, { -half, half });
+	}
+
+	// The generator's random() and rotationAxisAngle, for the random shapes
+	uint32_t Hash(uint32_t x)
+	{
+		x += (x << 10u);
+		x ^= (x >> 6u);
+		x += (x << 3u);
+		x ^= (x >> 11u);
+		x += (x << 15u);
+		return x;
+	}
+
+	float Random(uint32_t& seed)
+	{
+		seed = Hash(seed);
+		uint32_t bits = (seed & 0x007FFFFFu) | 0x3F800000u;
+		float f;
+		std::memcpy(&f, &bits, sizeof(f));
+		return f - 1.f;
+	}
+
+	// In order, the GLSL vec3 constructor evaluates its arguments left to right
+	glm::vec3 RandomVec3(uint32_t& seed)
+	{
+		float x = Random(seed);
+		float y = Random(seed);
+		float z = Random(seed);
+		return glm::vec3(x, y, z);
+	}
+
+	glm::mat3 RotationAxisAngle(const glm::vec3& v, float a)
+	{
+		float si = std::sin(a);
+		float co = std::cos(a);
+		float ic = 1.f - co;
+
+		// Column major, like the mat3x3 constructor in GLSL
+		return glm::mat3(v.x * v.x * ic + co, v.y * v.x * ic - si * v.z, v.z * v.x * ic + si * v.y,
+			v.x * v.y * ic + si * v.z, v.y * v.y * ic + co, v.z * v.y * ic - si * v.x,
+			v.x * v.z * ic - si * v.y, v.y * v.z * ic + si * v.x, v.z * v.z * ic + co);
+	}
+
+	inline float SamplePosition(int coord, int resolution)
+	{
+		return (static_cast<float>(coord) / resolution) * 2.f - 1.f;
+	}
+}
+
+void SdfProgram::EvaluateBatch(const std::vector<SdfInstruction>& tape, uint16_t tapeResult, const glm::vec3 * positions, int count, float * values,
+	std::vector<float>& pointScratch, std::vector<float>& valueScratch) const
+{
+	pointScratch.resize(static_cast<size_t>(pointRegisters) * 3 * count);
+	valueScratch.resize(static_cast<size_t>(valueRegisters) * count);
+
+	// Each op runs over every point before the next one, so the dispatch is paid once per batch
+	for (const SdfInstruction& instruction : tape)
+	{
+		const float * c = constants.data() + instruction.constant;
+
+		if (IsPointOp(instruction.op)) {
+			float * ox = pointScratch.data() + (instruction.out * 3) * static_cast<size_t>(count);
+			float * oy = ox + count;
+			float * oz = oy + count;
+			const float * ax = pointScratch.data() + (instruction.a * 3) * static_cast<size_t>(count);
+			const float * ay = ax + count;
+			const float * az = ay + count;
+
+			switch (instruction.op)
+			{
+			case SdfOp::Position:
+				for (int i = 0; i < count; ++i) {
+					ox[i] = positions[i].x;
+					oy[i] = positions[i].y;
+					oz[i] = positions[i].z;
+				}
+				break;
+			case SdfOp::Translate:
+				for (int i = 0; i < count; ++i) {
+					ox[i] = ax[i] - c[0];
+					oy[i] = ay[i] - c[1];
+					oz[i] = az[i] - c[2];
+				}
+				break;
+			case SdfOp::Scale:
+				for (int i = 0; i < count; ++i) {
+					ox[i] = ax[i] * c[0];
+					oy[i] = ay[i] * c[0];
+					oz[i] = az[i] * c[0];
+				}
+				break;
+			case SdfOp::Rotate:
+				for (int i = 0; i < count; ++i) {
+					float x = ax[i], y = ay[i], z = az[i];
+					ox[i] = (c[0] * x + c[3] * y) + c[6] * z;
+					oy[i] = (c[1] * x + c[4] * y) + c[7] * z;
+					oz[i] = (c[2] * x + c[5] * y) + c[8] * z;
+				}
+				break;
+			case SdfOp::Bend:
+				for (int i = 0; i < count; ++i) {
+					float x = ax[i], y = ay[i];
+					float co = std::cos(c[0] * y);
+					float si = std::sin(c[0] * y);
+					ox[i] = co * x + si * y;
+					oy[i] = -si * x + co * y;
+					oz[i] = az[i];
+				}
+				break;
+			case SdfOp::Repeat:
+				for (int i = 0; i < count; ++i) {
+					ox[i] = Repeat(ax[i], c[0], c[3]);
+					oy[i] = Repeat(ay[i], c[1], c[4]);
+					oz[i] = Repeat(az[i], c[2], c[5]);
+				}
+				break;
+			default:
+				break;
+			}
+
+			continue;
+		}
+
+		float * out = valueScratch.data() + instruction.out * static_cast<size_t>(count);
+
+		if (IsPrimitive(instruction.op)) {
+			const float * ax = pointScratch.data() + (instruction.a * 3) * static_cast<size_t>(count);
+			const float * ay = ax + count;
+			const float * az = ay + count;
+
+			for (int i = 0; i < count; ++i)
+				out[i] = Primitive(instruction.op, c, ax[i], ay[i], az[i]);
+
+			continue;
+		}
+
+		const float * a = valueScratch.data() + instruction.a * static_cast<size_t>(count);
+		const float * b = valueScratch.data() + instruction.b * static_cast<size_t>(count);
+
+		switch (instruction.op)
+		{
+		case SdfOp::Min:
+			for (int i = 0; i < count; ++i)
+				out[i] = std::min(a[i], b[i]);
+			break;
+		case SdfOp::Max:
+			for (int i = 0; i < count; ++i)
+				out[i] = std::max(a[i], b[i]);
+			break;
+		case SdfOp::Neg:
+			for (int i = 0; i < count; ++i)
+				out[i] = -a[i];
+			break;
+		case SdfOp::Mul:
+			for (int i = 0; i < count; ++i)
+				out[i] = a[i] * c[0];
+			break;
+		case SdfOp::SmoothMin:
+			for (int i = 0; i < count; ++i)
+				out[i] = SmoothMin(a[i], b[i], c[0]);
+			break;
+		default:
+			break;
+		}
+	}
+
+	const float * result = valueScratch.data() + tapeResult * static_cast<size_t>(count);
+	std::copy(result, result + count, values);
+}
+
+float SdfProgram::Evaluate(const glm::vec3& p) const
+{
+	std::vector<float> pointScratch, valueScratch;
+	float value;
+	EvaluateBatch(instructions, result, &p, 1, &value, pointScratch, valueScratch);
+	return value;
+}
+
+SdfInterval SdfProgram::EvaluateInterval(const SdfInterval box[3], std::vector<SdfInstruction>& pruned, uint16_t& prunedResult) const
+{
+	return EvaluateInterval(instructions, result, box, pruned, prunedResult);
+}
+
+SdfInterval SdfProgram::EvaluateInterval(const std::vector<SdfInstruction>& tape, uint16_t tapeResult, const SdfInterval box[3],
+	std::vector<SdfInstruction>& pruned, uint16_t& prunedResult) const
+{
+	// Small enough for the stack on the shapes we have, but graphs are authored at runtime
+	std::vector<SdfInterval> points(static_cast<size_t>(pointRegisters) * 3);
+	std::vector<SdfInterval> values(valueRegisters);
+
+	// A value register that turned out equal to another one in the whole box
+	std::vector<uint16_t> alias(valueRegisters);
+
+	for (uint16_t i = 0; i < valueRegisters; ++i)
+		alias[i] = i;
+
+	std::vector<SdfInstruction> kept;
+	kept.reserve(tape.size());
+
+	for (const SdfInstruction& tapeInstruction : tape)
+	{
+		SdfInstruction instruction = tapeInstruction;
+		const float * c = constants.data() + instruction.constant;
+
+		if (IsPointOp(instruction.op)) {
+			SdfInterval * o = &points[instruction.out * 3];
+			const SdfInterval * p = &points[instruction.a * 3];
+
+			switch (instruction.op)
+			{
+			case SdfOp::Position:
+				o[0] = box[0];
+				o[1] = box[1];
+				o[2] = box[2];
+				break;
+			case SdfOp::Translate:
+				for (int axis = 0; axis < 3; ++axis)
+					o[axis] = { p[axis].lo - c[axis], p[axis].hi - c[axis] };
+				break;
+			case SdfOp::Scale:
+				for (int axis = 0; axis < 3; ++axis)
+					o[axis] = Scale(p[axis], c[0]);
+				break;
+			case SdfOp::Rotate:
+				// Same summation order as the batch, rounding is monotonic so the bounds hold
+				for (int axis = 0; axis < 3; ++axis) {
+					SdfInterval x = Scale(p[0], c[axis]), y = Scale(p[1], c[3 + axis]), z = Scale(p[2], c[6 + axis]);
+					o[axis] = { (x.lo + y.lo) + z.lo, (x.hi + y.hi) + z.hi };
+				}
+				break;
+			case SdfOp::Bend: {
+				SdfInterval angle = Scale(p[1], c[0]);
+				SdfInterval co = Cos(angle), si = Sin(angle);
+				SdfInterval x0 = Mul(co, p[0]), x1 = Mul(si, p[1]);
+				SdfInterval y0 = Mul(si, p[0]), y1 = Mul(co, p[1]);
+				o[0] = { x0.lo + x1.lo, x0.hi + x1.hi };
+				o[1] = { -y0.hi + y1.lo, -y0.lo + y1.hi };
+				o[2] = p[2];
+				break;
+			}
+			case SdfOp::Repeat:
+				for (int axis = 0; axis < 3; ++axis)
+					o[axis] = RepeatInterval(p[axis], c[axis], c[3 + axis]);
+				break;
+			default:
+				break;
+			}
+
+			kept.push_back(instruction);
+			continue;
+		}
+
+		if (IsPrimitive(instruction.op)) {
+			// 1-Lipschitz: within half the box diagonal of the value at its center
+			const SdfInterval * p = &points[instruction.a * 3];
+			float center = Primitive(instruction.op, c, (p[0].lo + p[0].hi) * .5f, (p[1].lo + p[1].hi) * .5f, (p[2].lo + p[2].hi) * .5f);
+			float radius = Length(p[0].hi - p[0].lo, p[1].hi - p[1].lo, p[2].hi - p[2].lo) * .5f;
+			float slack = radius * (1.f + INTERVAL_PADDING) + INTERVAL_PADDING * (1.f + std::abs(center));
+
+			values[instruction.out] = { center - slack, center + slack };
+			kept.push_back(instruction);
+			continue;
+		}
+
+		instruction.a = alias[instruction.a];
+		instruction.b = alias[instruction.b];
+
+		const SdfInterval& a = values[instruction.a];
+		const SdfInterval& b = values[instruction.b];
+		SdfInterval& out = values[instruction.out];
+
+		switch (instruction.op)
+		{
+		case SdfOp::Min:
+			if (a.hi < b.lo) {
+				alias[instruction.out] = instruction.a;
+				continue;
+			}
+
+			if (b.hi < a.lo) {
+				alias[instruction.out] = instruction.b;
+				continue;
+			}
+
+			out = { std::min(a.lo, b.lo), std::min(a.hi, b.hi) };
+			break;
+		case SdfOp::Max:
+			if (a.lo > b.hi) {
+				alias[instruction.out] = instruction.a;
+				continue;
+			}
+
+			if (b.lo > a.hi) {
+				alias[instruction.out] = instruction.b;
+				continue;
+			}
+
+			out = { std::max(a.lo, b.lo), std::max(a.hi, b.hi) };
+			break;
+		case SdfOp::Neg:
+			out = { -a.hi, -a.lo };
+			break;
+		case SdfOp::Mul:
+			out = Scale(a, c[0]);
+			break;
+		case SdfOp::SmoothMin:
+			// The blend term underflows to exactly 0 past this gap, so the smaller branch comes out unchanged
+			if (a.hi < b.lo && std::exp(-c[0] * (b.lo - a.hi)) == 0.f) {
+				alias[instruction.out] = instruction.a;
+				continue;
+			}
+
+			if (b.hi < a.lo && std::exp(-c[0] * (a.lo - b.hi)) == 0.f) {
+				alias[instruction.out] = instruction.b;
+				continue;
+			}
+
+			// Never above min(a, b), never more than log(2) / k below it
+			out = { std::min(a.lo, b.lo) - (.6931472f / c[0]) * (1.f + INTERVAL_PADDING) - INTERVAL_PADDING, std::min(a.hi, b.hi) };
+			break;
+		default:
+			break;
+		}
+
+		kept.push_back(instruction);
+	}
+
+	prunedResult = alias[tapeResult];
+
+	// Drop everything the result no longer depends on, walking back from it
+	std::vector<uint8_t> livePoints(pointRegisters, 0);
+	std::vector<uint8_t> liveValues(valueRegisters, 0);
+	liveValues[prunedResult] = 1;
+
+	pruned.clear();
+
+	for (size_t i = kept.size(); i-- > 0;)
+	{
+		const SdfInstruction& instruction = kept[i];
+
+		if (IsPointOp(instruction.op)) {
+			if (!livePoints[instruction.out])
+				continue;
+
+			livePoints[instruction.a] = 1;
+		}
+		else {
+			if (!liveValues[instruction.out])
+				continue;
+
+			if (IsPrimitive(instruction.op)) {
+				livePoints[instruction.a] = 1;
+			}
+			else {
+				liveValues[instruction.a] = 1;
+
+				if (instruction.op == SdfOp::Min || instruction.op == SdfOp::Max || instruction.op == SdfOp::SmoothMin)
+					liveValues[instruction.b] = 1;
+			}
+		}
+
+		pruned.push_back(instruction);
+	}
+
+	std::reverse(pruned.begin(), pruned.end());
+	return values[prunedResult];
+}
+
+void SdfProgram::BakeRegion(const std::vector<SdfInstruction>& tape, uint16_t tapeResult, int resolution, const glm::ivec3& origin, int size, int level,
+	float farDistance, bool prune, float * distances, BakeScratch& scratch, SdfBakeStats& stats) const
+{
+	std::vector<SdfInstruction>& pruned = scratch.tapes[level];
+	uint16_t prunedResult = tapeResult;
+	SdfInterval range = { 0.f, 0.f };
+
+	if (prune) {
+		SdfInterval box[3];
+
+		for (int axis = 0; axis < 3; ++axis)
+			box[axis] = { SamplePosition(origin[axis], resolution), SamplePosition(origin[axis] + size - 1, resolution) };
+
+		range = EvaluateInterval(tape, tapeResult, box, pruned, prunedResult);
+		stats.instructions += tape.size();
+	}
+	else {
+		pruned = tape;
+	}
+
+	if (size > SDF_GRAPH_LEAF_SIZE) {
+		int half = size / 2;
+
+		for (int child = 0; child < 8; ++child) {
+			glm::ivec3 childOrigin = origin + glm::ivec3(child & 1, (child >> 1) & 1, child >> 2) * half;
+			BakeRegion(pruned, prunedResult, resolution, childOrigin, half, level + 1, farDistance, prune, distances, scratch, stats);
+		}
+
+		return;
+	}
+
+	size_t rowPitch = static_cast<size_t>(resolution);
+	size_t slicePitch = rowPitch * resolution;
+	size_t voxelCount = static_cast<size_t>(size) * size * size;
+
+	// Provably away from the surface, only the corners are evaluated
+	if (prune && farDistance > 0.f && (range.lo > farDistance || range.hi < -farDistance)) {
+		scratch.positions.resize(8);
+
+		for (int corner = 0; corner < 8; ++corner) {
+			glm::ivec3 coord = origin + glm::ivec3(corner & 1, (corner >> 1) & 1, corner >> 2) * (size - 1);
+			scratch.positions[corner] = glm::vec3(SamplePosition(coord.x, resolution), SamplePosition(coord.y, resolution), SamplePosition(coord.z, resolution));
+		}
+
+		float corners[8];
+		EvaluateBatch(pruned, prunedResult, scratch.positions.data(), 8, corners, scratch.points, scratch.values);
+
+		for (int z = 0; z < size; ++z) {
+			float tz = static_cast<float>(z) / (size - 1);
+
+			for (int y = 0; y < size; ++y) {
+				float ty = static_cast<float>(y) / (size - 1);
+				float * row = distances + (origin.z + z) * slicePitch + (origin.y + y) * rowPitch + origin.x;
+
+				for (int x = 0; x < size; ++x) {
+					float tx = static_cast<float>(x) / (size - 1);
+					float x00 = glm::mix(corners[0], corners[1], tx), x10 = glm::mix(corners[2], corners[3], tx);
+					float x01 = glm::mix(corners[4], corners[5], tx), x11 = glm::mix(corners[6], corners[7], tx);
+					row[x] = glm::mix(glm::mix(x00, x10, ty), glm::mix(x01, x11, ty), tz);
+				}
+			}
+		}
+
+		stats.interpolatedVoxels += voxelCount;
+		stats.instructions += pruned.size() * 8;
+		return;
+	}
+
+	scratch.positions.resize(voxelCount);
+	scratch.distances.resize(voxelCount);
+
+	for (int z = 0, i = 0; z < size; ++z)
+		for (int y = 0; y < size; ++y)
+			for (int x = 0; x < size; ++x, ++i)
+				scratch.positions[i] = glm::vec3(SamplePosition(origin.x + x, resolution), SamplePosition(origin.y + y, resolution), SamplePosition(origin.z + z, resolution));
+
+	EvaluateBatch(pruned, prunedResult, scratch.positions.data(), static_cast<int>(voxelCount), scratch.distances.data(), scratch.points, scratch.values);
+
+	for (int z = 0, i = 0; z < size; ++z)
+		for (int y = 0; y < size; ++y, i += size)
+			std::copy(scratch.distances.begin() + i, scratch.distances.begin() + i + size, distances + (origin.z + z) * slicePitch + (origin.y + y) * rowPitch + origin.x);
+
+	stats.exactVoxels += voxelCount;
+	stats.instructions += pruned.size() * voxelCount;
+}
+
+SdfBakeStats SdfProgram::Bake(int resolution, float farDistance, float * distances, bool prune) const
+{
+	if (resolution <= 0 || resolution % SDF_GRAPH_LEAF_SIZE != 0) {
+		throw std::runtime_error("SdfProgram::Bake needs a multiple of SDF_GRAPH_LEAF_SIZE");
+	}
+
+	// Tasks are the largest octree regions up to 4 leaves wide that tile the volume, each subdivided down to the leaves
+	int taskSize = SDF_GRAPH_LEAF_SIZE;
+
+	int levels = 1;
+
+	while (taskSize < SDF_GRAPH_LEAF_SIZE * 4 && resolution % (taskSize * 2) == 0) {
+		taskSize *= 2;
+		++levels;
+	}
+
+	int tasksPerAxis = resolution / taskSize;
+	std::vector<SdfBakeStats> taskStats(static_cast<size_t>(tasksPerAxis) * tasksPerAxis * tasksPerAxis);
+
+	Parallel::For(static_cast<int>(taskStats.size()), [&](int task) {
+		glm::ivec3 origin = glm::ivec3(task % tasksPerAxis, (task / tasksPerAxis) % tasksPerAxis, task / (tasksPerAxis * tasksPerAxis)) * taskSize;
+		BakeScratch scratch;
+		scratch.tapes.resize(levels);
+		BakeRegion(instructions, result, resolution, origin, taskSize, 0, farDistance, prune, distances, scratch, taskStats[task]);
+	});
+
+	SdfBakeStats stats;
+
+	for (const SdfBakeStats& task : taskStats) {
+		stats.exactVoxels += task.exactVoxels;
+		stats.interpolatedVoxels += task.interpolatedVoxels;
+		stats.instructions += task.instructions;
+	}
+
+	stats.fullInstructions = static_cast<uint64_t>(instructions.size()) * resolution * resolution * resolution;
+	return stats;
+}
+
+size_t SdfProgram::GetInstructionCount() const
+{
+	return instructions.size();
+}
+
+uint64_t SdfProgram::ComputeKey() const
+{
+	// Field by field, the struct has padding
+	std::vector<uint32_t> words;
+	words.reserve(instructions.size() * 4 + 1);
+	words.push_back(result);
+
+	for (const SdfInstruction& instruction : instructions) {
+		words.push_back(static_cast<uint32_t>(instruction.op));
+		words.push_back(instruction.out | (static_cast<uint32_t>(instruction.a) << 16));
+		words.push_back(instruction.b);
+		words.push_back(instruction.constant);
+	}
+
+	uint64_t key = FileUtils::Hash(words.data(), words.size() * sizeof(uint32_t));
+	return FileUtils::Hash(constants.data(), constants.size() * sizeof(float), key);
+}
+
+SdfGraph::Node SdfGraph::AddNode(SdfOp op, Node a, Node b, const float * values, int count)
+{
+	int nodeCount = static_cast<int>(nodes.size());
+
+	if (a >= nodeCount || b >= nodeCount) {
+		throw std::runtime_error("SdfGraph node out of range");
+	}
+
+	GraphNode node;
+	node.op = op;
+	node.children[0] = a;
+	node.children[1] = b;
+	node.constant = constants.size();
+	node.constantCount = count;
+	constants.insert(constants.end(), values, values + count);
+	nodes.push_back(node);
+	return nodeCount;
+}
+
+SdfGraph::Node SdfGraph::Sphere(float radius)
+{
+	return AddNode(SdfOp::Sphere, -1, -1, &radius, 1);
+}
+
+SdfGraph::Node SdfGraph::Box(const glm::vec3& halfSize)
+{
+	return AddNode(SdfOp::Box, -1, -1, &halfSize.x, 3);
+}
+
+SdfGraph::Node SdfGraph::Capsule(const glm::vec3& a, const glm::vec3& b, float radius)
+{
+	float values[7] = { a.x, a.y, a.z, b.x, b.y, b.z, radius };
+	return AddNode(SdfOp::Capsule, -1, -1, values, 7);
+}
+
+SdfGraph::Node SdfGraph::CappedCylinder(const glm::vec2& size)
+{
+	return AddNode(SdfOp::CappedCylinder, -1, -1, &size.x, 2);
+}
+
+SdfGraph::Node SdfGraph::Torus(const glm::vec2& radii)
+{
+	return AddNode(SdfOp::Torus, -1, -1, &radii.x, 2);
+}
+
+SdfGraph::Node SdfGraph::Torus82(const glm::vec2& radii)
+{
+	return AddNode(SdfOp::Torus82, -1, -1, &radii.x, 2);
+}
+
+SdfGraph::Node SdfGraph::Ellipsoid(const glm::vec3& radii)
+{
+	return AddNode(SdfOp::Ellipsoid, -1, -1, &radii.x, 3);
+}
+
+SdfGraph::Node SdfGraph::Plane()
+{
+	return AddNode(SdfOp::Plane, -1, -1, nullptr, 0);
+}
+
+SdfGraph::Node SdfGraph::Union(Node a, Node b)
+{
+	return AddNode(SdfOp::Min, a, b, nullptr, 0);
+}
+
+SdfGraph::Node SdfGraph::Intersection(Node a, Node b)
+{
+	return AddNode(SdfOp::Max, a, b, nullptr, 0);
+}
+
+SdfGraph::Node SdfGraph::Subtraction(Node a, Node b)
+{
+	// max(a, -b), compiled with a Neg so both branches prune like any max
+	return AddNode(SdfOp::Neg, a, b, nullptr, 0);
+}
+
+SdfGraph::Node SdfGraph::SmoothUnion(Node a, Node b, float k)
+{
+	if (k <= 0.f) {
+		throw std::runtime_error("SdfGraph::SmoothUnion needs a positive k");
+	}
+
+	return AddNode(SdfOp::SmoothMin, a, b, &k, 1);
+}
+
+SdfGraph::Node SdfGraph::Translate(Node child, const glm::vec3& offset)
+{
+	return AddNode(SdfOp::Translate, child, -1, &offset.x, 3);
+}
+
+SdfGraph::Node SdfGraph::Scale(Node child, float scale)
+{
+	if (scale <= 0.f) {
+		throw std::runtime_error("SdfGraph::Scale needs a positive scale");
+	}
+
+	return AddNode(SdfOp::Scale, child, -1, &scale, 1);
+}
+
+SdfGraph::Node SdfGraph::Rotate(Node child, const glm::mat3& rotation)
+{
+	return AddNode(SdfOp::Rotate, child, -1, &rotation[0][0], 9);
+}
+
+SdfGraph::Node SdfGraph::Bend(Node child, float magnitude)
+{
+	return AddNode(SdfOp::Bend, child, -1, &magnitude, 1);
+}
+
+SdfGraph::Node SdfGraph::Repeat(Node child, const glm::vec3& period, const glm::vec3& extent)
+{
+	float values[6] = { period.x, period.y, period.z, extent.x, extent.y, extent.z };
+	return AddNode(SdfOp::Repeat, child, -1, values, 6);
+}
+
+SdfProgram SdfGraph::Compile(Node root) const
+{
+	if (root < 0 || root >= static_cast<int>(nodes.size())) {
+		throw std::runtime_error("SdfGraph::Compile root out of range");
+	}
+
+	SdfProgram program;
+
+	// Identical point transforms of the same input share a register, and so do nodes reached twice at the same point
+	std::map<std::vector<float>, uint16_t> pointRegisters;
+	std::map<std::pair<Node, uint16_t>, uint16_t> nodeValues;
+
+	auto checkRegisters = [&]() {
+		if (program.pointRegisters == 0xFFFF || program.valueRegisters == 0xFFFF) {
+			throw std::runtime_error("SdfGraph too large for 16 bit registers");
+		}
+	};
+
+	auto emit = [&](SdfOp op, uint16_t out, uint16_t a, uint16_t b, const float * values, int count) {
+		SdfInstruction instruction;
+		instruction.op = op;
+		instruction.out = out;
+		instruction.a = a;
+		instruction.b = b;
+		instruction.constant = static_cast<uint32_t>(program.constants.size());
+		program.constants.insert(program.constants.end(), values, values + count);
+		program.instructions.push_back(instruction);
+	};
+
+	auto emitPoint = [&](SdfOp op, uint16_t a, const float * values, int count) {
+		std::vector<float> key = { static_cast<float>(op), static_cast<float>(a) };
+		key.insert(key.end(), values, values + count);
+
+		auto found = pointRegisters.find(key);
+
+		if (found != pointRegisters.end())
+			return found->second;
+
+		checkRegisters();
+		uint16_t out = program.pointRegisters++;
+		emit(op, out, a, 0, values, count);
+		pointRegisters[key] = out;
+		return out;
+	};
+
+	auto emitValue = [&](SdfOp op, uint16_t a, uint16_t b, const float * values, int count) {
+		checkRegisters();
+		uint16_t out = program.valueRegisters++;
+		emit(op, out, a, b, values, count);
+		return out;
+	};
+
+	std::function<uint16_t(Node, uint16_t)> compileNode = [&](Node index, uint16_t point) -> uint16_t {
+		auto found = nodeValues.find(std::make_pair(index, point));
+
+		if (found != nodeValues.end())
+			return found->second;
+
+		const GraphNode& node = nodes[index];
+		const float * c = constants.data() + node.constant;
+		uint16_t value;
+
+		switch (node.op)
+		{
+		case SdfOp::Translate:
+		case SdfOp::Rotate:
+		case SdfOp::Bend:
+		case SdfOp::Repeat:
+			value = compileNode(node.children[0], emitPoint(node.op, point, c, node.constantCount));
+			break;
+		case SdfOp::Scale: {
+			float inverse = 1.f / c[0];
+			value = compileNode(node.children[0], emitPoint(SdfOp::Scale, point, &inverse, 1));
+			value = emitValue(SdfOp::Mul, value, 0, c, 1);
+			break;
+		}
+		case SdfOp::Min:
+		case SdfOp::Max:
+		case SdfOp::SmoothMin: {
+			uint16_t a = compileNode(node.children[0], point);
+			uint16_t b = compileNode(node.children[1], point);
+			value = emitValue(node.op, a, b, c, node.constantCount);
+			break;
+		}
+		case SdfOp::Neg: {
+			// Subtraction
+			uint16_t a = compileNode(node.children[0], point);
+			uint16_t b = emitValue(SdfOp::Neg, compileNode(node.children[1], point), 0, nullptr, 0);
+			value = emitValue(SdfOp::Max, a, b, nullptr, 0);
+			break;
+		}
+		default:
+			value = emitValue(node.op, point, 0, c, node.constantCount);
+			break;
+		}
+
+		nodeValues[std::make_pair(index, point)] = value;
+		return value;
+	};
+
+	uint16_t position = emitPoint(SdfOp::Position, 0, nullptr, 0);
+	program.result = compileNode(root, position);
+	return program;
+}
+
+namespace SdfShapes {
+	SdfGraph::Node Minion(SdfGraph& graph)
+	{
+		// minionBaseSDF works on point * 4 around (0, 1.5, 0), the bends pivot there
+		glm::vec3 blendOffset(0.f, 1.5f, 0.f);
+
+		auto bend = [&](SdfGraph::Node child, float magnitude) {
+			return graph.Translate(graph.Bend(graph.Translate(child, -blendOffset), magnitude), blendOffset);
+		};
+
+		auto at = [&](SdfGraph::Node child, const glm::vec3& offset) {
+			return graph.Translate(child, offset);
+		};
+
+		SdfGraph::Node base = graph.Capsule(glm::vec3(0.f, .5f, 0.f), glm::vec3(0.f, 3.5f, 0.f), 1.15f);
+		SdfGraph::Node hand1 = bend(graph.Capsule(glm::vec3(1.15f, 1.25f, 0.f), glm::vec3(2.25f, .5f, 0.f), .135f), .15f);
+		SdfGraph::Node hand2 = bend(graph.Capsule(glm::vec3(-1.15f, 1.25f, 0.f), glm::vec3(-2.25f, .5f, 0.f), .135f), -.15f);
+		SdfGraph::Node foot1 = graph.Capsule(glm::vec3(.45f, -1.f, 0.f), glm::vec3(.35f, .5f, 0.f), .2f);
+		SdfGraph::Node foot2 = graph.Capsule(glm::vec3(-.45f, -1.f, 0.f), glm::vec3(-.35f, .5f, 0.f), .2f);
+
+		SdfGraph::Node dist = graph.SmoothUnion(base, hand1, 5.f);
+		dist = graph.SmoothUnion(dist, hand2, 5.f);
+		dist = graph.SmoothUnion(dist, foot1, 5.f);
+		dist = graph.SmoothUnion(dist, foot2, 5.f);
+
+		// Both hands are offset .15 down in their bent space
+		for (int side = 0; side < 2; ++side) {
+			float s = side == 0 ? 1.f : -1.f;
+			glm::vec3 down(0.f, .15f, 0.f);
+
+			SdfGraph::Node hand = at(graph.CappedCylinder(glm::vec2(.2f, .05f)), glm::vec3(1.6f * s, -.45f, 0.f) + down);
+			hand = graph.SmoothUnion(hand, at(graph.CappedCylinder(glm::vec2(.1f, .15f)), glm::vec3(1.6f * s, -.6f, 0.f) + down), 7.5f);
+			hand = graph.SmoothUnion(hand, at(graph.Sphere(.15f), glm::vec3(1.6f * s, -.8f, 0.f) + down), 10.f);
+			hand = graph.SmoothUnion(hand, at(graph.Sphere(.135f), glm::vec3(1.3f * s, -1.f, -.1f) + down), 20.f);
+			hand = graph.SmoothUnion(hand, at(graph.Sphere(.135f), glm::vec3(1.85f * s, -1.f, -.1f) + down), 20.f);
+			hand = graph.SmoothUnion(hand, at(graph.Sphere(.135f), glm::vec3(1.6f * s, -1.15f, -.05f) + down), 20.f);
+
+			// The left hand uses the point bent the other way, like minionBaseSDF
+			dist = graph.Union(dist, bend(hand, -.15f * s));
+		}
+
+		// glassPoint.xzy
+		glm::mat3 swizzle(1.f, 0.f, 0.f, 0.f, 0.f, 1.f, 0.f, 1.f, 0.f);
+		glm::vec3 glassOffset(0.f, 3.f, 1.15f);
+
+		SdfGraph::Node glassBase = at(graph.Rotate(graph.Torus82(glm::vec2(.5f, .1f)), swizzle), glassOffset);
+		SdfGraph::Node belt = at(graph.Torus82(glm::vec2(1.1f, .125f)), glm::vec3(0.f, 3.f, 0.f));
+		belt = graph.Subtraction(belt, at(graph.Sphere(.5f), glassOffset));
+		dist = graph.Union(dist, graph.Union(glassBase, belt));
+		dist = graph.Union(dist, at(graph.Sphere(.55f), glassOffset - glm::vec3(0.f, 0.f, .35f)));
+
+		SdfGraph::Node mouth = graph.Bend(at(graph.Ellipsoid(glm::vec3(.4f, .1f, 1.f)), glm::vec3(.8f, 1.5f, 1.15f)), .25f);
+		dist = graph.Subtraction(dist, mouth);
+
+		// point.y += .5, point *= 4
+		return graph.Translate(graph.Scale(dist, .25f), glm::vec3(0.f, -.5f, 0.f));
+	}
+
+	// randomSpheres and randomCubes rotate p again on every iteration, so each shape sees the product so far
+	SdfGraph::Node RandomSpheres(SdfGraph& graph)
+	{
+		uint32_t seed = 14041956 + 34534;
+		glm::mat3 rotation(1.f);
+		SdfGraph::Node dist = -1;
+
+		for (int i = 0; i < 32; ++i) {
+			glm::vec3 offset = RandomVec3(seed) - .5f;
+			RandomVec3(seed); // The unused size, it still advances the seed
+			glm::vec3 axis = glm::normalize(RandomVec3(seed));
+			float angle = Random(seed) * 3.14f;
+			rotation = RotationAxisAngle(axis, angle) * rotation;
+			float radius = glm::mix(.05f, .3f, Random(seed));
+
+			SdfGraph::Node sphere = graph.Rotate(graph.Translate(graph.Sphere(radius), -offset), rotation);
+			dist = dist < 0 ? sphere : graph.Union(dist, sphere);
+		}
+
+		return dist;
+	}
+
+	SdfGraph::Node RandomCubes(SdfGraph& graph)
+	{
+		uint32_t seed = 14041956 + 34534;
+		glm::mat3 rotation(1.f);
+		SdfGraph::Node dist = -1;
+
+		for (int i = 0; i < 32; ++i) {
+			glm::vec3 offset = RandomVec3(seed) - .5f;
+			glm::vec3 size = RandomVec3(seed) * .2f;
+			glm::vec3 axis = glm::normalize(RandomVec3(seed));
+			float angle = Random(seed) * 3.14f;
+			rotation = RotationAxisAngle(axis, angle) * rotation;
+
+			SdfGraph::Node box = graph.Rotate(graph.Translate(graph.Box(size), offset), rotation);
+			dist = dist < 0 ? box : graph.Union(dist, box);
+		}
+
+		return dist;
+	}
+
+	SdfGraph::Node ByName(SdfGraph& graph, const std::string& name)
+	{
+		if (name == "minion")
+			return Minion(graph);
+
+		if (name == "spheres")
+			return RandomSpheres(graph);
+
+		if (name == "cubes")
+			return RandomCubes(graph);
+
+		return -1;
+	}
+}
@@ -0,0 +1,173 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+
+// Octree leaves of SdfProgram::Bake, evaluated as one batch per tape
+#define SDF_GRAPH_LEAF_SIZE 8
+
+// Leaves whose interval stays this many of their cells away from zero are interpolated from their corners
+#define SDF_GRAPH_FAR_CELLS 4
+
+enum class SdfOp : uint8_t
+{
+	// Points, out = f(point a)
+	Position,			// The sample position
+	Translate,			// a - offset
+	Scale,				// a * inverse scale, the distance is scaled back with Mul
+	Rotate,				// matrix * a
+	Bend,				// opCheapBend in generator.comp
+	Repeat,				// repeatDimension per axis, a period of 0 leaves the axis alone
+
+	// Primitives, out = distance at point a. All are 1-Lipschitz in their own space.
+	Sphere,
+	Box,				// fBox
+	Capsule,
+	CappedCylinder,
+	Torus,
+	Torus82,
+	Ellipsoid,
+	Plane,
+
+	// Values, out = f(value a, value b)
+	Min,
+	Max,
+	Neg,
+	Mul,				// a * constant
+	SmoothMin			// smin in generator.comp, evaluated as min(a, b) - log(1 + exp(-k|a - b|)) / k so it can't overflow
+};
+
+// One operation of the tape. Registers are written once, points and values have their own files.
+struct SdfInstruction
+{
+	SdfOp op;
+	uint16_t out;
+	uint16_t a;
+	uint16_t b;
+	uint32_t constant;	// First constant in SdfProgram::constants
+};
+
+struct SdfInterval
+{
+	float lo;
+	float hi;
+};
+
+// Voxels of an SdfProgram::Bake, and how much work the pruning saved
+struct SdfBakeStats
+{
+	size_t exactVoxels = 0;
+	size_t interpolatedVoxels = 0;
+	uint64_t instructions = 0;		// Instructions run over every exact voxel and every interval
+	uint64_t fullInstructions = 0;	// What the unpruned tape would have run per voxel
+};
+
+// Flat bytecode of an SdfGraph, evaluated on the CPU
+class SdfProgram
+{
+public:
+	SdfProgram() = default;
+
+	// Full tape, one point at a time
+	float Evaluate(const glm::vec3& p) const;
+
+	// Bounds of the field over a box, and a shorter tape that gives the same values in it: min and max drop the
+	// branch that can't win, smooth min when the other branch can't change a bit. The tape is bit-identical there.
+	SdfInterval EvaluateInterval(const SdfInterval box[3], std::vector<SdfInstruction>& pruned, uint16_t& prunedResult) const;
+	SdfInterval EvaluateInterval(const std::vector<SdfInstruction>& tape, uint16_t tapeResult, const SdfInterval box[3],
+		std::vector<SdfInstruction>& pruned, uint16_t& prunedResult) const;
+
+	// resolution^3 distances, x fastest, at the same positions as generator.comp. Octree subdivision with interval
+	// pruning down to SDF_GRAPH_LEAF_SIZE bricks. Bricks whose interval stays farther than farDistance from zero are
+	// trilinear from their corners, with farDistance 0 every voxel is exact and matches Evaluate bit for bit.
+	// resolution must be a multiple of SDF_GRAPH_LEAF_SIZE.
+	// Without pruning, every brick runs the full tape: what the generator did with its hard-coded shapes.
+	SdfBakeStats Bake(int resolution, float farDistance, float * distances, bool prune = true) const;
+
+	size_t GetInstructionCount() const;
+
+	// Key for VolumeCache, covers the tape and its constants
+	uint64_t ComputeKey() const;
+
+private:
+	friend class SdfGraph;
+
+	std::vector<SdfInstruction> instructions;
+	std::vector<float> constants;
+	uint16_t pointRegisters = 0;
+	uint16_t valueRegisters = 0;
+	uint16_t result = 0;
+
+	// Runs a tape over count points, registers laid out as register * count + point
+	void EvaluateBatch(const std::vector<SdfInstruction>& tape, uint16_t tapeResult, const glm::vec3 * points, int count, float * values,
+		std::vector<float>& pointScratch, std::vector<float>& valueScratch) const;
+
+	struct BakeScratch
+	{
+		std::vector<float> points;
+		std::vector<float> values;
+		std::vector<glm::vec3> positions;
+		std::vector<float> distances;
+		std::vector<std::vector<SdfInstruction>> tapes;	// One per octree level
+	};
+
+	void BakeRegion(const std::vector<SdfInstruction>& tape, uint16_t tapeResult, int resolution, const glm::ivec3& origin, int size, int level,
+		float farDistance, bool prune, float * distances, BakeScratch& scratch, SdfBakeStats& stats) const;
+};
+
+// Procedural distance field authored at runtime, compiled into an SdfProgram. Nodes are handles into the graph and can
+// be shared, transforms evaluate their child at the transformed position.
+class SdfGraph
+{
+public:
+	typedef int Node;
+
+	Node Sphere(float radius);
+	Node Box(const glm::vec3& halfSize);
+	Node Capsule(const glm::vec3& a, const glm::vec3& b, float radius);
+	Node CappedCylinder(const glm::vec2& size);
+	Node Torus(const glm::vec2& radii);
+	Node Torus82(const glm::vec2& radii);
+	Node Ellipsoid(const glm::vec3& radii);
+	Node Plane();
+
+	Node Union(Node a, Node b);
+	Node Intersection(Node a, Node b);
+	Node Subtraction(Node a, Node b);	// a minus b
+	Node SmoothUnion(Node a, Node b, float k);
+
+	Node Translate(Node child, const glm::vec3& offset);	// child(p - offset)
+	Node Scale(Node child, float scale);					// child(p / scale) * scale
+	Node Rotate(Node child, const glm::mat3& rotation);		// child(rotation * p)
+	Node Bend(Node child, float magnitude);					// child(opCheapBend(p, magnitude))
+	Node Repeat(Node child, const glm::vec3& period, const glm::vec3& extent);
+
+	// Shared transforms are evaluated once
+	SdfProgram Compile(Node root) const;
+
+private:
+	struct GraphNode
+	{
+		SdfOp op;
+		Node children[2];
+		size_t constant;
+		int constantCount;
+	};
+
+	std::vector<GraphNode> nodes;
+	std::vector<float> constants;
+
+	Node AddNode(SdfOp op, Node a, Node b, const float * values, int count);
+};
+
+// The procedural shapes of generator.comp as graphs. Unlike minionBaseSDF, the minion distances are scaled back to the volume.
+namespace SdfShapes {
+	SdfGraph::Node Minion(SdfGraph& graph);
+	SdfGraph::Node RandomSpheres(SdfGraph& graph);
+	SdfGraph::Node RandomCubes(SdfGraph& graph);
+
+	// By name, for the command line: minion, spheres or cubes. -1 for anything else.
+	SdfGraph::Node ByName(SdfGraph& graph, const std::string& name);
+}
@@ -0,0 +1,169 @@
+#include "TaskScheduler.h"
+
+namespace {
+	// Index of the queue owned by the current thread, 0 for threads outside the pool
+	thread_local int workerIndex = 0;
+}
+
+TaskScheduler& TaskScheduler::Get()
+{
+	static TaskScheduler scheduler;
+	return scheduler;
+}
+
+TaskScheduler::TaskScheduler() : queuedTasks(0), running(false)
+{
+	unsigned int count = std::thread::hardware_concurrency();
+	Start(count > 0 ? count : 1);
+}
+
+TaskScheduler::~TaskScheduler()
+{
+	Stop();
+}
+
+unsigned int TaskScheduler::GetThreadCount() const
+{
+	return static_cast<unsigned int>(workers.size()) + 1;
+}
+
+void TaskScheduler::SetThreadCount(unsigned int count)
+{
+	Stop();
+	Start(count > 0 ? count : 1);
+}
+
+void TaskScheduler::Start(unsigned int count)
+{
+	running = true;
+	queues.clear();
+
+	for (unsigned int i = 0; i < count; ++i)
+		queues.emplace_back(new TaskQueue());
+
+	for (unsigned int i = 1; i < count; ++i)
+		workers.emplace_back(&TaskScheduler::WorkerLoop, this, static_cast<int>(i));
+}
+
+void TaskScheduler::Stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		running = false;
+	}
+
+	wakeUp.notify_all();
+
+	for (std::thread& worker : workers)
+		worker.join();
+
+	workers.clear();
+}
+
+void TaskScheduler::Push(Task&& task)
+{
+	TaskQueue & queue = *queues[workerIndex];
+
+	{
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.tasks.push_back(std::move(task));
+	}
+
+	queuedTasks++;
+
+	// Taking the lock orders the notification after a worker that found nothing went to sleep
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+	}
+
+	wakeUp.notify_one();
+}
+
+bool TaskScheduler::TryRunTask()
+{
+	Task task;
+	bool found = false;
+	int queueCount = static_cast<int>(queues.size());
+
+	// Own queue first, newest task
+	{
+		TaskQueue & queue = *queues[workerIndex];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+
+		if (!queue.tasks.empty())
+		{
+			task = std::move(queue.tasks.back());
+			queue.tasks.pop_back();
+			found = true;
+		}
+	}
+
+	// Otherwise steal the oldest task of someone else
+	for (int i = 1; i < queueCount && !found; ++i)
+	{
+		TaskQueue & queue = *queues[(workerIndex + i) % queueCount];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+
+		if (!queue.tasks.empty())
+		{
+			task = std::move(queue.tasks.front());
+			queue.tasks.pop_front();
+			found = true;
+		}
+	}
+
+	if (!found)
+		return false;
+
+	queuedTasks--;
+	task.function();
+	task.group->pending--;
+	return true;
+}
+
+void TaskScheduler::WorkerLoop(int index)
+{
+	workerIndex = index;
+
+	while (true)
+	{
+		if (TryRunTask())
+			continue;
+
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		wakeUp.wait(lock, [this]() { return !running || queuedTasks > 0; });
+
+		if (!running)
+			break;
+	}
+}
+
+TaskGroup::TaskGroup() : pending(0)
+{
+}
+
+TaskGroup::~TaskGroup()
+{
+	Wait();
+}
+
+void TaskGroup::Run(std::function<void()> function)
+{
+	TaskScheduler::Task task;
+	task.function = std::move(function);
+	task.group = this;
+
+	pending++;
+	TaskScheduler::Get().Push(std::move(task));
+}
+
+void TaskGroup::Wait()
+{
+	TaskScheduler & scheduler = TaskScheduler::Get();
+
+	while (pending > 0)
+	{
+		if (!scheduler.TryRunTask())
+			std::this_thread::yield();
+	}
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class TaskGroup;
+
+// Pool of persistent worker threads with one task deque each. Workers pop their own most recent
+// task first and steal the oldest task of other workers when they run out, so big subtrees spread
+// out quickly while small ones stay on the thread that created them.
+class TaskScheduler
+{
+public:
+	static TaskScheduler& Get();
+
+	~TaskScheduler();
+
+	// Total threads doing work, counting the thread that waits on a task group
+	unsigned int GetThreadCount() const;
+
+	// Restarts the pool with count - 1 workers. Must not be called while tasks are running.
+	void SetThreadCount(unsigned int count);
+
+private:
+	friend class TaskGroup;
+
+	struct Task
+	{
+		std::function<void()> function;
+		TaskGroup * group;
+	};
+
+	struct TaskQueue
+	{
+		std::mutex mutex;
+		std::deque<Task> tasks;
+	};
+
+	TaskScheduler();
+
+	void Start(unsigned int count);
+	void Stop();
+
+	void Push(Task&& task);
+	bool TryRunTask();
+	void WorkerLoop(int index);
+
+	// Queue 0 is shared by every thread that is not a worker
+	std::vector<std::unique_ptr<TaskQueue>> queues;
+	std::vector<std::thread> workers;
+
+	std::mutex sleepMutex;
+	std::condition_variable wakeUp;
+	std::atomic<int> queuedTasks;
+	std::atomic<bool> running;
+};
+
+// Set of tasks that can be waited on together. Waiting threads execute pending tasks instead of blocking,
+// so groups can be nested freely inside other tasks.
+class TaskGroup
+{
+public:
+	TaskGroup();
+	~TaskGroup();
+
+	void Run(std::function<void()> function);
+	void Wait();
+
+private:
+	friend class TaskScheduler;
+
+	std::atomic<int> pending;
+};
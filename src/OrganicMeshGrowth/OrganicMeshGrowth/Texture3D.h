@@ -18,6 +18,17 @@ public:
 	VkImage GetImage();
 	VkImageView GetImageView();
 	VkSampler GetSampler();
+
+	VkFormat GetFormat() const;
+	VkExtent3D GetExtent() const;
+
+	// Size of the whole image tightly packed, as buffer copies read and write it
+	VkDeviceSize GetByteSize() const;
+
+	// Blocking copies on the compute queue. Both leave the image in VK_IMAGE_LAYOUT_GENERAL, where the compute and
+	// raymarching descriptors expect it. CopyToBuffer makes the texels visible to the host once it returns.
+	void CopyFromBuffer(VkCommandPool commandPool, VkBuffer buffer);
+	void CopyToBuffer(VkCommandPool commandPool, VkBuffer buffer);
 	
 protected:
 	uint32_t width;
@@ -0,0 +1,168 @@
+#include "VolumeCache.h"
+#include "FileUtils.h"
+#include "MeshCache.h"
+#include <cstdio>
+#include <cstring>
+
+#define VOLUME_CACHE_ALIGNMENT 16
+
+namespace {
+	const char MAGIC[8] = { 'O', 'M', 'G', 'V', 'O', 'L', '\0', '\0' };
+
+	struct VolumeCacheHeader
+	{
+		char magic[8];
+		uint32_t version;
+		uint32_t headerSize;
+		uint64_t key;
+
+		int32_t width;
+		int32_t height;
+		int32_t depth;
+		uint32_t format;
+
+		uint64_t texelOffset;
+		uint64_t texelSize;
+		uint64_t fileSize;
+	};
+
+	inline uint64_t Align(uint64_t offset)
+	{
+		return (offset + VOLUME_CACHE_ALIGNMENT - 1) & ~static_cast<uint64_t>(VOLUME_CACHE_ALIGNMENT - 1);
+	}
+}
+
+VolumeCache::VolumeCache() : texels(nullptr), size(0)
+{
+}
+
+uint64_t VolumeCache::ComputeKey(uint64_t generatorKey, uint64_t meshKey, int width, int height, int depth, uint32_t format)
+{
+	struct {
+		uint32_t version;
+		uint32_t format;
+		int32_t width;
+		int32_t height;
+		int32_t depth;
+		int32_t padding;
+		uint64_t meshKey;
+	} parameters;
+
+	memset(&parameters, 0, sizeof(parameters));
+	parameters.version = VOLUME_CACHE_VERSION;
+	parameters.format = format;
+	parameters.width = width;
+	parameters.height = height;
+	parameters.depth = depth;
+	parameters.meshKey = meshKey;
+
+	return FileUtils::Hash(&parameters, sizeof(parameters), generatorKey);
+}
+
+std::string VolumeCache::GetCachePath(uint64_t key)
+{
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(key));
+	return std::string(MESH_CACHE_DIRECTORY) + "/" + name + ".omgvol";
+}
+
+bool VolumeCache::Save(const std::string& filename, uint64_t key, int width, int height, int depth, uint32_t format, const void * texels, uint64_t size)
+{
+	if (!FileUtils::EnsureDirectory(MESH_CACHE_DIRECTORY))
+		return false;
+
+	VolumeCacheHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.version = VOLUME_CACHE_VERSION;
+	header.headerSize = sizeof(VolumeCacheHeader);
+	header.key = key;
+	header.width = width;
+	header.height = height;
+	header.depth = depth;
+	header.format = format;
+	header.texelOffset = Align(sizeof(VolumeCacheHeader));
+	header.texelSize = size;
+	header.fileSize = header.texelOffset + size;
+
+	std::string temporaryFilename = filename + ".tmp";
+	FILE * f = fopen(temporaryFilename.c_str(), "wb");
+
+	if (f == nullptr)
+		return false;
+
+	static const char zeros[VOLUME_CACHE_ALIGNMENT] = {};
+	size_t padding = static_cast<size_t>(header.texelOffset - sizeof(header));
+
+	bool success = fwrite(&header, sizeof(header), 1, f) == 1
+		&& (padding == 0 || fwrite(zeros, 1, padding, f) == padding)
+		&& fwrite(texels, 1, static_cast<size_t>(size), f) == size;
+
+	success = fclose(f) == 0 && success;
+
+	if (!success || !FileUtils::ReplaceFile(temporaryFilename, filename))
+	{
+		remove(temporaryFilename.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+bool VolumeCache::Open(const std::string& filename, uint64_t key, uint64_t expectedSize)
+{
+	Close();
+
+	if (!file.Open(filename))
+		return false;
+
+	const char * data = file.GetData();
+	size_t fileSize = file.GetSize();
+
+	if (fileSize < sizeof(VolumeCacheHeader))
+	{
+		Close();
+		return false;
+	}
+
+	VolumeCacheHeader header;
+	memcpy(&header, data, sizeof(header));
+
+	// A stale or foreign file is just a cache miss
+	bool valid = memcmp(header.magic, MAGIC, sizeof(MAGIC)) == 0
+		&& header.version == VOLUME_CACHE_VERSION
+		&& header.headerSize == sizeof(VolumeCacheHeader)
+		&& header.key == key
+		&& header.fileSize == fileSize
+		&& header.texelSize == expectedSize
+		&& header.texelOffset % VOLUME_CACHE_ALIGNMENT == 0
+		&& header.texelOffset >= sizeof(VolumeCacheHeader)
+		&& header.texelOffset + header.texelSize == fileSize;
+
+	if (!valid)
+	{
+		Close();
+		return false;
+	}
+
+	texels = data + header.texelOffset;
+	size = header.texelSize;
+	return true;
+}
+
+void VolumeCache::Close()
+{
+	file.Close();
+	texels = nullptr;
+	size = 0;
+}
+
+const void * VolumeCache::GetTexels() const
+{
+	return texels;
+}
+
+uint64_t VolumeCache::GetSize() const
+{
+	return size;
+}
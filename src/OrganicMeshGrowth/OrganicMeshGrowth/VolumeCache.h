@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "MappedFile.h"
+
+// Bump this whenever the .omgvol header changes
+#define VOLUME_CACHE_VERSION 1
+
+// Generated .omgvol file: a header followed by the texels of a 3D image, tightly packed in the image format,
+// so a cache hit is a single copy into a staging buffer. Lives next to the .omgmesh files in MESH_CACHE_DIRECTORY.
+class VolumeCache
+{
+public:
+	VolumeCache();
+
+	// generatorKey covers the generator shader and its settings, meshKey the MeshCache key (0 if the volume does not
+	// depend on the mesh). The image size and format are part of the key too.
+	static uint64_t ComputeKey(uint64_t generatorKey, uint64_t meshKey, int width, int height, int depth, uint32_t format);
+	static std::string GetCachePath(uint64_t key);
+
+	// Writes to a temporary file and then moves it in place, so a crash never leaves a truncated cache
+	static bool Save(const std::string& filename, uint64_t key, int width, int height, int depth, uint32_t format, const void * texels, uint64_t size);
+
+	// Maps the file and validates it against the key and expected size. The texels stay valid until Close() or destruction.
+	bool Open(const std::string& filename, uint64_t key, uint64_t expectedSize);
+	void Close();
+
+	const void * GetTexels() const;
+	uint64_t GetSize() const;
+
+private:
+	MappedFile file;
+	const void * texels;
+	uint64_t size;
+};
@@ -0,0 +1,195 @@
+#include "WindingNumber.h"
+#include "MeshQuery.h"
+#include <cmath>
+#include <glm/gtc/constants.hpp>
+
+namespace {
+	const float INV_FOUR_PI = 1.f / (4.f * glm::pi<float>());
+
+	// Signed solid angle of a triangle seen from the origin, Van Oosterom and Strackee
+	inline float SolidAngle(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c)
+	{
+		float la = glm::length(a);
+		float lb = glm::length(b);
+		float lc = glm::length(c);
+
+		float determinant = glm::dot(a, glm::cross(b, c));
+		float denominator = la * lb * lc + glm::dot(a, b) * lc + glm::dot(b, c) * la + glm::dot(c, a) * lb;
+		return 2.f * std::atan2(determinant, denominator);
+	}
+}
+
+WindingNumber::WindingNumber(const CompactKdTree& tree) : nodes(tree.nodes, tree.nodes + tree.nodeCount),
+	pairParents(tree.pairParents, tree.pairParents + tree.pairCount), dipoles(tree.nodeCount),
+	leafTriangleStart(tree.nodeCount, 0), leafTriangleCount(tree.nodeCount, 0)
+{
+	MeshQuery query(tree);
+	std::vector<int> owner(tree.triangleCount, -1);
+
+	// Every triangle belongs to the first leaf that references it, so spatial splits don't count it twice
+	for (int node = 0; node < tree.nodeCount; ++node)
+	{
+		const CompactNode& n = tree.nodes[node];
+
+		if (!n.IsLeaf())
+			continue;
+
+		leafTriangleStart[node] = static_cast<int>(leafVertices.size() / 3);
+
+		for (int i = 0; i < n.GetPrimitiveCount(); ++i)
+		{
+			int triangle = tree.leafIndices[n.primitiveStartOffset + i];
+
+			if (owner[triangle] != -1)
+				continue;
+
+			owner[triangle] = node;
+
+			TriangleData t = query.LoadTriangle(triangle);
+			leafVertices.push_back(t.v1);
+			leafVertices.push_back(t.v2);
+			leafVertices.push_back(t.v3);
+		}
+
+		leafTriangleCount[node] = static_cast<int>(leafVertices.size() / 3) - leafTriangleStart[node];
+	}
+
+	// Children always come after their parent, so walking backwards merges them bottom up
+	for (int node = tree.nodeCount - 1; node >= 0; --node)
+	{
+		const CompactNode& n = tree.nodes[node];
+		NodeDipole& d = dipoles[node];
+
+		d.center = glm::vec3(0.f);
+		d.areaNormal = glm::vec3(0.f);
+		d.area = 0.f;
+		d.radius = 0.f;
+
+		if (n.IsLeaf())
+		{
+			const glm::vec3 * v = leafVertices.data() + leafTriangleStart[node] * 3;
+
+			for (int i = 0; i < leafTriangleCount[node]; ++i, v += 3)
+			{
+				glm::vec3 weightedNormal = glm::cross(v[1] - v[0], v[2] - v[0]) * .5f;
+				float area = glm::length(weightedNormal);
+
+				d.areaNormal += weightedNormal;
+				d.center += (v[0] + v[1] + v[2]) * (area / 3.f);
+				d.area += area;
+			}
+
+			if (d.area > 0.f)
+				d.center /= d.area;
+
+			v = leafVertices.data() + leafTriangleStart[node] * 3;
+
+			for (int i = 0; i < leafTriangleCount[node] * 3; ++i)
+				d.radius = glm::max(d.radius, glm::length(v[i] - d.center));
+		}
+		else
+		{
+			const NodeDipole& left = dipoles[n.GetLeftChild()];
+			const NodeDipole& right = dipoles[n.GetRightChild()];
+
+			d.areaNormal = left.areaNormal + right.areaNormal;
+			d.area = left.area + right.area;
+
+			if (d.area > 0.f)
+			{
+				d.center = (left.center * left.area + right.center * right.area) / d.area;
+
+				if (left.area > 0.f)
+					d.radius = glm::max(d.radius, glm::length(left.center - d.center) + left.radius);
+
+				if (right.area > 0.f)
+					d.radius = glm::max(d.radius, glm::length(right.center - d.center) + right.radius);
+			}
+		}
+	}
+}
+
+float WindingNumber::Evaluate(const glm::vec3& p) const
+{
+	WindingNumberStats stats;
+	return Evaluate(p, stats);
+}
+
+float WindingNumber::Evaluate(const glm::vec3& p, WindingNumberStats& stats) const
+{
+	// Same stackless walk as MeshQuery, but every node is visited unless its dipole is good enough.
+	// Left children are the even node of each pair, so after a left subtree comes its sibling.
+	float solidAngle = 0.f;
+	int currentNode = 0;
+	bool descending = true;
+
+	stats.queries++;
+
+	while (true)
+	{
+		if (descending)
+		{
+			const NodeDipole& d = dipoles[currentNode];
+			const CompactNode& node = nodes[currentNode];
+
+			stats.nodeVisits++;
+
+			if (d.area == 0.f)
+			{
+				descending = false;
+				continue;
+			}
+
+			glm::vec3 toCenter = d.center - p;
+			float distance = glm::length(toCenter);
+
+			if (distance > d.radius * WINDING_NUMBER_ACCURACY)
+			{
+				solidAngle += glm::dot(d.areaNormal, toCenter) / (distance * distance * distance);
+				descending = false;
+				stats.dipoles++;
+			}
+			else if (node.IsLeaf())
+			{
+				const glm::vec3 * v = leafVertices.data() + leafTriangleStart[currentNode] * 3;
+
+				for (int i = 0; i < leafTriangleCount[currentNode]; ++i, v += 3)
+					solidAngle += SolidAngle(v[0] - p, v[1] - p, v[2] - p);
+
+				stats.triangleTests += leafTriangleCount[currentNode];
+				descending = false;
+			}
+			else
+			{
+				currentNode = node.GetLeftChild();
+			}
+		}
+		else
+		{
+			if (currentNode == 0)
+				break;
+
+			if ((currentNode & 1) == 0)
+			{
+				currentNode ^= 1;
+				descending = true;
+			}
+			else
+			{
+				currentNode = pairParents[currentNode / 2];
+			}
+		}
+	}
+
+	return solidAngle * INV_FOUR_PI;
+}
+
+float WindingNumber::EvaluateBruteForce(const glm::vec3& p) const
+{
+	float solidAngle = 0.f;
+
+	for (size_t i = 0; i < leafVertices.size(); i += 3)
+		solidAngle += SolidAngle(leafVertices[i] - p, leafVertices[i + 1] - p, leafVertices[i + 2] - p);
+
+	return solidAngle * INV_FOUR_PI;
+}
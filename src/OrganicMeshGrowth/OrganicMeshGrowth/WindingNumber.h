@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "Mesh.h"
+
+// A node is replaced by its dipole once the query is this many bounding radii away from its center.
+// Bigger is more accurate and slower, 2 is the usual Barnes-Hut choice.
+#define WINDING_NUMBER_ACCURACY 2.f
+
+// Work done by winding number queries, accumulated over many calls
+struct WindingNumberStats
+{
+	uint64_t queries = 0;
+	uint64_t nodeVisits = 0;
+	uint64_t dipoles = 0;			// Nodes approximated by their dipole
+	uint64_t triangleTests = 0;		// Exact solid angles
+};
+
+// Generalized winding number of the mesh, ~1 inside and ~0 outside even with holes and self intersections.
+// Evaluated Barnes-Hut style over the compact kd-tree: nodes far from the query are replaced by the dipole
+// of their area weighted normals, and only leaves close to it sum exact triangle solid angles.
+// Triangles referenced by several leaves are only counted in the first one.
+class WindingNumber
+{
+public:
+	WindingNumber(const CompactKdTree& tree);
+
+	float Evaluate(const glm::vec3& p) const;
+	float Evaluate(const glm::vec3& p, WindingNumberStats& stats) const;
+
+	// Sums every triangle, the reference the approximation is validated against
+	float EvaluateBruteForce(const glm::vec3& p) const;
+
+	inline bool IsInside(const glm::vec3& p) const { return Evaluate(p) > .5f; }
+
+private:
+	struct NodeDipole
+	{
+		glm::vec3 center;		// Area weighted centroid of the node triangles
+		float radius;			// Around center, containing every vertex
+		glm::vec3 areaNormal;	// Sum of area times outward normal
+		float area;				// Zero for nodes without triangles, which are skipped
+	};
+
+	// Copied, so the kd-tree arrays can go away once this is built
+	std::vector<CompactNode> nodes;
+	std::vector<int> pairParents;
+	std::vector<NodeDipole> dipoles;
+
+	// Three vertices per owned triangle, grouped by leaf
+	std::vector<glm::vec3> leafVertices;
+	std::vector<int> leafTriangleStart;
+	std::vector<int> leafTriangleCount;
+};
@@ -1,13 +1,10 @@
 cd shaders
 
-%VK_SDK_PATH%\Bin\glslangValidator.exe -V graphics.vert
-move vert.spv graphics.vert.spv
-
-%VK_SDK_PATH%\Bin\glslangValidator.exe -V graphics.frag
-move frag.spv graphics.frag.spv
-
-%VK_SDK_PATH%\Bin\glslangValidator.exe -V kernel.comp
-move comp.spv kernel.comp.spv
-
-%VK_SDK_PATH%\Bin\glslangValidator.exe -V generator.comp
-move comp.spv generator.comp.spv
\ No newline at end of file
+rem -o writes next to the source, and the first shader that fails stops the script so no stale .spv is left behind
+%VK_SDK_PATH%\Bin\glslangValidator.exe -V graphics.vert -o graphics.vert.spv || exit /b 1
+%VK_SDK_PATH%\Bin\glslangValidator.exe -V graphics.frag -o graphics.frag.spv || exit /b 1
+%VK_SDK_PATH%\Bin\glslangValidator.exe -V kernel.comp -o kernel.comp.spv || exit /b 1
+%VK_SDK_PATH%\Bin\glslangValidator.exe -V bricks.comp -o bricks.comp.spv || exit /b 1
+%VK_SDK_PATH%\Bin\glslangValidator.exe -V derivatives.comp -o derivatives.comp.spv || exit /b 1
+%VK_SDK_PATH%\Bin\glslangValidator.exe -V relaxation.comp -o relaxation.comp.spv || exit /b 1
+%VK_SDK_PATH%\Bin\glslangValidator.exe -V generator.comp -o generator.comp.spv || exit /b 1
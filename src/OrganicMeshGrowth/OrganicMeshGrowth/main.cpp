@@ -6,6 +6,16 @@
 #include "Camera.h"
 #include "Scene.h"
 #include "Image.h"
+#include "Benchmark.h"
+#include "ObjParser.h"
+#include "SdfBaker.h"
+#include "SdfGraph.h"
+#include "GrowthSimulator.h"
+#include "NoiseBaker.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <chrono>
+#include <functional>
 #include <iostream>
 
 Device* device;
@@ -65,9 +75,295 @@ namespace {
             previousY = yPosition;
         }
     }
+
+    // 1 to 4 switch between the growth presets without stopping, the sdf grows on from where it is
+    void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods) {
+        const GrowthPreset presets[] = { GrowthPreset::MoltenCore, GrowthPreset::DemonBunny, GrowthPreset::Coral, GrowthPreset::Mushroom };
+
+        if (action == GLFW_PRESS && key >= GLFW_KEY_1 && key <= GLFW_KEY_4) {
+            GrowthPreset preset = presets[key - GLFW_KEY_1];
+            renderer->SetGrowthBehaviour(GrowthBehaviour::FromPreset(preset));
+            std::cout << "Growth behaviour " << GrowthBehaviour::GetPresetName(preset) << std::endl;
+        }
+    }
+
+    // Bakes a mesh SDF on the CPU and writes it with SdfBaker::Save, no window or Vulkan device needed
+    // A band width of 0 computes exact distances everywhere, otherwise see SdfBaker::BakeNarrowBand.
+    // Without a band, a coarse resolution above 0 bakes coarse to fine, see SdfBaker::BakeHierarchical.
+    bool bakeMeshSDF(const std::string& objFilename, const std::string& outputFilename, int resolution, float scaleMultiplier, int bandWidth, int coarseResolution) {
+        ObjData obj;
+        std::string error;
+
+        if (!ObjParser::Load(objFilename, obj, error)) {
+            std::cout << "Failed to load " << objFilename << ": " << error << std::endl;
+            return false;
+        }
+
+        Arena arena;
+        TriangleSoup triangles;
+        triangles.Load(arena, obj, scaleMultiplier);
+
+        Mesh kdMesh(KD_TREE_MAX_DEPTH, KD_TREE_MAX_LEAF_SIZE, triangles, KD_TREE_SPLIT_METHOD, KD_TREE_SPATIAL_SPLITS, KD_TREE_TRIANGLE_LAYOUT);
+        kdMesh.Build();
+
+        // Scans with holes bake with the right sign, unlike the bent normals of the GPU generator
+        SdfBaker baker(kdMesh.GetCompactKdTree(), SdfSignMethod::WindingNumberBricks);
+        std::vector<float> distances(static_cast<size_t>(resolution) * resolution * resolution);
+
+        std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+        size_t exactCount = 0;
+
+        if (bandWidth > 0)
+            baker.BakeNarrowBand(resolution, bandWidth, distances.data());
+        else if (coarseResolution > 0)
+            exactCount = baker.BakeHierarchical(resolution, coarseResolution, distances.data());
+        else
+            baker.Bake(resolution, distances.data());
+
+        std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+
+        std::cout << "Baked " << objFilename << " at " << resolution << "^3 in " << elapsed.count() << " s" << (SdfBaker::UsesAVX2() ? " (AVX2)" : "");
+
+        if (bandWidth > 0)
+            std::cout << ", narrow band of " << bandWidth << " cells";
+        else if (coarseResolution > 0)
+            std::cout << ", from " << coarseResolution << "^3 with " << exactCount << " exact queries, " << distances.size() - exactCount << " skipped";
+
+        std::cout << std::endl;
+
+        if (!SdfBaker::Save(outputFilename, resolution, distances.data())) {
+            std::cout << "Could not write " << outputFilename << std::endl;
+            return false;
+        }
+
+        return true;
+    }
+
+    // Bakes one of the SdfShapes, exact everywhere, in the same format as bakeMeshSDF
+    bool bakeShapeSDF(const std::string& shape, const std::string& outputFilename, int resolution) {
+        SdfGraph graph;
+        SdfGraph::Node root = SdfShapes::ByName(graph, shape);
+
+        if (root < 0) {
+            std::cout << "Unknown shape " << shape << ", expected minion, spheres or cubes" << std::endl;
+            return false;
+        }
+
+        SdfProgram program = graph.Compile(root);
+        std::vector<float> distances(static_cast<size_t>(resolution) * resolution * resolution);
+
+        std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+        SdfBakeStats stats = program.Bake(resolution, 0.f, distances.data());
+        std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+
+        std::cout << "Baked " << shape << " at " << resolution << "^3 in " << elapsed.count() << " s, " << program.GetInstructionCount() << " instructions, "
+            << static_cast<double>(stats.instructions) / distances.size() << " run per voxel" << std::endl;
+
+        if (!SdfBaker::Save(outputFilename, resolution, distances.data())) {
+            std::cout << "Could not write " << outputFilename << std::endl;
+            return false;
+        }
+
+        return true;
+    }
+
+    // Runs a preset or behaviour file on the CPU from a mesh or one of the SdfShapes and saves the grown volume.
+    // Every step is one frame of the application, the vector field is the default NoiseBaker one.
+    bool growSDF(const std::string& behaviourName, const std::string& seed, const std::string& outputFilename, int steps, int resolution, float scaleMultiplier) {
+        GrowthBehaviour behaviour;
+        std::string behaviourError;
+
+        if (!GrowthBehaviour::FromName(behaviourName, behaviour, behaviourError)) {
+            std::cout << behaviourError << ", expected a behaviour file or molten-core, demon-bunny, coral or mushroom" << std::endl;
+            return false;
+        }
+
+        std::vector<float> distances(static_cast<size_t>(resolution) * resolution * resolution);
+
+        if (seed.size() > 4 && seed.compare(seed.size() - 4, 4, ".obj") == 0) {
+            ObjData obj;
+            std::string error;
+
+            if (!ObjParser::Load(seed, obj, error)) {
+                std::cout << "Failed to load " << seed << ": " << error << std::endl;
+                return false;
+            }
+
+            Arena arena;
+            TriangleSoup triangles;
+            triangles.Load(arena, obj, scaleMultiplier);
+
+            Mesh kdMesh(KD_TREE_MAX_DEPTH, KD_TREE_MAX_LEAF_SIZE, triangles, KD_TREE_SPLIT_METHOD, KD_TREE_SPATIAL_SPLITS, KD_TREE_TRIANGLE_LAYOUT);
+            kdMesh.Build();
+
+            SdfBaker baker(kdMesh.GetCompactKdTree(), SdfSignMethod::WindingNumberBricks);
+            baker.Bake(resolution, distances.data());
+        }
+        else {
+            SdfGraph graph;
+            SdfGraph::Node root = SdfShapes::ByName(graph, seed);
+
+            if (root < 0) {
+                std::cout << "Unknown seed " << seed << ", expected an .obj mesh, minion, spheres or cubes" << std::endl;
+                return false;
+            }
+
+            graph.Compile(root).Bake(resolution, 0.f, distances.data());
+        }
+
+        std::vector<float> field(distances.size() * 4);
+        NoiseBaker(NoiseParameters(), resolution).Bake(field.data());
+
+        GrowthSimulator simulator(resolution, behaviour);
+        simulator.SetVolume(distances.data());
+        simulator.SetVectorField(field.data());
+
+        std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+        double activeBricks = 0.0;
+
+        for (int i = 0; i < steps; ++i) {
+            simulator.Step((i + 1) * GROWTH_FRAME_TIME);
+            activeBricks += simulator.GetActiveBrickCount();
+        }
+
+        std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+
+        std::cout << "Grew " << seed << " with " << behaviourName << " at " << resolution << "^3, " << steps << " steps in " << elapsed.count() << " s, "
+            << distances.size() * static_cast<double>(steps) / elapsed.count() * 1e-6 << " Mcells/s" << (GrowthSimulator::UsesAVX2() ? " (AVX2)" : "");
+
+        if (simulator.IsSparse())
+            std::cout << ", " << 100.0 * activeBricks / (std::max(steps, 1) * static_cast<double>(simulator.GetBrickCount())) << "% of the bricks updated per step";
+
+        std::cout << std::endl;
+
+        if (!SdfBaker::Save(outputFilename, resolution, simulator.GetVolume())) {
+            std::cout << "Could not write " << outputFilename << std::endl;
+            return false;
+        }
+
+        return true;
+    }
+
+    struct BenchmarkEntry {
+        const char* name;
+        std::function<void(const std::vector<std::string>&)> run;
+    };
+
+    // Every offline measurement of Benchmark.h with the sizes it was written for, in the order they were added
+    const std::vector<BenchmarkEntry>& benchmarkEntries() {
+        static const std::vector<BenchmarkEntry> entries = {
+            { "obj-parsing", [](const std::vector<std::string>& meshes) { Benchmark::ObjParsing(meshes, 5); } },
+            { "kd-tree-splits", [](const std::vector<std::string>& meshes) { Benchmark::KdTreeSplits(meshes, 64); } },
+            { "kd-tree-build-scaling", [](const std::vector<std::string>& meshes) { Benchmark::KdTreeBuildScaling(meshes, 5); } },
+            { "triangle-layouts", [](const std::vector<std::string>& meshes) { Benchmark::TriangleLayouts(meshes, 64); } },
+            { "kd-tree-traversal", [](const std::vector<std::string>& meshes) { Benchmark::KdTreeTraversal(meshes, 24); } },
+            { "kd-tree-parameters", [](const std::vector<std::string>& meshes) { Benchmark::KdTreeParameters(meshes, 32); } },
+            { "sdf-baking", [](const std::vector<std::string>& meshes) { Benchmark::SdfBaking(meshes, 64); } },
+            { "narrow-band-baking", [](const std::vector<std::string>& meshes) { Benchmark::NarrowBandBaking(meshes, 128, SDF_NARROW_BAND_WIDTH); } },
+            { "sign-methods", [](const std::vector<std::string>& meshes) { Benchmark::SignMethods(meshes, 32); } },
+            { "brick-culling", [](const std::vector<std::string>& meshes) { Benchmark::BrickCulling(meshes, 128); } },
+            { "hierarchical-baking", [](const std::vector<std::string>& meshes) { Benchmark::HierarchicalBaking(meshes, 256, 64); } },
+            { "closest-features", [](const std::vector<std::string>& meshes) { Benchmark::ClosestFeatures(meshes, 64); } },
+            { "noise-baking", [](const std::vector<std::string>&) { Benchmark::NoiseBaking(256); } },
+            { "procedural-shapes", [](const std::vector<std::string>&) { Benchmark::ProceduralShapes(256); } },
+            { "growth-simulation", [](const std::vector<std::string>&) { Benchmark::GrowthSimulation(128, 10); } },
+            { "sparse-growth", [](const std::vector<std::string>&) { Benchmark::SparseGrowth(128, 60); } },
+            { "growth-behaviours", [](const std::vector<std::string>&) { Benchmark::GrowthBehaviours(128, 10); } },
+            { "derivative-field", [](const std::vector<std::string>&) { Benchmark::DerivativeField(128, 10); } },
+            { "separable-relaxation", [](const std::vector<std::string>&) { Benchmark::SeparableRelaxation(64, 3); } }
+        };
+
+        return entries;
+    }
+
+    // All of them without a name
+    bool runBenchmarks(const std::string& name) {
+        std::vector<std::string> meshes = { "meshes/bunny.obj", "meshes/dragon.obj", "meshes/head.obj", "meshes/killaroo.obj", "meshes/lucy.obj", "meshes/teapot.obj" };
+        bool found = false;
+
+        for (const BenchmarkEntry& entry : benchmarkEntries()) {
+            if (name.empty() || name == entry.name) {
+                entry.run(meshes);
+                found = true;
+            }
+        }
+
+        if (!found) {
+            std::cout << "Unknown benchmark " << name << ", expected one of:";
+
+            for (const BenchmarkEntry& entry : benchmarkEntries())
+                std::cout << " " << entry.name;
+
+            std::cout << std::endl;
+        }
+
+        return found;
+    }
 }
 
-int main() {
+int main(int argc, char** argv) {
+
+	// AVX2 is a hard requirement of x64 builds, there is no scalar fallback at runtime: the compiler may use it anywhere in
+	// the files built with it, including inline functions from headers that the linker can pick for the whole program.
+	// This turns the illegal instruction into a message, unless a static initializer of those files got there first.
+	if ((SdfBaker::UsesAVX2() || NoiseBaker::UsesAVX2() || GrowthSimulator::UsesAVX2()) && !Parallel::HasAVX2()) {
+		std::cout << "This build needs a CPU with AVX2 and FMA, build without /arch:AVX2 to run on this one" << std::endl;
+		return 1;
+	}
+
+	// Offline measurements instead of the application: --benchmark [name], all of them without a name
+	if (argc >= 2 && std::string(argv[1]) == "--benchmark") {
+		return runBenchmarks(argc > 2 ? argv[2] : "") ? 0 : 1;
+	}
+
+	// Headless baking: --bake mesh.obj output.sdf [resolution] [scale] [band] [coarse]
+	if (argc >= 4 && std::string(argv[1]) == "--bake") {
+		int resolution = argc > 4 ? atoi(argv[4]) : SCENE_SDF_RESOLUTION;
+		float scaleMultiplier = argc > 5 ? static_cast<float>(atof(argv[5])) : 1.f;
+		int bandWidth = argc > 6 ? atoi(argv[6]) : 0;
+		int coarseResolution = argc > 7 ? atoi(argv[7]) : 0;
+		return bakeMeshSDF(argv[2], argv[3], resolution, scaleMultiplier, bandWidth, coarseResolution) ? 0 : 1;
+	}
+
+	// Headless procedural shapes: --bake-shape minion|spheres|cubes output.sdf [resolution]
+	if (argc >= 4 && std::string(argv[1]) == "--bake-shape") {
+		int resolution = argc > 4 ? atoi(argv[4]) : SCENE_SDF_RESOLUTION;
+		return bakeShapeSDF(argv[2], argv[3], resolution) ? 0 : 1;
+	}
+
+	// Headless growth: --grow molten-core|demon-bunny|coral|mushroom|behaviour.txt mesh.obj|shape output.sdf [steps] [resolution] [scale]
+	if (argc >= 5 && std::string(argv[1]) == "--grow") {
+		int steps = argc > 5 ? atoi(argv[5]) : GROWTH_FULL_STEPS;
+		int resolution = argc > 6 ? atoi(argv[6]) : SCENE_SDF_RESOLUTION;
+		float scaleMultiplier = argc > 7 ? static_cast<float>(atof(argv[7])) : 1.f;
+		return growSDF(argv[2], argv[3], argv[4], steps, resolution, scaleMultiplier) ? 0 : 1;
+	}
+
+	// --shape minion|spheres|cubes seeds the growth with a procedural shape instead of the mesh
+	// --behaviour molten-core|demon-bunny|coral|mushroom|behaviour.txt grows with it instead of the mushroom
+	// --check-step time compares the first kernel step, run at that time, with GrowthSimulator before growing on
+	std::string shape;
+	GrowthBehaviour behaviour = GrowthBehaviour::FromPreset(GrowthPreset::Mushroom);
+	bool checkStep = false;
+	float checkStepTime = 0.f;
+
+	for (int i = 1; i + 1 < argc; i += 2) {
+		std::string option = argv[i];
+		std::string error;
+
+		if (option == "--shape") {
+			shape = argv[i + 1];
+		}
+		else if (option == "--behaviour") {
+			if (!GrowthBehaviour::FromName(argv[i + 1], behaviour, error)) {
+				throw std::runtime_error(error);
+			}
+		}
+		else if (option == "--check-step") {
+			checkStep = true;
+			checkStepTime = static_cast<float>(atof(argv[i + 1]));
+		}
+	}
 
 	system("compiler.bat");
 	
@@ -186,24 +482,65 @@ int main() {
 	scene->LoadMesh("meshes/mushroom_base.obj", .4f);
 
     renderer = new Renderer(device, swapChain, scene, camera);
-	renderer->GenerateSceneSDF();
+	renderer->SetGrowthBehaviour(behaviour);
+
+	bool generated = true;
+
+	if (!shape.empty()) {
+		SdfGraph graph;
+		SdfGraph::Node root = SdfShapes::ByName(graph, shape);
+
+		if (root < 0) {
+			throw std::runtime_error("Unknown shape " + shape);
+		}
+
+		// The generator won't run to write the vector field, so it is always baked on the CPU here
+		renderer->UpdateVectorField();
+
+		renderer->LoadProceduralSDF(graph.Compile(root));
+	}
+	else {
+		// Keeps the window responsive while the generator runs, closing it cancels generation
+		generated = renderer->GenerateSceneSDF([](int finishedTiles, int tileCount) {
+			glfwPollEvents();
+			std::cout << "\rGenerating SDF " << (100 * finishedTiles) / tileCount << "%" << std::flush;
+			return !ShouldQuit();
+		});
+	}
 
 	float delta = scene->UpdateTime();
 
-	std::cout << "SDF generated in " << delta << " seconds " << std::endl;
-	
-    glfwSetWindowSizeCallback(GetGLFWWindow(), resizeCallback);
-    glfwSetMouseButtonCallback(GetGLFWWindow(), mouseDownCallback);
-    glfwSetCursorPosCallback(GetGLFWWindow(), mouseMoveCallback);
-	
-    while (!ShouldQuit()) {
-        glfwPollEvents();
-        scene->UpdateTime();
-        renderer->Frame();
-    }
+	if (generated)
+		std::cout << std::endl << "SDF generated in " << delta << " seconds " << std::endl;
+	else
+		std::cout << std::endl << "SDF generation cancelled after " << delta << " seconds " << std::endl;
+
+	// Debug builds run the generator batches, fences and timestamp queries under the validation layers
+	if (ENABLE_VALIDATION)
+		std::cout << "Validation layers after generation: " << instance->GetValidationErrorCount() << " errors, " << instance->GetValidationWarningCount() << " warnings" << std::endl;
+
+	// Closing the window cancelled generation: the sdf is half written, so nothing grows or renders from it
+	if (generated) {
+		if (checkStep)
+			renderer->CompareKernelStep(checkStepTime);
+
+		glfwSetWindowSizeCallback(GetGLFWWindow(), resizeCallback);
+		glfwSetMouseButtonCallback(GetGLFWWindow(), mouseDownCallback);
+		glfwSetCursorPosCallback(GetGLFWWindow(), mouseMoveCallback);
+		glfwSetKeyCallback(GetGLFWWindow(), keyCallback);
+
+		while (!ShouldQuit()) {
+			glfwPollEvents();
+			scene->UpdateTime();
+			renderer->Frame();
+		}
+	}
 
     vkDeviceWaitIdle(device->GetVkDevice());
 
+	if (ENABLE_VALIDATION)
+		std::cout << "Validation layers in total: " << instance->GetValidationErrorCount() << " errors, " << instance->GetValidationWarningCount() << " warnings" << std::endl;
+
     vkDestroyImage(device->GetVkDevice(), grassImage, nullptr);
     vkFreeMemory(device->GetVkDevice(), grassImageMemory, nullptr);
 